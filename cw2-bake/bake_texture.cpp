@@ -0,0 +1,382 @@
+#include "bake_texture.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#include "compress_texture.hpp"
+
+#include "../labutils/error.hpp"
+#include "../labutils/image_decoder.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	// A destination texel covers at most three source texels per axis (3->1)
+	constexpr std::size_t kMaxTaps_ = 3;
+
+	struct Tap_
+	{
+		std::uint32_t first;
+		std::uint32_t count;
+		float weights[kMaxTaps_];
+	};
+
+	std::vector<Tap_> compute_taps_( std::uint32_t aSrc, std::uint32_t aDst );
+
+	std::vector<float> downsample_( std::vector<float> const&, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aChannels, std::uint32_t aNewWidth, std::uint32_t aNewHeight );
+
+	float srgb_to_linear_( float );
+	float linear_to_srgb_( float );
+
+	void checked_write_( FILE*, std::size_t, void const*, char const* aPath );
+}
+
+baked::BakedTextureFormat compressed_format( baked::BakedTextureFormat aFormat, ETextureCompression aCompression, bool aOpaque )
+{
+	if( ETextureCompression::none == aCompression )
+		return aFormat;
+
+	switch( aFormat )
+	{
+		case baked::kBakedTextureR8Unorm:
+			return baked::kBakedTextureBc4Unorm;
+		case baked::kBakedTextureRgba8Unorm:
+			return baked::kBakedTextureBc5Unorm;
+		case baked::kBakedTextureRgba8Srgb:
+			return ETextureCompression::bc1 == aCompression && aOpaque
+				? baked::kBakedTextureBc1Srgb
+				: baked::kBakedTextureBc7Srgb
+			;
+		default:
+			return aFormat;
+	}
+}
+
+TextureMips build_texture_mips( std::uint8_t const* aTexels, std::uint32_t aWidth, std::uint32_t aHeight, baked::BakedTextureFormat aFormat )
+{
+	assert( aWidth > 0 && aHeight > 0 );
+
+	auto const channels = baked::texture_channels( aFormat );
+	auto const srgb = baked::kBakedTextureRgba8Srgb == aFormat;
+
+	// sRGB applies to the color channels only; alpha is stored linearly
+	auto const is_srgb_ = [&] (std::size_t aIndex) {
+		return srgb && 3 != aIndex % channels;
+	};
+
+	TextureMips ret;
+	ret.format = aFormat;
+
+	auto& base = ret.levels.emplace_back();
+	base.width = aWidth;
+	base.height = aHeight;
+	base.texels.assign( aTexels, aTexels + std::size_t(aWidth) * aHeight * channels );
+
+	float toLinear[256];
+	for( int i = 0; i < 256; ++i )
+		toLinear[i] = srgb_to_linear_( i / 255.f );
+
+	// Keep the current level in floating point, so that rounding errors do
+	// not accumulate down the chain
+	std::vector<float> current( base.texels.size() );
+	for( std::size_t i = 0; i < current.size(); ++i )
+		current[i] = is_srgb_( i ) ? toLinear[base.texels[i]] : base.texels[i] / 255.f;
+
+	std::uint32_t width = aWidth, height = aHeight;
+	while( width > 1 || height > 1 )
+	{
+		auto const newWidth = std::max( width >> 1, 1u );
+		auto const newHeight = std::max( height >> 1, 1u );
+
+		current = downsample_( current, width, height, channels, newWidth, newHeight );
+		width = newWidth;
+		height = newHeight;
+
+		auto& level = ret.levels.emplace_back();
+		level.width = width;
+		level.height = height;
+		level.texels.resize( current.size() );
+
+		for( std::size_t i = 0; i < current.size(); ++i )
+		{
+			auto const value = is_srgb_( i ) ? linear_to_srgb_( current[i] ) : current[i];
+			level.texels[i] = std::uint8_t(std::clamp( value, 0.f, 1.f ) * 255.f + 0.5f);
+		}
+	}
+
+	return ret;
+}
+
+double compress_texture_mips( TextureMips& aMips, baked::BakedTextureFormat aFormat )
+{
+	assert( !aMips.levels.empty() );
+	assert( baked::texture_channels( aFormat ) == baked::texture_channels( aMips.format ) );
+
+	double psnr = 0.0;
+	for( auto& level : aMips.levels )
+	{
+		auto blocks = compress_image( level.texels.data(), level.width, level.height, aFormat );
+
+		if( &level == &aMips.levels.front() )
+		{
+			auto const decoded = decompress_image( blocks.data(), level.width, level.height, aFormat );
+			psnr = compression_psnr( level.texels.data(), decoded.data(), level.width, level.height, aFormat );
+		}
+
+		level.texels = std::move(blocks);
+	}
+
+	aMips.format = aFormat;
+	return psnr;
+}
+
+void write_baked_texture( char const* aPath, TextureMips const& aMips )
+{
+	assert( !aMips.levels.empty() );
+
+	baked::BakedTextureHeader header{};
+	std::memcpy( header.magic, baked::kTextureMagic, sizeof(header.magic) );
+	header.format = aMips.format;
+	header.width = aMips.levels[0].width;
+	header.height = aMips.levels[0].height;
+	header.levelCount = std::uint32_t(aMips.levels.size());
+
+	std::vector<baked::BakedTextureLevel> levels( aMips.levels.size() );
+
+	std::uint64_t offset = sizeof(header) + levels.size() * sizeof(baked::BakedTextureLevel);
+	for( std::size_t i = 0; i < levels.size(); ++i )
+	{
+		offset = baked::align_up( offset, baked::kBakedTextureAlign );
+
+		levels[i].offset = offset;
+		levels[i].size = aMips.levels[i].texels.size();
+		levels[i].width = aMips.levels[i].width;
+		levels[i].height = aMips.levels[i].height;
+
+		offset += levels[i].size;
+	}
+
+	FILE* fof = std::fopen( aPath, "wb" );
+	if( !fof )
+		throw lut::Error( "Unable to open '%s' for writing", aPath );
+
+	try
+	{
+		checked_write_( fof, sizeof(header), &header, aPath );
+		checked_write_( fof, levels.size() * sizeof(baked::BakedTextureLevel), levels.data(), aPath );
+
+		static constexpr std::uint8_t kZeros[baked::kBakedTextureAlign]{};
+
+		std::uint64_t written = sizeof(header) + levels.size() * sizeof(baked::BakedTextureLevel);
+		for( std::size_t i = 0; i < levels.size(); ++i )
+		{
+			checked_write_( fof, std::size_t(levels[i].offset - written), kZeros, aPath );
+			checked_write_( fof, aMips.levels[i].texels.size(), aMips.levels[i].texels.data(), aPath );
+
+			written = levels[i].offset + levels[i].size;
+		}
+	}
+	catch( ... )
+	{
+		std::fclose( fof );
+		throw;
+	}
+
+	if( 0 != std::fclose( fof ) )
+		throw lut::Error( "%s: fclose() failed", aPath );
+}
+
+TextureBakeInfo bake_texture( char const* aInput, char const* aOutput, baked::BakedTextureFormat aFormat, ETextureCompression aCompression )
+{
+	auto const image = lut::load_image_data( aInput, baked::texture_channels( aFormat ) );
+	auto mips = build_texture_mips( image.pixels.get(), image.width, image.height, aFormat );
+
+	bool opaque = true;
+	if( 4 == image.channels )
+	{
+		auto const* texels = image.pixels.get();
+		for( std::size_t i = 3; i < image.size_bytes() && opaque; i += 4 )
+			opaque = 255 == texels[i];
+	}
+
+	TextureBakeInfo ret;
+	ret.format = compressed_format( aFormat, aCompression, opaque );
+	ret.width = image.width;
+	ret.height = image.height;
+	ret.psnr = std::numeric_limits<double>::infinity();
+
+	if( ret.format != aFormat )
+		ret.psnr = compress_texture_mips( mips, ret.format );
+
+	write_baked_texture( aOutput, mips );
+	return ret;
+}
+
+TextureBakeInfo bake_packed_texture( PackedChannel const aInputs[4], char const* aOutput, ETextureCompression aCompression )
+{
+	constexpr std::size_t kChannels = 4;
+
+	lut::ImageData images[kChannels];
+
+	std::uint32_t width = 1, height = 1;
+	for( std::size_t c = 0; c < kChannels; ++c )
+	{
+		auto const* path = aInputs[c].path;
+		if( !path || !*path )
+			continue;
+
+		// stb_image computes the luminance when asked for one channel, and
+		// drops alpha when doing so
+		images[c] = lut::load_image_data( path, aInputs[c].alpha ? 4 : 1 );
+		width = std::max( width, images[c].width );
+		height = std::max( height, images[c].height );
+	}
+
+	std::vector<std::uint8_t> texels( std::size_t(width) * height * kChannels );
+	for( std::size_t c = 0; c < kChannels; ++c )
+	{
+		auto const& image = images[c];
+		if( !image.pixels )
+		{
+			for( std::size_t i = c; i < texels.size(); i += kChannels )
+				texels[i] = aInputs[c].fill;
+			continue;
+		}
+
+		// Single channel, or the alpha (last) channel of RGBA
+		auto const stride = image.channels;
+		auto const offset = image.channels - 1;
+
+		for( std::uint32_t y = 0; y < height; ++y )
+		{
+			auto const sy = std::uint32_t(std::uint64_t(y) * image.height / height);
+			auto const* src = image.pixels.get() + std::size_t(sy) * image.width * stride + offset;
+			auto* dst = texels.data() + std::size_t(y) * width * kChannels + c;
+
+			for( std::uint32_t x = 0; x < width; ++x )
+				dst[x*kChannels] = src[std::uint64_t(x) * image.width / width * stride];
+		}
+	}
+
+	auto mips = build_texture_mips( texels.data(), width, height, baked::kBakedTextureRgba8Unorm );
+
+	TextureBakeInfo ret;
+	ret.format = baked::kBakedTextureRgba8Unorm;
+	ret.width = width;
+	ret.height = height;
+	ret.psnr = std::numeric_limits<double>::infinity();
+
+	if( ETextureCompression::none != aCompression )
+	{
+		ret.format = baked::kBakedTextureBc7Unorm;
+		ret.psnr = compress_texture_mips( mips, ret.format );
+	}
+
+	write_baked_texture( aOutput, mips );
+	return ret;
+}
+
+namespace
+{
+	std::vector<Tap_> compute_taps_( std::uint32_t aSrc, std::uint32_t aDst )
+	{
+		assert( aDst > 0 && aDst <= aSrc && aSrc <= 3*aDst );
+
+		std::vector<Tap_> ret( aDst );
+
+		// Destination texel i covers the source interval [i*aSrc, (i+1)*aSrc)
+		// in units of 1/aDst source texels; integers keep this exact.
+		for( std::uint32_t i = 0; i < aDst; ++i )
+		{
+			std::uint64_t const lo = std::uint64_t(i) * aSrc;
+			std::uint64_t const hi = lo + aSrc;
+
+			auto& tap = ret[i];
+			tap.first = std::uint32_t(lo / aDst);
+			tap.count = std::uint32_t((hi + aDst - 1) / aDst) - tap.first;
+			assert( tap.count >= 1 && tap.count <= kMaxTaps_ );
+
+			for( std::uint32_t k = 0; k < tap.count; ++k )
+			{
+				auto const a = std::max( lo, std::uint64_t(tap.first + k) * aDst );
+				auto const b = std::min( hi, std::uint64_t(tap.first + k + 1) * aDst );
+				tap.weights[k] = float(b - a) / aSrc;
+			}
+		}
+
+		return ret;
+	}
+
+	std::vector<float> downsample_( std::vector<float> const& aSrc, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aChannels, std::uint32_t aNewWidth, std::uint32_t aNewHeight )
+	{
+		auto const xtaps = compute_taps_( aWidth, aNewWidth );
+		auto const ytaps = compute_taps_( aHeight, aNewHeight );
+
+		// Horizontal pass: aHeight rows of aNewWidth texels
+		std::vector<float> rows( std::size_t(aNewWidth) * aHeight * aChannels, 0.f );
+		for( std::uint32_t y = 0; y < aHeight; ++y )
+		{
+			float const* src = aSrc.data() + std::size_t(y) * aWidth * aChannels;
+			float* dst = rows.data() + std::size_t(y) * aNewWidth * aChannels;
+
+			for( std::uint32_t x = 0; x < aNewWidth; ++x )
+			{
+				auto const& tap = xtaps[x];
+				for( std::uint32_t k = 0; k < tap.count; ++k )
+				{
+					for( std::uint32_t c = 0; c < aChannels; ++c )
+						dst[x*aChannels + c] += tap.weights[k] * src[(tap.first + k)*aChannels + c];
+				}
+			}
+		}
+
+		// Vertical pass
+		auto const rowSize = std::size_t(aNewWidth) * aChannels;
+
+		std::vector<float> ret( rowSize * aNewHeight, 0.f );
+		for( std::uint32_t y = 0; y < aNewHeight; ++y )
+		{
+			auto const& tap = ytaps[y];
+			float* dst = ret.data() + y * rowSize;
+
+			for( std::uint32_t k = 0; k < tap.count; ++k )
+			{
+				float const* src = rows.data() + (tap.first + k) * rowSize;
+				for( std::size_t i = 0; i < rowSize; ++i )
+					dst[i] += tap.weights[k] * src[i];
+			}
+		}
+
+		return ret;
+	}
+
+	float srgb_to_linear_( float aValue )
+	{
+		return aValue <= 0.04045f
+			? aValue / 12.92f
+			: std::pow( (aValue + 0.055f) / 1.055f, 2.4f )
+		;
+	}
+	float linear_to_srgb_( float aValue )
+	{
+		return aValue <= 0.0031308f
+			? aValue * 12.92f
+			: 1.055f * std::pow( aValue, 1.f / 2.4f ) - 0.055f
+		;
+	}
+
+	void checked_write_( FILE* aOut, std::size_t aBytes, void const* aData, char const* aPath )
+	{
+		auto const ret = std::fwrite( aData, 1, aBytes, aOut );
+
+		if( ret != aBytes )
+			throw lut::Error( "%s: fwrite() failed: %zu instead of %zu", aPath, ret, aBytes );
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,90 @@
+#ifndef BAKE_TEXTURE_HPP_1F6C3A82_94D7_4E0B_B25A_7C08E3D9416F
+#define BAKE_TEXTURE_HPP_1F6C3A82_94D7_4E0B_B25A_7C08E3D9416F
+
+#include <vector>
+
+#include <cstdint>
+
+#include "../cw2/baked_format.hpp"
+
+enum class ETextureCompression
+{
+	none,
+	bc7, // BC7 for color, BC4 for single channel textures, BC5 for normal maps
+	bc1  // as bc7, but BC1 for opaque color textures
+};
+
+// Storage format of a texture that the runtime uses as aFormat (see
+// find_unique_textures_() in main.cpp). aOpaque tells whether all texels
+// have an alpha of 255; BC1 is only used for opaque textures. The only
+// textures used as kBakedTextureRgba8Unorm are normal maps, which are stored
+// as BC5 (x and y only).
+baked::BakedTextureFormat compressed_format( baked::BakedTextureFormat, ETextureCompression, bool aOpaque );
+
+// Full mip chain of an 8-bit image, largest level first. Rows are stored
+// bottom-up, like the decoded input.
+struct TextureMips
+{
+	baked::BakedTextureFormat format;
+
+	struct Level
+	{
+		std::uint32_t width, height;
+		std::vector<std::uint8_t> texels;
+	};
+
+	std::vector<Level> levels;
+};
+
+// Builds the mip chain of an image with texture_channels(aFormat) channels,
+// down to 1x1. Level 0 is a copy of the input. Each further level is box
+// filtered from the previous one: every texel is the area-weighted average
+// of the texels it covers, which is a plain 2x2 average for even sizes and
+// stays correct for odd ones. Filtering happens in floating point; with
+// kBakedTextureRgba8Srgb, the color channels are converted to linear first
+// (alpha is always linear).
+TextureMips build_texture_mips(
+	std::uint8_t const* aTexels,
+	std::uint32_t aWidth,
+	std::uint32_t aHeight,
+	baked::BakedTextureFormat
+);
+
+// Compresses each level of aMips (see compress_texture.hpp) to aFormat,
+// which must be a compressed format. Returns the PSNR of level 0.
+double compress_texture_mips( TextureMips&, baked::BakedTextureFormat );
+
+// Writes a baked texture container (see baked_format.hpp). Throws
+// labutils::Error on failure.
+void write_baked_texture( char const* aPath, TextureMips const& );
+
+struct TextureBakeInfo
+{
+	baked::BakedTextureFormat format; // as stored
+	std::uint32_t width, height;
+	double psnr; // of level 0; infinite without compression
+};
+
+// Decodes the image at aInput, builds its mip chain, optionally compresses it
+// and writes the result to aOutput. Thread-safe.
+TextureBakeInfo bake_texture( char const* aInput, char const* aOutput, baked::BakedTextureFormat, ETextureCompression );
+
+// Source of one channel of a packed texture. Without a path, the channel is
+// filled with a constant.
+struct PackedChannel
+{
+	char const* path;  // may be null or empty
+	bool alpha;        // use the alpha of the RGBA image, not its luminance
+	std::uint8_t fill; // value used without a path
+};
+
+// Packs up to four images into the channels of one linear RGBA texture (see
+// kBakedMaterialPackedRma in baked_format.hpp), then bakes it like
+// bake_texture(). aInputs describes one channel each. Inputs of different
+// sizes are resampled to the largest width and height with nearest neighbour
+// filtering; without any inputs, the result is a single texel. Stored as BC7
+// with any compression, since BC1's 5:6:5 endpoints are too coarse for
+// material parameters. Thread-safe.
+TextureBakeInfo bake_packed_texture( PackedChannel const aInputs[4], char const* aOutput, ETextureCompression );
+
+#endif // BAKE_TEXTURE_HPP_1F6C3A82_94D7_4E0B_B25A_7C08E3D9416F
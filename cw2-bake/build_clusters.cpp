@@ -0,0 +1,161 @@
+#include "build_clusters.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	// Below this, the normal cone is considered too wide to be useful
+	constexpr float kMinConeDot_ = 0.1f;
+
+	void compute_bounds_( baked::BakedClusterRecordV2&, IndexedMesh const& );
+}
+
+std::vector<baked::BakedClusterRecordV2> build_clusters( IndexedMesh const& aMesh, std::uint32_t aMeshId, std::uint32_t aMaxVertices, std::uint32_t aMaxTriangles )
+{
+	assert( aMaxVertices >= 3 && aMaxTriangles >= 1 );
+	assert( 0 == aMesh.indices.size() % 3 );
+
+	std::vector<baked::BakedClusterRecordV2> ret;
+
+	// Cluster that each vertex was last added to
+	constexpr std::uint32_t kNone = ~std::uint32_t(0);
+	std::vector<std::uint32_t> owner( aMesh.vert.size(), kNone );
+
+	baked::BakedClusterRecordV2 current{};
+	current.meshId = aMeshId;
+
+	auto const flush_ = [&] {
+		if( 0 == current.indexCount )
+			return;
+
+		compute_bounds_( current, aMesh );
+		ret.emplace_back( current );
+
+		current.firstIndex += current.indexCount;
+		current.indexCount = 0;
+		current.vertexCount = 0;
+	};
+
+	for( std::size_t i = 0; i < aMesh.indices.size(); i += 3 )
+	{
+		auto const clusterId = std::uint32_t(ret.size());
+
+		std::uint32_t added = 0;
+		for( std::size_t k = 0; k < 3; ++k )
+		{
+			auto const v = aMesh.indices[i+k];
+			bool const seen = clusterId == owner[v]
+				|| (k >= 1 && v == aMesh.indices[i])
+				|| (k >= 2 && v == aMesh.indices[i+1])
+			;
+			if( !seen )
+				++added;
+		}
+
+		if( current.vertexCount + added > aMaxVertices || current.indexCount/3 + 1 > aMaxTriangles )
+			flush_();
+
+		auto const id = std::uint32_t(ret.size());
+		for( std::size_t k = 0; k < 3; ++k )
+		{
+			auto const v = aMesh.indices[i+k];
+			if( id != owner[v] )
+			{
+				owner[v] = id;
+				++current.vertexCount;
+			}
+		}
+
+		current.indexCount += 3;
+	}
+
+	flush_();
+
+	return ret;
+}
+
+namespace
+{
+	void compute_bounds_( baked::BakedClusterRecordV2& aCluster, IndexedMesh const& aMesh )
+	{
+		auto const beg = aCluster.firstIndex;
+		auto const end = aCluster.firstIndex + aCluster.indexCount;
+
+		// Bounding sphere: center of the AABB, radius to the farthest vertex
+		glm::vec3 bmin( std::numeric_limits<float>::max() );
+		glm::vec3 bmax( std::numeric_limits<float>::lowest() );
+		for( auto i = beg; i < end; ++i )
+		{
+			auto const& p = aMesh.vert[aMesh.indices[i]];
+			bmin = glm::min( bmin, p );
+			bmax = glm::max( bmax, p );
+		}
+
+		glm::vec3 const center = 0.5f * (bmin + bmax);
+
+		float radius = 0.f;
+		for( auto i = beg; i < end; ++i )
+			radius = std::max( radius, glm::length( aMesh.vert[aMesh.indices[i]] - center ) );
+
+		// Normal cone: average of the (unit) face normals, and the largest
+		// deviation from it. Degenerate triangles are ignored; they are never
+		// rasterized.
+		glm::vec3 axis( 0.f );
+		for( auto i = beg; i < end; i += 3 )
+		{
+			auto const& a = aMesh.vert[aMesh.indices[i+0]];
+			auto const& b = aMesh.vert[aMesh.indices[i+1]];
+			auto const& c = aMesh.vert[aMesh.indices[i+2]];
+
+			auto const n = glm::cross( b - a, c - a );
+			auto const len = glm::length( n );
+			if( len > 0.f )
+				axis += n / len;
+		}
+
+		float minDot = 1.f;
+		float const axisLen = glm::length( axis );
+		if( axisLen > 0.f )
+		{
+			axis /= axisLen;
+
+			for( auto i = beg; i < end; i += 3 )
+			{
+				auto const& a = aMesh.vert[aMesh.indices[i+0]];
+				auto const& b = aMesh.vert[aMesh.indices[i+1]];
+				auto const& c = aMesh.vert[aMesh.indices[i+2]];
+
+				auto const n = glm::cross( b - a, c - a );
+				auto const len = glm::length( n );
+				if( len > 0.f )
+					minDot = std::min( minDot, glm::dot( axis, n / len ) );
+			}
+		}
+
+		for( int k = 0; k < 3; ++k )
+			aCluster.center[k] = center[k];
+		aCluster.radius = radius;
+
+		if( axisLen <= 0.f || minDot < kMinConeDot_ )
+		{
+			aCluster.coneAxis[0] = aCluster.coneAxis[1] = aCluster.coneAxis[2] = 0.f;
+			aCluster.coneCutoff = 1.f;
+		}
+		else
+		{
+			for( int k = 0; k < 3; ++k )
+				aCluster.coneAxis[k] = axis[k];
+
+			// sin() of the cone's half angle
+			aCluster.coneCutoff = std::sqrt( std::max( 0.f, 1.f - minDot*minDot ) );
+		}
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,28 @@
+#ifndef BUILD_CLUSTERS_HPP_E83A61C4_0F2D_47B9_A5C8_6B91D7E204F3
+#define BUILD_CLUSTERS_HPP_E83A61C4_0F2D_47B9_A5C8_6B91D7E204F3
+
+#include <vector>
+
+#include <cstdint>
+
+#include "index_mesh.hpp"
+
+#include "../cw2/baked_format.hpp"
+
+constexpr std::uint32_t kClusterMaxVertices = 64;
+constexpr std::uint32_t kClusterMaxTriangles = 124;
+
+// Splits the index buffer of aMesh into clusters of consecutive triangles,
+// each referencing at most aMaxVertices unique vertices and containing at
+// most aMaxTriangles triangles. Clusters are formed greedily in index buffer
+// order, so this works best after optimize_vertex_cache(). The returned
+// records have meshId set to aMeshId and include the bounds described in
+// baked_format.hpp.
+std::vector<baked::BakedClusterRecordV2> build_clusters(
+	IndexedMesh const&,
+	std::uint32_t aMeshId,
+	std::uint32_t aMaxVertices = kClusterMaxVertices,
+	std::uint32_t aMaxTriangles = kClusterMaxTriangles
+);
+
+#endif // BUILD_CLUSTERS_HPP_E83A61C4_0F2D_47B9_A5C8_6B91D7E204F3
@@ -0,0 +1,874 @@
+#include "compress_texture.hpp"
+
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+#include <cstring>
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define COMPRESS_SSE_ 1
+#endif
+
+namespace
+{
+	constexpr std::uint32_t kBlockTexels_ = 16;
+
+	// Refinement passes after the initial (principal axis) endpoints
+	constexpr int kRefinePasses_ = 2;
+
+	// Texels of a 4x4 block in row-major order, one array per channel
+	struct Block_
+	{
+		alignas(16) float c[4][kBlockTexels_];
+	};
+
+	// Colors that the indices of a block select from
+	struct Palette_
+	{
+		float v[16][4];
+		std::uint32_t count;
+	};
+
+	// Fixed-size bit stream, least significant bit first
+	struct Bits_
+	{
+		std::uint8_t* data;
+		std::uint32_t pos = 0;
+
+		void put( std::uint32_t aValue, std::uint32_t aBits )
+		{
+			for( std::uint32_t i = 0; i < aBits; ++i, ++pos )
+			{
+				if( (aValue >> i) & 1u )
+					data[pos >> 3] |= std::uint8_t(1u << (pos & 7));
+			}
+		}
+
+		std::uint32_t get( std::uint32_t aBits )
+		{
+			std::uint32_t ret = 0;
+			for( std::uint32_t i = 0; i < aBits; ++i, ++pos )
+				ret |= std::uint32_t((data[pos >> 3] >> (pos & 7)) & 1u) << i;
+			return ret;
+		}
+	};
+
+	void load_block_( Block_&, std::uint8_t const* aTexels, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aChannels, std::uint32_t aX, std::uint32_t aY );
+
+	// Picks the closest palette entry for each texel, considering the first
+	// aChannels channels. Returns the total squared error.
+	float select_indices_( Block_ const&, std::uint32_t aChannels, Palette_ const&, std::uint8_t aIndices[kBlockTexels_] );
+
+	void principal_endpoints_( Block_ const&, std::uint32_t aChannels, float aE0[4], float aE1[4] );
+
+	// Least squares endpoints for the given indices; aWeights[i] is the
+	// interpolation weight of index i between the two endpoints. Returns
+	// false if the system is degenerate (e.g., all texels use one index).
+	bool refit_endpoints_( Block_ const&, std::uint32_t aChannels, std::uint8_t const aIndices[kBlockTexels_], float const* aWeights, float aE0[4], float aE1[4] );
+
+	void encode_bc1_( Block_ const&, std::uint8_t* aOut );
+	void encode_bc4_( Block_ const&, std::uint32_t aChannel, std::uint8_t* aOut );
+	void encode_bc7_( Block_ const&, std::uint8_t* aOut );
+
+	void decode_bc1_( std::uint8_t const*, std::uint8_t aRgba[kBlockTexels_][4] );
+	void decode_bc4_( std::uint8_t const*, std::uint8_t aValues[kBlockTexels_] );
+	void decode_bc7_( std::uint8_t const*, std::uint8_t aRgba[kBlockTexels_][4] );
+
+	// Channels stored by a compressed format, as a bit mask (1 = R, 2 = G, ..)
+	std::uint32_t stored_channels_( baked::BakedTextureFormat );
+}
+
+std::vector<std::uint8_t> compress_image( std::uint8_t const* aTexels, std::uint32_t aWidth, std::uint32_t aHeight, baked::BakedTextureFormat aFormat )
+{
+	assert( baked::texture_is_compressed( aFormat ) );
+
+	auto const channels = baked::texture_channels( aFormat );
+	auto const blockBytes = baked::texture_block_bytes( aFormat );
+
+	std::vector<std::uint8_t> ret( baked::texture_level_size( aFormat, aWidth, aHeight ), 0 );
+
+	std::uint8_t* out = ret.data();
+	for( std::uint32_t y = 0; y < aHeight; y += 4 )
+	{
+		for( std::uint32_t x = 0; x < aWidth; x += 4 )
+		{
+			Block_ block;
+			load_block_( block, aTexels, aWidth, aHeight, channels, x, y );
+
+			switch( aFormat )
+			{
+				case baked::kBakedTextureBc1Srgb:
+					encode_bc1_( block, out );
+					break;
+				case baked::kBakedTextureBc4Unorm:
+					encode_bc4_( block, 0, out );
+					break;
+				case baked::kBakedTextureBc5Unorm:
+					encode_bc4_( block, 0, out );
+					encode_bc4_( block, 1, out+8 );
+					break;
+				case baked::kBakedTextureBc7Srgb:
+				case baked::kBakedTextureBc7Unorm:
+					encode_bc7_( block, out );
+					break;
+				default:
+					assert( false );
+			}
+
+			out += blockBytes;
+		}
+	}
+
+	return ret;
+}
+
+std::vector<std::uint8_t> decompress_image( std::uint8_t const* aBlocks, std::uint32_t aWidth, std::uint32_t aHeight, baked::BakedTextureFormat aFormat )
+{
+	assert( baked::texture_is_compressed( aFormat ) );
+
+	auto const channels = baked::texture_channels( aFormat );
+	auto const blockBytes = baked::texture_block_bytes( aFormat );
+
+	std::vector<std::uint8_t> ret( std::size_t(aWidth) * aHeight * channels, 0 );
+
+	std::uint8_t const* in = aBlocks;
+	for( std::uint32_t y = 0; y < aHeight; y += 4 )
+	{
+		for( std::uint32_t x = 0; x < aWidth; x += 4 )
+		{
+			std::uint8_t rgba[kBlockTexels_][4]{};
+			std::uint8_t values[kBlockTexels_];
+
+			switch( aFormat )
+			{
+				case baked::kBakedTextureBc1Srgb:
+					decode_bc1_( in, rgba );
+					break;
+				case baked::kBakedTextureBc4Unorm:
+					decode_bc4_( in, values );
+					for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+						rgba[i][0] = values[i];
+					break;
+				case baked::kBakedTextureBc5Unorm:
+					decode_bc4_( in, values );
+					for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+						rgba[i][0] = values[i];
+					decode_bc4_( in+8, values );
+					for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+					{
+						rgba[i][1] = values[i];
+						rgba[i][3] = 255; // as sampled: (r, g, 0, 1)
+					}
+					break;
+				case baked::kBakedTextureBc7Srgb:
+				case baked::kBakedTextureBc7Unorm:
+					decode_bc7_( in, rgba );
+					break;
+				default:
+					assert( false );
+			}
+
+			for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+			{
+				auto const tx = x + i % 4, ty = y + i / 4;
+				if( tx < aWidth && ty < aHeight )
+				{
+					for( std::uint32_t k = 0; k < channels; ++k )
+						ret[(std::size_t(ty) * aWidth + tx) * channels + k] = rgba[i][k];
+				}
+			}
+
+			in += blockBytes;
+		}
+	}
+
+	return ret;
+}
+
+double compression_psnr( std::uint8_t const* aOriginal, std::uint8_t const* aDecoded, std::uint32_t aWidth, std::uint32_t aHeight, baked::BakedTextureFormat aFormat )
+{
+	auto const channels = baked::texture_channels( aFormat );
+	auto const stored = stored_channels_( aFormat );
+
+	double sum = 0.0;
+	std::size_t count = 0;
+
+	auto const texels = std::size_t(aWidth) * aHeight;
+	for( std::size_t i = 0; i < texels; ++i )
+	{
+		for( std::uint32_t k = 0; k < channels; ++k )
+		{
+			if( !(stored & (1u << k)) )
+				continue;
+
+			double const diff = double(aOriginal[i*channels+k]) - aDecoded[i*channels+k];
+			sum += diff * diff;
+			++count;
+		}
+	}
+
+	if( 0.0 == sum )
+		return std::numeric_limits<double>::infinity();
+
+	auto const mse = sum / double(count);
+	return 10.0 * std::log10( 255.0 * 255.0 / mse );
+}
+
+namespace
+{
+	void load_block_( Block_& aBlock, std::uint8_t const* aTexels, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aChannels, std::uint32_t aX, std::uint32_t aY )
+	{
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+		{
+			auto const tx = std::min( aX + i % 4, aWidth-1 );
+			auto const ty = std::min( aY + i / 4, aHeight-1 );
+
+			auto const* texel = aTexels + (std::size_t(ty) * aWidth + tx) * aChannels;
+			for( std::uint32_t k = 0; k < 4; ++k )
+				aBlock.c[k][i] = k < aChannels ? float(texel[k]) : 0.f;
+		}
+	}
+
+	float select_indices_( Block_ const& aBlock, std::uint32_t aChannels, Palette_ const& aPalette, std::uint8_t aIndices[kBlockTexels_] )
+	{
+		assert( aChannels >= 1 && aChannels <= 4 );
+		assert( aPalette.count >= 1 && aPalette.count <= 16 );
+
+		float total = 0.f;
+
+#		if defined(COMPRESS_SSE_)
+		for( std::uint32_t t = 0; t < kBlockTexels_; t += 4 )
+		{
+			__m128 texel[4];
+			for( std::uint32_t k = 0; k < aChannels; ++k )
+				texel[k] = _mm_load_ps( aBlock.c[k] + t );
+
+			auto best = _mm_set1_ps( std::numeric_limits<float>::max() );
+			auto bestIndex = _mm_setzero_si128();
+
+			for( std::uint32_t p = 0; p < aPalette.count; ++p )
+			{
+				auto dist = _mm_setzero_ps();
+				for( std::uint32_t k = 0; k < aChannels; ++k )
+				{
+					auto const diff = _mm_sub_ps( texel[k], _mm_set1_ps( aPalette.v[p][k] ) );
+					dist = _mm_add_ps( dist, _mm_mul_ps( diff, diff ) );
+				}
+
+				auto const closer = _mm_castps_si128( _mm_cmplt_ps( dist, best ) );
+				best = _mm_min_ps( dist, best );
+				bestIndex = _mm_or_si128(
+					_mm_and_si128( closer, _mm_set1_epi32( int(p) ) ),
+					_mm_andnot_si128( closer, bestIndex )
+				);
+			}
+
+			alignas(16) std::int32_t indices[4];
+			alignas(16) float errors[4];
+			_mm_store_si128( reinterpret_cast<__m128i*>(indices), bestIndex );
+			_mm_store_ps( errors, best );
+
+			for( std::uint32_t j = 0; j < 4; ++j )
+			{
+				aIndices[t+j] = std::uint8_t(indices[j]);
+				total += errors[j];
+			}
+		}
+#		else // !COMPRESS_SSE_
+		for( std::uint32_t t = 0; t < kBlockTexels_; ++t )
+		{
+			float best = std::numeric_limits<float>::max();
+			std::uint8_t bestIndex = 0;
+
+			for( std::uint32_t p = 0; p < aPalette.count; ++p )
+			{
+				float dist = 0.f;
+				for( std::uint32_t k = 0; k < aChannels; ++k )
+				{
+					auto const diff = aBlock.c[k][t] - aPalette.v[p][k];
+					dist += diff * diff;
+				}
+
+				if( dist < best )
+				{
+					best = dist;
+					bestIndex = std::uint8_t(p);
+				}
+			}
+
+			aIndices[t] = bestIndex;
+			total += best;
+		}
+#		endif // ~ COMPRESS_SSE_
+
+		return total;
+	}
+
+	void principal_endpoints_( Block_ const& aBlock, std::uint32_t aChannels, float aE0[4], float aE1[4] )
+	{
+		float mean[4]{}, lo[4], hi[4];
+		for( std::uint32_t k = 0; k < aChannels; ++k )
+		{
+			lo[k] = hi[k] = aBlock.c[k][0];
+			for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+			{
+				mean[k] += aBlock.c[k][i];
+				lo[k] = std::min( lo[k], aBlock.c[k][i] );
+				hi[k] = std::max( hi[k], aBlock.c[k][i] );
+			}
+			mean[k] /= float(kBlockTexels_);
+		}
+
+		float cov[4][4]{};
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+		{
+			for( std::uint32_t a = 0; a < aChannels; ++a )
+			{
+				for( std::uint32_t b = 0; b < aChannels; ++b )
+					cov[a][b] += (aBlock.c[a][i] - mean[a]) * (aBlock.c[b][i] - mean[b]);
+			}
+		}
+
+		// Power iteration, starting from the diagonal of the bounding box
+		float axis[4]{};
+		for( std::uint32_t k = 0; k < aChannels; ++k )
+			axis[k] = hi[k] - lo[k];
+
+		for( int iter = 0; iter < 8; ++iter )
+		{
+			float next[4]{};
+			float len = 0.f;
+			for( std::uint32_t a = 0; a < aChannels; ++a )
+			{
+				for( std::uint32_t b = 0; b < aChannels; ++b )
+					next[a] += cov[a][b] * axis[b];
+				len += next[a] * next[a];
+			}
+
+			if( len <= 0.f )
+				break;
+
+			len = std::sqrt( len );
+			for( std::uint32_t k = 0; k < aChannels; ++k )
+				axis[k] = next[k] / len;
+		}
+
+		float len = 0.f;
+		for( std::uint32_t k = 0; k < aChannels; ++k )
+			len += axis[k] * axis[k];
+
+		float tmin = 0.f, tmax = 0.f;
+		if( len > 0.f )
+		{
+			len = std::sqrt( len );
+			for( std::uint32_t k = 0; k < aChannels; ++k )
+				axis[k] /= len;
+
+			tmin = std::numeric_limits<float>::max();
+			tmax = std::numeric_limits<float>::lowest();
+			for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+			{
+				float t = 0.f;
+				for( std::uint32_t k = 0; k < aChannels; ++k )
+					t += (aBlock.c[k][i] - mean[k]) * axis[k];
+
+				tmin = std::min( tmin, t );
+				tmax = std::max( tmax, t );
+			}
+		}
+
+		for( std::uint32_t k = 0; k < 4; ++k )
+		{
+			aE0[k] = k < aChannels ? std::clamp( mean[k] + tmin * axis[k], 0.f, 255.f ) : 0.f;
+			aE1[k] = k < aChannels ? std::clamp( mean[k] + tmax * axis[k], 0.f, 255.f ) : 0.f;
+		}
+	}
+
+	bool refit_endpoints_( Block_ const& aBlock, std::uint32_t aChannels, std::uint8_t const aIndices[kBlockTexels_], float const* aWeights, float aE0[4], float aE1[4] )
+	{
+		float a = 0.f, b = 0.f, c = 0.f;
+		float rhs0[4]{}, rhs1[4]{};
+
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+		{
+			float const t = aWeights[aIndices[i]];
+			float const s = 1.f - t;
+
+			a += s * s;
+			b += s * t;
+			c += t * t;
+
+			for( std::uint32_t k = 0; k < aChannels; ++k )
+			{
+				rhs0[k] += s * aBlock.c[k][i];
+				rhs1[k] += t * aBlock.c[k][i];
+			}
+		}
+
+		float const det = a * c - b * b;
+		if( std::abs( det ) < 1e-6f )
+			return false;
+
+		for( std::uint32_t k = 0; k < aChannels; ++k )
+		{
+			aE0[k] = std::clamp( (c * rhs0[k] - b * rhs1[k]) / det, 0.f, 255.f );
+			aE1[k] = std::clamp( (a * rhs1[k] - b * rhs0[k]) / det, 0.f, 255.f );
+		}
+
+		return true;
+	}
+
+
+	// BC1
+	std::uint16_t quantize_565_( float const aColor[4] )
+	{
+		auto const r = std::uint32_t(std::lround( aColor[0] * 31.f / 255.f ));
+		auto const g = std::uint32_t(std::lround( aColor[1] * 63.f / 255.f ));
+		auto const b = std::uint32_t(std::lround( aColor[2] * 31.f / 255.f ));
+		return std::uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void expand_565_( std::uint16_t aColor, std::uint32_t aRgb[3] )
+	{
+		auto const r = (aColor >> 11) & 31u, g = (aColor >> 5) & 63u, b = aColor & 31u;
+		aRgb[0] = (r << 3) | (r >> 2);
+		aRgb[1] = (g << 2) | (g >> 4);
+		aRgb[2] = (b << 3) | (b >> 2);
+	}
+
+	// Four color mode (c0 > c1) or, if c0 == c1, a single color
+	void bc1_palette_( std::uint16_t aC0, std::uint16_t aC1, std::uint32_t aRgb[4][3] )
+	{
+		expand_565_( aC0, aRgb[0] );
+		expand_565_( aC1, aRgb[1] );
+
+		for( int k = 0; k < 3; ++k )
+		{
+			if( aC0 > aC1 )
+			{
+				aRgb[2][k] = (2*aRgb[0][k] + aRgb[1][k]) / 3;
+				aRgb[3][k] = (aRgb[0][k] + 2*aRgb[1][k]) / 3;
+			}
+			else
+			{
+				aRgb[2][k] = (aRgb[0][k] + aRgb[1][k]) / 2;
+				aRgb[3][k] = 0;
+			}
+		}
+	}
+
+	void encode_bc1_( Block_ const& aBlock, std::uint8_t* aOut )
+	{
+		static constexpr float kWeights[4] = { 0.f, 1.f, 1.f/3.f, 2.f/3.f };
+
+		std::uint16_t bestC0 = 0, bestC1 = 0;
+		std::uint8_t bestIndices[kBlockTexels_]{};
+		float bestError = std::numeric_limits<float>::max();
+
+		auto const try_ = [&] (float const aE0[4], float const aE1[4]) {
+			auto c0 = quantize_565_( aE0 ), c1 = quantize_565_( aE1 );
+			if( c0 < c1 )
+				std::swap( c0, c1 );
+
+			std::uint32_t rgb[4][3];
+			bc1_palette_( c0, c1, rgb );
+
+			Palette_ palette;
+			palette.count = c0 == c1 ? 1 : 4;
+			for( std::uint32_t p = 0; p < palette.count; ++p )
+			{
+				for( int k = 0; k < 3; ++k )
+					palette.v[p][k] = float(rgb[p][k]);
+			}
+
+			std::uint8_t indices[kBlockTexels_];
+			auto const error = select_indices_( aBlock, 3, palette, indices );
+			if( error < bestError )
+			{
+				bestError = error;
+				bestC0 = c0;
+				bestC1 = c1;
+				std::memcpy( bestIndices, indices, sizeof(indices) );
+			}
+		};
+
+		float e0[4], e1[4];
+		principal_endpoints_( aBlock, 3, e0, e1 );
+		try_( e0, e1 );
+
+		// The refit solves for the endpoints in palette order (c0, c1)
+		for( int pass = 0; pass < kRefinePasses_ && bestC0 != bestC1; ++pass )
+		{
+			if( !refit_endpoints_( aBlock, 3, bestIndices, kWeights, e0, e1 ) )
+				break;
+			try_( e0, e1 );
+		}
+
+		std::uint32_t indices = 0;
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+			indices |= std::uint32_t(bestIndices[i]) << (2*i);
+
+		aOut[0] = std::uint8_t(bestC0 & 0xff);
+		aOut[1] = std::uint8_t(bestC0 >> 8);
+		aOut[2] = std::uint8_t(bestC1 & 0xff);
+		aOut[3] = std::uint8_t(bestC1 >> 8);
+		for( int i = 0; i < 4; ++i )
+			aOut[4+i] = std::uint8_t(indices >> (8*i));
+	}
+
+	void decode_bc1_( std::uint8_t const* aIn, std::uint8_t aRgba[kBlockTexels_][4] )
+	{
+		auto const c0 = std::uint16_t(aIn[0] | (aIn[1] << 8));
+		auto const c1 = std::uint16_t(aIn[2] | (aIn[3] << 8));
+
+		std::uint32_t rgb[4][3];
+		bc1_palette_( c0, c1, rgb );
+
+		std::uint32_t const indices = aIn[4] | (aIn[5] << 8) | (aIn[6] << 16) | (std::uint32_t(aIn[7]) << 24);
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+		{
+			auto const index = (indices >> (2*i)) & 3u;
+			for( int k = 0; k < 3; ++k )
+				aRgba[i][k] = std::uint8_t(rgb[index][k]);
+			aRgba[i][3] = c0 <= c1 && 3 == index ? 0 : 255;
+		}
+	}
+
+
+	// BC4
+	void bc4_palette_( std::uint32_t aR0, std::uint32_t aR1, std::uint32_t aValues[8] )
+	{
+		aValues[0] = aR0;
+		aValues[1] = aR1;
+
+		if( aR0 > aR1 )
+		{
+			for( std::uint32_t i = 1; i <= 6; ++i )
+				aValues[1+i] = ((7-i)*aR0 + i*aR1 + 3) / 7;
+		}
+		else
+		{
+			for( std::uint32_t i = 1; i <= 4; ++i )
+				aValues[1+i] = ((5-i)*aR0 + i*aR1 + 2) / 5;
+			aValues[6] = 0;
+			aValues[7] = 255;
+		}
+	}
+
+	void encode_bc4_( Block_ const& aBlock, std::uint32_t aChannel, std::uint8_t* aOut )
+	{
+		// Single channel block. Use the eight value mode (r0 > r1) spanning
+		// the channel's range.
+		Block_ block;
+		float lo = 255.f, hi = 0.f;
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+		{
+			block.c[0][i] = aBlock.c[aChannel][i];
+			lo = std::min( lo, block.c[0][i] );
+			hi = std::max( hi, block.c[0][i] );
+		}
+
+		auto const r0 = std::uint32_t(std::lround( hi ));
+		auto const r1 = std::uint32_t(std::lround( lo ));
+
+		std::uint8_t indices[kBlockTexels_]{};
+		if( r0 != r1 )
+		{
+			std::uint32_t values[8];
+			bc4_palette_( r0, r1, values );
+
+			Palette_ palette;
+			palette.count = 8;
+			for( std::uint32_t p = 0; p < 8; ++p )
+				palette.v[p][0] = float(values[p]);
+
+			select_indices_( block, 1, palette, indices );
+		}
+
+		std::uint64_t bits = 0;
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+			bits |= std::uint64_t(indices[i]) << (3*i);
+
+		aOut[0] = std::uint8_t(r0);
+		aOut[1] = std::uint8_t(r1);
+		for( int i = 0; i < 6; ++i )
+			aOut[2+i] = std::uint8_t(bits >> (8*i));
+	}
+
+	void decode_bc4_( std::uint8_t const* aIn, std::uint8_t aValues[kBlockTexels_] )
+	{
+		std::uint32_t values[8];
+		bc4_palette_( aIn[0], aIn[1], values );
+
+		std::uint64_t bits = 0;
+		for( int i = 0; i < 6; ++i )
+			bits |= std::uint64_t(aIn[2+i]) << (8*i);
+
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+			aValues[i] = std::uint8_t(values[(bits >> (3*i)) & 7u]);
+	}
+
+
+	// BC7, mode 6
+	constexpr std::uint32_t kBc7Weights_[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Bc7Endpoint_
+	{
+		std::uint32_t q[4]; // 7 bits
+		std::uint32_t p;    // shared p-bit
+
+		std::uint32_t value( std::uint32_t aChannel ) const noexcept
+		{
+			return (q[aChannel] << 1) | p;
+		}
+	};
+
+	Bc7Endpoint_ quantize_bc7_( float const aColor[4] )
+	{
+		Bc7Endpoint_ best{};
+		float bestError = std::numeric_limits<float>::max();
+
+		for( std::uint32_t p = 0; p < 2; ++p )
+		{
+			Bc7Endpoint_ ep{};
+			ep.p = p;
+
+			float error = 0.f;
+			for( std::uint32_t k = 0; k < 4; ++k )
+			{
+				auto const q = std::lround( (aColor[k] - float(p)) * 0.5f );
+				ep.q[k] = std::uint32_t(std::clamp( q, 0l, 127l ));
+
+				auto const diff = float(ep.value( k )) - aColor[k];
+				error += diff * diff;
+			}
+
+			if( error < bestError )
+			{
+				bestError = error;
+				best = ep;
+			}
+		}
+
+		return best;
+	}
+
+	void bc7_palette_( Bc7Endpoint_ const& aE0, Bc7Endpoint_ const& aE1, Palette_& aPalette )
+	{
+		aPalette.count = 16;
+		for( std::uint32_t i = 0; i < 16; ++i )
+		{
+			auto const w = kBc7Weights_[i];
+			for( std::uint32_t k = 0; k < 4; ++k )
+				aPalette.v[i][k] = float(((64-w) * aE0.value( k ) + w * aE1.value( k ) + 32) >> 6);
+		}
+	}
+
+	// Endpoint values aA and aB, with p-bits aP0 and aP1, that weight aW
+	// interpolates to exactly aValue
+	bool solve_bc7_channel_( std::uint32_t aValue, std::uint32_t aW, std::uint32_t aP0, std::uint32_t aP1, std::uint32_t& aA, std::uint32_t& aB )
+	{
+		for( std::uint32_t a = aP0; a < 256; a += 2 )
+		{
+			if( 0 == aW )
+			{
+				if( a != aValue )
+					continue;
+
+				aA = a;
+				aB = (a & ~1u) | aP1; // any value of parity aP1
+				return true;
+			}
+
+			// Smallest b of parity aP1 for which the result reaches aValue
+			auto const lo = std::int32_t(64*aValue) - 32 - std::int32_t((64-aW)*a);
+			std::uint32_t b = lo > 0 ? (std::uint32_t(lo) + aW - 1) / aW : 0;
+			if( (b & 1u) != aP1 )
+				++b;
+
+			if( b < 256 && ((64-aW)*a + aW*b + 32) >> 6 == aValue )
+			{
+				aA = a;
+				aB = b;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// Solid blocks: one endpoint cannot hold a color whose channels differ
+	// in parity (the p-bit is shared), but a palette entry between two
+	// endpoints with different p-bits often can. Returns false if the block
+	// is not solid or no exact encoding was found.
+	bool solid_bc7_( Block_ const& aBlock, Bc7Endpoint_& aE0, Bc7Endpoint_& aE1, std::uint8_t& aIndex )
+	{
+		for( std::uint32_t i = 1; i < kBlockTexels_; ++i )
+		{
+			for( std::uint32_t k = 0; k < 4; ++k )
+			{
+				if( aBlock.c[k][i] != aBlock.c[k][0] )
+					return false;
+			}
+		}
+
+		for( std::uint32_t index = 0; index < 16; ++index )
+		{
+			for( std::uint32_t p = 0; p < 4; ++p )
+			{
+				// Equal p-bits first
+				Bc7Endpoint_ e0{}, e1{};
+				e0.p = p >> 1;
+				e1.p = (p >> 1) ^ (p & 1u);
+
+				bool exact = true;
+				for( std::uint32_t k = 0; k < 4 && exact; ++k )
+				{
+					std::uint32_t a = 0, b = 0;
+					exact = solve_bc7_channel_( std::uint32_t(aBlock.c[k][0]), kBc7Weights_[index], e0.p, e1.p, a, b );
+					e0.q[k] = a >> 1;
+					e1.q[k] = b >> 1;
+				}
+
+				if( exact )
+				{
+					aE0 = e0;
+					aE1 = e1;
+					aIndex = std::uint8_t(index);
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	void encode_bc7_( Block_ const& aBlock, std::uint8_t* aOut )
+	{
+		static float const* const kWeights = [] {
+			static float weights[16];
+			for( std::uint32_t i = 0; i < 16; ++i )
+				weights[i] = kBc7Weights_[i] / 64.f;
+			return weights;
+		}();
+
+		Bc7Endpoint_ best0{}, best1{};
+		std::uint8_t bestIndices[kBlockTexels_]{};
+		float bestError = std::numeric_limits<float>::max();
+
+		auto const try_ = [&] (float const aE0[4], float const aE1[4]) {
+			auto const ep0 = quantize_bc7_( aE0 );
+			auto const ep1 = quantize_bc7_( aE1 );
+
+			Palette_ palette;
+			bc7_palette_( ep0, ep1, palette );
+
+			std::uint8_t indices[kBlockTexels_];
+			auto const error = select_indices_( aBlock, 4, palette, indices );
+			if( error < bestError )
+			{
+				bestError = error;
+				best0 = ep0;
+				best1 = ep1;
+				std::memcpy( bestIndices, indices, sizeof(indices) );
+			}
+		};
+
+		std::uint8_t solidIndex;
+		if( solid_bc7_( aBlock, best0, best1, solidIndex ) )
+		{
+			std::memset( bestIndices, solidIndex, sizeof(bestIndices) );
+		}
+		else
+		{
+			float e0[4], e1[4];
+			principal_endpoints_( aBlock, 4, e0, e1 );
+			try_( e0, e1 );
+
+			for( int pass = 0; pass < kRefinePasses_ && bestError > 0.f; ++pass )
+			{
+				if( !refit_endpoints_( aBlock, 4, bestIndices, kWeights, e0, e1 ) )
+					break;
+				try_( e0, e1 );
+			}
+		}
+
+		// The first index is stored without its most significant bit, which
+		// must therefore be zero. Swapping the endpoints inverts the indices.
+		if( bestIndices[0] & 8u )
+		{
+			std::swap( best0, best1 );
+			for( auto& index : bestIndices )
+				index = std::uint8_t(15 - index);
+		}
+
+		std::memset( aOut, 0, 16 );
+		Bits_ bits{ aOut };
+
+		bits.put( 1u << 6, 7 ); // mode 6
+		for( std::uint32_t k = 0; k < 4; ++k )
+		{
+			bits.put( best0.q[k], 7 );
+			bits.put( best1.q[k], 7 );
+		}
+		bits.put( best0.p, 1 );
+		bits.put( best1.p, 1 );
+
+		bits.put( bestIndices[0], 3 );
+		for( std::uint32_t i = 1; i < kBlockTexels_; ++i )
+			bits.put( bestIndices[i], 4 );
+
+		assert( 128 == bits.pos );
+	}
+
+	void decode_bc7_( std::uint8_t const* aIn, std::uint8_t aRgba[kBlockTexels_][4] )
+	{
+		std::uint8_t block[16];
+		std::memcpy( block, aIn, sizeof(block) );
+		Bits_ bits{ block };
+
+		if( (1u << 6) != bits.get( 7 ) )
+			throw lut::Error( "decode_bc7_(): only mode 6 blocks are supported" );
+
+		Bc7Endpoint_ e0{}, e1{};
+		for( std::uint32_t k = 0; k < 4; ++k )
+		{
+			e0.q[k] = bits.get( 7 );
+			e1.q[k] = bits.get( 7 );
+		}
+		e0.p = bits.get( 1 );
+		e1.p = bits.get( 1 );
+
+		Palette_ palette;
+		bc7_palette_( e0, e1, palette );
+
+		for( std::uint32_t i = 0; i < kBlockTexels_; ++i )
+		{
+			auto const index = bits.get( 0 == i ? 3 : 4 );
+			for( std::uint32_t k = 0; k < 4; ++k )
+				aRgba[i][k] = std::uint8_t(palette.v[index][k]);
+		}
+	}
+
+
+	std::uint32_t stored_channels_( baked::BakedTextureFormat aFormat )
+	{
+		switch( aFormat )
+		{
+			case baked::kBakedTextureBc1Srgb: return 0x7;
+			case baked::kBakedTextureBc4Unorm: return 0x1;
+			case baked::kBakedTextureBc5Unorm: return 0x3;
+			case baked::kBakedTextureR8Unorm: return 0x1;
+			default: return 0xf;
+		}
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
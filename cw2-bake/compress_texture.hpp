@@ -0,0 +1,54 @@
+#ifndef COMPRESS_TEXTURE_HPP_C5D81E37_6A2F_4B94_8E05_3F7B9A26D1C8
+#define COMPRESS_TEXTURE_HPP_C5D81E37_6A2F_4B94_8E05_3F7B9A26D1C8
+
+#include <vector>
+
+#include <cstdint>
+
+#include "../cw2/baked_format.hpp"
+
+// Block compression of 8-bit images into the compressed formats of
+// baked_format.hpp:
+//  - BC1: RGB (opaque, four color mode)
+//  - BC4: R
+//  - BC5: R and G, two BC4 blocks
+//  - BC7: RGBA, using mode 6 only (one subset, 7.7.7.7 endpoints with a
+//    p-bit each, 4-bit indices)
+//
+// Endpoints start out along the principal axis of the block's colors and are
+// refined with a least squares fit to the chosen indices. Index selection
+// uses SSE2 where available. Solid BC7 blocks are encoded exactly, except
+// for the few colors that mode 6 cannot represent (e.g., with channels both
+// at 0 and at 255 that differ in parity).
+
+// Compresses aWidth x aHeight texels with texture_channels(aFormat)
+// channels each. aFormat must be a compressed format. Partial blocks at the
+// right and top edges repeat the last column and row.
+std::vector<std::uint8_t> compress_image(
+	std::uint8_t const* aTexels,
+	std::uint32_t aWidth,
+	std::uint32_t aHeight,
+	baked::BakedTextureFormat
+);
+
+// Decodes blocks written by compress_image() back to
+// texture_channels(aFormat) channels per texel. BC7 blocks must use mode 6.
+std::vector<std::uint8_t> decompress_image(
+	std::uint8_t const* aBlocks,
+	std::uint32_t aWidth,
+	std::uint32_t aHeight,
+	baked::BakedTextureFormat
+);
+
+// Peak signal-to-noise ratio in dB between two images with
+// texture_channels(aFormat) channels, over the channels that aFormat stores
+// (e.g., only R and G for BC5). Infinite if the images are identical.
+double compression_psnr(
+	std::uint8_t const* aOriginal,
+	std::uint8_t const* aDecoded,
+	std::uint32_t aWidth,
+	std::uint32_t aHeight,
+	baked::BakedTextureFormat
+);
+
+#endif // COMPRESS_TEXTURE_HPP_C5D81E37_6A2F_4B94_8E05_3F7B9A26D1C8
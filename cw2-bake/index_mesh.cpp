@@ -1,8 +1,11 @@
 #include "index_mesh.hpp"
 
+#include <limits>
 #include <numeric>
-#include <unordered_map>
+#include <utility>
+#include <algorithm>
 
+#include <cassert>
 #include <cstddef>
 
 #include <glm/glm.hpp>
@@ -28,15 +31,37 @@ namespace
 		float scale;
 	};
 
-	// hash discretized mesh positions
-	using VicinityKey_ = std::size_t;
-	inline VicinityKey_ hash_discretized_position_( DiscretizedPosition_ const& aPos );
-
 	// generate vicinity map 
-	using VicinityMap_ = std::unordered_multimap<VicinityKey_,std::size_t>;
+	// The vicinity map is a flat spatial hash. Vertex indices are sorted by
+	// the key of their cell (LSD radix sort), so that each occupied cell is
+	// a contiguous range in `vertices`. An open-addressing table maps cell
+	// keys to these ranges. Within a cell, vertices are in ascending order.
+	using VicinityKey_ = std::uint64_t;
+
+	struct VicinityMap_
+	{
+		struct Slot
+		{
+			VicinityKey_ key;
+			std::uint32_t begin, end; // range in vertices
+		};
+
+		static constexpr VicinityKey_ kEmpty = ~VicinityKey_(0);
+
+		std::uint32_t bitsPerAxis;
+		std::vector<std::uint32_t> vertices;
+
+		std::vector<Slot> slots; // power-of-two size
+		std::uint32_t slotShift;
+
+		inline VicinityKey_ key( DiscretizedPosition_ const& ) const;
+		inline std::pair<std::uint32_t,std::uint32_t> find( VicinityKey_ ) const;
+	};
+
 	void build_vicinity_map_( 
 		VicinityMap_&, 
 		Discretizer_ const&,
+		std::uint32_t aSubdiv,
 		std::vector<glm::vec3> const&
 	);
 
@@ -66,7 +91,7 @@ namespace
 //--    IndexedMesh                     ///{{{2///////////////////////////////
 IndexedMesh::IndexedMesh()
 	: aabbMin( std::numeric_limits<float>::max() )
-	, aabbMax( std::numeric_limits<float>::min() )
+	, aabbMax( std::numeric_limits<float>::lowest() )
 {}
 
 //--    make_indexed_mesh()             ///{{{2///////////////////////////////
@@ -74,7 +99,7 @@ IndexedMesh make_indexed_mesh( TriangleSoup const& aSoup, float aErrorTolerance
 {
 	// compute bounding volume
 	glm::vec3 bmin( std::numeric_limits<float>::max() );
-	glm::vec3 bmax( std::numeric_limits<float>::min() );
+	glm::vec3 bmax( std::numeric_limits<float>::lowest() );
 
 	for( std::size_t vert = 0; vert < aSoup.vert.size(); ++vert )
 	{
@@ -97,7 +122,7 @@ IndexedMesh make_indexed_mesh( TriangleSoup const& aSoup, float aErrorTolerance
 
 	// build the vincinity map
 	VicinityMap_ vincinityMap;
-	build_vicinity_map_( vincinityMap, dis, aSoup.vert );
+	build_vicinity_map_( vincinityMap, dis, std::uint32_t(subdiv), aSoup.vert );
 
 	// collapse vertices
 	IndexBuffer_ indices;
@@ -204,28 +229,114 @@ namespace
 
 namespace
 {
-	std::hash<VicinityKey_> gHash_;
+	inline
+	VicinityKey_ VicinityMap_::key( DiscretizedPosition_ const& aDP ) const
+	{
+		// Cell coordinates are in [-1, subdiv+1] (including neighbours of
+		// occupied cells); bias by one so that each fits into bitsPerAxis.
+		VicinityKey_ const x = VicinityKey_(std::uint32_t(aDP.x+1));
+		VicinityKey_ const y = VicinityKey_(std::uint32_t(aDP.y+1));
+		VicinityKey_ const z = VicinityKey_(std::uint32_t(aDP.z+1));
+		return x | (y << bitsPerAxis) | (z << (2*bitsPerAxis));
+	}
 
-	inline VicinityKey_ hash_discretized_position_( DiscretizedPosition_ const& aDP )
+	inline
+	std::uint32_t slot_of_( VicinityKey_ aKey, std::uint32_t aShift )
 	{
-		// Based on boost::hash_combine.
-		std::size_t hash = gHash_(aDP.x);
-		hash ^= gHash_(aDP.y) + 0x9e3779b9 + (hash<<6) + (hash>>2);
-		hash ^= gHash_(aDP.z) + 0x9e3779b9 + (hash<<6) + (hash>>2);
-		return hash;
+		// Fibonacci hashing
+		return std::uint32_t((aKey * 0x9e3779b97f4a7c15ull) >> aShift);
 	}
-}
 
-namespace
-{
-	void build_vicinity_map_( VicinityMap_& aMap, Discretizer_ const& aD, std::vector<glm::vec3> const& aPositions )
+	inline
+	std::pair<std::uint32_t,std::uint32_t> VicinityMap_::find( VicinityKey_ aKey ) const
+	{
+		auto const mask = std::uint32_t(slots.size()-1);
+		for( auto slot = slot_of_( aKey, slotShift );; slot = (slot+1) & mask )
+		{
+			auto const& s = slots[slot];
+			if( aKey == s.key )
+				return { s.begin, s.end };
+			if( kEmpty == s.key )
+				return { 0, 0 };
+		}
+	}
+
+	void build_vicinity_map_( VicinityMap_& aMap, Discretizer_ const& aD, std::uint32_t aSubdiv, std::vector<glm::vec3> const& aPositions )
 	{
-		for( std::size_t index = 0; index < aPositions.size(); ++index )
+		assert( aPositions.size() <= std::numeric_limits<std::uint32_t>::max() );
+		auto const count = std::uint32_t(aPositions.size());
+
+		// [-1, subdiv+1] biased by one needs to represent subdiv+2
+		aMap.bitsPerAxis = 1;
+		while( (std::uint64_t(1) << aMap.bitsPerAxis) < std::uint64_t(aSubdiv)+3 )
+			++aMap.bitsPerAxis;
+
+		assert( 3*aMap.bitsPerAxis < 64 ); // kEmpty must not be a valid key
+
+		// Compute keys
+		std::vector<VicinityKey_> keys( count );
+		for( std::uint32_t index = 0; index < count; ++index )
+			keys[index] = aMap.key( aD.discretize( aPositions[index] ) );
+
+		// Sort (key,index) pairs by key. LSD radix sort with 8-bit digits; it
+		// is stable, so each cell's indices remain in ascending order.
+		aMap.vertices.resize( count );
+		std::iota( aMap.vertices.begin(), aMap.vertices.end(), 0u );
+
+		std::vector<VicinityKey_> tmpKeys( count );
+		std::vector<std::uint32_t> tmpVertices( count );
+
+		auto const keyBits = 3*aMap.bitsPerAxis;
+		for( std::uint32_t shift = 0; shift < keyBits; shift += 8 )
+		{
+			std::uint32_t histogram[256] = {};
+			for( auto const k : keys )
+				++histogram[(k >> shift) & 0xff];
+
+			std::uint32_t sum = 0;
+			for( auto& h : histogram )
+				sum += std::exchange( h, sum );
+
+			for( std::uint32_t i = 0; i < count; ++i )
+			{
+				auto const dst = histogram[(keys[i] >> shift) & 0xff]++;
+				tmpKeys[dst] = keys[i];
+				tmpVertices[dst] = aMap.vertices[i];
+			}
+
+			keys.swap( tmpKeys );
+			aMap.vertices.swap( tmpVertices );
+		}
+
+		// Count cells and size the table for a load factor of at most 1/2
+		std::uint32_t cells = 0;
+		for( std::uint32_t i = 0; i < count; ++i )
 		{
-			DiscretizedPosition_ dp = aD.discretize( aPositions[index] );
-			VicinityKey_ vk = hash_discretized_position_( dp );
+			if( 0 == i || keys[i] != keys[i-1] )
+				++cells;
+		}
+
+		std::uint32_t slotBits = 1;
+		while( (std::uint64_t(1) << slotBits) < 2*std::uint64_t(cells) )
+			++slotBits;
+
+		aMap.slotShift = 64 - slotBits;
+		aMap.slots.assign( std::size_t(1) << slotBits, VicinityMap_::Slot{ VicinityMap_::kEmpty, 0, 0 } );
+
+		// Insert cells
+		auto const mask = std::uint32_t(aMap.slots.size()-1);
+		for( std::uint32_t beg = 0; beg < count; )
+		{
+			auto end = beg+1;
+			while( end < count && keys[end] == keys[beg] )
+				++end;
+
+			auto slot = slot_of_( keys[beg], aMap.slotShift );
+			while( VicinityMap_::kEmpty != aMap.slots[slot].key )
+				slot = (slot+1) & mask;
 
-			aMap.insert( std::make_pair(vk, index) );
+			aMap.slots[slot] = VicinityMap_::Slot{ keys[beg], beg, end };
+			beg = end;
 		}
 	}
 }
@@ -332,12 +443,12 @@ namespace
 			for( std::size_t j = 0; j < kNeighbourCount_; ++j )
 			{
 				DiscretizedPosition_ const dq = neighbour_( dp, j );
-				VicinityKey_ const vk = hash_discretized_position_( dq );
+				VicinityKey_ const vk = aVM.key( dq );
 
-				// get vertices in this bucket
-				for( auto [it, jt] = aVM.equal_range( vk ); it != jt; ++it )
+				// get vertices in this cell
+				for( auto [it, jt] = aVM.find( vk ); it != jt; ++it )
 				{
-					std::size_t const idx =  it->second;
+					std::size_t const idx = aVM.vertices[it];
 
 					if( idx == i ) continue; // don't try to merge with self
 					if( ~std::size_t(0) != collapseMap[idx] ) continue; // don't remerge
@@ -8,12 +8,15 @@
 #include <rapidobj/rapidobj.hpp>
 
 #include "../labutils/error.hpp"
+#include "../labutils/trace.hpp"
 #include "input_model.hpp"
 
 namespace lut = labutils;
 
 InputModel load_wavefront_obj( char const* aPath )
 {
+	LUT_TRACE_SCOPE( __func__ );
+
 	assert( aPath );
 	
 	// Ask rapidobj to load the requested file
@@ -1,3 +1,5 @@
+#include <chrono>
+#include <algorithm>
 #include <iterator>
 #include <vector>
 #include <typeinfo>
@@ -6,7 +8,9 @@
 #include <system_error>
 #include <unordered_map>
 
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 
 #include <tgen.h>
@@ -16,6 +20,13 @@
 #include "index_mesh.hpp"
 #include "input_model.hpp"
 #include "load_model_obj.hpp"
+#include "pack_vertices.hpp"
+#include "optimize_mesh.hpp"
+#include "build_clusters.hpp"
+#include "bake_texture.hpp"
+#include "parallel.hpp"
+
+#include "../cw2/baked_format.hpp"
 
 
 #include "../labutils/vulkan_window.hpp"
@@ -26,6 +37,7 @@
 #include "../labutils/vkbuffer.hpp"
 #include "../labutils/allocator.hpp" 
 #include "../labutils/to_string.hpp"
+#include "../labutils/trace.hpp"
 namespace lut = labutils;
 
 namespace
@@ -41,7 +53,7 @@ namespace
 	 * including non-printable characters (e.g. the \0) early keeps the file
 	 * from being misidentified as text.
 	 */
-	 constexpr char kFileMagic[16] = "\0\0COMP5822Mmesh";
+	 constexpr auto const& kFileMagic = baked::kFileMagic;
 
 	/* Note: change the file variant if you change the file format! 
 	 *
@@ -50,20 +62,78 @@ namespace
 	 * additional tangent space information.
 	 */
 	//constexpr char kFileVariant[16] = "default";
-	 constexpr char kFileVariant[16] = "sc22ap-tan";
+	 constexpr auto const& kFileVariant = baked::kFileVariantV1;
+	 constexpr auto const& kFileVariantV2 = baked::kFileVariantV2;
 
 	// types
 	struct TextureInfo_
 	{
 		std::uint32_t uniqueId;
 		std::uint8_t channels;
+		baked::BakedTextureFormat format; // as used by the first material referencing it
 		std::string newPath;
+
+		// Packed textures only (see pack_key_()): source image of each
+		// channel, or empty and the value to fill the channel with. The key
+		// of such textures is not a path.
+		bool packed = false;
+		std::string packedSources[4];
+		std::uint8_t packedFill[4];
+	};
+
+	enum class EFileFormat_
+	{
+		v1, // sequential records, see kFileVariant
+		v2  // section table + aligned arrays, see kFileVariantV2
+	};
+
+	enum class EOptimize_
+	{
+		none,
+		cache,   // vertex cache + vertex fetch
+		overdraw // as cache, plus cluster sorting for overdraw
+	};
+
+	enum class ETextures_
+	{
+		copy, // copy the source images
+		bake  // baked containers with precomputed mips, see baked_format.hpp
+	};
+
+	struct BakeOptions_
+	{
+		char const* output = "assets/cw2/sponza-pbr.comp5822mesh";
+		char const* input = "assets-src/cw2/sponza-pbr.obj";
+
+		EFileFormat_ format = EFileFormat_::v2;
+
+		// v2 only; see baked_format.hpp
+		baked::BakedVertexFormatV2 vertexFormat = baked::kBakedVertexSeparate;
+
+		// Worker threads for per-mesh processing; 0 = hardware threads
+		unsigned jobs = 1;
+
+		EOptimize_ optimize = EOptimize_::none;
+
+		// v2 only: split meshes into clusters, see BakedClusterRecordV2
+		bool clusters = true;
+
+		ETextures_ textures = ETextures_::bake;
+		ETextureCompression textureCompression = ETextureCompression::bc7; // bake only
+
+		// v2 with baked textures only: one texture per material for
+		// roughness, metalness and alpha mask, see kBakedMaterialPackedRma
+		bool packTextures = true;
+
+		// Record the stages as Chrome trace JSON; see labutils/trace.hpp
+		char const* trace = nullptr;
 	};
 
 	// local functions:
+	BakeOptions_ parse_options_( int, char* [] );
+
 	void process_model_(
-		char const* aOutput,
-		char const* aInputOBJ,
+		BakeOptions_ const&,
 		glm::mat4x4 const& aStaticTransform = glm::mat4x4( 1.f ) //TODO
 	);
 
@@ -74,30 +144,77 @@ namespace
 		std::vector<IndexedMesh> const&,
 		std::unordered_map<std::string,TextureInfo_> const&
 	);
+	void write_model_data_v2_(
+		FILE*,
+		InputModel const&,
+		std::vector<IndexedMesh> const&,
+		std::unordered_map<std::string,TextureInfo_> const&,
+		BakeOptions_ const&
+	);
 
 
 	std::vector<IndexedMesh> index_meshes_(
 		InputModel const&,
+		unsigned aJobs,
 		float aErrorTolerance = 1e-5f
 	);
 
+	void optimize_meshes_(
+		std::vector<IndexedMesh>&,
+		EOptimize_,
+		unsigned aJobs
+	);
+
 	std::unordered_map<std::string,TextureInfo_> find_unique_textures_(
-		InputModel const&
+		InputModel const&,
+		bool aPackTextures
+	);
+
+	std::string pack_key_(
+		InputMaterialInfo const&
+	);
+	void pack_fill_(
+		InputMaterialInfo const&,
+		std::uint8_t (&aFill)[4]
 	);
 
 	std::unordered_map<std::string,TextureInfo_> new_paths_(
 		std::unordered_map<std::string,TextureInfo_>,
-		std::filesystem::path const& aTexDir
+		std::filesystem::path const& aTexDir,
+		ETextures_
+	);
+
+	void copy_textures_(
+		std::unordered_map<std::string,TextureInfo_> const&,
+		std::filesystem::path const& aRootDir
+	);
+	void bake_textures_(
+		std::unordered_map<std::string,TextureInfo_> const&,
+		std::filesystem::path const& aRootDir,
+		ETextureCompression,
+		unsigned aJobs
 	);
 }
 
 
-int main() try
+int main( int aArgc, char* aArgv[] ) try
 {
-	process_model_(
-		"assets/cw2/sponza-pbr.comp5822mesh",
-		"assets-src/cw2/sponza-pbr.obj"
-	);
+	auto const options = parse_options_( aArgc, aArgv );
+
+	if( options.trace )
+	{
+		lut::set_trace_thread_name( "main" );
+		lut::enable_trace( true );
+	}
+
+	process_model_( options );
+
+	if( options.trace )
+	{
+		lut::enable_trace( false );
+		lut::write_chrome_trace( options.trace );
+		std::printf( "Wrote trace to %s\n", options.trace );
+	}
 
 	return 0;
 }
@@ -212,48 +329,185 @@ namespace
 			
 	}
 
-	void process_model_( char const* aOutput, char const* aInputOBJ, glm::mat4x4 const& aStaticTransform )
+	BakeOptions_ parse_options_( int aArgc, char* aArgv[] )
 	{
+		BakeOptions_ ret;
+
+		auto const usage_ = [&] {
+			std::fprintf( stderr, "Usage: %s [--format v1|v2] [--vertex-format separate|packed|packed16] [--jobs N] [--optimize none|cache|overdraw] [--no-clusters] [--textures copy|bake] [--texture-compression none|bc7|bc1] [--no-pack-textures] [--output FILE] [--input OBJ] [--trace FILE]\n", aArgc > 0 ? aArgv[0] : "cw2-bake" );
+		};
+
+		for( int i = 1; i < aArgc; ++i )
+		{
+			auto const has_value_ = [&] (char const* aName) {
+				if( i+1 >= aArgc )
+				{
+					usage_();
+					throw lut::Error( "Option '%s' requires a value", aName );
+				}
+				return aArgv[++i];
+			};
+
+			if( 0 == std::strcmp( "--format", aArgv[i] ) )
+			{
+				char const* const value = has_value_( "--format" );
+				if( 0 == std::strcmp( "v1", value ) )
+					ret.format = EFileFormat_::v1;
+				else if( 0 == std::strcmp( "v2", value ) )
+					ret.format = EFileFormat_::v2;
+				else
+					throw lut::Error( "Unknown file format '%s' (expected v1 or v2)", value );
+			}
+			else if( 0 == std::strcmp( "--vertex-format", aArgv[i] ) )
+			{
+				char const* const value = has_value_( "--vertex-format" );
+				if( 0 == std::strcmp( "separate", value ) )
+					ret.vertexFormat = baked::kBakedVertexSeparate;
+				else if( 0 == std::strcmp( "packed", value ) )
+					ret.vertexFormat = baked::kBakedVertexPackedF32;
+				else if( 0 == std::strcmp( "packed16", value ) )
+					ret.vertexFormat = baked::kBakedVertexPackedQ16;
+				else
+					throw lut::Error( "Unknown vertex format '%s' (expected separate, packed or packed16)", value );
+			}
+			else if( 0 == std::strcmp( "--jobs", aArgv[i] ) )
+			{
+				char const* const value = has_value_( "--jobs" );
+
+				char* end = nullptr;
+				auto const jobs = std::strtoul( value, &end, 10 );
+				if( end == value || '\0' != *end || jobs > 1024 )
+					throw lut::Error( "Invalid job count '%s' (expected 0..1024)", value );
+
+				ret.jobs = unsigned(jobs);
+			}
+			else if( 0 == std::strcmp( "--optimize", aArgv[i] ) )
+			{
+				char const* const value = has_value_( "--optimize" );
+				if( 0 == std::strcmp( "none", value ) )
+					ret.optimize = EOptimize_::none;
+				else if( 0 == std::strcmp( "cache", value ) )
+					ret.optimize = EOptimize_::cache;
+				else if( 0 == std::strcmp( "overdraw", value ) )
+					ret.optimize = EOptimize_::overdraw;
+				else
+					throw lut::Error( "Unknown optimization '%s' (expected none, cache or overdraw)", value );
+			}
+			else if( 0 == std::strcmp( "--no-clusters", aArgv[i] ) )
+				ret.clusters = false;
+			else if( 0 == std::strcmp( "--textures", aArgv[i] ) )
+			{
+				char const* const value = has_value_( "--textures" );
+				if( 0 == std::strcmp( "copy", value ) )
+					ret.textures = ETextures_::copy;
+				else if( 0 == std::strcmp( "bake", value ) )
+					ret.textures = ETextures_::bake;
+				else
+					throw lut::Error( "Unknown texture mode '%s' (expected copy or bake)", value );
+			}
+			else if( 0 == std::strcmp( "--texture-compression", aArgv[i] ) )
+			{
+				char const* const value = has_value_( "--texture-compression" );
+				if( 0 == std::strcmp( "none", value ) )
+					ret.textureCompression = ETextureCompression::none;
+				else if( 0 == std::strcmp( "bc7", value ) )
+					ret.textureCompression = ETextureCompression::bc7;
+				else if( 0 == std::strcmp( "bc1", value ) )
+					ret.textureCompression = ETextureCompression::bc1;
+				else
+					throw lut::Error( "Unknown texture compression '%s' (expected none, bc7 or bc1)", value );
+			}
+			else if( 0 == std::strcmp( "--no-pack-textures", aArgv[i] ) )
+				ret.packTextures = false;
+			else if( 0 == std::strcmp( "--output", aArgv[i] ) )
+				ret.output = has_value_( "--output" );
+			else if( 0 == std::strcmp( "--input", aArgv[i] ) )
+				ret.input = has_value_( "--input" );
+			else if( 0 == std::strcmp( "--trace", aArgv[i] ) )
+			{
+				ret.trace = has_value_( "--trace" );
+				if( !lut::kTraceCompiled )
+					throw lut::Error( "--trace requires a build with tracing (premake5 --trace)" );
+			}
+			else
+			{
+				usage_();
+				throw lut::Error( "Unknown option '%s'", aArgv[i] );
+			}
+		}
+
+		if( EFileFormat_::v1 == ret.format && baked::kBakedVertexSeparate != ret.vertexFormat )
+			throw lut::Error( "Packed vertex formats require --format v2" );
+
+		// Packed textures are produced by the baker only, and referenced
+		// through v2 material flags. Silently fall back otherwise, since
+		// packing is the default.
+		if( EFileFormat_::v2 != ret.format || ETextures_::bake != ret.textures )
+			ret.packTextures = false;
+
+		return ret;
+	}
+
+	void process_model_( BakeOptions_ const& aOptions, glm::mat4x4 const& aStaticTransform )
+	{
+		LUT_TRACE_SCOPE( __func__ );
+
 		static constexpr std::size_t vertexSize = sizeof(float)*(3+3+2);
 
 		// Figure out output paths
-		std::filesystem::path const outname( aOutput );
+		std::filesystem::path const outname( aOptions.output );
 		std::filesystem::path const rootdir = outname.parent_path();
 		std::filesystem::path const basename = outname.stem();
 		std::filesystem::path const texdir = basename.string() + "-tex";
 
 		// Load input model
-		auto const model = load_wavefront_obj( aInputOBJ );
+		auto const model = load_wavefront_obj( aOptions.input );
 
 		std::size_t inputVerts = 0;
 		for( auto const& imesh : model.meshes )
 			inputVerts += imesh.vertexCount;
 
-		std::printf( "%s: %zu meshes, %zu materials\n", aInputOBJ, model.meshes.size(), model.materials.size() );
+		std::printf( "%s: %zu meshes, %zu materials\n", aOptions.input, model.meshes.size(), model.materials.size() );
 		std::printf( " - triangle soup vertices: %zu => %zu kB\n", inputVerts, inputVerts*vertexSize/1024 );
 
-		// Index meshes
-		auto indexed = index_meshes_( model );
+		// Index meshes and generate tangents
+		auto const jobs = resolve_jobs( aOptions.jobs );
+		auto const indexStart = std::chrono::steady_clock::now();
+
+		auto indexed = index_meshes_( model, jobs );
+
+		auto const indexTime = std::chrono::duration<double>( std::chrono::steady_clock::now() - indexStart ).count();
+		std::printf( " - indexing + tangents: %.3f s (%u thread%s)\n", indexTime, jobs, 1 == jobs ? "" : "s" );
 
 		std::size_t outputVerts = 0, outputIndices = 0;
-		for( auto & mesh : indexed )
+		for( auto const& mesh : indexed )
 		{
 			outputVerts += mesh.vert.size();
 			outputIndices += mesh.indices.size();	
-
-			// For Task 1.4
-			ComputeTangents(mesh);
-			// For Task 1.5
-			//Generate_TBN_Quaternion(mesh);
 		}
 		
 
 		std::printf( " - indexed vertices: %zu with %zu indices => %zu kB\n", outputVerts, outputIndices, (outputVerts*vertexSize + outputIndices*sizeof(std::uint32_t))/1024 );
 
+		// Optimize meshes (reorders triangles and vertices in place)
+		if( EOptimize_::none != aOptions.optimize )
+			optimize_meshes_( indexed, aOptions.optimize, jobs );
+
+		if( EFileFormat_::v2 == aOptions.format )
+		{
+			auto const separateSize = vertex_size( baked::kBakedVertexSeparate );
+			auto const bakedSize = vertex_size( aOptions.vertexFormat );
+			std::printf( " - baked vertex data: %zu bytes/vertex => %zu kB (separate fp32: %zu bytes/vertex => %zu kB)\n", bakedSize, outputVerts*bakedSize/1024, separateSize, outputVerts*separateSize/1024 );
+		}
+
 		// Find list of unique textures
-		auto const textures = new_paths_( find_unique_textures_( model ), texdir );
+		auto const textures = new_paths_( find_unique_textures_( model, aOptions.packTextures ), texdir, aOptions.textures );
 
-		std::printf( " - unique textures: %zu\n", textures.size() );
+		std::size_t packedTextures = 0;
+		for( auto const& entry : textures )
+			packedTextures += entry.second.packed;
+
+		std::printf( " - unique textures: %zu (%zu packed)\n", textures.size(), packedTextures );
 
 		// Ensure output directory exists
 		std::filesystem::create_directories( rootdir );
@@ -268,7 +522,10 @@ namespace
 
 		try
 		{
-			write_model_data_( fof, model, indexed, textures );
+			if( EFileFormat_::v2 == aOptions.format )
+				write_model_data_v2_( fof, model, indexed, textures, aOptions );
+			else
+				write_model_data_( fof, model, indexed, textures );
 		}
 		catch( ... )
 		{
@@ -278,35 +535,13 @@ namespace
 
 		std::fclose( fof );
 
-		// Copy textures
+		// Copy or bake textures
 		std::filesystem::create_directories( rootdir / texdir );
 
-		std::size_t errors = 0;
-		for( auto const& entry : textures )
-		{
-			auto const dest = rootdir / entry.second.newPath;
-
-			std::error_code ec;
-			bool ret = std::filesystem::copy_file( 
-				entry.first,
-				dest,
-				std::filesystem::copy_options::none,
-				ec
-			);
-
-			if( !ret )
-			{
-				++errors;
-				std::fprintf( stderr, "copy_file(): '%s' failed: %s (%s)\n", dest.string().c_str(), ec.message().c_str(), ec.category().name() );
-			}
-		}
-
-		auto const total = textures.size();
-		std::printf( "Copied %zu textures out of %zu.\n", total-errors, total );
-		if( errors )
-		{
-			std::fprintf( stderr, "Some copies reported an error. Currently, the code will never overwrite existing files. The errors likely just indicate that the file was copied previously. Remove old files manually, if necessary.\n" );
-		}
+		if( ETextures_::bake == aOptions.textures )
+			bake_textures_( textures, rootdir, aOptions.textureCompression, jobs );
+		else
+			copy_textures_( textures, rootdir );
 	}
 }
 
@@ -332,8 +567,22 @@ namespace
 		checked_write_( aOut, length, aString );
 	}
 
+	std::vector<TextureInfo_ const*> order_textures_( std::unordered_map<std::string,TextureInfo_> const& aTextures )
+	{
+		std::vector<TextureInfo_ const*> ordered( aTextures.size() );
+		for( auto const& tex : aTextures )
+		{
+			assert( !ordered[tex.second.uniqueId] );
+			ordered[tex.second.uniqueId] = &tex.second;
+		}
+
+		return ordered;
+	}
+
 	void write_model_data_( FILE* aOut, InputModel const& aModel, std::vector<IndexedMesh> const& aIndexedMeshes, std::unordered_map<std::string,TextureInfo_> const& aTextures )
 	{
+		LUT_TRACE_SCOPE( __func__ );
+
 		// Write header
 		// Format:
 		//   - char[16] : file magic
@@ -347,12 +596,7 @@ namespace
 		//  - repeat U times:
 		//    - string : path to texture 
 		//    - uint8_t : number of channels in texture
-		std::vector<TextureInfo_ const*> orderedUnqiue( aTextures.size() );
-		for( auto const& tex : aTextures )
-		{
-			assert( !orderedUnqiue[tex.second.uniqueId] );
-			orderedUnqiue[tex.second.uniqueId] = &tex.second;
-		}
+		auto const orderedUnqiue = order_textures_( aTextures );
 
 		std::uint32_t const textureCount = std::uint32_t(orderedUnqiue.size());
 		checked_write_( aOut, sizeof(textureCount), &textureCount );
@@ -443,12 +687,323 @@ namespace
 
 namespace
 {
-	std::vector<IndexedMesh> index_meshes_( InputModel const& aModel, float aErrorTolerance )
+	// Writes zero bytes until aOffset is a multiple of aAlign
+	void write_padding_( FILE* aOut, std::uint64_t& aOffset, std::uint64_t aAlign )
+	{
+		static constexpr char zeros[baked::kBakedAlignV2] = {};
+
+		auto const target = baked::align_up( aOffset, aAlign );
+		assert( target - aOffset <= sizeof(zeros) );
+
+		checked_write_( aOut, std::size_t(target - aOffset), zeros );
+		aOffset = target;
+	}
+
+	void write_tracked_( FILE* aOut, std::uint64_t& aOffset, std::size_t aBytes, void const* aData )
+	{
+		checked_write_( aOut, aBytes, aData );
+		aOffset += aBytes;
+	}
+
+	void write_model_data_v2_( FILE* aOut, InputModel const& aModel, std::vector<IndexedMesh> const& aIndexedMeshes, std::unordered_map<std::string,TextureInfo_> const& aTextures, BakeOptions_ const& aOptions )
 	{
-		std::vector<IndexedMesh> indexed;
+		LUT_TRACE_SCOPE( __func__ );
+
+		using namespace baked;
+
+		auto const vertexFormat = aOptions.vertexFormat;
+
+		assert( aModel.meshes.size() == aIndexedMeshes.size() );
+
+		auto const orderedUnique = order_textures_( aTextures );
+
+		// Lay out the file first. Everything is fixed-size except for the
+		// texture paths and the geometry arrays, so all offsets are known
+		// before the first byte is written. Packed vertex streams are
+		// produced up front for the same reason.
+		bool const packed = kBakedVertexSeparate != vertexFormat;
+		bool const quantized = kBakedVertexPackedQ16 == vertexFormat;
+
+		std::vector<std::vector<std::byte>> packedVertices;
+		std::vector<BakedQuantizationRecordV2> quantization;
+		if( packed )
+		{
+			packedVertices.resize( aIndexedMeshes.size() );
+			quantization.resize( aIndexedMeshes.size() );
+			for( std::size_t i = 0; i < aIndexedMeshes.size(); ++i )
+				packedVertices[i] = pack_vertices( aIndexedMeshes[i], vertexFormat, quantization[i] );
+		}
+
+		std::vector<BakedClusterRecordV2> clusters;
+		if( aOptions.clusters )
+		{
+			for( std::size_t i = 0; i < aIndexedMeshes.size(); ++i )
+			{
+				auto const mc = build_clusters( aIndexedMeshes[i], std::uint32_t(i) );
+				clusters.insert( clusters.end(), mc.begin(), mc.end() );
+			}
+
+			std::size_t clusterVerts = 0, clusterIndices = 0;
+			for( auto const& cluster : clusters )
+			{
+				clusterVerts += cluster.vertexCount;
+				clusterIndices += cluster.indexCount;
+			}
+
+			auto const count = std::max<std::size_t>( clusters.size(), 1 );
+			std::printf( " - clusters: %zu (average %.1f vertices, %.1f triangles)\n", clusters.size(), double(clusterVerts)/count, double(clusterIndices)/3/count );
+		}
+
+		std::vector<BakedBoundsRecordV2> bounds( aIndexedMeshes.size() );
+		for( std::size_t i = 0; i < aIndexedMeshes.size(); ++i )
+		{
+			for( int k = 0; k < 3; ++k )
+			{
+				bounds[i].min[k] = aIndexedMeshes[i].aabbMin[k];
+				bounds[i].max[k] = aIndexedMeshes[i].aabbMax[k];
+			}
+		}
+
+		// Optional sections consisting of a BakedCountV2 followed by
+		// fixed-size records; placed after the geometry.
+		struct RecordSection_
+		{
+			std::uint32_t id;
+			std::size_t count;
+			std::size_t recordSize;
+			void const* records;
+		};
+
+		std::vector<RecordSection_> recordSections;
+		if( quantized )
+			recordSections.push_back( { kBakedSectionQuantization, quantization.size(), sizeof(BakedQuantizationRecordV2), quantization.data() } );
+		if( aOptions.clusters )
+			recordSections.push_back( { kBakedSectionClusters, clusters.size(), sizeof(BakedClusterRecordV2), clusters.data() } );
+		recordSections.push_back( { kBakedSectionBounds, bounds.size(), sizeof(BakedBoundsRecordV2), bounds.data() } );
+
+		std::uint32_t const sectionCount = std::uint32_t(4 + recordSections.size());
+
+		std::vector<BakedSectionV2> sections( sectionCount );
+		sections[0].id = kBakedSectionTextures;
+		sections[1].id = kBakedSectionMaterials;
+		sections[2].id = kBakedSectionMeshes;
+		sections[3].id = kBakedSectionGeometry;
+
+		std::uint64_t offset = sizeof(BakedHeaderV2) + sectionCount*sizeof(BakedSectionV2);
+
+		// Textures
+		std::uint64_t stringBytes = 0;
+		for( auto const& tex : orderedUnique )
+			stringBytes += tex->newPath.size() + 1;
+
+		sections[0].offset = align_up( offset, kBakedAlignV2 );
+		sections[0].size = sizeof(BakedCountV2) + orderedUnique.size()*sizeof(BakedTextureRecordV2) + stringBytes;
+		offset = sections[0].offset + sections[0].size;
 
-		for( auto const& imesh : aModel.meshes )
+		// Materials
+		sections[1].offset = align_up( offset, kBakedAlignV2 );
+		sections[1].size = sizeof(BakedCountV2) + aModel.materials.size()*sizeof(BakedMaterialRecordV2);
+		offset = sections[1].offset + sections[1].size;
+
+		// Meshes
+		sections[2].offset = align_up( offset, kBakedAlignV2 );
+		sections[2].size = sizeof(BakedCountV2) + aModel.meshes.size()*sizeof(BakedMeshRecordV2);
+		offset = sections[2].offset + sections[2].size;
+
+		// Geometry
+		sections[3].offset = align_up( offset, kBakedAlignV2 );
+		offset = sections[3].offset;
+
+		std::vector<BakedMeshRecordV2> meshRecords( aModel.meshes.size() );
+		for( std::size_t i = 0; i < aModel.meshes.size(); ++i )
 		{
+			auto const& imesh = aIndexedMeshes[i];
+			auto& rec = meshRecords[i];
+
+			rec.materialId = std::uint32_t(aModel.meshes[i].materialIndex);
+			rec.vertexCount = std::uint32_t(imesh.vert.size());
+			rec.indexCount = std::uint32_t(imesh.indices.size());
+
+			auto const place_ = [&] (std::uint64_t aBytes) {
+				auto const ret = align_up( offset, kBakedAlignV2 );
+				offset = ret + aBytes;
+				return ret;
+			};
+
+			if( packed )
+			{
+				rec.positionsOffset = place_( packedVertices[i].size() );
+			}
+			else
+			{
+				rec.positionsOffset = place_( sizeof(glm::vec3)*rec.vertexCount );
+				rec.normalsOffset = place_( sizeof(glm::vec3)*rec.vertexCount );
+				rec.texcoordsOffset = place_( sizeof(glm::vec2)*rec.vertexCount );
+				rec.tangentsOffset = place_( sizeof(glm::vec4)*rec.vertexCount );
+			}
+
+			rec.indicesOffset = place_( sizeof(std::uint32_t)*rec.indexCount );
+		}
+
+		sections[3].size = offset - sections[3].offset;
+
+		// Record sections
+		for( std::size_t i = 0; i < recordSections.size(); ++i )
+		{
+			auto& section = sections[4+i];
+			section.id = recordSections[i].id;
+			section.offset = align_up( offset, kBakedAlignV2 );
+			section.size = sizeof(BakedCountV2) + recordSections[i].count*recordSections[i].recordSize;
+			offset = section.offset + section.size;
+		}
+
+		// Write header and table of contents
+		std::uint64_t written = 0;
+
+		BakedHeaderV2 header{};
+		std::memcpy( header.magic, kFileMagic, sizeof(header.magic) );
+		std::memcpy( header.variant, kFileVariantV2, sizeof(header.variant) );
+		header.sectionCount = sectionCount;
+		header.vertexFormat = vertexFormat;
+
+		write_tracked_( aOut, written, sizeof(header), &header );
+		write_tracked_( aOut, written, sectionCount*sizeof(BakedSectionV2), sections.data() );
+
+		// Write textures
+		write_padding_( aOut, written, kBakedAlignV2 );
+		assert( written == sections[0].offset );
+		{
+			BakedCountV2 const count{ std::uint32_t(orderedUnique.size()), 0 };
+			write_tracked_( aOut, written, sizeof(count), &count );
+
+			std::uint64_t stringOffset = written + orderedUnique.size()*sizeof(BakedTextureRecordV2);
+			for( auto const& tex : orderedUnique )
+			{
+				BakedTextureRecordV2 rec{};
+				rec.pathOffset = stringOffset;
+				rec.pathLength = std::uint32_t(tex->newPath.size());
+				rec.channels = tex->channels;
+				write_tracked_( aOut, written, sizeof(rec), &rec );
+
+				stringOffset += tex->newPath.size() + 1;
+			}
+
+			for( auto const& tex : orderedUnique )
+				write_tracked_( aOut, written, tex->newPath.size()+1, tex->newPath.c_str() );
+		}
+
+		// Write materials
+		write_padding_( aOut, written, kBakedAlignV2 );
+		assert( written == sections[1].offset );
+		{
+			BakedCountV2 const count{ std::uint32_t(aModel.materials.size()), 0 };
+			write_tracked_( aOut, written, sizeof(count), &count );
+
+			auto const tex_id_ = [&] (std::string const& aTexturePath) {
+				if( aTexturePath.empty() )
+					return kNoTexture;
+
+				auto const it = aTextures.find( aTexturePath );
+				assert( aTextures.end() != it );
+				return it->second.uniqueId;
+			};
+
+			for( auto const& mat : aModel.materials )
+			{
+				BakedMaterialRecordV2 rec{};
+				rec.baseColorTextureId = tex_id_( mat.baseColorTexturePath );
+				rec.normalMapTextureId = tex_id_( mat.normalMapTexturePath );
+
+				if( aOptions.packTextures )
+				{
+					auto const packedId = tex_id_( pack_key_( mat ) );
+
+					rec.roughnessTextureId = packedId;
+					rec.metalnessTextureId = packedId;
+					rec.alphaMaskTextureId = mat.alphaMaskTexturePath.empty() ? kNoTexture : packedId;
+					rec.flags = kBakedMaterialPackedRma;
+				}
+				else
+				{
+					rec.roughnessTextureId = tex_id_( mat.roughnessTexturePath );
+					rec.metalnessTextureId = tex_id_( mat.metalnessTexturePath );
+					rec.alphaMaskTextureId = tex_id_( mat.alphaMaskTexturePath );
+				}
+
+				write_tracked_( aOut, written, sizeof(rec), &rec );
+			}
+		}
+
+		// Write mesh records
+		write_padding_( aOut, written, kBakedAlignV2 );
+		assert( written == sections[2].offset );
+		{
+			BakedCountV2 const count{ std::uint32_t(meshRecords.size()), 0 };
+			write_tracked_( aOut, written, sizeof(count), &count );
+			write_tracked_( aOut, written, meshRecords.size()*sizeof(BakedMeshRecordV2), meshRecords.data() );
+		}
+
+		// Write geometry
+		for( std::size_t i = 0; i < aIndexedMeshes.size(); ++i )
+		{
+			auto const& imesh = aIndexedMeshes[i];
+			auto const& rec = meshRecords[i];
+
+			auto const write_array_ = [&] (std::uint64_t aOffset, std::size_t aBytes, void const* aData) {
+				write_padding_( aOut, written, kBakedAlignV2 );
+				assert( written == aOffset ); (void)aOffset;
+				write_tracked_( aOut, written, aBytes, aData );
+			};
+
+			if( packed )
+			{
+				write_array_( rec.positionsOffset, packedVertices[i].size(), packedVertices[i].data() );
+			}
+			else
+			{
+				write_array_( rec.positionsOffset, sizeof(glm::vec3)*rec.vertexCount, imesh.vert.data() );
+				write_array_( rec.normalsOffset, sizeof(glm::vec3)*rec.vertexCount, imesh.norm.data() );
+				write_array_( rec.texcoordsOffset, sizeof(glm::vec2)*rec.vertexCount, imesh.text.data() );
+				write_array_( rec.tangentsOffset, sizeof(glm::vec4)*rec.vertexCount, imesh.tangent.data() );
+			}
+
+			write_array_( rec.indicesOffset, sizeof(std::uint32_t)*rec.indexCount, imesh.indices.data() );
+		}
+
+		assert( written == sections[3].offset + sections[3].size );
+
+		// Write record sections
+		for( std::size_t i = 0; i < recordSections.size(); ++i )
+		{
+			auto const& rs = recordSections[i];
+
+			write_padding_( aOut, written, kBakedAlignV2 );
+			assert( written == sections[4+i].offset );
+
+			BakedCountV2 const count{ std::uint32_t(rs.count), 0 };
+			write_tracked_( aOut, written, sizeof(count), &count );
+			write_tracked_( aOut, written, rs.count*rs.recordSize, rs.records );
+
+			assert( written == sections[4+i].offset + sections[4+i].size );
+		}
+	}
+}
+
+namespace
+{
+	std::vector<IndexedMesh> index_meshes_( InputModel const& aModel, unsigned aJobs, float aErrorTolerance )
+	{
+		LUT_TRACE_SCOPE( __func__ );
+
+		// Meshes are independent. Each task writes only its own slot in
+		// indexed, so the result does not depend on aJobs.
+		std::vector<IndexedMesh> indexed( aModel.meshes.size() );
+
+		auto const index_mesh_ = [&] (std::size_t aMeshIndex)
+		{
+			LUT_TRACE_SCOPE( "index_mesh" );
+
+			auto const& imesh = aModel.meshes[aMeshIndex];
 			auto const endIndex = imesh.vertexStartIndex + imesh.vertexCount;
 
 			TriangleSoup soup;
@@ -466,8 +1021,18 @@ namespace
 				soup.norm.emplace_back( aModel.normals[i] );
 
 
-			indexed.emplace_back( make_indexed_mesh( soup, aErrorTolerance ) );
-		}
+			auto& mesh = indexed[aMeshIndex];
+			mesh = make_indexed_mesh( soup, aErrorTolerance );
+
+			// For Task 1.4
+			ComputeTangents(mesh);
+			// For Task 1.5
+			//Generate_TBN_Quaternion(mesh);
+		};
+
+		parallel_for( aModel.meshes.size(), aJobs, index_mesh_, [&] (std::size_t aMeshIndex) {
+			return aModel.meshes[aMeshIndex].vertexCount;
+		} );
 
 		return indexed;
 	}
@@ -475,12 +1040,47 @@ namespace
 
 namespace
 {
-	std::unordered_map<std::string,TextureInfo_> find_unique_textures_( InputModel const& aModel )
+	void optimize_meshes_( std::vector<IndexedMesh>& aMeshes, EOptimize_ aOptimize, unsigned aJobs )
+	{
+		LUT_TRACE_SCOPE( __func__ );
+
+		std::vector<VertexCacheStats> before( aMeshes.size() ), after( aMeshes.size() );
+
+		parallel_for( aMeshes.size(), aJobs, [&] (std::size_t aMeshIndex) {
+			LUT_TRACE_SCOPE( "optimize_mesh" );
+
+			auto& mesh = aMeshes[aMeshIndex];
+			before[aMeshIndex] = analyze_vertex_cache( mesh.indices, mesh.vert.size() );
+
+			optimize_vertex_cache( mesh, EOptimize_::overdraw == aOptimize );
+			optimize_vertex_fetch( mesh );
+
+			after[aMeshIndex] = analyze_vertex_cache( mesh.indices, mesh.vert.size() );
+		}, [&] (std::size_t aMeshIndex) {
+			return aMeshes[aMeshIndex].indices.size();
+		} );
+
+		VertexCacheStats totalBefore, totalAfter;
+		for( std::size_t i = 0; i < aMeshes.size(); ++i )
+		{
+			totalBefore += before[i];
+			totalAfter += after[i];
+		}
+
+		std::printf( " - vertex cache (FIFO %u): ACMR %.3f => %.3f, ATVR %.3f => %.3f%s\n", kVertexCacheSize, totalBefore.acmr(), totalAfter.acmr(), totalBefore.atvr(), totalAfter.atvr(), EOptimize_::overdraw == aOptimize ? " (with overdraw ordering)" : "" );
+	}
+}
+
+namespace
+{
+	std::unordered_map<std::string,TextureInfo_> find_unique_textures_( InputModel const& aModel, bool aPackTextures )
 	{
+		LUT_TRACE_SCOPE( __func__ );
+
 		std::unordered_map<std::string,TextureInfo_> unique;
 
 		std::uint32_t texid = 0;
-		auto const add_unique_ = [&] (std::string const& aPath, std::uint8_t aChannels)
+		auto const add_unique_ = [&] (std::string const& aPath, std::uint8_t aChannels, baked::BakedTextureFormat aFormat)
 		{
 			if( aPath.empty() )
 				return;
@@ -488,6 +1088,7 @@ namespace
 			TextureInfo_ info{};
 			info.uniqueId = texid;
 			info.channels = aChannels;
+			info.format = aFormat;
 
 			auto const [it, isNew] = unique.emplace( std::make_pair(aPath,info) );
 
@@ -497,22 +1098,111 @@ namespace
 
 		for( auto const& mat : aModel.materials )
 		{
-			add_unique_( mat.baseColorTexturePath, 4 );
-			add_unique_( mat.roughnessTexturePath, 1 ); 
-			add_unique_( mat.metalnessTexturePath, 1 ); 
-			add_unique_( mat.alphaMaskTexturePath, 4 );  // assume == baseColor
-			add_unique_( mat.normalMapTexturePath, 4 );  // eh...
+			// Same formats (and order) as the runtime uses for each role
+			add_unique_( mat.baseColorTexturePath, 4, baked::kBakedTextureRgba8Srgb );
+
+			if( aPackTextures )
+			{
+				// Materials sharing all three inputs (and constants, for
+				// missing ones) share the packed texture. The alpha mask is
+				// the alpha channel of the RGBA base color (see
+				// InputMaterialInfo); bake_textures_() takes it from there.
+				auto const key = pack_key_( mat );
+				add_unique_( key, 4, baked::kBakedTextureRgba8Unorm );
+
+				auto& info = unique[key];
+				info.packed = true;
+				info.packedSources[0] = mat.roughnessTexturePath;
+				info.packedSources[1] = mat.metalnessTexturePath;
+				info.packedSources[2] = mat.alphaMaskTexturePath;
+				pack_fill_( mat, info.packedFill );
+			}
+			else
+			{
+				add_unique_( mat.roughnessTexturePath, 1, baked::kBakedTextureR8Unorm ); 
+				add_unique_( mat.metalnessTexturePath, 1, baked::kBakedTextureR8Unorm ); 
+				add_unique_( mat.alphaMaskTexturePath, 4, baked::kBakedTextureR8Unorm );  // assume == baseColor
+			}
+
+			add_unique_( mat.normalMapTexturePath, 4, baked::kBakedTextureRgba8Unorm );  // eh...
 		}
 
 		return unique;
 	}
 
-	std::unordered_map<std::string,TextureInfo_> new_paths_( std::unordered_map<std::string,TextureInfo_> aTextures, std::filesystem::path const& aTexDir )
+	std::string pack_key_( InputMaterialInfo const& aMaterial )
+	{
+		// Paths can not start with a NUL, so this never collides with the
+		// key of a regular texture
+		std::string ret( 1, '\0' );
+		ret += aMaterial.roughnessTexturePath;
+		ret += '\0';
+		ret += aMaterial.metalnessTexturePath;
+		ret += '\0';
+		ret += aMaterial.alphaMaskTexturePath;
+
+		// Constants only matter for channels without a source
+		std::uint8_t fill[4];
+		pack_fill_( aMaterial, fill );
+
+		std::string const* const sources[] = { &aMaterial.roughnessTexturePath, &aMaterial.metalnessTexturePath, &aMaterial.alphaMaskTexturePath };
+		for( std::size_t c = 0; c < std::size(sources); ++c )
+		{
+			ret += '\0';
+			if( sources[c]->empty() )
+				ret += char(fill[c]);
+		}
+
+		return ret;
+	}
+
+	void pack_fill_( InputMaterialInfo const& aMaterial, std::uint8_t (&aFill)[4] )
+	{
+		// Channels without a texture hold the material's scalar factors.
+		// Missing (non-finite) factors default to rough and non-metallic;
+		// without a mask, everything is opaque.
+		auto const unorm8_ = [] (float aValue, float aDefault) {
+			if( !std::isfinite( aValue ) )
+				aValue = aDefault;
+			return std::uint8_t(std::lround( std::clamp( aValue, 0.f, 1.f ) * 255.f ));
+		};
+
+		aFill[0] = unorm8_( aMaterial.baseRoughness, 1.f );
+		aFill[1] = unorm8_( aMaterial.baseMetalness, 0.f );
+		aFill[2] = 255;
+		aFill[3] = 255;
+	}
+
+	std::unordered_map<std::string,TextureInfo_> new_paths_( std::unordered_map<std::string,TextureInfo_> aTextures, std::filesystem::path const& aTexDir, ETextures_ aTextureMode )
 	{
 		for( auto& entry : aTextures )
 		{
 			std::filesystem::path const originalPath( entry.first );
-			auto const filename = originalPath.filename();
+			auto filename = originalPath.filename();
+
+			// Named after the first of their sources, if any; the ID keeps
+			// different combinations apart
+			if( entry.second.packed )
+			{
+				filename.clear();
+				for( auto const& source : entry.second.packedSources )
+				{
+					if( !source.empty() )
+					{
+						filename = std::filesystem::path( source ).stem();
+						filename += "-";
+						break;
+					}
+				}
+
+				filename += "rma" + std::to_string( entry.second.uniqueId );
+			}
+
+			// Keep the original extension, so that e.g. a.png and a.jpg do not
+			// end up in the same file
+			if( ETextures_::bake == aTextureMode )
+				filename += baked::kBakedTextureExtension;
+
 			auto const newpath = aTexDir / filename;
 		
 			auto& info = entry.second;
@@ -524,6 +1214,130 @@ namespace
 		// argument, NRVO is unlikely to occur.
 		return aTextures; 
 	}
+
+	void copy_textures_( std::unordered_map<std::string,TextureInfo_> const& aTextures, std::filesystem::path const& aRootDir )
+	{
+		LUT_TRACE_SCOPE( __func__ );
+
+		std::size_t errors = 0;
+		for( auto const& entry : aTextures )
+		{
+			assert( !entry.second.packed ); // see parse_options_()
+			auto const dest = aRootDir / entry.second.newPath;
+
+			std::error_code ec;
+			bool ret = std::filesystem::copy_file( 
+				entry.first,
+				dest,
+				std::filesystem::copy_options::none,
+				ec
+			);
+
+			if( !ret )
+			{
+				++errors;
+				std::fprintf( stderr, "copy_file(): '%s' failed: %s (%s)\n", dest.string().c_str(), ec.message().c_str(), ec.category().name() );
+			}
+		}
+
+		auto const total = aTextures.size();
+		std::printf( "Copied %zu textures out of %zu.\n", total-errors, total );
+		if( errors )
+		{
+			std::fprintf( stderr, "Some copies reported an error. Currently, the code will never overwrite existing files. The errors likely just indicate that the file was copied previously. Remove old files manually, if necessary.\n" );
+		}
+	}
+
+	char const* texture_format_name_( baked::BakedTextureFormat aFormat )
+	{
+		switch( aFormat )
+		{
+			case baked::kBakedTextureR8Unorm: return "R8";
+			case baked::kBakedTextureRgba8Unorm: return "RGBA8";
+			case baked::kBakedTextureRgba8Srgb: return "RGBA8 sRGB";
+			case baked::kBakedTextureBc1Srgb: return "BC1 sRGB";
+			case baked::kBakedTextureBc4Unorm: return "BC4";
+			case baked::kBakedTextureBc5Unorm: return "BC5";
+			case baked::kBakedTextureBc7Srgb: return "BC7 sRGB";
+			case baked::kBakedTextureBc7Unorm: return "BC7";
+		}
+		return "?";
+	}
+
+	void bake_textures_( std::unordered_map<std::string,TextureInfo_> const& aTextures, std::filesystem::path const& aRootDir, ETextureCompression aCompression, unsigned aJobs )
+	{
+		LUT_TRACE_SCOPE( __func__ );
+
+		auto const start = std::chrono::steady_clock::now();
+
+		// In file order, which keeps the report below stable
+		std::vector<std::pair<std::string const,TextureInfo_> const*> entries( aTextures.size() );
+		for( auto const& entry : aTextures )
+			entries[entry.second.uniqueId] = &entry;
+
+		std::vector<std::uintmax_t> inputSizes( entries.size(), 0 );
+		for( std::size_t i = 0; i < entries.size(); ++i )
+		{
+			auto const add_size_ = [&] (std::string const& aPath) {
+				std::error_code ec;
+				auto const size = std::filesystem::file_size( aPath, ec );
+				if( !ec )
+					inputSizes[i] += size;
+			};
+
+			auto const& info = entries[i]->second;
+			if( info.packed )
+			{
+				for( auto const& source : info.packedSources )
+				{
+					if( !source.empty() )
+						add_size_( source );
+				}
+			}
+			else
+				add_size_( entries[i]->first );
+		}
+
+		// Unlike copying, baking always overwrites the output: the result
+		// depends on the baker, not just on the source image.
+		std::vector<TextureBakeInfo> results( entries.size() );
+		parallel_for( entries.size(), aJobs, [&] (std::size_t aIndex) {
+			LUT_TRACE_SCOPE( "bake_texture" );
+
+			auto const& entry = *entries[aIndex];
+			auto const dest = aRootDir / entry.second.newPath;
+
+			if( entry.second.packed )
+			{
+				// Only the alpha mask (b) is read from an RGBA image's alpha
+				auto const& info = entry.second;
+				PackedChannel inputs[4];
+				for( std::size_t c = 0; c < 4; ++c )
+					inputs[c] = PackedChannel{ info.packedSources[c].c_str(), 2 == c, info.packedFill[c] };
+
+				results[aIndex] = bake_packed_texture( inputs, dest.string().c_str(), aCompression );
+			}
+			else
+				results[aIndex] = bake_texture( entry.first.c_str(), dest.string().c_str(), entry.second.format, aCompression );
+		}, [&] (std::size_t aIndex) { return inputSizes[aIndex]; } );
+
+		for( std::size_t i = 0; i < entries.size(); ++i )
+		{
+			auto const& info = results[i];
+			std::printf( " - %s: %ux%u %s", entries[i]->second.newPath.c_str(), info.width, info.height, texture_format_name_( info.format ) );
+			if( std::isinf( info.psnr ) )
+				std::printf( "\n" );
+			else
+				std::printf( ", PSNR %.2f dB\n", info.psnr );
+		}
+
+		std::uintmax_t outputBytes = 0;
+		for( auto const* entry : entries )
+			outputBytes += std::filesystem::file_size( aRootDir / entry->second.newPath );
+
+		auto const bakeTime = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+		std::printf( "Baked %zu textures with mips in %.3f s => %ju kB\n", entries.size(), bakeTime, outputBytes/1024 );
+	}
 }
 
 
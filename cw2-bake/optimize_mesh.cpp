@@ -0,0 +1,335 @@
+#include "optimize_mesh.hpp"
+
+#include <limits>
+#include <numeric>
+#include <algorithm>
+#include <type_traits>
+
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+namespace
+{
+	constexpr std::uint32_t kNone_ = ~std::uint32_t(0);
+
+	// Triangles adjacent to each vertex, in CSR form
+	struct Adjacency_
+	{
+		std::vector<std::uint32_t> offsets; // vertexCount+1
+		std::vector<std::uint32_t> triangles;
+	};
+
+	Adjacency_ build_adjacency_( std::vector<std::uint32_t> const&, std::size_t aVertexCount );
+
+	// Returns the triangle order and the starts of the clusters in it
+	void tipsify_(
+		std::vector<std::uint32_t>& aOrder,
+		std::vector<std::uint32_t>& aClusters,
+		std::vector<std::uint32_t> const& aIndices,
+		std::size_t aVertexCount,
+		std::uint32_t aCacheSize
+	);
+
+	void sort_clusters_(
+		std::vector<std::uint32_t>& aOrder,
+		std::vector<std::uint32_t> const& aClusters,
+		IndexedMesh const&
+	);
+}
+
+VertexCacheStats analyze_vertex_cache( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount, std::uint32_t aCacheSize )
+{
+	assert( aCacheSize > 0 );
+
+	VertexCacheStats ret;
+	ret.triangles = aIndices.size() / 3;
+	ret.vertices = aVertexCount;
+
+	// FIFO cache: a vertex is in the cache if it was inserted fewer than
+	// aCacheSize insertions ago.
+	std::vector<std::size_t> insertedAt( aVertexCount, std::numeric_limits<std::size_t>::max() );
+	std::size_t time = 0;
+
+	for( auto const index : aIndices )
+	{
+		assert( index < aVertexCount );
+
+		auto& at = insertedAt[index];
+		if( at == std::numeric_limits<std::size_t>::max() || time - at >= aCacheSize )
+		{
+			at = time++;
+			++ret.misses;
+		}
+	}
+
+	return ret;
+}
+
+void optimize_vertex_cache( IndexedMesh& aMesh, bool aOptimizeOverdraw, std::uint32_t aCacheSize )
+{
+	assert( aCacheSize > 0 );
+	assert( 0 == aMesh.indices.size() % 3 );
+
+	std::vector<std::uint32_t> order, clusters;
+	tipsify_( order, clusters, aMesh.indices, aMesh.vert.size(), aCacheSize );
+
+	if( aOptimizeOverdraw )
+		sort_clusters_( order, clusters, aMesh );
+
+	std::vector<std::uint32_t> indices;
+	indices.reserve( aMesh.indices.size() );
+	for( auto const tri : order )
+	{
+		indices.push_back( aMesh.indices[3*tri+0] );
+		indices.push_back( aMesh.indices[3*tri+1] );
+		indices.push_back( aMesh.indices[3*tri+2] );
+	}
+
+	aMesh.indices = std::move(indices);
+}
+
+void optimize_vertex_fetch( IndexedMesh& aMesh )
+{
+	auto const vertexCount = aMesh.vert.size();
+
+	std::vector<std::uint32_t> remap( vertexCount, kNone_ );
+	std::vector<std::uint32_t> from;
+	from.reserve( vertexCount );
+
+	for( auto& index : aMesh.indices )
+	{
+		assert( index < vertexCount );
+		if( kNone_ == remap[index] )
+		{
+			remap[index] = std::uint32_t(from.size());
+			from.push_back( index );
+		}
+
+		index = remap[index];
+	}
+
+	auto const shuffle_ = [&] (auto& aAttrib) {
+		if( aAttrib.empty() )
+			return;
+
+		assert( aAttrib.size() == vertexCount );
+
+		std::remove_reference_t<decltype(aAttrib)> out( from.size() );
+		for( std::size_t i = 0; i < from.size(); ++i )
+			out[i] = aAttrib[from[i]];
+
+		aAttrib = std::move(out);
+	};
+
+	shuffle_( aMesh.vert );
+	shuffle_( aMesh.norm );
+	shuffle_( aMesh.text );
+	shuffle_( aMesh.tangent );
+}
+
+namespace
+{
+	Adjacency_ build_adjacency_( std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount )
+	{
+		Adjacency_ ret;
+		ret.offsets.assign( aVertexCount+1, 0 );
+
+		for( auto const index : aIndices )
+			++ret.offsets[index+1];
+
+		std::partial_sum( ret.offsets.begin(), ret.offsets.end(), ret.offsets.begin() );
+
+		ret.triangles.resize( aIndices.size() );
+
+		std::vector<std::uint32_t> fill( ret.offsets.begin(), ret.offsets.end()-1 );
+		for( std::size_t i = 0; i < aIndices.size(); ++i )
+			ret.triangles[fill[aIndices[i]]++] = std::uint32_t(i / 3);
+
+		return ret;
+	}
+
+	void tipsify_( std::vector<std::uint32_t>& aOrder, std::vector<std::uint32_t>& aClusters, std::vector<std::uint32_t> const& aIndices, std::size_t aVertexCount, std::uint32_t aCacheSize )
+	{
+		auto const triangleCount = aIndices.size() / 3;
+
+		aOrder.clear();
+		aOrder.reserve( triangleCount );
+		aClusters.clear();
+
+		if( 0 == triangleCount )
+			return;
+
+		auto const adj = build_adjacency_( aIndices, aVertexCount );
+
+		// live triangle count per vertex
+		std::vector<std::uint32_t> live( aVertexCount );
+		for( std::size_t v = 0; v < aVertexCount; ++v )
+			live[v] = adj.offsets[v+1] - adj.offsets[v];
+
+		std::vector<std::uint32_t> cacheTime( aVertexCount, 0 );
+		std::vector<char> emitted( triangleCount, 0 );
+
+		std::vector<std::uint32_t> deadEnd; // stack
+		std::vector<std::uint32_t> candidates;
+
+		std::uint32_t time = aCacheSize+1;
+		std::size_t cursor = 0;
+
+		// Start at the first vertex of the first triangle
+		std::uint32_t fan = aIndices[0];
+		aClusters.push_back( 0 );
+
+		while( kNone_ != fan )
+		{
+			candidates.clear();
+
+			for( auto t = adj.offsets[fan]; t < adj.offsets[fan+1]; ++t )
+			{
+				auto const tri = adj.triangles[t];
+				if( emitted[tri] )
+					continue;
+
+				for( std::size_t k = 0; k < 3; ++k )
+				{
+					auto const v = aIndices[3*tri+k];
+
+					deadEnd.push_back( v );
+					candidates.push_back( v );
+
+					--live[v];
+
+					if( time - cacheTime[v] > aCacheSize )
+						cacheTime[v] = time++;
+				}
+
+				emitted[tri] = 1;
+				aOrder.push_back( tri );
+			}
+
+			// Pick the next fanning vertex: the candidate that would still be
+			// in the cache after emitting all of its remaining triangles, and
+			// among those the oldest one.
+			std::uint32_t best = kNone_;
+			std::int64_t bestPriority = -1;
+			for( auto const v : candidates )
+			{
+				if( 0 == live[v] )
+					continue;
+
+				std::int64_t priority = 0;
+				if( std::int64_t(time) - cacheTime[v] + 2*std::int64_t(live[v]) <= aCacheSize )
+					priority = std::int64_t(time) - cacheTime[v];
+
+				if( priority > bestPriority )
+				{
+					bestPriority = priority;
+					best = v;
+				}
+			}
+
+			if( kNone_ != best )
+			{
+				fan = best;
+				continue;
+			}
+
+			// Dead end. Recently referenced vertices first, then any vertex
+			// that still has live triangles. Either way, this starts a new
+			// cluster.
+			fan = kNone_;
+			while( !deadEnd.empty() && kNone_ == fan )
+			{
+				auto const v = deadEnd.back();
+				deadEnd.pop_back();
+				if( live[v] > 0 )
+					fan = v;
+			}
+
+			while( kNone_ == fan && cursor < aVertexCount )
+			{
+				if( live[cursor] > 0 )
+					fan = std::uint32_t(cursor);
+				++cursor;
+			}
+
+			if( kNone_ != fan && aOrder.size() != aClusters.back() )
+				aClusters.push_back( std::uint32_t(aOrder.size()) );
+		}
+
+		assert( aOrder.size() == triangleCount );
+	}
+
+	void sort_clusters_( std::vector<std::uint32_t>& aOrder, std::vector<std::uint32_t> const& aClusters, IndexedMesh const& aMesh )
+	{
+		auto const clusterCount = aClusters.size();
+		if( clusterCount <= 1 )
+			return;
+
+		auto const cluster_end_ = [&] (std::size_t aCluster) {
+			return aCluster+1 < clusterCount ? aClusters[aCluster+1] : std::uint32_t(aOrder.size());
+		};
+
+		// Area-weighted centroid and normal of each cluster and of the mesh
+		std::vector<glm::vec3> centroids( clusterCount, glm::vec3(0.f) );
+		std::vector<glm::vec3> normals( clusterCount, glm::vec3(0.f) );
+
+		glm::vec3 meshCentroid( 0.f );
+		float meshArea = 0.f;
+
+		for( std::size_t c = 0; c < clusterCount; ++c )
+		{
+			float area = 0.f;
+			for( auto i = aClusters[c]; i < cluster_end_( c ); ++i )
+			{
+				auto const tri = aOrder[i];
+				auto const& a = aMesh.vert[aMesh.indices[3*tri+0]];
+				auto const& b = aMesh.vert[aMesh.indices[3*tri+1]];
+				auto const& d = aMesh.vert[aMesh.indices[3*tri+2]];
+
+				auto const n = glm::cross( b - a, d - a ); // |n| = 2*area
+				auto const w = glm::length( n );
+
+				centroids[c] += (a + b + d) * (w / 3.f);
+				normals[c] += n;
+				area += w;
+			}
+
+			meshCentroid += centroids[c];
+			meshArea += area;
+
+			if( area > 0.f )
+				centroids[c] /= area;
+		}
+
+		if( meshArea > 0.f )
+			meshCentroid /= meshArea;
+
+		// Clusters that face away from the mesh center tend to occlude the
+		// others, so draw them first.
+		std::vector<float> sortKey( clusterCount );
+		for( std::size_t c = 0; c < clusterCount; ++c )
+		{
+			auto const len = glm::length( normals[c] );
+			sortKey[c] = len > 0.f
+				? glm::dot( centroids[c] - meshCentroid, normals[c] / len )
+				: 0.f
+			;
+		}
+
+		std::vector<std::uint32_t> clusterOrder( clusterCount );
+		std::iota( clusterOrder.begin(), clusterOrder.end(), 0u );
+		std::stable_sort( clusterOrder.begin(), clusterOrder.end(), [&] (std::uint32_t aA, std::uint32_t aB) {
+			return sortKey[aA] > sortKey[aB];
+		} );
+
+		std::vector<std::uint32_t> order;
+		order.reserve( aOrder.size() );
+		for( auto const c : clusterOrder )
+			order.insert( order.end(), aOrder.begin() + aClusters[c], aOrder.begin() + cluster_end_( c ) );
+
+		aOrder = std::move(order);
+	}
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
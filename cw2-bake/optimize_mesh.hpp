@@ -0,0 +1,62 @@
+#ifndef OPTIMIZE_MESH_HPP_A4E9D2F1_7C38_4B65_8E1A_2F60C9B7D843
+#define OPTIMIZE_MESH_HPP_A4E9D2F1_7C38_4B65_8E1A_2F60C9B7D843
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "index_mesh.hpp"
+
+// Post-transform vertex cache size assumed by the optimizer and by the
+// statistics (FIFO replacement).
+constexpr std::uint32_t kVertexCacheSize = 16;
+
+// Result of simulating a FIFO post-transform vertex cache
+struct VertexCacheStats
+{
+	std::size_t misses = 0;    // = number of vertex shader invocations
+	std::size_t triangles = 0;
+	std::size_t vertices = 0;
+
+	// average cache miss ratio: misses per triangle (>= 0.5, ideally)
+	double acmr() const noexcept { return triangles ? double(misses) / triangles : 0.0; }
+	// average transform to vertex ratio: misses per vertex (>= 1.0)
+	double atvr() const noexcept { return vertices ? double(misses) / vertices : 0.0; }
+
+	VertexCacheStats& operator+= ( VertexCacheStats const& aOther ) noexcept
+	{
+		misses += aOther.misses;
+		triangles += aOther.triangles;
+		vertices += aOther.vertices;
+		return *this;
+	}
+};
+
+VertexCacheStats analyze_vertex_cache(
+	std::vector<std::uint32_t> const& aIndices,
+	std::size_t aVertexCount,
+	std::uint32_t aCacheSize = kVertexCacheSize
+);
+
+// Reorders the triangles of aMesh for the post-transform vertex cache, using
+// Tipsify (Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex
+// Locality and Reduced Overdraw", SIGGRAPH 2007).
+//
+// If aOptimizeOverdraw is set, the clusters produced by Tipsify (runs of
+// triangles between points where the cache is effectively restarted) are
+// additionally sorted so that outward-facing clusters are drawn first. This
+// keeps most of the vertex cache benefit, since each cluster begins with a
+// cold cache anyway.
+void optimize_vertex_cache(
+	IndexedMesh&,
+	bool aOptimizeOverdraw = false,
+	std::uint32_t aCacheSize = kVertexCacheSize
+);
+
+// Reorders the vertices of aMesh in order of first use by the index buffer,
+// and remaps the indices accordingly. Vertices that are not referenced are
+// dropped. Should run after optimize_vertex_cache().
+void optimize_vertex_fetch( IndexedMesh& );
+
+#endif // OPTIMIZE_MESH_HPP_A4E9D2F1_7C38_4B65_8E1A_2F60C9B7D843
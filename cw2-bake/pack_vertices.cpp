@@ -0,0 +1,138 @@
+#include "pack_vertices.hpp"
+
+#include <cmath>
+#include <cassert>
+#include <cstring>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+namespace
+{
+	// Octahedral encoding of a unit vector into [-1,1]^2. See e.g.
+	// Cigolle et al., "A Survey of Efficient Representations for Independent
+	// Unit Vectors", JCGT 2014.
+	glm::vec2 oct_encode_( glm::vec3 aVec )
+	{
+		float const l1 = std::abs(aVec.x) + std::abs(aVec.y) + std::abs(aVec.z);
+		if( l1 <= 0.f )
+			return glm::vec2( 0.f ); // degenerate; decodes to +Z
+
+		aVec /= l1;
+
+		glm::vec2 ret( aVec.x, aVec.y );
+		if( aVec.z < 0.f )
+		{
+			ret.x = (1.f - std::abs(aVec.y)) * (aVec.x >= 0.f ? 1.f : -1.f);
+			ret.y = (1.f - std::abs(aVec.x)) * (aVec.y >= 0.f ? 1.f : -1.f);
+		}
+
+		return ret;
+	}
+
+	void pack_frame_( std::int16_t aOut[4], glm::vec3 const& aNormal, glm::vec4 const& aTangent )
+	{
+		auto const n = oct_encode_( aNormal );
+		auto const t = oct_encode_( glm::vec3( aTangent ) );
+
+		aOut[0] = std::int16_t(glm::packSnorm1x16( n.x ));
+		aOut[1] = std::int16_t(glm::packSnorm1x16( n.y ));
+		aOut[2] = std::int16_t(glm::packSnorm1x16( t.x ));
+		aOut[3] = std::int16_t(glm::packSnorm1x16( t.y ));
+	}
+
+	void pack_texcoord_( std::uint16_t aOut[2], glm::vec2 const& aTexCoord )
+	{
+		aOut[0] = glm::packHalf1x16( aTexCoord.x );
+		aOut[1] = glm::packHalf1x16( aTexCoord.y );
+	}
+
+	template< typename tVertex >
+	std::vector<std::byte> to_bytes_( std::vector<tVertex> const& aVertices )
+	{
+		std::vector<std::byte> ret( aVertices.size() * sizeof(tVertex) );
+		if( !ret.empty() )
+			std::memcpy( ret.data(), aVertices.data(), ret.size() );
+		return ret;
+	}
+}
+
+std::size_t vertex_size( baked::BakedVertexFormatV2 aFormat )
+{
+	switch( aFormat )
+	{
+		case baked::kBakedVertexSeparate:
+			return sizeof(glm::vec3) + sizeof(glm::vec3) + sizeof(glm::vec2) + sizeof(glm::vec4);
+		case baked::kBakedVertexPackedF32:
+			return sizeof(baked::BakedPackedVertexF32);
+		case baked::kBakedVertexPackedQ16:
+			return sizeof(baked::BakedPackedVertexQ16);
+	}
+
+	assert( false );
+	return 0;
+}
+
+std::vector<std::byte> pack_vertices( IndexedMesh const& aMesh, baked::BakedVertexFormatV2 aFormat, baked::BakedQuantizationRecordV2& aQuantization )
+{
+	auto const count = aMesh.vert.size();
+	assert( aMesh.norm.size() == count );
+	assert( aMesh.text.size() == count );
+	assert( aMesh.tangent.size() == count );
+
+	for( int i = 0; i < 3; ++i )
+	{
+		aQuantization.offset[i] = 0.f;
+		aQuantization.scale[i] = 1.f;
+	}
+
+	if( baked::kBakedVertexPackedF32 == aFormat )
+	{
+		std::vector<baked::BakedPackedVertexF32> verts( count );
+		for( std::size_t i = 0; i < count; ++i )
+		{
+			auto& v = verts[i];
+			v.position[0] = aMesh.vert[i].x;
+			v.position[1] = aMesh.vert[i].y;
+			v.position[2] = aMesh.vert[i].z;
+			v.tangentSign = aMesh.tangent[i].w < 0.f ? -1.f : 1.f;
+
+			pack_frame_( v.frame, aMesh.norm[i], aMesh.tangent[i] );
+			pack_texcoord_( v.texcoord, aMesh.text[i] );
+		}
+
+		return to_bytes_( verts );
+	}
+
+	assert( baked::kBakedVertexPackedQ16 == aFormat );
+
+	// Quantize against the mesh's bounding box. An empty extent (flat mesh)
+	// gets scale 0, so that all of its vertices decode to the offset.
+	glm::vec3 const extent = aMesh.aabbMax - aMesh.aabbMin;
+	glm::vec3 invExtent;
+	for( int i = 0; i < 3; ++i )
+	{
+		aQuantization.offset[i] = aMesh.aabbMin[i];
+		aQuantization.scale[i] = extent[i] / 65535.f;
+		invExtent[i] = extent[i] > 0.f ? 1.f / extent[i] : 0.f;
+	}
+
+	std::vector<baked::BakedPackedVertexQ16> verts( count );
+	for( std::size_t i = 0; i < count; ++i )
+	{
+		auto& v = verts[i];
+
+		glm::vec3 const rel = (aMesh.vert[i] - aMesh.aabbMin) * invExtent;
+		v.position[0] = glm::packUnorm1x16( rel.x );
+		v.position[1] = glm::packUnorm1x16( rel.y );
+		v.position[2] = glm::packUnorm1x16( rel.z );
+		v.tangentSign = aMesh.tangent[i].w < 0.f ? 0 : 65535;
+
+		pack_frame_( v.frame, aMesh.norm[i], aMesh.tangent[i] );
+		pack_texcoord_( v.texcoord, aMesh.text[i] );
+	}
+
+	return to_bytes_( verts );
+}
+
+//--///}}}1/////////////// vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,26 @@
+#ifndef PACK_VERTICES_HPP_0B5E2A8C_64D1_4F0E_A7C3_91D2E4F6B830
+#define PACK_VERTICES_HPP_0B5E2A8C_64D1_4F0E_A7C3_91D2E4F6B830
+
+#include <vector>
+
+#include <cstddef>
+
+#include "index_mesh.hpp"
+
+#include "../cw2/baked_format.hpp"
+
+// Size in bytes of a single vertex in the given format. For
+// kBakedVertexSeparate this is the sum of the four fp32 attributes.
+std::size_t vertex_size( baked::BakedVertexFormatV2 );
+
+// Interleave and compress the vertex attributes of aMesh into a single stream
+// of BakedPackedVertexF32 or BakedPackedVertexQ16 (see baked_format.hpp).
+// aQuantization receives the parameters needed to reconstruct positions; for
+// kBakedVertexPackedF32 it is the identity (offset 0, scale 1).
+std::vector<std::byte> pack_vertices(
+	IndexedMesh const&,
+	baked::BakedVertexFormatV2,
+	baked::BakedQuantizationRecordV2& aQuantization
+);
+
+#endif // PACK_VERTICES_HPP_0B5E2A8C_64D1_4F0E_A7C3_91D2E4F6B830
@@ -0,0 +1,121 @@
+#ifndef PARALLEL_HPP_5C1F7E93_2B64_4A8D_9E07_D3A6B8F14C52
+#define PARALLEL_HPP_5C1F7E93_2B64_4A8D_9E07_D3A6B8F14C52
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <numeric>
+#include <utility>
+#include <algorithm>
+#include <exception>
+
+#include <cstddef>
+
+// Number of worker threads to use for a --jobs value. 0 selects the number of
+// hardware threads.
+inline unsigned resolve_jobs( unsigned aJobs )
+{
+	if( 0 != aJobs )
+		return aJobs;
+
+	auto const hw = std::thread::hardware_concurrency();
+	return hw ? hw : 1;
+}
+
+// Calls aTask(i) for each i in [0, aCount), using up to aJobs threads (the
+// calling thread is one of them). Tasks are handed out one at a time from a
+// shared counter, so idle threads take the next pending task as soon as they
+// finish one. If aCost is given, tasks are started in order of decreasing
+// cost, which keeps a single large task from ending up last.
+//
+// Each task must only write its own outputs (e.g. results[i]); the result is
+// then independent of the number of threads and of scheduling. If a task
+// throws (or a thread cannot be started), the remaining tasks are skipped and
+// the first exception is rethrown on the calling thread once all threads
+// have been joined.
+template< typename tTask, typename tCost >
+void parallel_for( std::size_t aCount, unsigned aJobs, tTask&& aTask, tCost&& aCost )
+{
+	std::vector<std::size_t> order( aCount );
+	std::iota( order.begin(), order.end(), std::size_t(0) );
+	std::stable_sort( order.begin(), order.end(), [&] (std::size_t aA, std::size_t aB) {
+		return aCost( aA ) > aCost( aB );
+	} );
+
+	std::atomic<std::size_t> next{ 0 };
+	std::atomic<bool> failed{ false };
+
+	std::mutex errorMutex;
+	std::exception_ptr error;
+
+	auto const fail_ = [&] {
+		std::lock_guard<std::mutex> lock( errorMutex );
+		if( !error )
+			error = std::current_exception();
+		failed = true;
+	};
+
+	auto const worker_ = [&] {
+		while( !failed.load( std::memory_order_relaxed ) )
+		{
+			auto const i = next.fetch_add( 1, std::memory_order_relaxed );
+			if( i >= aCount )
+				break;
+
+			try
+			{
+				aTask( order[i] );
+			}
+			catch( ... )
+			{
+				fail_();
+			}
+		}
+	};
+
+	// Joins the started threads on every path out of here; destroying a
+	// joinable std::thread calls std::terminate().
+	struct Joiner_
+	{
+		std::vector<std::thread> threads;
+
+		~Joiner_()
+		{
+			for( auto& thread : threads )
+				thread.join();
+		}
+	} joiner;
+
+	auto const threadCount = std::min<std::size_t>( std::max( aJobs, 1u ), aCount );
+
+	// If a thread cannot be started, the ones that were stop after their
+	// current task and the error is reported like a failed task.
+	try
+	{
+		joiner.threads.reserve( threadCount );
+		for( std::size_t i = 1; i < threadCount; ++i )
+			joiner.threads.emplace_back( worker_ );
+	}
+	catch( ... )
+	{
+		fail_();
+	}
+
+	worker_();
+
+	for( auto& thread : joiner.threads )
+		thread.join();
+	joiner.threads.clear();
+
+	if( error )
+		std::rethrow_exception( error );
+}
+
+template< typename tTask >
+void parallel_for( std::size_t aCount, unsigned aJobs, tTask&& aTask )
+{
+	parallel_for( aCount, aJobs, std::forward<tTask>(aTask), [] (std::size_t) { return 0; } );
+}
+
+#endif // PARALLEL_HPP_5C1F7E93_2B64_4A8D_9E07_D3A6B8F14C52
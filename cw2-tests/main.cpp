@@ -0,0 +1,123 @@
+#include "tests.hpp"
+
+#include <vector>
+#include <exception>
+
+#include <cstdio>
+#include <cstring>
+
+namespace
+{
+	struct Case_
+	{
+		char const* name;
+		void (*func)();
+		bool benchmark;
+	};
+
+	constexpr unsigned kMaxPrintedFailures_ = 8;
+
+	// Function-local, since cases register during static initialization
+	std::vector<Case_>& cases_()
+	{
+		static std::vector<Case_> cases;
+		return cases;
+	}
+
+	unsigned gFailures_ = 0; // of the running case
+}
+
+int main( int aArgc, char* aArgv[] ) try
+{
+	bool benchmark = false;
+	char const* filter = nullptr;
+
+	for( int i = 1; i < aArgc; ++i )
+	{
+		if( 0 == std::strcmp( "--benchmark", aArgv[i] ) )
+			benchmark = true;
+		else if( '-' != aArgv[i][0] && !filter )
+			filter = aArgv[i];
+		else
+		{
+			std::fprintf( stderr, "Usage: %s [--benchmark] [NAME]\n"
+				"Runs the tests (or, with --benchmark, the benchmarks) whose names contain NAME.\n", aArgv[0] );
+			return 2;
+		}
+	}
+
+	unsigned run = 0, failed = 0;
+	for( auto const& c : cases_() )
+	{
+		if( c.benchmark != benchmark || (filter && !std::strstr( c.name, filter )) )
+			continue;
+
+		std::printf( "%s\n", c.name );
+		std::fflush( stdout );
+
+		gFailures_ = 0;
+		try
+		{
+			c.func();
+		}
+		catch( std::exception const& eErr )
+		{
+			std::fprintf( stderr, "  exception: %s\n", eErr.what() );
+			++gFailures_;
+		}
+
+		++run;
+		if( gFailures_ )
+		{
+			std::fprintf( stderr, "  FAILED (%u checks)\n", gFailures_ );
+			++failed;
+		}
+	}
+
+	std::printf( "%u of %u %s passed\n", run - failed, run, benchmark ? "benchmarks" : "tests" );
+	return failed ? 1 : 0;
+}
+catch( std::exception const& eErr )
+{
+	std::fprintf( stderr, "Top-level exception: %s\n", eErr.what() );
+	return 1;
+}
+
+namespace tests
+{
+	bool register_case( char const* aName, void (*aFunc)(), bool aBenchmark )
+	{
+		cases_().emplace_back( Case_{ aName, aFunc, aBenchmark } );
+		return true;
+	}
+
+	bool check( bool aPassed, char const* aExpr, char const* aFile, int aLine )
+	{
+		if( !aPassed && gFailures_++ < kMaxPrintedFailures_ )
+			std::fprintf( stderr, "  %s:%d: CHECK( %s ) failed\n", aFile, aLine, aExpr );
+
+		return aPassed;
+	}
+
+
+	std::uint32_t Random::next() noexcept
+	{
+		// PCG-XSH-RR
+		auto const old = mState;
+		mState = old * 6364136223846793005ull + 1442695040888963407ull;
+
+		auto const xorshifted = std::uint32_t(((old >> 18) ^ old) >> 27);
+		auto const rot = std::uint32_t(old >> 59);
+		return (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+	}
+
+	float Random::uniform( float aMin, float aMax ) noexcept
+	{
+		return aMin + (aMax - aMin) * float(next() >> 8) * (1.f / float(1u << 24));
+	}
+
+	std::uint32_t Random::below( std::uint32_t aCount ) noexcept
+	{
+		return std::uint32_t((std::uint64_t(next()) * aCount) >> 32);
+	}
+}
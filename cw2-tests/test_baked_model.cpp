@@ -0,0 +1,62 @@
+#include "tests.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include <cstring>
+
+#include "../cw2/baked_model.hpp"
+#include "../cw2/baked_format.hpp"
+
+#include "../labutils/error.hpp"
+
+namespace
+{
+	// Header of a V1 file with no textures, materials or meshes
+	std::vector<char> empty_v1_()
+	{
+		std::vector<char> ret( 32 + 3*sizeof(std::uint32_t), 0 );
+		std::memcpy( ret.data(), baked::kFileMagic, 16 );
+		std::memcpy( ret.data() + 16, baked::kFileVariantV1, 16 );
+		return ret;
+	}
+
+	bool loads_( std::vector<char> const& aBytes )
+	{
+		auto const path = (std::filesystem::temp_directory_path() / "cw2-tests-baked-model.comp5822mesh").string();
+
+		{
+			std::ofstream of( path, std::ios::binary );
+			of.write( aBytes.data(), std::streamsize(aBytes.size()) );
+		}
+
+		bool ret = true;
+		try
+		{
+			auto const model = load_baked_model( path.c_str() );
+			ret = model.textures.empty() && model.materials.empty() && model.meshes.empty();
+		}
+		catch( lut::Error const& )
+		{
+			ret = false;
+		}
+
+		std::filesystem::remove( path );
+		return ret;
+	}
+}
+
+TEST_CASE( baked_model_checks_every_variant_byte )
+{
+	CHECK( loads_( empty_v1_() ) );
+
+	// Every byte of the magic and of the variant counts, including the last
+	for( std::size_t i : { 0u, 2u, 15u, 16u, 25u, 31u } )
+	{
+		auto bytes = empty_v1_();
+		bytes[i] ^= 'x';
+		CHECK( !loads_( bytes ) );
+	}
+}
@@ -0,0 +1,148 @@
+#include "tests.hpp"
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+#include "../cw2/benchmark.hpp"
+
+#include "../labutils/error.hpp"
+
+namespace
+{
+	bool parses_( char const* aText )
+	{
+		try
+		{
+			parse_camera_path( aText, "test" );
+			return true;
+		}
+		catch( labutils::Error const& )
+		{
+			return false;
+		}
+	}
+
+	bool near_( glm::mat4 const& aA, glm::mat4 const& aB, float aTolerance = 1e-5f )
+	{
+		for( int i = 0; i < 4; ++i )
+		{
+			if( glm::length( aA[i] - aB[i] ) > aTolerance )
+				return false;
+		}
+		return true;
+	}
+}
+
+TEST_CASE( parse_camera_path_forms_and_comments )
+{
+	auto const path = parse_camera_path(
+		"# header comment\n"
+		"\n"
+		"0   1 2 3   90 0      # yaw only\n"
+		"  \t\n"
+		"2.5 4 5 6   1 0 0 0\n"
+		"3   0 0 0   0 0 2 0", // not normalized, no final newline
+		"test"
+	);
+
+	CHECK( 3 == path.keyframes.size() );
+	if( 3 != path.keyframes.size() )
+		return;
+
+	auto const& k0 = path.keyframes[0];
+	CHECK( 0.f == k0.time && glm::vec3( 1.f, 2.f, 3.f ) == k0.position );
+
+	// Yaw 90 degrees turns the view direction (-z) to -x
+	auto const view = glm::mat3_cast( k0.orientation ) * glm::vec3( 0.f, 0.f, -1.f );
+	CHECK( glm::length( view - glm::vec3( -1.f, 0.f, 0.f ) ) < 1e-5f );
+
+	CHECK( 2.5f == path.keyframes[1].time );
+	CHECK( std::abs( glm::length( path.keyframes[2].orientation ) - 1.f ) < 1e-6f );
+
+	// Clamped at the ends, interpolated between
+	CHECK( near_( sample_camera_path( path, -1.f ), sample_camera_path( path, 0.f ) ) );
+	CHECK( near_( sample_camera_path( path, 9.f ), sample_camera_path( path, 3.f ) ) );
+	auto const mid = sample_camera_path( path, 1.25f );
+	CHECK( glm::length( glm::vec3( mid[3] ) - glm::vec3( 2.5f, 3.5f, 4.5f ) ) < 1e-5f );
+
+	CHECK( 0.f == camera_path_time( path, 0, 7 ) );
+	CHECK( 3.f == camera_path_time( path, 6, 7 ) );
+	CHECK( 0.f == camera_path_time( path, 0, 1 ) );
+
+	// Printed keyframes parse back to the same camera
+	auto const printed = format_camera_keyframe( 0.f, mid );
+	auto const reparsed = parse_camera_path( printed.c_str(), "printed" );
+	CHECK( near_( sample_camera_path( reparsed, 0.f ), mid ) );
+}
+
+TEST_CASE( parse_camera_path_rejects_bad_input )
+{
+	CHECK( parses_( "0 0 0 0 0 0" ) );
+
+	CHECK( !parses_( "" ) );                            // no keyframes
+	CHECK( !parses_( "# only a comment\n" ) );
+	CHECK( !parses_( "0 0 0 0 0" ) );                   // 5 values
+	CHECK( !parses_( "0 0 0 0 0 0 0" ) );               // 7 values
+	CHECK( !parses_( "0 0 0 0 0 0 0 0 0" ) );           // 9 values
+	CHECK( !parses_( "0 0 0 0 0 0 x" ) );               // junk
+	CHECK( !parses_( "0 0 0 0  0 0 0 0" ) );            // zero quaternion
+	CHECK( !parses_( "1 0 0 0 0 0\n1 0 0 0 0 0" ) );    // equal times
+	CHECK( !parses_( "1 0 0 0 0 0\n0.5 0 0 0 0 0" ) );  // decreasing times
+}
+
+TEST_CASE( percentile_nearest_rank )
+{
+	std::vector<double> const values = { 5.0, 1.0, 4.0, 2.0, 3.0, 6.0, 7.0, 8.0, 9.0, 10.0 };
+
+	CHECK( 5.0 == percentile( values, 50.0 ) );
+	CHECK( 10.0 == percentile( values, 95.0 ) );
+	CHECK( 10.0 == percentile( values, 100.0 ) );
+	CHECK( 1.0 == percentile( values, 0.0 ) );          // rank clamped to 1
+	CHECK( 1.0 == percentile( values, 10.0 ) );
+	CHECK( 2.0 == percentile( values, 10.5 ) );
+
+	// Negative values (unknown) are ignored
+	CHECK( 2.0 == percentile( { -1.0, 2.0, -5.0, 4.0 }, 50.0 ) );
+	CHECK( percentile( { -1.0, -2.0 }, 50.0 ) < 0.0 );
+	CHECK( percentile( {}, 50.0 ) < 0.0 );
+	CHECK( 7.0 == percentile( { 7.0 }, 99.0 ) );
+}
+
+TEST_CASE( write_benchmark_csv_rows )
+{
+	std::vector<FrameSample> samples( 3 );
+	for( std::size_t i = 0; i < samples.size(); ++i )
+	{
+		samples[i].frameMs = 10.0 + double(i);
+		samples[i].cpuMs = 2.0;
+		samples[i].gpuMs = 0 == i ? -1.0 : 5.0;
+		samples[i].draws = 100 + i;
+		samples[i].triangles = 1000;
+	}
+
+	auto const path = (std::filesystem::temp_directory_path() / "cw2-tests-benchmark.csv").string();
+	write_benchmark_csv( path.c_str(), samples );
+
+	std::vector<std::string> lines;
+	{
+		std::ifstream in( path );
+		for( std::string line; std::getline( in, line ); )
+			lines.emplace_back( line );
+	}
+	std::filesystem::remove( path );
+
+	// Header and one row per frame; nothing else
+	CHECK( 4 == lines.size() );
+	if( 4 != lines.size() )
+		return;
+
+	CHECK( "frame,frame_ms,cpu_ms,gpu_ms,draws,triangles" == lines[0] );
+	CHECK( "0,10.0000,2.0000,,100,1000" == lines[1] );
+	CHECK( "2,12.0000,2.0000,5.0000,102,1000" == lines[3] );
+}
@@ -0,0 +1,146 @@
+#include "tests.hpp"
+
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../cw2/clustered_lights.hpp"
+
+// clusters.comp can only be compared against assign_lights() on a device.
+// These tests pin down the reference: a fragment's list must hold every
+// light that reaches it, up to kMaxLightsPerCluster.
+
+namespace
+{
+	constexpr float kNear_ = 0.1f, kFar_ = 100.f;
+	constexpr std::uint32_t kWidth_ = 1280, kHeight_ = 720;
+
+	struct Scene_
+	{
+		glm::mat4 camera, projection;
+		LightClusterUniform uniform;
+	};
+
+	Scene_ make_scene_( std::uint32_t aLightCount )
+	{
+		Scene_ ret;
+		ret.camera = glm::lookAt( glm::vec3( 3.f, 2.f, 12.f ), glm::vec3( 0.f, 0.f, -5.f ), glm::vec3( 0.f, 1.f, 0.f ) );
+		ret.projection = glm::perspectiveRH_ZO( glm::radians( 60.f ), float(kWidth_) / kHeight_, kNear_, kFar_ );
+		ret.projection[1][1] *= -1.f;
+		ret.uniform = make_light_cluster_uniform( ret.camera, ret.projection, kNear_, kFar_, kWidth_, kHeight_, aLightCount );
+		return ret;
+	}
+
+	// World space position of the fragment at aFragCoord with view space
+	// depth aDepth
+	glm::vec3 unproject_( Scene_ const& aScene, glm::vec2 const& aFragCoord, float aDepth )
+	{
+		auto const ndc = aFragCoord / glm::vec2( float(kWidth_), float(kHeight_) ) * 2.f - 1.f;
+		auto const p = glm::inverse( aScene.projection ) * glm::vec4( ndc, 1.f, 1.f );
+		auto const ray = glm::vec3( p ) / p.w;
+		auto const view = ray / -ray.z * aDepth;
+		return glm::vec3( glm::inverse( aScene.camera ) * glm::vec4( view, 1.f ) );
+	}
+
+	// Checks the lists at random fragments. Returns the number of lights
+	// that were found to cover a fragment.
+	std::size_t check_fragments_( tests::Random& aRandom, Scene_ const& aScene, std::vector<PointLight> const& aLights, LightClusterLists const& aLists, int aFragments )
+	{
+		std::size_t covering = 0;
+		for( int iter = 0; iter < aFragments; ++iter )
+		{
+			glm::vec2 const frag( aRandom.uniform( 0.f, float(kWidth_) ), aRandom.uniform( 0.f, float(kHeight_) ) );
+			auto const depth = kNear_ * std::pow( kFar_ / kNear_, aRandom.uniform( 0.f, 1.f ) );
+			auto const pos = unproject_( aScene, frag, depth );
+
+			auto const cluster = light_cluster_index( aScene.uniform, frag, pos );
+			CHECK( cluster < kLightClusterCount );
+			if( cluster >= kLightClusterCount )
+				continue;
+
+			auto const count = aLists.counts[cluster];
+			CHECK( count <= kMaxLightsPerCluster );
+
+			auto const beg = aLists.indices.begin() + std::ptrdiff_t(cluster) * kMaxLightsPerCluster;
+			auto const end = beg + std::min( count, kMaxLightsPerCluster );
+			CHECK( std::is_sorted( beg, end ) );
+
+			for( std::uint32_t i = 0; i < aLights.size(); ++i )
+			{
+				// A small margin for fragments on cluster boundaries
+				auto const& pr = aLights[i].positionRadius;
+				if( glm::length( glm::vec3( pr ) - pos ) > pr.w - 1e-4f * depth )
+					continue;
+
+				++covering;
+
+				// Dropped only if the list is full with lower indices
+				bool const listed = std::binary_search( beg, end, i );
+				CHECK( listed || (kMaxLightsPerCluster == count && i > *(end-1)) );
+			}
+		}
+
+		return covering;
+	}
+}
+
+TEST_CASE( assign_lights_covers_fragments )
+{
+	tests::Random random( 19 );
+
+	auto const lights = make_random_lights( 500, glm::vec3( -20.f, -5.f, -60.f ), glm::vec3( 20.f, 10.f, 15.f ), 2.f, 19 );
+	auto const scene = make_scene_( std::uint32_t(lights.size()) );
+	auto const lists = assign_lights( scene.uniform, lights );
+
+	CHECK( kLightClusterCount == lists.counts.size() );
+	CHECK( std::size_t(kLightClusterCount) * kMaxLightsPerCluster == lists.indices.size() );
+
+	// Lights must actually reach some of the sampled fragments, and not
+	// every cluster may list every light
+	CHECK( check_fragments_( random, scene, lights, lists, 4000 ) > 1000 );
+	CHECK( *std::max_element( lists.counts.begin(), lists.counts.end() ) < lights.size() );
+
+	// Only the first lightCount lights are assigned
+	auto partial = scene;
+	partial.uniform.lightCount = 10;
+	auto const few = assign_lights( partial.uniform, lights );
+	for( std::uint32_t c = 0; c < kLightClusterCount; ++c )
+	{
+		for( std::uint32_t i = 0; i < few.counts[c]; ++i )
+			CHECK( few.indices[std::size_t(c) * kMaxLightsPerCluster + i] < 10 );
+	}
+}
+
+TEST_CASE( assign_lights_caps_clusters )
+{
+	tests::Random random( 191 );
+
+	// More lights than fit, all around the camera with a radius that covers
+	// the whole frustum
+	std::vector<PointLight> lights( kMaxLightsPerCluster + 72 );
+	for( auto& light : lights )
+	{
+		light.positionRadius = glm::vec4( random.uniform( -1.f, 1.f ), random.uniform( -1.f, 1.f ), random.uniform( 0.f, 2.f ), 2.f * kFar_ );
+		light.color = glm::vec4( 1.f );
+	}
+
+	auto const scene = make_scene_( std::uint32_t(lights.size()) );
+	auto const lists = assign_lights( scene.uniform, lights );
+
+	// Every cluster is full, with the lowest light indices
+	bool full = true;
+	for( std::uint32_t c = 0; c < kLightClusterCount; ++c )
+	{
+		full = full && kMaxLightsPerCluster == lists.counts[c];
+		for( std::uint32_t i = 0; i < kMaxLightsPerCluster; ++i )
+			full = full && i == lists.indices[std::size_t(c) * kMaxLightsPerCluster + i];
+	}
+	CHECK( full );
+
+	check_fragments_( random, scene, lights, lists, 200 );
+}
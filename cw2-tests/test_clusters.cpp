@@ -0,0 +1,221 @@
+#include "tests.hpp"
+
+#include <vector>
+
+#include <cmath>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../cw2/culling.hpp"
+#include "../cw2-bake/index_mesh.hpp"
+#include "../cw2-bake/optimize_mesh.hpp"
+#include "../cw2-bake/build_clusters.hpp"
+
+namespace
+{
+	// Bumpy sphere, so that clusters get proper normal cones, as a soup of
+	// aRes x aRes quads with shared corners
+	TriangleSoup bumpy_sphere_( std::uint32_t aRes )
+	{
+		auto const point_ = [&] (std::uint32_t aI, std::uint32_t aJ) {
+			float const u = float(aI) / aRes * 6.2831853f, v = float(aJ) / aRes * 3.1415927f;
+			float const r = 5.f + 0.3f * std::sin( 7.f * u ) * std::sin( 5.f * v );
+			return r * glm::vec3( std::cos( u ) * std::sin( v ), std::cos( v ), std::sin( u ) * std::sin( v ) );
+		};
+
+		TriangleSoup ret;
+		for( std::uint32_t i = 0; i < aRes; ++i )
+		{
+			for( std::uint32_t j = 0; j < aRes; ++j )
+			{
+				std::uint32_t const corners[6][2] = { {i,j}, {i+1,j}, {i+1,j+1}, {i,j}, {i+1,j+1}, {i,j+1} };
+				for( auto const& c : corners )
+				{
+					auto const p = point_( c[0] % aRes, c[1] );
+					ret.vert.emplace_back( p );
+					ret.norm.emplace_back( glm::normalize( p ) );
+					ret.text.emplace_back( float(c[0]) / aRes, float(c[1]) / aRes );
+				}
+			}
+		}
+
+		return ret;
+	}
+
+	// Unrelated random triangles; most clusters get no usable cone
+	TriangleSoup random_soup_( tests::Random& aRandom, std::size_t aTriangles )
+	{
+		TriangleSoup ret;
+		for( std::size_t i = 0; i < 3*aTriangles; ++i )
+		{
+			ret.vert.emplace_back( aRandom.uniform( -5.f, 5.f ), aRandom.uniform( -5.f, 5.f ), aRandom.uniform( -5.f, 5.f ) );
+			ret.norm.emplace_back( 0.f, 1.f, 0.f );
+			ret.text.emplace_back( 0.f, 0.f );
+		}
+
+		return ret;
+	}
+
+	BakedArray<baked::BakedClusterRecordV2> view_( std::vector<baked::BakedClusterRecordV2> const& aClusters )
+	{
+		BakedArray<baked::BakedClusterRecordV2> ret;
+		ret.bytes = reinterpret_cast<std::byte const*>(aClusters.data());
+		ret.count = aClusters.size();
+		return ret;
+	}
+
+	glm::vec3 center_( baked::BakedClusterRecordV2 const& aCluster )
+	{
+		return glm::vec3( aCluster.center[0], aCluster.center[1], aCluster.center[2] );
+	}
+
+	// Partition of the index buffer, vertex and triangle limits, and bounding
+	// spheres that contain every triangle
+	void check_clusters_( IndexedMesh const& aMesh, std::vector<baked::BakedClusterRecordV2> const& aClusters, std::uint32_t aMeshId )
+	{
+		std::uint32_t next = 0;
+		for( auto const& cluster : aClusters )
+		{
+			CHECK( aMeshId == cluster.meshId );
+			CHECK( next == cluster.firstIndex );
+			CHECK( 0 != cluster.indexCount && 0 == cluster.indexCount % 3 );
+			CHECK( cluster.indexCount / 3 <= kClusterMaxTriangles );
+			next = cluster.firstIndex + cluster.indexCount;
+
+			std::vector<std::uint32_t> unique;
+			for( auto i = cluster.firstIndex; i < next && i < aMesh.indices.size(); ++i )
+			{
+				auto const v = aMesh.indices[i];
+				bool seen = false;
+				for( auto const u : unique )
+					seen = seen || u == v;
+				if( !seen )
+					unique.emplace_back( v );
+
+				auto const dist = glm::length( aMesh.vert[v] - center_( cluster ) );
+				CHECK( dist <= cluster.radius * (1.f + 1e-5f) + 1e-6f );
+			}
+
+			CHECK( unique.size() == cluster.vertexCount );
+			CHECK( cluster.vertexCount <= kClusterMaxVertices );
+		}
+
+		CHECK( next == aMesh.indices.size() );
+	}
+
+	// Whether a triangle of the cluster faces aCameraPos (by the winding that
+	// build_clusters() uses for its normal cones)
+	bool any_front_facing_( IndexedMesh const& aMesh, baked::BakedClusterRecordV2 const& aCluster, glm::vec3 const& aCameraPos )
+	{
+		for( auto i = aCluster.firstIndex; i < aCluster.firstIndex + aCluster.indexCount; i += 3 )
+		{
+			auto const& a = aMesh.vert[aMesh.indices[i+0]];
+			auto const& b = aMesh.vert[aMesh.indices[i+1]];
+			auto const& c = aMesh.vert[aMesh.indices[i+2]];
+
+			auto const n = glm::cross( b - a, c - a );
+			auto const len = glm::length( n );
+			if( len > 0.f && glm::dot( n / len, aCameraPos - a ) > 1e-4f )
+				return true;
+		}
+
+		return false;
+	}
+
+	// Samples camera positions around (and inside) the mesh. A cluster with a
+	// front-facing triangle must never be culled by its cone. The frustum
+	// test alone is taken from the same cluster without a cone.
+	std::size_t check_cone_culling_( tests::Random& aRandom, IndexedMesh const& aMesh, std::vector<baked::BakedClusterRecordV2> const& aClusters, int aCameras )
+	{
+		std::size_t coneCulled = 0;
+		for( int iter = 0; iter < aCameras; ++iter )
+		{
+			glm::vec3 const eye( aRandom.uniform( -12.f, 12.f ), aRandom.uniform( -12.f, 12.f ), aRandom.uniform( -12.f, 12.f ) );
+			glm::vec3 const target( aRandom.uniform( -2.f, 2.f ), aRandom.uniform( -2.f, 2.f ), aRandom.uniform( -2.f, 2.f ) );
+
+			auto proj = glm::perspectiveRH_ZO( glm::radians( 90.f ), 1.f, 0.05f, 100.f );
+			proj[1][1] *= -1.f;
+			auto const frustum = make_frustum( proj * glm::lookAt( eye, target, glm::vec3( 0.f, 1.f, 0.f ) ) );
+
+			std::size_t expected = 0, expectedIndices = 0;
+			for( auto const& cluster : aClusters )
+			{
+				auto noCone = cluster;
+				noCone.coneAxis[0] = noCone.coneAxis[1] = noCone.coneAxis[2] = 0.f;
+				noCone.coneCutoff = 1.f;
+
+				bool const inFrustum = cluster_visible( noCone, frustum, eye );
+				bool const visible = cluster_visible( cluster, frustum, eye );
+
+				CHECK( !visible || inFrustum );
+				if( inFrustum && any_front_facing_( aMesh, cluster, eye ) )
+					CHECK( visible );
+
+				if( inFrustum && !visible )
+					++coneCulled;
+				if( visible )
+				{
+					++expected;
+					expectedIndices += cluster.indexCount;
+				}
+			}
+
+			// cull_clusters() draws exactly the visible clusters
+			std::vector<IndexRange> ranges;
+			CHECK( expected == cull_clusters( view_( aClusters ), frustum, eye, ranges ) );
+
+			std::size_t indices = 0;
+			for( auto const& range : ranges )
+				indices += range.indexCount;
+			CHECK( expectedIndices == indices );
+		}
+
+		return coneCulled;
+	}
+}
+
+TEST_CASE( build_clusters_partition_and_bounds )
+{
+	tests::Random random( 7 );
+
+	auto sphere = make_indexed_mesh( bumpy_sphere_( 96 ) );
+	optimize_vertex_cache( sphere );
+	auto const sphereClusters = build_clusters( sphere, 3 );
+	CHECK( sphereClusters.size() > 1 );
+	check_clusters_( sphere, sphereClusters, 3 );
+
+	// Unindexed triangles hit the vertex limit before the triangle limit
+	auto const soup = make_indexed_mesh( random_soup_( random, 1000 ) );
+	auto const soupClusters = build_clusters( soup, 0 );
+	check_clusters_( soup, soupClusters, 0 );
+	for( auto const& cluster : soupClusters )
+		CHECK( cluster.vertexCount > kClusterMaxVertices - 3 || &cluster == &soupClusters.back() );
+
+	// Smaller limits
+	auto const small = build_clusters( sphere, 1, 16, 8 );
+	std::uint32_t next = 0;
+	for( auto const& cluster : small )
+	{
+		CHECK( next == cluster.firstIndex );
+		CHECK( cluster.vertexCount <= 16 && cluster.indexCount <= 3*8 );
+		next += cluster.indexCount;
+	}
+	CHECK( next == sphere.indices.size() );
+}
+
+TEST_CASE( cluster_cones_never_cull_front_faces )
+{
+	tests::Random random( 77 );
+
+	auto sphere = make_indexed_mesh( bumpy_sphere_( 96 ) );
+	optimize_vertex_cache( sphere );
+	auto const sphereClusters = build_clusters( sphere, 0 );
+
+	// The cones must cull something, otherwise this tests nothing
+	CHECK( check_cone_culling_( random, sphere, sphereClusters, 200 ) > 0 );
+
+	auto const soup = make_indexed_mesh( random_soup_( random, 1000 ) );
+	check_cone_culling_( random, soup, build_clusters( soup, 0 ), 50 );
+}
@@ -0,0 +1,192 @@
+#include "tests.hpp"
+
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+
+#include "../cw2-bake/compress_texture.hpp"
+
+namespace
+{
+	using baked::BakedTextureFormat;
+
+	constexpr BakedTextureFormat kFormats_[] = {
+		baked::kBakedTextureBc1Srgb,
+		baked::kBakedTextureBc4Unorm,
+		baked::kBakedTextureBc5Unorm,
+		baked::kBakedTextureBc7Srgb,
+		baked::kBakedTextureBc7Unorm
+	};
+
+	double round_trip_psnr_( std::vector<std::uint8_t> const& aTexels, std::uint32_t aWidth, std::uint32_t aHeight, BakedTextureFormat aFormat )
+	{
+		auto const blocks = compress_image( aTexels.data(), aWidth, aHeight, aFormat );
+		CHECK( blocks.size() == baked::texture_level_size( aFormat, aWidth, aHeight ) );
+
+		auto const decoded = decompress_image( blocks.data(), aWidth, aHeight, aFormat );
+		CHECK( decoded.size() == aTexels.size() );
+
+		return compression_psnr( aTexels.data(), decoded.data(), aWidth, aHeight, aFormat );
+	}
+
+	// BC7 mode 6 block, packed LSB first as in the specification
+	struct Bc7Writer_
+	{
+		std::uint8_t bytes[16]{};
+		std::uint32_t pos = 0;
+
+		void put( std::uint32_t aValue, std::uint32_t aBits )
+		{
+			for( std::uint32_t i = 0; i < aBits; ++i, ++pos )
+				bytes[pos / 8] |= std::uint8_t(((aValue >> i) & 1u) << (pos % 8));
+		}
+	};
+}
+
+TEST_CASE( compress_solid_blocks_exactly )
+{
+	tests::Random random( 13 );
+
+	for( auto const format : kFormats_ )
+	{
+		auto const channels = baked::texture_channels( format );
+		bool const bc1 = baked::kBakedTextureBc1Srgb == format;
+		bool const bc7 = baked::kBakedTextureBc7Srgb == format || baked::kBakedTextureBc7Unorm == format;
+
+		for( int iter = 0; iter < 100; ++iter )
+		{
+			// BC7 mode 6 reaches every color with channels in [1, 254], and
+			// colors that mix 0 and 255 only if they all share a parity
+			std::uint8_t color[4];
+			for( auto& c : color )
+				c = std::uint8_t(bc7 ? 1 + random.below( 254 ) : random.below( 256 ));
+
+			if( 0 == iter )
+				color[0] = color[1] = color[2] = color[3] = 0;
+			else if( 1 == iter )
+				color[0] = color[1] = color[2] = color[3] = 255;
+			else if( 2 == iter )
+				color[0] = 255, color[1] = 128, color[2] = 3, color[3] = 255;
+
+			// BC1 stores two 5:6:5 endpoints, so only their colors are
+			// exact; pick those and expand them like the decoder
+			if( bc1 )
+			{
+				auto const r = random.below( 32 ), g = random.below( 64 ), b = random.below( 32 );
+				color[0] = std::uint8_t((r << 3) | (r >> 2));
+				color[1] = std::uint8_t((g << 2) | (g >> 4));
+				color[2] = std::uint8_t((b << 3) | (b >> 2));
+				color[3] = 255;
+			}
+
+			// 8x8, two blocks in each direction
+			std::vector<std::uint8_t> texels( 8*8*channels );
+			for( std::size_t i = 0; i < texels.size(); ++i )
+				texels[i] = color[i % channels];
+
+			CHECK( std::isinf( round_trip_psnr_( texels, 8, 8, format ) ) );
+		}
+	}
+}
+
+TEST_CASE( compress_gradients_and_noise_above_psnr_floor )
+{
+	tests::Random random( 131 );
+
+	// Floors in dB, a few below what the encoders reach. Random texels
+	// only need to beat a constant guess (about 11 dB). Partial blocks
+	// (13x7) are included.
+	struct Floor { BakedTextureFormat format; double gradient, noise; };
+	Floor const floors[] = {
+		{ baked::kBakedTextureBc1Srgb, 31.0, 12.0 },
+		{ baked::kBakedTextureBc4Unorm, 35.0, 27.0 },
+		{ baked::kBakedTextureBc5Unorm, 35.0, 27.0 },
+		{ baked::kBakedTextureBc7Srgb, 45.0, 12.0 },
+		{ baked::kBakedTextureBc7Unorm, 45.0, 12.0 }
+	};
+
+	for( auto const& floor : floors )
+	{
+		auto const channels = baked::texture_channels( floor.format );
+
+		for( auto const size : { std::uint32_t(16), std::uint32_t(13) } )
+		{
+			std::uint32_t const width = size, height = size / 2 + 1;
+
+			std::vector<std::uint8_t> gradient( width * height * channels ), noise( gradient.size() );
+			for( std::uint32_t y = 0; y < height; ++y )
+			{
+				for( std::uint32_t x = 0; x < width; ++x )
+				{
+					// Diagonal ramp; colors on a line through RGB(A) space
+					auto const v = (x + y) * 255 / (width + height - 2);
+					auto* t = &gradient[(y * width + x) * channels];
+					t[0] = std::uint8_t(v);
+					if( 4 == channels )
+					{
+						t[1] = std::uint8_t(255 - v);
+						t[2] = std::uint8_t(64 + v / 2);
+						t[3] = std::uint8_t(255 - v / 4);
+					}
+				}
+			}
+			for( auto& t : noise )
+				t = std::uint8_t(random.below( 256 ));
+			if( 4 == channels && baked::kBakedTextureBc1Srgb == floor.format )
+			{
+				for( std::size_t i = 3; i < noise.size(); i += 4 )
+					noise[i] = 255;
+			}
+
+			auto const g = round_trip_psnr_( gradient, width, height, floor.format );
+			auto const n = round_trip_psnr_( noise, width, height, floor.format );
+			if( !CHECK( g >= floor.gradient ) || !CHECK( n >= floor.noise ) )
+				std::printf( "  format %u, %ux%u: gradient %.1f dB, noise %.1f dB\n", unsigned(floor.format), width, height, g, n );
+		}
+	}
+}
+
+TEST_CASE( compress_bc7_mode6_bit_layout )
+{
+	// Opaque white: both endpoints at 127 with p-bit 1 (= 255), all
+	// indices 0. Mode bit 6, then 8 x 7 set bits, then the two p-bits.
+	std::uint8_t white[4*4*4];
+	for( auto& t : white )
+		t = 255;
+
+	auto const encoded = compress_image( white, 4, 4, baked::kBakedTextureBc7Unorm );
+	std::uint8_t const expected[16] = { 0xc0, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x01, 0, 0, 0, 0, 0, 0, 0 };
+	CHECK( 16 == encoded.size() && std::equal( encoded.begin(), encoded.end(), expected ) );
+
+	// Endpoints (0, 0, 0, 0) and (255, 255, 255, 255); texel i uses index i
+	Bc7Writer_ block;
+	block.put( 1u << 6, 7 );
+	for( int k = 0; k < 4; ++k )
+	{
+		block.put( 0, 7 );
+		block.put( 127, 7 );
+	}
+	block.put( 0, 1 );
+	block.put( 1, 1 );
+	block.put( 0, 3 );
+	for( std::uint32_t i = 1; i < 16; ++i )
+		block.put( i, 4 );
+	CHECK( 128 == block.pos );
+
+	std::uint32_t const weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	auto const decoded = decompress_image( block.bytes, 4, 4, baked::kBakedTextureBc7Unorm );
+	bool match = true;
+	for( std::uint32_t i = 0; i < 16; ++i )
+	{
+		auto const expect = (weights[i] * 255 + 32) >> 6;
+		for( std::uint32_t k = 0; k < 4; ++k )
+			match = match && expect == decoded[i*4+k];
+	}
+	CHECK( match );
+
+	// The encoder reproduces the ramp exactly
+	CHECK( std::isinf( round_trip_psnr_( decoded, 4, 4, baked::kBakedTextureBc7Unorm ) ) );
+}
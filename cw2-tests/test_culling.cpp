@@ -0,0 +1,421 @@
+#include "tests.hpp"
+
+#include <vector>
+#include <algorithm>
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../cw2/culling.hpp"
+
+namespace
+{
+	// Camera as set up by cw2 (Vulkan depth range, Y mirrored), looking
+	// along an oblique direction so that no plane is axis aligned
+	glm::mat4 test_proj_cam_()
+	{
+		auto proj = glm::perspectiveRH_ZO( glm::radians( 60.f ), 16.f / 9.f, 0.1f, 100.f );
+		proj[1][1] *= -1.f;
+
+		auto const view = glm::lookAt( glm::vec3( 3.f, 2.f, -5.f ), glm::vec3( -10.f, 5.f, 30.f ), glm::vec3( 0.f, 1.f, 0.f ) );
+		return proj * view;
+	}
+
+	float plane_distance_( glm::vec4 const& aPlane, glm::vec3 const& aPoint )
+	{
+		return glm::dot( glm::vec3(aPlane), aPoint ) + aPlane.w;
+	}
+
+	// Brute force reference: a box is culled if all eight corners lie outside
+	// of one plane. Returns the smallest over the planes of the largest
+	// corner distance; the box is visible if this is >= 0.
+	float corner_margin_( Frustum const& aFrustum, glm::vec3 const& aMin, glm::vec3 const& aMax )
+	{
+		float margin = INFINITY;
+		for( auto const& plane : aFrustum.planes )
+		{
+			float farthest = -INFINITY;
+			for( int i = 0; i < 8; ++i )
+			{
+				glm::vec3 const corner(
+					(i & 1) ? aMax.x : aMin.x,
+					(i & 2) ? aMax.y : aMin.y,
+					(i & 4) ? aMax.z : aMin.z
+				);
+				farthest = std::max( farthest, plane_distance_( plane, corner ) );
+			}
+
+			margin = std::min( margin, farthest );
+		}
+
+		return margin;
+	}
+
+	// The implementations sum in different orders; results may differ for
+	// boxes this close to a plane
+	constexpr float kAmbiguousMargin_ = 1e-4f;
+
+	struct Box_
+	{
+		glm::vec3 min, max;
+	};
+
+	// Compares cull_aabbs() against aabb_visible() and the brute force test.
+	// Returns the number of visible boxes.
+	std::size_t check_boxes_( Frustum const& aFrustum, std::vector<Box_> const& aBoxes )
+	{
+		AabbList list;
+		for( auto const& box : aBoxes )
+			add_aabb( list, box.min, box.max );
+
+		CHECK( aBoxes.size() == list.count );
+		CHECK( 0 == list.centerX.size() % kAabbBatchSize );
+
+		// One extra entry, to catch writes past the end
+		std::vector<std::uint8_t> visible( aBoxes.size() + 1, 0xcd );
+		auto const count = cull_aabbs( aFrustum, list, visible.data() );
+
+		CHECK( 0xcd == visible.back() );
+
+		std::size_t expected = 0;
+		for( std::size_t i = 0; i < aBoxes.size(); ++i )
+		{
+			auto const& box = aBoxes[i];
+			auto const scalar = aabb_visible( aFrustum, box.min, box.max );
+
+			CHECK( visible[i] <= 1 );
+			CHECK( bool(visible[i]) == scalar );
+
+			auto const margin = corner_margin_( aFrustum, box.min, box.max );
+			if( std::abs( margin ) > kAmbiguousMargin_ )
+				CHECK( scalar == (margin >= 0.f) );
+
+			expected += visible[i];
+		}
+
+		CHECK( expected == count );
+		return count;
+	}
+
+	Box_ random_box_( tests::Random& aRandom )
+	{
+		glm::vec3 const center( aRandom.uniform( -60.f, 60.f ), aRandom.uniform( -60.f, 60.f ), aRandom.uniform( -60.f, 100.f ) );
+		glm::vec3 const extent( aRandom.uniform( 0.f, 8.f ), aRandom.uniform( 0.f, 8.f ), aRandom.uniform( 0.f, 8.f ) );
+		return { center - extent, center + extent };
+	}
+}
+
+TEST_CASE( cull_aabbs_matches_reference )
+{
+	auto const frustum = make_frustum( test_proj_cam_() );
+
+	tests::Random random( 1 );
+
+	std::vector<Box_> boxes;
+	for( int i = 0; i < 10007; ++i )
+		boxes.emplace_back( random_box_( random ) );
+
+	// Both outcomes must be well represented
+	auto const visible = check_boxes_( frustum, boxes );
+	CHECK( visible > boxes.size() / 10 );
+	CHECK( visible < boxes.size() - boxes.size() / 10 );
+}
+
+TEST_CASE( cull_aabbs_partial_batches )
+{
+	auto const frustum = make_frustum( test_proj_cam_() );
+
+	tests::Random random( 2 );
+
+	// Counts that are not multiples of kAabbBatchSize leave padding in the
+	// last batch; padding must neither be written nor counted
+	for( std::size_t count = 0; count <= 3 * kAabbBatchSize + 1; ++count )
+	{
+		std::vector<Box_> boxes;
+		for( std::size_t i = 0; i < count; ++i )
+			boxes.emplace_back( random_box_( random ) );
+
+		check_boxes_( frustum, boxes );
+	}
+
+	// A degenerate box at the origin is what the zeroed padding describes;
+	// put the frustum around it so that counting padding would show
+	auto const around = make_frustum( glm::perspectiveRH_ZO( glm::radians( 60.f ), 1.f, 0.1f, 10.f )
+		* glm::lookAt( glm::vec3( 0.f, 0.f, 5.f ), glm::vec3( 0.f ), glm::vec3( 0.f, 1.f, 0.f ) ) );
+	CHECK( aabb_visible( around, glm::vec3( 0.f ), glm::vec3( 0.f ) ) );
+
+	std::vector<Box_> far{ { glm::vec3( 1000.f ), glm::vec3( 1001.f ) } };
+	CHECK( 0 == check_boxes_( around, far ) );
+}
+
+TEST_CASE( cull_aabbs_straddling_planes )
+{
+	auto const projCam = test_proj_cam_();
+	auto const frustum = make_frustum( projCam );
+
+	// A point well inside the frustum
+	auto const inv = glm::inverse( projCam );
+	auto const inner = inv * glm::vec4( 0.02f, -0.01f, 0.9f, 1.f );
+	glm::vec3 const inside = glm::vec3(inner) / inner.w;
+
+	for( auto const& plane : frustum.planes )
+		CHECK( plane_distance_( plane, inside ) > 0.f );
+
+	tests::Random random( 3 );
+
+	std::vector<Box_> straddling, outside;
+	for( int p = 0; p < Frustum::kPlaneCount; ++p )
+	{
+		auto const& plane = frustum.planes[p];
+		glm::vec3 const n( plane );
+
+		// Project the inner point onto the plane, and check that the result
+		// is on the frustum's face, i.e., inside all other planes
+		auto const onPlane = inside - plane_distance_( plane, inside ) * n;
+		for( int q = 0; q < Frustum::kPlaneCount; ++q )
+		{
+			if( q != p )
+				CHECK( plane_distance_( frustum.planes[q], onPlane ) > 0.f );
+		}
+
+		for( int i = 0; i < 16; ++i )
+		{
+			glm::vec3 const extent( random.uniform( 0.01f, 0.05f ), random.uniform( 0.01f, 0.05f ), random.uniform( 0.01f, 0.05f ) );
+			auto const reach = glm::dot( glm::abs( n ), extent );
+
+			// Centered on the plane, or shifted so that only a sliver of the
+			// box remains inside: visible
+			auto const inward = random.uniform( -0.9f, 0.9f ) * reach;
+			auto const c0 = onPlane + inward * n;
+			straddling.push_back( { c0 - extent, c0 + extent } );
+
+			// Entirely outside of the plane, but close: culled
+			auto const c1 = onPlane - (reach + 0.01f) * n;
+			outside.push_back( { c1 - extent, c1 + extent } );
+		}
+	}
+
+	CHECK( straddling.size() == check_boxes_( frustum, straddling ) );
+	CHECK( 0 == check_boxes_( frustum, outside ) );
+}
+
+namespace
+{
+	// Depth buffer cleared to 1 (far), with random rectangles of nearer depth
+	std::vector<float> random_depth_( tests::Random& aRandom, std::uint32_t aWidth, std::uint32_t aHeight, int aOccluders )
+	{
+		std::vector<float> ret( std::size_t(aWidth) * aHeight, 1.f );
+		for( int i = 0; i < aOccluders; ++i )
+		{
+			auto const x0 = aRandom.below( aWidth ), y0 = aRandom.below( aHeight );
+			auto const x1 = x0 + 1 + aRandom.below( aWidth - x0 ), y1 = y0 + 1 + aRandom.below( aHeight - y0 );
+			auto const depth = aRandom.uniform( 0.2f, 1.f );
+
+			for( auto y = y0; y < y1; ++y )
+			{
+				for( auto x = x0; x < x1; ++x )
+					ret[std::size_t(y) * aWidth + x] = std::min( ret[std::size_t(y) * aWidth + x], depth );
+			}
+		}
+
+		return ret;
+	}
+
+	// Base texels [aBegin, aEnd) that a texel of level aLevel covers (one
+	// axis), by following the footprints down the levels
+	void base_footprint_( DepthPyramid const& aPyramid, std::size_t aLevel, std::uint32_t aTexel, bool aVertical, std::uint32_t& aBegin, std::uint32_t& aEnd )
+	{
+		aBegin = aTexel;
+		aEnd = aTexel + 1;
+
+		for( auto level = aLevel; level > 0; --level )
+		{
+			auto const& dst = aPyramid.levels[level];
+			auto const& src = aPyramid.levels[level-1];
+			auto const dstSize = aVertical ? dst.height : dst.width;
+			auto const srcSize = aVertical ? src.height : src.width;
+
+			std::uint32_t b0, e0, b1, e1;
+			depth_pyramid_footprint( aBegin, srcSize, dstSize, b0, e0 );
+			depth_pyramid_footprint( aEnd - 1, srcSize, dstSize, b1, e1 );
+			aBegin = b0;
+			aEnd = e1;
+		}
+	}
+}
+
+TEST_CASE( depth_pyramid_is_conservative )
+{
+	tests::Random random( 17 );
+
+	std::uint32_t const sizes[][2] = { { 64, 64 }, { 37, 23 }, { 1, 9 }, { 10, 1 }, { 5, 3 }, { 1, 1 }, { 129, 67 } };
+	for( auto const& size : sizes )
+	{
+		auto const width = size[0], height = size[1];
+		auto const depth = random_depth_( random, width, height, 12 );
+
+		auto const pyramid = build_depth_pyramid( depth.data(), width, height );
+		CHECK( !pyramid.levels.empty() );
+		CHECK( pyramid.levels.front().depth == depth );
+		CHECK( 1 == pyramid.levels.back().width && 1 == pyramid.levels.back().height );
+
+		for( std::size_t l = 1; l < pyramid.levels.size(); ++l )
+		{
+			auto const& level = pyramid.levels[l];
+			CHECK( level.width == std::max( 1u, pyramid.levels[l-1].width / 2 ) );
+			CHECK( level.height == std::max( 1u, pyramid.levels[l-1].height / 2 ) );
+			CHECK( level.depth.size() == std::size_t(level.width) * level.height );
+
+			// Each texel is the maximum of the base texels it covers: never
+			// nearer (conservative), and no farther than necessary
+			for( std::uint32_t y = 0; y < level.height; ++y )
+			{
+				std::uint32_t y0, y1;
+				base_footprint_( pyramid, l, y, true, y0, y1 );
+
+				for( std::uint32_t x = 0; x < level.width; ++x )
+				{
+					std::uint32_t x0, x1;
+					base_footprint_( pyramid, l, x, false, x0, x1 );
+
+					float expected = 0.f;
+					for( auto sy = y0; sy < y1; ++sy )
+					{
+						for( auto sx = x0; sx < x1; ++sx )
+							expected = std::max( expected, depth[std::size_t(sy) * width + sx] );
+					}
+
+					CHECK( expected == level.depth[std::size_t(y) * level.width + x] );
+				}
+			}
+		}
+
+		// Together, the texels of a level cover the whole base level
+		for( std::size_t l = 1; l < pyramid.levels.size(); ++l )
+		{
+			std::uint32_t b, e;
+			base_footprint_( pyramid, l, 0, false, b, e );
+			CHECK( 0 == b );
+			base_footprint_( pyramid, l, pyramid.levels[l].width - 1, false, b, e );
+			CHECK( width == e );
+			base_footprint_( pyramid, l, pyramid.levels[l].height - 1, true, b, e );
+			CHECK( height == e );
+		}
+
+		float maxDepth = 0.f;
+		for( auto const d : depth )
+			maxDepth = std::max( maxDepth, d );
+		CHECK( maxDepth == pyramid.levels.back().depth[0] );
+	}
+}
+
+TEST_CASE( aabb_unoccluded_never_falsely_occludes )
+{
+	auto const projCam = test_proj_cam_();
+	auto const frustum = make_frustum( projCam );
+
+	tests::Random random( 18 );
+
+	std::uint32_t const width = 97, height = 61;
+
+	std::size_t occluded = 0, tested = 0;
+	for( int iter = 0; iter < 20; ++iter )
+	{
+		auto const depth = random_depth_( random, width, height, 6 );
+		auto const pyramid = build_depth_pyramid( depth.data(), width, height );
+
+		for( int i = 0; i < 500; ++i )
+		{
+			auto const box = random_box_( random );
+			if( !aabb_visible( frustum, box.min, box.max ) )
+				continue;
+
+			++tested;
+			if( aabb_unoccluded( pyramid, projCam, box.min, box.max ) )
+				continue;
+
+			++occluded;
+
+			// Brute force: the box's screen rectangle in the full resolution
+			// depth buffer, and its nearest depth. Every covered texel must
+			// lie in front of the box.
+			glm::vec2 rectMin( 1.f ), rectMax( 0.f );
+			float nearest = 1.f;
+			bool crossesNear = false;
+			for( int c = 0; c < 8; ++c )
+			{
+				auto const clip = projCam * glm::vec4(
+					(c & 1) ? box.max.x : box.min.x,
+					(c & 2) ? box.max.y : box.min.y,
+					(c & 4) ? box.max.z : box.min.z,
+					1.f
+				);
+
+				crossesNear = crossesNear || clip.w <= 0.f || clip.z <= 0.f;
+
+				auto const ndc = glm::vec3(clip) / clip.w;
+				rectMin = glm::min( rectMin, glm::vec2(ndc) * 0.5f + 0.5f );
+				rectMax = glm::max( rectMax, glm::vec2(ndc) * 0.5f + 0.5f );
+				nearest = std::min( nearest, ndc.z );
+			}
+
+			CHECK( !crossesNear );
+
+			rectMin = glm::clamp( rectMin, 0.f, 1.f );
+			rectMax = glm::clamp( rectMax, 0.f, 1.f );
+
+			auto const x0 = std::min( std::uint32_t(rectMin.x * width), width - 1 ), x1 = std::min( std::uint32_t(rectMax.x * width), width - 1 );
+			auto const y0 = std::min( std::uint32_t(rectMin.y * height), height - 1 ), y1 = std::min( std::uint32_t(rectMax.y * height), height - 1 );
+
+			for( auto y = y0; y <= y1; ++y )
+			{
+				for( auto x = x0; x <= x1; ++x )
+					CHECK( depth[std::size_t(y) * width + x] < nearest );
+			}
+		}
+	}
+
+	// Some boxes must actually be occluded for this to mean anything
+	CHECK( occluded > 0 );
+	CHECK( occluded < tested );
+}
+
+TEST_CASE( aabb_unoccluded_in_front_of_depth )
+{
+	auto const projCam = test_proj_cam_();
+	auto const inv = glm::inverse( projCam );
+
+	auto const unproject_ = [&] (glm::vec3 const& aNdc) {
+		auto const p = inv * glm::vec4( aNdc, 1.f );
+		return glm::vec3(p) / p.w;
+	};
+
+	// A wall at depth 0.99 over the whole screen
+	std::uint32_t const width = 64, height = 48;
+	std::vector<float> const depth( std::size_t(width) * height, 0.99f );
+	auto const pyramid = build_depth_pyramid( depth.data(), width, height );
+
+	tests::Random random( 19 );
+	for( int i = 0; i < 1000; ++i )
+	{
+		// Small box around a point in front of the wall: visible
+		glm::vec3 const ndc( random.uniform( -0.9f, 0.9f ), random.uniform( -0.9f, 0.9f ), random.uniform( 0.5f, 0.98f ) );
+		auto const center = unproject_( ndc );
+		glm::vec3 const extent( random.uniform( 0.001f, 0.05f ) );
+		CHECK( aabb_unoccluded( pyramid, projCam, center - extent, center + extent ) );
+
+		// The same box behind the wall: occluded
+		auto const behind = unproject_( glm::vec3( ndc.x, ndc.y, 0.9995f ) );
+		CHECK( !aabb_unoccluded( pyramid, projCam, behind - extent * 0.01f, behind + extent * 0.01f ) );
+	}
+
+	// Boxes that cross the near plane, or lie behind the camera, are never
+	// occluded
+	auto const atNear = unproject_( glm::vec3( 0.f, 0.f, 0.f ) );
+	CHECK( aabb_unoccluded( pyramid, projCam, atNear - glm::vec3( 0.01f ), atNear + glm::vec3( 0.01f ) ) );
+
+	glm::vec3 const eye( 3.f, 2.f, -5.f ); // see test_proj_cam_()
+	CHECK( aabb_unoccluded( pyramid, projCam, eye - glm::vec3( 1.f ), eye + glm::vec3( 1.f ) ) );
+}
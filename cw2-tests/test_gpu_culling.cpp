@@ -0,0 +1,123 @@
+#include "tests.hpp"
+
+#include <vector>
+
+#include <cstring>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../cw2/culling.hpp"
+#include "../cw2/gpu_culling.hpp"
+
+// cull.comp and hiz.comp can only be compared against these references on a
+// device; see the note in gpu_culling.hpp. These tests pin down the
+// references themselves.
+
+namespace
+{
+	bool same_command_( VkDrawIndexedIndirectCommand const& aA, VkDrawIndexedIndirectCommand const& aB )
+	{
+		return 0 == std::memcmp( &aA, &aB, sizeof(aA) );
+	}
+}
+
+TEST_CASE( cull_indirect_draws_compacts_per_pipeline )
+{
+	auto proj = glm::perspectiveRH_ZO( glm::radians( 60.f ), 16.f / 9.f, 0.1f, 100.f );
+	proj[1][1] *= -1.f;
+	auto const projCam = proj * glm::lookAt( glm::vec3( 0.f, 1.f, 10.f ), glm::vec3( 0.f ), glm::vec3( 0.f, 1.f, 0.f ) );
+	auto const frustum = make_frustum( projCam );
+
+	tests::Random random( 170 );
+
+	// Random meshes, some without bounds; commands in both pipelines
+	std::uint32_t const meshCount = 300;
+
+	std::vector<CullBounds> bounds( meshCount );
+	for( auto& b : bounds )
+	{
+		glm::vec3 const center( random.uniform( -40.f, 40.f ), random.uniform( -20.f, 20.f ), random.uniform( -80.f, 30.f ) );
+		glm::vec3 const extent( random.uniform( 0.1f, 3.f ) );
+		b.aabbMin = glm::vec4( center - extent, 0 == random.below( 10 ) ? 0.f : 1.f );
+		b.aabbMax = glm::vec4( center + extent, 0.f );
+	}
+
+	IndirectDrawPlan plan;
+	plan.first[kDrawPipelineOpaque] = 0;
+	plan.count[kDrawPipelineOpaque] = 200;
+	plan.first[kDrawPipelineAlphaMasked] = 200;
+	plan.count[kDrawPipelineAlphaMasked] = 100;
+
+	for( std::uint32_t i = 0; i < meshCount; ++i )
+	{
+		VkDrawIndexedIndirectCommand cmd{};
+		cmd.indexCount = 3 * (1 + random.below( 100 ));
+		cmd.instanceCount = 1;
+		cmd.firstIndex = random.below( 100000 );
+		cmd.vertexOffset = std::int32_t(random.below( 100000 ));
+		cmd.firstInstance = (i * 7) % meshCount; // not in mesh order
+		plan.commands.emplace_back( cmd );
+	}
+
+	// A pyramid with a wall in the left half of the screen
+	std::uint32_t const width = 80, height = 45;
+	std::vector<float> depth( std::size_t(width) * height, 1.f );
+	for( std::uint32_t y = 0; y < height; ++y )
+	{
+		for( std::uint32_t x = 0; x < width / 2; ++x )
+			depth[std::size_t(y) * width + x] = 0.95f;
+	}
+
+	auto const pyramid = build_depth_pyramid( depth.data(), width, height );
+
+	for( auto const* pyr : { static_cast<DepthPyramid const*>(nullptr), &pyramid } )
+	{
+		auto const culled = cull_indirect_draws( plan, bounds, frustum, projCam, pyr );
+
+		// Same layout as the input
+		CHECK( culled.commands.size() == plan.commands.size() );
+
+		std::size_t survivors = 0;
+		for( std::uint32_t p = 0; p < kDrawPipelineCount; ++p )
+		{
+			CHECK( culled.first[p] == plan.first[p] );
+			CHECK( culled.count[p] <= plan.count[p] );
+
+			// Survivors first, in input order; the rest of the range zeroed
+			std::uint32_t next = plan.first[p];
+			for( std::uint32_t i = plan.first[p]; i < plan.first[p] + plan.count[p]; ++i )
+			{
+				auto const& cmd = plan.commands[i];
+				auto const& b = bounds[cmd.firstInstance];
+
+				bool visible = true;
+				if( 0.f != b.aabbMin.w )
+				{
+					visible = aabb_visible( frustum, glm::vec3(b.aabbMin), glm::vec3(b.aabbMax) )
+						&& (!pyr || aabb_unoccluded( *pyr, projCam, glm::vec3(b.aabbMin), glm::vec3(b.aabbMax) ));
+				}
+
+				if( visible )
+					CHECK( next < culled.commands.size() && same_command_( cmd, culled.commands[next++] ) );
+			}
+
+			CHECK( next == plan.first[p] + culled.count[p] );
+			for( ; next < plan.first[p] + plan.count[p]; ++next )
+				CHECK( same_command_( VkDrawIndexedIndirectCommand{}, culled.commands[next] ) );
+
+			survivors += culled.count[p];
+		}
+
+		// Both outcomes must occur
+		CHECK( survivors > 0 );
+		CHECK( survivors < plan.commands.size() );
+	}
+
+	// Occlusion only ever removes commands
+	auto const frustumOnly = cull_indirect_draws( plan, bounds, frustum, projCam, nullptr );
+	auto const occluded = cull_indirect_draws( plan, bounds, frustum, projCam, &pyramid );
+	for( std::uint32_t p = 0; p < kDrawPipelineCount; ++p )
+		CHECK( occluded.count[p] <= frustumOnly.count[p] );
+	CHECK( occluded.count[0] + occluded.count[1] < frustumOnly.count[0] + frustumOnly.count[1] );
+}
@@ -0,0 +1,271 @@
+#include "tests.hpp"
+
+#include <limits>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include <cmath>
+#include <cstdio>
+
+#include <glm/glm.hpp>
+
+#include "../cw2-bake/index_mesh.hpp"
+
+// make_indexed_mesh() used to find merge candidates with a std::unordered_
+// multimap from hashed grid cells to vertices. The radix-sorted spatial hash
+// that replaced it must produce the same mesh: for each unmerged vertex, all
+// of its mergeable and still unmerged neighbours are claimed, so the order
+// in which candidates are visited does not matter. The previous version is
+// kept here, condensed, as the reference.
+
+namespace
+{
+	struct MultimapReference_
+	{
+		struct Cell
+		{
+			std::int32_t x, y, z;
+		};
+
+		glm::vec3 min;
+		float scale;
+
+		Cell discretize( glm::vec3 const& aPos ) const
+		{
+			Cell ret;
+			ret.x = std::uint32_t((aPos[0]-min[0])*scale);
+			ret.y = std::uint32_t((aPos[1]-min[1])*scale);
+			ret.z = std::uint32_t((aPos[2]-min[2])*scale);
+			return ret;
+		}
+
+		static std::size_t hash( Cell const& aCell )
+		{
+			std::hash<std::size_t> h;
+			std::size_t ret = h( aCell.x );
+			ret ^= h( aCell.y ) + 0x9e3779b9 + (ret<<6) + (ret>>2);
+			ret ^= h( aCell.z ) + 0x9e3779b9 + (ret<<6) + (ret>>2);
+			return ret;
+		}
+	};
+
+	bool mergable_( TriangleSoup const& aSoup, std::size_t aI, std::size_t aJ, float aTolerance )
+	{
+		for( int k = 0; k < 3; ++k )
+		{
+			if( std::abs( aSoup.vert[aI][k] - aSoup.vert[aJ][k] ) > aTolerance )
+				return false;
+		}
+
+		if( !aSoup.norm.empty() )
+		{
+			for( int k = 0; k < 3; ++k )
+			{
+				if( std::abs( aSoup.norm[aI][k] - aSoup.norm[aJ][k] ) > aTolerance )
+					return false;
+			}
+		}
+
+		for( int k = 0; k < 2; ++k )
+		{
+			if( std::abs( aSoup.text[aI][k] - aSoup.text[aJ][k] ) > aTolerance )
+				return false;
+		}
+
+		return true;
+	}
+
+	IndexedMesh multimap_indexed_mesh_( TriangleSoup const& aSoup, float aTolerance = 1e-6f )
+	{
+		constexpr float kAABBMarginFactor = 10.f;
+		constexpr std::size_t kSparseGridMaxSize = 1024*1024;
+
+		glm::vec3 bmin( std::numeric_limits<float>::max() );
+		glm::vec3 bmax( std::numeric_limits<float>::lowest() );
+		for( auto const& p : aSoup.vert )
+		{
+			bmin = glm::min( bmin, p );
+			bmax = glm::max( bmax, p );
+		}
+
+		auto const fmin = bmin - glm::vec3( kAABBMarginFactor * aTolerance );
+		auto const fmax = bmax + glm::vec3( kAABBMarginFactor * aTolerance );
+
+		auto const side = fmax - fmin;
+		float const maxSide = std::max( side.x, std::max( side.y, side.z ) );
+		std::size_t const subdiv = std::min( kSparseGridMaxSize, std::size_t(maxSide / (2.f*aTolerance) + .5f) );
+
+		MultimapReference_ grid{ fmin, std::uint32_t(subdiv) / maxSide };
+
+		std::unordered_multimap<std::size_t,std::size_t> cells;
+		for( std::size_t i = 0; i < aSoup.vert.size(); ++i )
+			cells.insert( std::make_pair( MultimapReference_::hash( grid.discretize( aSoup.vert[i] ) ), i ) );
+
+		constexpr std::size_t kNone = ~std::size_t(0);
+		std::vector<std::size_t> collapseMap( aSoup.vert.size(), kNone );
+		std::vector<std::size_t> mapping;
+
+		IndexedMesh ret;
+		for( std::size_t i = 0; i < aSoup.vert.size(); ++i )
+		{
+			if( kNone != collapseMap[i] )
+			{
+				ret.indices.emplace_back( std::uint32_t(collapseMap[i]) );
+				continue;
+			}
+
+			auto const cell = grid.discretize( aSoup.vert[i] );
+
+			collapseMap[i] = mapping.size();
+			ret.indices.emplace_back( std::uint32_t(mapping.size()) );
+			mapping.emplace_back( i );
+
+			for( int dx = -1; dx <= 1; ++dx )
+			{
+				for( int dy = -1; dy <= 1; ++dy )
+				{
+					for( int dz = -1; dz <= 1; ++dz )
+					{
+						MultimapReference_::Cell const other{ cell.x + dx, cell.y + dy, cell.z + dz };
+						for( auto [it, jt] = cells.equal_range( MultimapReference_::hash( other ) ); it != jt; ++it )
+						{
+							auto const j = it->second;
+							if( kNone == collapseMap[j] && mergable_( aSoup, i, j, aTolerance ) )
+								collapseMap[j] = collapseMap[i];
+						}
+					}
+				}
+			}
+		}
+
+		for( auto const from : mapping )
+		{
+			ret.vert.emplace_back( aSoup.vert[from] );
+			ret.text.emplace_back( aSoup.text[from] );
+			if( !aSoup.norm.empty() )
+				ret.norm.emplace_back( aSoup.norm[from] );
+		}
+
+		ret.aabbMin = bmin;
+		ret.aabbMax = bmax;
+		return ret;
+	}
+
+	// Tessellated sphere: aRes x aRes quads, i.e., 6 aRes^2 soup vertices,
+	// most of which are shared by six triangles
+	TriangleSoup sphere_soup_( std::uint32_t aRes )
+	{
+		auto const point_ = [&] (std::uint32_t aI, std::uint32_t aJ) {
+			float const u = float(aI) / aRes * 6.2831853f, v = float(aJ) / aRes * 3.1415927f;
+			return 10.f * glm::vec3( std::cos( u ) * std::sin( v ), std::cos( v ), std::sin( u ) * std::sin( v ) );
+		};
+
+		TriangleSoup ret;
+		ret.vert.reserve( 6 * std::size_t(aRes) * aRes );
+		ret.norm.reserve( 6 * std::size_t(aRes) * aRes );
+		ret.text.reserve( 6 * std::size_t(aRes) * aRes );
+
+		for( std::uint32_t i = 0; i < aRes; ++i )
+		{
+			for( std::uint32_t j = 0; j < aRes; ++j )
+			{
+				std::uint32_t const corners[6][2] = { {i,j}, {i+1,j}, {i+1,j+1}, {i,j}, {i+1,j+1}, {i,j+1} };
+				for( auto const& c : corners )
+				{
+					auto const p = point_( c[0], c[1] );
+					ret.vert.emplace_back( p );
+					ret.norm.emplace_back( glm::normalize( p ) );
+					ret.text.emplace_back( float(c[0]) / aRes, float(c[1]) / aRes );
+				}
+			}
+		}
+
+		return ret;
+	}
+
+	// Few distinct positions, each repeated with jitter of up to about the
+	// tolerance and with a few different normals and texture coordinates.
+	// Candidates straddle cell boundaries and chains of merges occur.
+	TriangleSoup jittered_soup_( tests::Random& aRandom, std::size_t aVertices, float aTolerance )
+	{
+		std::vector<glm::vec3> bases( aVertices / 8 + 1 );
+		for( auto& b : bases )
+			b = glm::vec3( aRandom.uniform( -1.f, 1.f ), aRandom.uniform( -1.f, 1.f ), aRandom.uniform( -1.f, 1.f ) );
+
+		TriangleSoup ret;
+		for( std::size_t i = 0; i < aVertices; ++i )
+		{
+			auto const& base = bases[aRandom.below( std::uint32_t(bases.size()) )];
+			auto const jitter_ = [&] { return aRandom.uniform( -0.7f, 0.7f ) * aTolerance; };
+
+			ret.vert.emplace_back( base + glm::vec3( jitter_(), jitter_(), jitter_() ) );
+			ret.norm.emplace_back( 0.f, 0 == aRandom.below( 4 ) ? -1.f : 1.f, 0.f );
+			ret.text.emplace_back( 0.5f * float(aRandom.below( 2 )) + jitter_(), 0.f );
+		}
+
+		return ret;
+	}
+
+	bool same_mesh_( IndexedMesh const& aA, IndexedMesh const& aB )
+	{
+		return aA.indices == aB.indices
+			&& aA.vert == aB.vert
+			&& aA.norm == aB.norm
+			&& aA.text == aB.text
+			&& aA.aabbMin == aB.aabbMin
+			&& aA.aabbMax == aB.aabbMax
+		;
+	}
+}
+
+TEST_CASE( index_mesh_matches_multimap_reference )
+{
+	tests::Random random( 5 );
+
+	for( auto const res : { 1u, 7u, 64u } )
+	{
+		auto const soup = sphere_soup_( res );
+		auto const mesh = make_indexed_mesh( soup );
+		CHECK( mesh.vert.size() < soup.vert.size() );
+		CHECK( same_mesh_( mesh, multimap_indexed_mesh_( soup ) ) );
+	}
+
+	for( auto const tolerance : { 1e-6f, 1e-4f, 1e-2f } )
+	{
+		auto const soup = jittered_soup_( random, 20000, tolerance );
+		auto const mesh = make_indexed_mesh( soup, tolerance );
+		CHECK( same_mesh_( mesh, multimap_indexed_mesh_( soup, tolerance ) ) );
+	}
+
+	// Without normals, and a single vertex
+	auto soup = jittered_soup_( random, 5000, 1e-3f );
+	soup.norm.clear();
+	CHECK( same_mesh_( make_indexed_mesh( soup, 1e-3f ), multimap_indexed_mesh_( soup, 1e-3f ) ) );
+
+	soup.vert.resize( 1 );
+	soup.text.resize( 1 );
+	auto const single = make_indexed_mesh( soup );
+	CHECK( 1 == single.vert.size() && 1 == single.indices.size() && 0 == single.indices[0] );
+}
+
+BENCHMARK_CASE( index_mesh_vs_multimap )
+{
+	for( auto const res : { 250u, 600u, 1000u } )
+	{
+		auto const soup = sphere_soup_( res );
+
+		auto const t0 = std::chrono::steady_clock::now();
+		auto const mesh = make_indexed_mesh( soup, 1e-5f );
+		auto const t1 = std::chrono::steady_clock::now();
+		auto const reference = multimap_indexed_mesh_( soup, 1e-5f );
+		auto const t2 = std::chrono::steady_clock::now();
+
+		CHECK( same_mesh_( mesh, reference ) );
+
+		auto const radix = std::chrono::duration<double>( t1 - t0 ).count();
+		auto const multimap = std::chrono::duration<double>( t2 - t1 ).count();
+		std::printf( "  %zu soup vertices => %zu: %.3f s (multimap %.3f s, %.1fx)\n", soup.vert.size(), mesh.vert.size(), radix, multimap, multimap / radix );
+	}
+}
@@ -0,0 +1,123 @@
+#include "tests.hpp"
+
+#include <vector>
+
+#include "../cw2/indirect.hpp"
+#include "../cw2/geometry_arena.hpp"
+
+namespace
+{
+	constexpr std::uint32_t kNoTexture_ = 0xffffffff;
+
+	// Model with random materials (some alpha masked) and meshes (some
+	// without indices). The planning functions only look at the counts, so
+	// the arrays have no data.
+	BakedModel random_model_( tests::Random& aRandom, std::uint32_t aMaterials, std::uint32_t aMeshes )
+	{
+		BakedModel ret;
+
+		for( std::uint32_t i = 0; i < aMaterials; ++i )
+		{
+			BakedMaterialInfo mat{};
+			mat.alphaMaskTextureId = 0 == aRandom.below( 3 ) ? i : kNoTexture_;
+			mat.normalMapTextureId = kNoTexture_;
+			ret.materials.emplace_back( mat );
+		}
+
+		for( std::uint32_t i = 0; i < aMeshes; ++i )
+		{
+			BakedMeshData mesh{};
+			mesh.materialId = aRandom.below( aMaterials );
+			mesh.positions.count = 1 + aRandom.below( 500 );
+			mesh.indices.count = 0 == aRandom.below( 8 ) ? 0 : 3 * (1 + aRandom.below( 1000 ));
+			ret.meshes.emplace_back( std::move(mesh) );
+		}
+
+		return ret;
+	}
+
+	EDrawPipeline pipeline_of_( BakedModel const& aModel, std::uint32_t aMeshId )
+	{
+		auto const& mat = aModel.materials[aModel.meshes[aMeshId].materialId];
+		return kNoTexture_ != mat.alphaMaskTextureId ? kDrawPipelineAlphaMasked : kDrawPipelineOpaque;
+	}
+}
+
+TEST_CASE( plan_indirect_draws_matches_arena )
+{
+	tests::Random random( 16 );
+
+	for( int iter = 0; iter < 20; ++iter )
+	{
+		auto const model = random_model_( random, 1 + random.below( 12 ), random.below( 200 ) );
+		auto const layout = plan_geometry_arena( model );
+		auto const plan = plan_indirect_draws( model, layout.meshes );
+
+		// One command for each mesh with indices, and only for those
+		std::size_t expected = 0;
+		for( auto const& mesh : model.meshes )
+			expected += mesh.indices.empty() ? 0 : 1;
+		CHECK( expected == plan.commands.size() );
+
+		// Ranges tile the command array, in pipeline order
+		std::uint32_t next = 0;
+		for( std::uint32_t p = 0; p < kDrawPipelineCount; ++p )
+		{
+			CHECK( next == plan.first[p] );
+			next += plan.count[p];
+		}
+		CHECK( next == plan.commands.size() );
+
+		std::vector<bool> seen( model.meshes.size(), false );
+		for( std::uint32_t p = 0; p < kDrawPipelineCount; ++p )
+		{
+			for( std::uint32_t i = plan.first[p]; i < plan.first[p] + plan.count[p]; ++i )
+			{
+				auto const& cmd = plan.commands[i];
+
+				// firstInstance is the mesh ID; each mesh is drawn once
+				auto const meshId = cmd.firstInstance;
+				CHECK( meshId < model.meshes.size() );
+				if( meshId >= model.meshes.size() )
+					continue;
+
+				CHECK( !seen[meshId] );
+				seen[meshId] = true;
+
+				// Location in the arena
+				auto const& sm = layout.meshes[meshId];
+				CHECK( 0 != sm.indexCount );
+				CHECK( sm.indexCount == cmd.indexCount );
+				CHECK( sm.firstIndex == cmd.firstIndex );
+				CHECK( sm.vertexOffset == cmd.vertexOffset );
+				CHECK( 1 == cmd.instanceCount );
+
+				CHECK( p == pipeline_of_( model, meshId ) );
+
+				// Sorted by material, then by mesh ID
+				if( i > plan.first[p] )
+				{
+					auto const prevId = plan.commands[i-1].firstInstance;
+					auto const prevMat = model.meshes[prevId].materialId;
+					auto const mat = model.meshes[meshId].materialId;
+					CHECK( prevMat < mat || (prevMat == mat && prevId < meshId) );
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE( plan_indirect_draws_empty )
+{
+	tests::Random random( 161 );
+
+	// Only meshes without indices
+	auto model = random_model_( random, 3, 10 );
+	for( auto& mesh : model.meshes )
+		mesh.indices.count = 0;
+
+	auto const plan = plan_indirect_draws( model, plan_geometry_arena( model ).meshes );
+	CHECK( plan.commands.empty() );
+	for( std::uint32_t p = 0; p < kDrawPipelineCount; ++p )
+		CHECK( 0 == plan.first[p] && 0 == plan.count[p] );
+}
@@ -0,0 +1,128 @@
+#include "tests.hpp"
+
+#include <array>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "../cw2-bake/index_mesh.hpp"
+#include "../cw2-bake/optimize_mesh.hpp"
+
+namespace
+{
+	using Triangle_ = std::array<glm::vec3,3>;
+
+	// aN x aN quads in the XZ plane, two triangles each, facing +Y. With
+	// aRandom, the triangles are shuffled (keeping each one's winding).
+	IndexedMesh grid_( std::uint32_t aN, tests::Random* aRandom )
+	{
+		IndexedMesh ret;
+		for( std::uint32_t z = 0; z <= aN; ++z )
+		{
+			for( std::uint32_t x = 0; x <= aN; ++x )
+			{
+				ret.vert.emplace_back( float(x), 0.f, float(z) );
+				ret.norm.emplace_back( 0.f, 1.f, 0.f );
+				ret.text.emplace_back( float(x) / aN, float(z) / aN );
+			}
+		}
+
+		std::vector<std::array<std::uint32_t,3>> tris;
+		for( std::uint32_t z = 0; z < aN; ++z )
+		{
+			for( std::uint32_t x = 0; x < aN; ++x )
+			{
+				auto const i = z * (aN+1) + x;
+				tris.push_back( { i, i + aN+1, i+1 } );
+				tris.push_back( { i+1, i + aN+1, i + aN+2 } );
+			}
+		}
+
+		if( aRandom )
+		{
+			for( std::size_t i = tris.size(); i > 1; --i )
+				std::swap( tris[i-1], tris[aRandom->below( std::uint32_t(i) )] );
+		}
+
+		for( auto const& t : tris )
+			ret.indices.insert( ret.indices.end(), t.begin(), t.end() );
+
+		ret.aabbMin = glm::vec3( 0.f );
+		ret.aabbMax = glm::vec3( float(aN), 0.f, float(aN) );
+		return ret;
+	}
+
+	// Triangles by vertex position, each rotated to start at its smallest
+	// corner (which keeps the winding), sorted. Equal for two meshes iff
+	// they draw the same triangles with the same winding.
+	std::vector<Triangle_> triangle_set_( IndexedMesh const& aMesh )
+	{
+		auto const less_ = [] (glm::vec3 const& aA, glm::vec3 const& aB) {
+			return std::make_pair( aA.x, aA.z ) < std::make_pair( aB.x, aB.z );
+		};
+
+		std::vector<Triangle_> ret;
+		for( std::size_t i = 0; i < aMesh.indices.size(); i += 3 )
+		{
+			Triangle_ t{ aMesh.vert[aMesh.indices[i+0]], aMesh.vert[aMesh.indices[i+1]], aMesh.vert[aMesh.indices[i+2]] };
+			std::rotate( t.begin(), std::min_element( t.begin(), t.end(), less_ ), t.end() );
+			ret.emplace_back( t );
+		}
+
+		std::sort( ret.begin(), ret.end(), [&] (Triangle_ const& aA, Triangle_ const& aB) {
+			return std::lexicographical_compare( aA.begin(), aA.end(), aB.begin(), aB.end(), less_ );
+		} );
+		return ret;
+	}
+
+	double acmr_( IndexedMesh const& aMesh )
+	{
+		return analyze_vertex_cache( aMesh.indices, aMesh.vert.size() ).acmr();
+	}
+}
+
+TEST_CASE( optimize_vertex_cache_permutes_triangles )
+{
+	tests::Random random( 6 );
+
+	for( auto* rng : { static_cast<tests::Random*>(nullptr), &random } )
+	{
+		for( bool overdraw : { false, true } )
+		{
+			auto const input = grid_( 40, rng );
+
+			auto mesh = input;
+			optimize_vertex_cache( mesh, overdraw );
+
+			// Same triangles, same winding; vertices untouched
+			CHECK( mesh.indices.size() == input.indices.size() );
+			CHECK( mesh.vert == input.vert );
+			CHECK( triangle_set_( mesh ) == triangle_set_( input ) );
+
+			// Not worse than the input; much better than a shuffled one
+			CHECK( acmr_( mesh ) <= acmr_( input ) );
+			if( rng )
+				CHECK( acmr_( mesh ) < 0.75 * acmr_( input ) );
+
+			// Fetch order: vertices in order of first use, triangles kept
+			auto const acmr = acmr_( mesh );
+			optimize_vertex_fetch( mesh );
+
+			CHECK( mesh.vert.size() == input.vert.size() );
+			CHECK( triangle_set_( mesh ) == triangle_set_( input ) );
+			CHECK( acmr == acmr_( mesh ) );
+
+			std::uint32_t nextNew = 0;
+			bool firstUse = true;
+			for( auto const index : mesh.indices )
+			{
+				firstUse = firstUse && index <= nextNew;
+				if( index == nextNew )
+					++nextNew;
+			}
+			CHECK( firstUse );
+		}
+	}
+}
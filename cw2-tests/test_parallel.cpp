@@ -0,0 +1,61 @@
+#include "tests.hpp"
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "../cw2-bake/parallel.hpp"
+
+TEST_CASE( parallel_for_runs_each_task_once )
+{
+	for( unsigned jobs : { 1u, 3u, 16u } )
+	{
+		for( std::size_t count : { 0u, 1u, 2u, 1000u } )
+		{
+			std::vector<std::atomic<int>> runs( count );
+			for( auto& r : runs )
+				r = 0;
+
+			// Costs out of order, with ties
+			parallel_for( count, jobs, [&] (std::size_t aI) {
+				++runs[aI];
+			}, [] (std::size_t aI) { return aI % 7; } );
+
+			bool once = true;
+			for( auto const& r : runs )
+				once = once && 1 == r;
+			CHECK( once );
+		}
+	}
+}
+
+TEST_CASE( parallel_for_rethrows_after_join )
+{
+	for( unsigned jobs : { 1u, 4u } )
+	{
+		std::atomic<std::size_t> started{ 0 }, finished{ 0 };
+
+		bool caught = false;
+		try
+		{
+			parallel_for( 500, jobs, [&] (std::size_t aI) {
+				++started;
+				if( 37 == aI )
+					throw std::runtime_error( "task 37" );
+				++finished;
+			} );
+		}
+		catch( std::runtime_error const& eErr )
+		{
+			caught = std::string( eErr.what() ) == "task 37";
+		}
+
+		CHECK( caught );
+
+		// All threads were joined before the rethrow, so nothing is still
+		// running; the tasks after the failure were skipped
+		CHECK( started == finished + 1 );
+		CHECK( 1 != jobs || 38 == started );
+	}
+}
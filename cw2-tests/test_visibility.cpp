@@ -0,0 +1,189 @@
+#include "tests.hpp"
+
+#include <cmath>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../cw2/visibility.hpp"
+
+namespace
+{
+	glm::mat4 test_proj_cam_()
+	{
+		auto proj = glm::perspectiveRH_ZO( glm::radians( 60.f ), 4.f / 3.f, 0.1f, 100.f );
+		proj[1][1] *= -1.f;
+
+		auto const view = glm::lookAt( glm::vec3( 1.f, 2.f, 8.f ), glm::vec3( 0.f, 0.5f, 0.f ), glm::vec3( 0.f, 1.f, 0.f ) );
+		return proj * view;
+	}
+
+	bool near_( glm::vec3 const& aA, glm::vec3 const& aB, float aEps )
+	{
+		return glm::all( glm::lessThanEqual( glm::abs( aA - aB ), glm::vec3( aEps ) ) );
+	}
+
+	glm::vec2 ndc_( glm::vec4 const& aClip )
+	{
+		return glm::vec2( aClip ) / aClip.w;
+	}
+
+	// Perspective-correct interpolation as specified for the rasterizer
+	// (Vulkan spec, "Basic Polygon Rasterization"): screen space barycentrics
+	// from signed areas, weighted by 1/w and renormalized
+	glm::vec3 rasterizer_barycentrics_( glm::vec4 const& aC0, glm::vec4 const& aC1, glm::vec4 const& aC2, glm::vec2 const& aNdc )
+	{
+		auto const p0 = ndc_( aC0 ), p1 = ndc_( aC1 ), p2 = ndc_( aC2 );
+		auto const area_ = [] (glm::vec2 const& aA, glm::vec2 const& aB, glm::vec2 const& aC) {
+			return (aB.x - aA.x) * (aC.y - aA.y) - (aB.y - aA.y) * (aC.x - aA.x);
+		};
+
+		auto const total = area_( p0, p1, p2 );
+		glm::vec3 const screen( area_( aNdc, p1, p2 ) / total, area_( p0, aNdc, p2 ) / total, area_( p0, p1, aNdc ) / total );
+
+		auto const perspective = screen / glm::vec3( aC0.w, aC1.w, aC2.w );
+		return perspective / (perspective.x + perspective.y + perspective.z);
+	}
+
+	struct Triangle_
+	{
+		glm::vec3 p[3];
+		glm::vec4 clip[3];
+	};
+
+	// Random triangle in front of the camera that covers a reasonable screen
+	// area, so that float precision does not dominate the comparisons
+	Triangle_ random_triangle_( tests::Random& aRandom, glm::mat4 const& aProjCam )
+	{
+		for( ;; )
+		{
+			Triangle_ ret;
+			for( int i = 0; i < 3; ++i )
+			{
+				ret.p[i] = glm::vec3( aRandom.uniform( -3.f, 3.f ), aRandom.uniform( -2.f, 3.f ), aRandom.uniform( -6.f, 4.f ) );
+				ret.clip[i] = aProjCam * glm::vec4( ret.p[i], 1.f );
+			}
+
+			if( ret.clip[0].w < 0.5f || ret.clip[1].w < 0.5f || ret.clip[2].w < 0.5f )
+				continue;
+
+			auto const e0 = ndc_( ret.clip[1] ) - ndc_( ret.clip[0] );
+			auto const e1 = ndc_( ret.clip[2] ) - ndc_( ret.clip[0] );
+			if( std::abs( e0.x * e1.y - e0.y * e1.x ) < 0.05f )
+				continue;
+
+			return ret;
+		}
+	}
+
+	glm::vec3 random_weights_( tests::Random& aRandom )
+	{
+		auto u = aRandom.uniform( 0.f, 1.f ), v = aRandom.uniform( 0.f, 1.f );
+		if( u + v > 1.f )
+		{
+			u = 1.f - u;
+			v = 1.f - v;
+		}
+
+		return glm::vec3( 1.f - u - v, u, v );
+	}
+}
+
+TEST_CASE( visibility_barycentrics_interpolate_like_rasterizer )
+{
+	auto const projCam = test_proj_cam_();
+	glm::vec2 const pixelSize( 2.f / 1280.f, 2.f / 720.f );
+
+	tests::Random random( 21 );
+
+	for( int iter = 0; iter < 2000; ++iter )
+	{
+		auto const tri = random_triangle_( random, projCam );
+
+		// A point on the triangle with known (object space) barycentrics;
+		// these are what perspective-correct interpolation must recover
+		auto const weights = random_weights_( random );
+		auto const point = visibility_interpolate( weights, tri.p[0], tri.p[1], tri.p[2] );
+		auto const ndc = ndc_( projCam * glm::vec4( point, 1.f ) );
+
+		auto const b = visibility_barycentrics( tri.clip[0], tri.clip[1], tri.clip[2], ndc, pixelSize );
+
+		CHECK( std::abs( b.lambda.x + b.lambda.y + b.lambda.z - 1.f ) < 1e-5f );
+		CHECK( near_( b.lambda, weights, 2e-3f ) );
+		CHECK( near_( b.lambda, rasterizer_barycentrics_( tri.clip[0], tri.clip[1], tri.clip[2], ndc ), 2e-3f ) );
+
+		// Interpolated attributes, e.g., positions, match
+		auto const interpolated = visibility_interpolate( b.lambda, tri.p[0], tri.p[1], tri.p[2] );
+		CHECK( glm::length( interpolated - point ) < 1e-2f );
+
+		// The derivatives are forward differences to the next pixel
+		auto const bx = visibility_barycentrics( tri.clip[0], tri.clip[1], tri.clip[2], ndc + glm::vec2( pixelSize.x, 0.f ), pixelSize );
+		auto const by = visibility_barycentrics( tri.clip[0], tri.clip[1], tri.clip[2], ndc + glm::vec2( 0.f, pixelSize.y ), pixelSize );
+		CHECK( near_( b.ddx, bx.lambda - b.lambda, 1e-4f ) );
+		CHECK( near_( b.ddy, by.lambda - b.lambda, 1e-4f ) );
+		CHECK( std::abs( b.ddx.x + b.ddx.y + b.ddx.z ) < 1e-5f );
+		CHECK( std::abs( b.ddy.x + b.ddy.y + b.ddy.z ) < 1e-5f );
+	}
+}
+
+TEST_CASE( visibility_barycentrics_at_vertices )
+{
+	auto const projCam = test_proj_cam_();
+	glm::vec2 const pixelSize( 2.f / 1280.f, 2.f / 720.f );
+
+	tests::Random random( 22 );
+
+	for( int iter = 0; iter < 500; ++iter )
+	{
+		auto const tri = random_triangle_( random, projCam );
+
+		for( int i = 0; i < 3; ++i )
+		{
+			auto const b = visibility_barycentrics( tri.clip[0], tri.clip[1], tri.clip[2], ndc_( tri.clip[i] ), pixelSize );
+
+			glm::vec3 unit( 0.f );
+			unit[i] = 1.f;
+			CHECK( near_( b.lambda, unit, 1e-4f ) );
+		}
+	}
+}
+
+TEST_CASE( visibility_pack_round_trips )
+{
+	// Including the largest values that fit
+	std::uint32_t const meshIds[] = { 0, 1, 2, 77, 1000, kVisibilityMaxMeshes - 1 };
+	std::uint32_t const triangles[] = { 0, 1, 12345, kVisibilityMaxTriangles - 2, kVisibilityMaxTriangles - 1 };
+
+	for( auto const meshId : meshIds )
+	{
+		for( auto const triangle : triangles )
+		{
+			auto const packed = visibility_pack( meshId, triangle );
+			CHECK( 0 != packed );
+
+			std::uint32_t mesh = ~0u, tri = ~0u;
+			CHECK( visibility_unpack( packed, mesh, tri ) );
+			CHECK( meshId == mesh );
+			CHECK( triangle == tri );
+		}
+	}
+
+	std::uint32_t mesh, tri;
+	CHECK( !visibility_unpack( 0, mesh, tri ) );
+
+	static_assert( visibility_pack( 3, 5 ) == ((4u << kVisibilityTriangleBits) | 5u) );
+}
+
+TEST_CASE( visibility_pack_rejects_overflow )
+{
+	// Values that do not fit must not alias another mesh's triangle; they
+	// read back as "nothing drawn"
+	CHECK( 0 == visibility_pack( 0, kVisibilityMaxTriangles ) );
+	CHECK( 0 == visibility_pack( 5, kVisibilityMaxTriangles + 7 ) );
+	CHECK( 0 == visibility_pack( 5, ~0u ) );
+	CHECK( 0 == visibility_pack( kVisibilityMaxMeshes, 0 ) );
+	CHECK( 0 == visibility_pack( ~0u, 0 ) );
+
+	std::uint32_t mesh, tri;
+	CHECK( !visibility_unpack( visibility_pack( 1, kVisibilityMaxTriangles ), mesh, tri ) );
+}
@@ -0,0 +1,47 @@
+#ifndef TESTS_HPP_00E985E7_294F_402C_BEFF_E947B93E543B
+#define TESTS_HPP_00E985E7_294F_402C_BEFF_E947B93E543B
+
+#include <cstdint>
+
+// Minimal test harness for the CPU-side parts of cw2 and cw2-bake; nothing
+// in here needs a Vulkan device.
+//
+// TEST_CASE( name ) { ... } defines and registers a test. CHECK( expr )
+// records a failure of the running test if expr is false, and carries on.
+// BENCHMARK_CASE( name ) registers a benchmark, which is run only with
+// --benchmark (see main.cpp).
+
+#define TEST_CASE( aName ) TESTS_CASE_( aName, false )
+#define BENCHMARK_CASE( aName ) TESTS_CASE_( aName, true )
+
+#define CHECK( aExpr ) ::tests::check( bool(aExpr), #aExpr, __FILE__, __LINE__ )
+
+#define TESTS_CASE_( aName, aBenchmark ) \
+	static void aName(); \
+	static bool const aName##Registered_ = ::tests::register_case( #aName, &aName, aBenchmark ); \
+	static void aName()
+
+namespace tests
+{
+	bool register_case( char const* aName, void (*aFunc)(), bool aBenchmark );
+
+	// Returns aPassed. Only the first few failures of a test are printed.
+	bool check( bool aPassed, char const* aExpr, char const* aFile, int aLine );
+
+	// Deterministic pseudo-random numbers, so that failures are reproducible
+	class Random
+	{
+		public:
+			explicit Random( std::uint64_t aSeed ) noexcept : mState( aSeed ) {}
+
+			std::uint32_t next() noexcept;
+
+			float uniform( float aMin, float aMax ) noexcept;
+			std::uint32_t below( std::uint32_t aCount ) noexcept; // [0, aCount)
+
+		private:
+			std::uint64_t mState;
+	};
+}
+
+#endif // TESTS_HPP_00E985E7_294F_402C_BEFF_E947B93E543B
@@ -0,0 +1,323 @@
+#ifndef BAKED_FORMAT_HPP_3E0C8B52_7A41_4C7B_9B0E_6F2D54A1C9E7
+#define BAKED_FORMAT_HPP_3E0C8B52_7A41_4C7B_9B0E_6F2D54A1C9E7
+
+// On-disk structures of the baked file format, version 2. Shared between the
+// baker (cw2-bake/main.cpp, which writes the file) and the runtime loader
+// (cw2/baked_model.cpp). The version 1 format is a plain stream of records;
+// it is documented in baked_model.hpp.
+//
+// Version 2 layout:
+//
+//  - BakedHeaderV2 (file magic, variant, number of sections)
+//  - BakedSectionV2 x sectionCount (table of contents)
+//  - sections, each starting at a multiple of kBakedAlignV2 bytes
+//
+// All offsets are absolute byte offsets from the start of the file, so that
+// a memory-mapped file can be accessed without parsing anything but the
+// header, the table of contents and the fixed-size records. Every attribute
+// and index array in the geometry section starts at a multiple of
+// kBakedAlignV2, which means the arrays can be used in place or copied to
+// the GPU with a single aligned copy.
+//
+// Sections:
+//  - kBakedSectionTextures:
+//    - BakedCountV2
+//    - BakedTextureRecordV2 x count
+//    - path strings (each zero-terminated), referenced by the records
+//  - kBakedSectionMaterials:
+//    - BakedCountV2
+//    - BakedMaterialRecordV2 x count
+//  - kBakedSectionMeshes:
+//    - BakedCountV2
+//    - BakedMeshRecordV2 x count
+//  - kBakedSectionGeometry:
+//    - raw attribute and index arrays referenced by the mesh records
+//  - kBakedSectionQuantization (only with kBakedVertexPackedQ16):
+//    - BakedCountV2
+//    - BakedQuantizationRecordV2 x count (one per mesh)
+//  - kBakedSectionClusters (optional):
+//    - BakedCountV2
+//    - BakedClusterRecordV2 x count
+//    Clusters are sorted by mesh. The clusters of a mesh partition its index
+//    buffer into consecutive ranges, in order.
+//  - kBakedSectionBounds (optional):
+//    - BakedCountV2
+//    - BakedBoundsRecordV2 x count (one per mesh)
+//
+// Textures are stored in separate files, referenced by the texture records.
+// Depending on the baker's --textures option, these are either copies of
+// the source images, or baked texture containers (kBakedTextureExtension):
+//
+//  - BakedTextureHeader (texture magic, format, size, number of levels)
+//  - BakedTextureLevel x levelCount, largest level first
+//  - texel data of each level, starting at a multiple of kBakedTextureAlign
+//
+// Each level is a complete mip level in the header's format, with tightly
+// packed rows stored bottom-up (the first row is the bottom-most one, as in
+// the runtime's decoded images). The levels form the full mip chain down to
+// 1x1, computed offline, so a container is uploaded with a single copy.
+// Block compressed levels consist of 4x4 texel blocks in the same order
+// (see texture_level_size()); partial blocks at the edges are padded.
+//
+// Materials may instead reference a texture that packs several of their
+// single-channel inputs into one (see kBakedMaterialPackedRma). Such textures
+// only exist as baked containers.
+//
+// Readers must ignore sections with unknown IDs.
+//
+// The vertex format is global to the file and stored in the header. With
+// kBakedVertexSeparate, each mesh has four separate fp32 attribute arrays
+// (position, normal, texture coordinate, tangent). The packed formats instead
+// store a single interleaved stream (BakedPackedVertexF32 or
+// BakedPackedVertexQ16), referenced by BakedMeshRecordV2::positionsOffset:
+//  - normal and tangent are octahedral-encoded into four snorm16 values
+//  - the texture coordinate is stored as two half floats
+//  - the tangent's handedness (w) is stored in the position's w component:
+//    values below 0.5 mean -1, others +1
+//  - positions are either fp32, or unorm16 relative to the mesh's bounding
+//    box: position = offset + q * scale (see BakedQuantizationRecordV2)
+
+#include <cstdint>
+
+namespace baked
+{
+	constexpr char kFileMagic[16] = "\0\0COMP5822Mmesh";
+
+	constexpr char kFileVariantV1[16] = "sc22ap-tan";
+	constexpr char kFileVariantV2[16] = "sc22ap-tan-v2";
+
+	constexpr std::uint64_t kBakedAlignV2 = 64;
+
+	constexpr std::uint32_t kNoTexture = ~std::uint32_t(0);
+
+	constexpr char kTextureMagic[16] = "\0\0COMP5822Mtex";
+	constexpr char kBakedTextureExtension[] = ".comp5822tex";
+
+	constexpr std::uint64_t kBakedTextureAlign = 16;
+
+	enum BakedSectionIdV2 : std::uint32_t
+	{
+		kBakedSectionTextures = 1,
+		kBakedSectionMaterials = 2,
+		kBakedSectionMeshes = 3,
+		kBakedSectionGeometry = 4,
+		kBakedSectionQuantization = 5,
+		kBakedSectionClusters = 6,
+		kBakedSectionBounds = 7
+	};
+
+	enum BakedVertexFormatV2 : std::uint32_t
+	{
+		kBakedVertexSeparate = 0,
+		kBakedVertexPackedF32 = 1,
+		kBakedVertexPackedQ16 = 2
+	};
+
+	enum BakedTextureFormat : std::uint32_t
+	{
+		kBakedTextureR8Unorm = 1,
+		kBakedTextureRgba8Unorm = 2,
+		kBakedTextureRgba8Srgb = 3, // mips filtered in linear space
+		kBakedTextureBc1Srgb = 4,   // opaque RGB
+		kBakedTextureBc4Unorm = 5,
+		kBakedTextureBc5Unorm = 6,  // RG; normal maps store x and y only
+		kBakedTextureBc7Srgb = 7,
+		kBakedTextureBc7Unorm = 8   // packed material channels
+	};
+
+	enum BakedMaterialFlagsV2 : std::uint32_t
+	{
+		// Roughness (R), metalness (G) and the alpha mask (B) share one
+		// linear RGBA texture: roughnessTextureId and metalnessTextureId
+		// both refer to it, as does alphaMaskTextureId if the material has
+		// an alpha mask (otherwise it is kNoTexture). B is undefined for
+		// materials without an alpha mask.
+		kBakedMaterialPackedRma = 1
+	};
+
+	struct BakedHeaderV2
+	{
+		char magic[16];
+		char variant[16];
+
+		std::uint32_t sectionCount;
+		std::uint32_t vertexFormat; // BakedVertexFormatV2
+		std::uint32_t reserved[2];
+	};
+
+	struct BakedSectionV2
+	{
+		std::uint32_t id;
+		std::uint32_t reserved;
+		std::uint64_t offset;
+		std::uint64_t size;
+	};
+
+	struct BakedCountV2
+	{
+		std::uint32_t count;
+		std::uint32_t reserved;
+	};
+
+	struct BakedTextureRecordV2
+	{
+		std::uint64_t pathOffset; // absolute offset of zero-terminated string
+		std::uint32_t pathLength; // excluding the terminating zero
+		std::uint8_t channels;
+		std::uint8_t reserved[3];
+	};
+
+	struct BakedMaterialRecordV2
+	{
+		std::uint32_t baseColorTextureId;
+		std::uint32_t roughnessTextureId;
+		std::uint32_t metalnessTextureId;
+		std::uint32_t alphaMaskTextureId; // kNoTexture if not available
+		std::uint32_t normalMapTextureId; // kNoTexture if not available
+		std::uint32_t flags; // BakedMaterialFlagsV2
+		std::uint32_t reserved[2];
+	};
+
+	struct BakedMeshRecordV2
+	{
+		std::uint32_t materialId;
+		std::uint32_t vertexCount;
+		std::uint32_t indexCount;
+		std::uint32_t reserved;
+
+		// Absolute offsets of the arrays; each is aligned to kBakedAlignV2.
+		// With packed vertex formats, positionsOffset refers to the
+		// interleaved vertex stream and the other attribute offsets are zero.
+		std::uint64_t positionsOffset; // vertexCount x vec3
+		std::uint64_t normalsOffset;   // vertexCount x vec3
+		std::uint64_t texcoordsOffset; // vertexCount x vec2
+		std::uint64_t tangentsOffset;  // vertexCount x vec4
+		std::uint64_t indicesOffset;   // indexCount x uint32_t
+	};
+
+	struct BakedQuantizationRecordV2
+	{
+		float offset[3];
+		float scale[3];
+	};
+
+	// Object space axis aligned bounding box of a mesh's vertices
+	struct BakedBoundsRecordV2
+	{
+		float min[3];
+		float max[3];
+	};
+
+	// A cluster (meshlet) is a range of at most 124 triangles referencing at
+	// most 64 unique vertices. The bounds allow culling clusters on their
+	// own: a bounding sphere, and a normal cone such that the cluster is
+	// entirely back-facing when viewed from a camera position p with
+	//   dot(center - p, coneAxis) >= coneCutoff * length(center - p) + radius
+	// where coneCutoff is the sine of the cone's half angle. Clusters whose
+	// normals spread too widely have coneAxis = 0 and coneCutoff = 1, which
+	// never passes the test.
+	struct BakedClusterRecordV2
+	{
+		std::uint32_t meshId;
+		std::uint32_t firstIndex; // relative to the mesh's index buffer
+		std::uint32_t indexCount;
+		std::uint32_t vertexCount; // unique vertices referenced
+
+		float center[3];
+		float radius;
+
+		float coneAxis[3];
+		float coneCutoff;
+	};
+
+	struct BakedTextureHeader
+	{
+		char magic[16];
+
+		std::uint32_t format; // BakedTextureFormat
+		std::uint32_t width;
+		std::uint32_t height;
+		std::uint32_t levelCount;
+	};
+
+	struct BakedTextureLevel
+	{
+		std::uint64_t offset; // absolute, aligned to kBakedTextureAlign
+		std::uint64_t size;
+		std::uint32_t width;
+		std::uint32_t height;
+	};
+
+	struct BakedPackedVertexF32
+	{
+		float position[3];
+		float tangentSign;      // -1 or +1
+		std::int16_t frame[4];  // snorm16: oct. normal (xy), oct. tangent (zw)
+		std::uint16_t texcoord[2]; // half float
+	};
+
+	struct BakedPackedVertexQ16
+	{
+		std::uint16_t position[3]; // unorm16, see BakedQuantizationRecordV2
+		std::uint16_t tangentSign; // unorm16: 0 = -1, 65535 = +1
+		std::int16_t frame[4];
+		std::uint16_t texcoord[2];
+	};
+
+	static_assert( sizeof(BakedHeaderV2) == 48 );
+	static_assert( sizeof(BakedSectionV2) == 24 );
+	static_assert( sizeof(BakedCountV2) == 8 );
+	static_assert( sizeof(BakedTextureRecordV2) == 16 );
+	static_assert( sizeof(BakedMaterialRecordV2) == 32 );
+	static_assert( sizeof(BakedMeshRecordV2) == 56 );
+	static_assert( sizeof(BakedQuantizationRecordV2) == 24 );
+	static_assert( sizeof(BakedClusterRecordV2) == 48 );
+	static_assert( sizeof(BakedBoundsRecordV2) == 24 );
+	static_assert( sizeof(BakedTextureHeader) == 32 );
+	static_assert( sizeof(BakedTextureLevel) == 24 );
+	static_assert( sizeof(BakedPackedVertexF32) == 28 );
+	static_assert( sizeof(BakedPackedVertexQ16) == 20 );
+
+	constexpr std::uint64_t align_up( std::uint64_t aValue, std::uint64_t aAlign )
+	{
+		return (aValue + aAlign - 1) / aAlign * aAlign;
+	}
+
+	// Number of 8-bit channels decoded from the source image
+	constexpr std::uint32_t texture_channels( BakedTextureFormat aFormat )
+	{
+		return kBakedTextureR8Unorm == aFormat || kBakedTextureBc4Unorm == aFormat ? 1 : 4;
+	}
+
+	constexpr bool texture_is_compressed( BakedTextureFormat aFormat )
+	{
+		return aFormat >= kBakedTextureBc1Srgb;
+	}
+
+	// Bytes per texel, or per 4x4 block for compressed formats
+	constexpr std::uint32_t texture_block_bytes( BakedTextureFormat aFormat )
+	{
+		switch( aFormat )
+		{
+			case kBakedTextureR8Unorm: return 1;
+			case kBakedTextureRgba8Unorm: return 4;
+			case kBakedTextureRgba8Srgb: return 4;
+			case kBakedTextureBc1Srgb: return 8;
+			case kBakedTextureBc4Unorm: return 8;
+			case kBakedTextureBc5Unorm: return 16;
+			case kBakedTextureBc7Srgb: return 16;
+			case kBakedTextureBc7Unorm: return 16;
+		}
+		return 0;
+	}
+
+	constexpr std::uint64_t texture_level_size( BakedTextureFormat aFormat, std::uint32_t aWidth, std::uint32_t aHeight )
+	{
+		return texture_is_compressed( aFormat )
+			? std::uint64_t((aWidth+3)/4) * ((aHeight+3)/4) * texture_block_bytes( aFormat )
+			: std::uint64_t(aWidth) * aHeight * texture_block_bytes( aFormat )
+		;
+	}
+}
+
+#endif // BAKED_FORMAT_HPP_3E0C8B52_7A41_4C7B_9B0E_6F2D54A1C9E7
@@ -1,75 +1,125 @@
 #include "baked_model.hpp"
 
+#include <algorithm>
+
 #include <cstdio>
 #include <cstring>
 
+#include "baked_format.hpp"
+
 #include "../labutils/error.hpp"
-#include "../labutils/to_string.hpp"
-#include "../labutils/vkutil.hpp"
+#include "../labutils/trace.hpp"
 namespace lut = labutils;
 
 namespace
 {
-	// See cw2-bake/main.cpp for more info
-	constexpr char kFileMagic[16] = "\0\0COMP5822Mmesh";
-	constexpr char kFileVariant[16] = "sc22ap-tan";
+	// See cw2-bake/main.cpp and baked_format.hpp for more info
+	using baked::kFileMagic;
+	using baked::kFileVariantV1;
+	using baked::kFileVariantV2;
 
 	constexpr std::uint32_t kMaxString = 32*1024;
 
+	// Bounds-checked cursor into the mapped file
+	struct Reader_
+	{
+		std::byte const* beg;
+		std::byte const* cur;
+		std::byte const* end;
+	};
+
 	// functions
-	BakedModel load_baked_model_( FILE*, char const* );
+	BakedModel load_baked_model_( Reader_&, char const* );
+
+	void load_v1_( BakedModel&, Reader_&, std::string const& aPrefix, char const* );
+	void load_v2_( BakedModel&, Reader_&, std::string const& aPrefix, char const* );
 }
 
 BakedModel load_baked_model( char const* aModelPath )
 {
-	FILE* fin = std::fopen( aModelPath, "rb" );
-	if( !fin )
-		throw lut::Error( "load_baked_model(): unable to open '%s' for reading", aModelPath );
+	LUT_TRACE_SCOPE( __func__ );
 
-	try
-	{
-		auto ret = load_baked_model_( fin, aModelPath );
-		std::fclose( fin );
-		return ret;
-	}
-	catch( ... )
-	{
-		std::fclose( fin );
-		throw;
-	}
+	lut::MappedFile file = lut::map_file( aModelPath );
+
+	Reader_ reader{ file.data, file.data, file.data + file.size };
+	auto ret = load_baked_model_( reader, aModelPath );
+
+	// The meshes hold views into the mapping, so it moves along with them
+	ret.file = std::move(file);
+	return ret;
 }
 
 namespace
 {
-	void checked_read_( FILE* aFin, std::size_t aBytes, void* aBuffer )
+	std::byte const* checked_read_( Reader_& aIn, std::size_t aBytes )
 	{
-		auto ret = std::fread( aBuffer, 1, aBytes, aFin );
+		auto const avail = std::size_t(aIn.end - aIn.cur);
+
+		if( aBytes > avail )
+			throw lut::Error( "checked_read_(): expected %zu bytes, got %zu", aBytes, avail );
 
-		if( aBytes != ret )
-			throw lut::Error( "checked_read_(): expected %zu bytes, got %zu", aBytes, ret );
+		auto const ret = aIn.cur;
+		aIn.cur += aBytes;
+		return ret;
 	}
 
-	std::uint32_t read_uint32_( FILE* aFin )
+	std::uint32_t read_uint32_( Reader_& aIn )
 	{
 		std::uint32_t ret;
-		checked_read_( aFin, sizeof(std::uint32_t), &ret );
+		std::memcpy( &ret, checked_read_( aIn, sizeof(std::uint32_t) ), sizeof(std::uint32_t) );
 		return ret;
 	}
-	std::string read_string_( FILE* aFin )
+	std::string read_string_( Reader_& aIn )
 	{
-		auto const length = read_uint32_( aFin );
+		auto const length = read_uint32_( aIn );
 
 		if( length >= kMaxString )
 			throw lut::Error( "read_string_(): unexpectedly long string (%u bytes)", length );
 
-		std::string ret;
-		ret.resize( length );
+		auto const chars = reinterpret_cast<char const*>(checked_read_( aIn, length ));
+
+		// The stored length includes the terminating '\0'.
+		std::string ret( chars, length );
+		if( !ret.empty() && '\0' == ret.back() )
+			ret.pop_back();
 
-		checked_read_( aFin, length, ret.data() );
 		return ret;
 	}
 
-	BakedModel load_baked_model_( FILE* aFin, char const* aInputName )
+	template< typename tType >
+	BakedArray<tType> read_array_( Reader_& aIn, std::uint32_t aCount )
+	{
+		BakedArray<tType> ret;
+		ret.count = aCount;
+		ret.bytes = checked_read_( aIn, std::size_t(aCount)*sizeof(tType) );
+		return ret;
+	}
+
+	// Texture IDs must refer to one of aTextureCount textures; the alpha mask
+	// and the normal map may be absent (0xffffffff).
+	void check_material_( BakedMaterialInfo const& aInfo, std::size_t aTextureCount, std::uint32_t aMaterialId, char const* aInputName )
+	{
+		auto const valid_ = [&] (std::uint32_t aTextureId, bool aOptional) {
+			return aTextureId < aTextureCount || (aOptional && 0xffffffff == aTextureId);
+		};
+
+		if( !valid_( aInfo.baseColorTextureId, false ) || !valid_( aInfo.roughnessTextureId, false ) || !valid_( aInfo.metalnessTextureId, false ) || !valid_( aInfo.alphaMaskTextureId, true ) || !valid_( aInfo.normalMapTextureId, true ) )
+			throw lut::Error( "load_baked_model(): %s: material %u: invalid texture id", aInputName, aMaterialId );
+	}
+
+	// Indices are used as is by the GPU (and by the CPU, e.g., in the
+	// visibility resolve), so each must refer to one of the mesh's vertices.
+	void check_indices_( BakedArray<std::uint32_t> const& aIndices, std::uint32_t aVertexCount, std::uint32_t aMeshId, char const* aInputName )
+	{
+		std::uint32_t maxIndex = 0;
+		for( std::size_t i = 0; i < aIndices.size(); ++i )
+			maxIndex = std::max( maxIndex, aIndices[i] );
+
+		if( !aIndices.empty() && maxIndex >= aVertexCount )
+			throw lut::Error( "load_baked_model(): %s: mesh %u: index %u out of range (%u vertices)", aInputName, aMeshId, maxIndex, aVertexCount );
+	}
+
+	BakedModel load_baked_model_( Reader_& aIn, char const* aInputName )
 	{
 		BakedModel ret;
 
@@ -83,336 +133,347 @@ namespace
 		;
 
 		// Read header and verify file magic and variant
-		char magic[16];
-		checked_read_( aFin, 16, magic );
+		auto const magic = checked_read_( aIn, 16 );
 
 		if( 0 != std::memcmp( magic, kFileMagic, 16 ) )
 			throw lut::Error( "load_baked_model_(): %s: invalid file signature!", aInputName );
 
 		char variant[16];
-		checked_read_( aFin, 16, variant );
+		std::memcpy( variant, checked_read_( aIn, 16 ), 16 );
+
+		if( 0 == std::memcmp( variant, kFileVariantV1, 16 ) )
+			load_v1_( ret, aIn, prefix, aInputName );
+		else if( 0 == std::memcmp( variant, kFileVariantV2, 16 ) )
+			load_v2_( ret, aIn, prefix, aInputName );
+		else
+			throw lut::Error( "load_baked_model_(): %s: file variant is '%.16s', expected '%s' or '%s'", aInputName, variant, kFileVariantV1, kFileVariantV2 );
 
-		if( 0 != std::memcmp( variant, kFileVariant, 16 ) )
-			throw lut::Error( "load_baked_model_(): %s: file variant is '%s', expected '%s'", aInputName, variant, kFileVariant );
+		return ret;
+	}
 
+	void load_v1_( BakedModel& aModel, Reader_& aIn, std::string const& aPrefix, char const* aInputName )
+	{
 		// Read texture info
-		auto const textureCount = read_uint32_( aFin );
+		auto const textureCount = read_uint32_( aIn );
+		aModel.textures.reserve( textureCount );
 		for( std::uint32_t i = 0; i < textureCount; ++i )
 		{
 			BakedTextureInfo info;
-			info.path = prefix + read_string_( aFin );
+			info.path = aPrefix + read_string_( aIn );
 
 			std::uint8_t channels;
-			checked_read_( aFin, sizeof(std::uint8_t), &channels );
+			std::memcpy( &channels, checked_read_( aIn, sizeof(std::uint8_t) ), sizeof(std::uint8_t) );
 			info.channels = channels;
 
-			ret.textures.emplace_back( std::move(info) );
+			aModel.textures.emplace_back( std::move(info) );
 		}
 
 		// Read material info
-		auto const materialCount = read_uint32_( aFin );
+		auto const materialCount = read_uint32_( aIn );
+		aModel.materials.reserve( materialCount );
 		for( std::uint32_t i = 0; i < materialCount; ++i )
 		{
 			BakedMaterialInfo info;
-			info.baseColorTextureId = read_uint32_( aFin );
-			info.roughnessTextureId = read_uint32_( aFin );
-			info.metalnessTextureId = read_uint32_( aFin );
-			info.alphaMaskTextureId = read_uint32_( aFin );
-			info.normalMapTextureId = read_uint32_( aFin );
+			info.baseColorTextureId = read_uint32_( aIn );
+			info.roughnessTextureId = read_uint32_( aIn );
+			info.metalnessTextureId = read_uint32_( aIn );
+			info.alphaMaskTextureId = read_uint32_( aIn );
+			info.normalMapTextureId = read_uint32_( aIn );
 
-			assert( info.baseColorTextureId < ret.textures.size() );
-			assert( info.roughnessTextureId < ret.textures.size() );
-			assert( info.metalnessTextureId < ret.textures.size() );
+			check_material_( info, aModel.textures.size(), i, aInputName );
 
-			ret.materials.emplace_back( std::move(info) );
+			aModel.materials.emplace_back( std::move(info) );
 		}
 
 		// Read mesh data
-		auto const meshCount = read_uint32_( aFin );
+		auto const meshCount = read_uint32_( aIn );
+		aModel.meshes.reserve( meshCount );
 		for( std::uint32_t i = 0; i < meshCount; ++i )
 		{
 			BakedMeshData data;
-			data.materialId = read_uint32_( aFin );
-			assert( data.materialId < ret.materials.size() );
-
-			auto const V = read_uint32_( aFin );
-			auto const I = read_uint32_( aFin );
-
-			data.positions.resize( V );
-			checked_read_( aFin, V*sizeof(glm::vec3), data.positions.data() );
+			data.materialId = read_uint32_( aIn );
+			if( data.materialId >= aModel.materials.size() )
+				throw lut::Error( "load_v1_(): %s: mesh %u: invalid material id %u", aInputName, i, data.materialId );
 
-			data.normals.resize( V );
-			checked_read_( aFin, V*sizeof(glm::vec3), data.normals.data() );
+			auto const V = read_uint32_( aIn );
+			auto const I = read_uint32_( aIn );
 
-			data.texcoords.resize( V );
-			checked_read_( aFin, V*sizeof(glm::vec2), data.texcoords.data() );
+			data.positions = read_array_<glm::vec3>( aIn, V );
+			data.normals = read_array_<glm::vec3>( aIn, V );
+			data.texcoords = read_array_<glm::vec2>( aIn, V );
+			data.tangents = read_array_<glm::vec4>( aIn, V );
+			data.indices = read_array_<std::uint32_t>( aIn, I );
 
-			data.tangents.resize(V);
-			checked_read_(aFin, V * sizeof(glm::vec4), data.tangents.data());
+			check_indices_( data.indices, V, i, aInputName );
 
-			data.indices.resize( I );
-			checked_read_( aFin, I*sizeof(std::uint32_t), data.indices.data() );
-
-			ret.meshes.emplace_back( std::move(data) );
+			aModel.meshes.emplace_back( std::move(data) );
 		}
 
 		// Check
-		char byte;
-		auto const check = std::fread( &byte, 1, 1, aFin );
-		
-		if( 0 != check )
+		if( aIn.cur != aIn.end )
 			std::fprintf( stderr, "Note: '%s' contains trailing bytes\n", aInputName );
+	}
+}
+
+namespace
+{
+	// Returns a pointer to aBytes bytes at absolute offset aOffset, after
+	// checking that the range lies within the file.
+	std::byte const* checked_range_( Reader_ const& aIn, std::uint64_t aOffset, std::uint64_t aBytes )
+	{
+		auto const fileSize = std::uint64_t(aIn.end - aIn.beg);
 
+		if( aOffset > fileSize || aBytes > fileSize - aOffset )
+			throw lut::Error( "checked_range_(): range [%llu, +%llu) exceeds file size %llu", (unsigned long long)aOffset, (unsigned long long)aBytes, (unsigned long long)fileSize );
+
+		return aIn.beg + aOffset;
+	}
+
+	template< typename tType >
+	tType read_record_( Reader_ const& aIn, std::uint64_t aOffset )
+	{
+		tType ret;
+		std::memcpy( &ret, checked_range_( aIn, aOffset, sizeof(tType) ), sizeof(tType) );
 		return ret;
 	}
-}
 
+	template< typename tType >
+	BakedArray<tType> view_array_( Reader_ const& aIn, baked::BakedSectionV2 const& aSection, std::uint64_t aOffset, std::uint64_t aCount, char const* aInputName )
+	{
+		auto const bytes = aCount * sizeof(tType);
 
-void create_mesh(BakedModel aModel, lut::Allocator const& allocator, labutils::VulkanContext const& aContext, std::vector<SceneMesh>& sceneMeshes)
-{
+		if( aOffset < aSection.offset || aOffset + bytes > aSection.offset + aSection.size )
+			throw lut::Error( "load_v2_(): %s: array at %llu lies outside of the geometry section", aInputName, (unsigned long long)aOffset );
+		if( 0 != aOffset % baked::kBakedAlignV2 )
+			throw lut::Error( "load_v2_(): %s: array at %llu is misaligned", aInputName, (unsigned long long)aOffset );
+
+		BakedArray<tType> ret;
+		ret.count = std::size_t(aCount);
+		ret.bytes = checked_range_( aIn, aOffset, bytes );
+		return ret;
+	}
 
-	for (unsigned int i = 0; i < aModel.meshes.size(); i++)
+	void load_v2_( BakedModel& aModel, Reader_& aIn, std::string const& aPrefix, char const* aInputName )
 	{
-		// Creating position, normal and texture buffers
-		lut::Buffer vertexPosGPU = lut::create_buffer(
-			allocator,
-			//sizeof(model.dataTextured.positions),
-			sizeof(glm::vec3) * aModel.meshes[i].positions.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		lut::Buffer vertexNormGPU = lut::create_buffer(
-			allocator,
-			sizeof(glm::vec3) * aModel.meshes[i].normals.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		lut::Buffer vertexUvGPU = lut::create_buffer(
-			allocator,
-			sizeof(glm::vec2) * aModel.meshes[i].texcoords.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		lut::Buffer vertexTanGPU = lut::create_buffer(
-			allocator,
-			sizeof(glm::vec4) * aModel.meshes[i].tangents.size(),
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		lut::Buffer vertexIndGPU = lut::create_buffer(
-			allocator,
-			sizeof(std::uint32_t) * aModel.meshes[i].indices.size(),
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY
-		);
-
-		//Staging Buffers
-		lut::Buffer posStaging = lut::create_buffer(
-			allocator,
-			sizeof(glm::vec3) * aModel.meshes[i].positions.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		lut::Buffer normStaging = lut::create_buffer(
-			allocator,
-			sizeof(glm::vec3) * aModel.meshes[i].normals.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		lut::Buffer uvStaging = lut::create_buffer(
-			allocator,
-			sizeof(glm::vec2) * aModel.meshes[i].texcoords.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		lut::Buffer tanStaging = lut::create_buffer(
-			allocator,
-			sizeof(glm::vec4) * aModel.meshes[i].tangents.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		lut::Buffer indStaging = lut::create_buffer(
-			allocator,
-			sizeof(std::uint32_t) * aModel.meshes[i].indices.size(),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_MEMORY_USAGE_CPU_TO_GPU
-		);
-
-		void* posPtr = nullptr;
-		if (auto const res = vmaMapMemory(allocator.allocator, posStaging.allocation, &posPtr); VK_SUCCESS != res)
+		using namespace baked;
+
+		// Rest of the header (magic and variant were consumed by the caller)
+		auto const header = read_record_<BakedHeaderV2>( aIn, 0 );
+
+		// Table of contents
+		BakedSectionV2 const* textures = nullptr;
+		BakedSectionV2 const* materials = nullptr;
+		BakedSectionV2 const* meshes = nullptr;
+		BakedSectionV2 const* geometry = nullptr;
+		BakedSectionV2 const* quantization = nullptr;
+		BakedSectionV2 const* clusters = nullptr;
+		BakedSectionV2 const* bounds = nullptr;
+
+		// Check the size against the file before allocating space for it
+		checked_range_( aIn, sizeof(BakedHeaderV2), std::uint64_t(header.sectionCount)*sizeof(BakedSectionV2) );
+
+		std::vector<BakedSectionV2> toc( header.sectionCount );
+		std::uint64_t end = sizeof(BakedHeaderV2) + std::uint64_t(header.sectionCount)*sizeof(BakedSectionV2);
+
+		for( std::uint32_t i = 0; i < header.sectionCount; ++i )
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			auto& section = toc[i];
+			section = read_record_<BakedSectionV2>( aIn, sizeof(BakedHeaderV2) + i*sizeof(BakedSectionV2) );
+
+			checked_range_( aIn, section.offset, section.size );
+			end = std::max( end, section.offset + section.size );
+
+			switch( section.id )
+			{
+				case kBakedSectionTextures: textures = &section; break;
+				case kBakedSectionMaterials: materials = &section; break;
+				case kBakedSectionMeshes: meshes = &section; break;
+				case kBakedSectionGeometry: geometry = &section; break;
+				case kBakedSectionQuantization: quantization = &section; break;
+				case kBakedSectionClusters: clusters = &section; break;
+				case kBakedSectionBounds: bounds = &section; break;
+				default: break; // ignore unknown sections
+			}
 		}
-		std::memcpy(posPtr, aModel.meshes[i].positions.data(), sizeof(glm::vec3) * aModel.meshes[i].positions.size());
-		vmaUnmapMemory(allocator.allocator, posStaging.allocation);
 
-		void* normPtr = nullptr;
-		if (auto const res = vmaMapMemory(allocator.allocator, normStaging.allocation, &normPtr); VK_SUCCESS != res)
+		if( !textures || !materials || !meshes || !geometry )
+			throw lut::Error( "load_v2_(): %s: missing required section(s)", aInputName );
+
+		std::size_t packedVertexSize = 0;
+		switch( header.vertexFormat )
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			case kBakedVertexSeparate: break;
+			case kBakedVertexPackedF32: packedVertexSize = sizeof(BakedPackedVertexF32); break;
+			case kBakedVertexPackedQ16: packedVertexSize = sizeof(BakedPackedVertexQ16); break;
+			default:
+				throw lut::Error( "load_v2_(): %s: unknown vertex format %u", aInputName, header.vertexFormat );
 		}
-		std::memcpy(normPtr, aModel.meshes[i].normals.data(), sizeof(glm::vec3) * aModel.meshes[i].normals.size());
-		vmaUnmapMemory(allocator.allocator, normStaging.allocation);
 
-		void* uvPtr = nullptr;
-		if (auto const res = vmaMapMemory(allocator.allocator, uvStaging.allocation, &uvPtr); VK_SUCCESS != res)
-		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+		if( kBakedVertexPackedQ16 == header.vertexFormat && !quantization )
+			throw lut::Error( "load_v2_(): %s: missing quantization section", aInputName );
 
-		}
-		std::memcpy(uvPtr, aModel.meshes[i].texcoords.data(), sizeof(glm::vec2) * aModel.meshes[i].texcoords.size());
-		vmaUnmapMemory(allocator.allocator, uvStaging.allocation);
+		aModel.vertexFormat = BakedVertexFormatV2(header.vertexFormat);
 
-		void* tanPtr = nullptr;
-		if (auto const res = vmaMapMemory(allocator.allocator, tanStaging.allocation, &tanPtr); VK_SUCCESS != res)
+		// Records are fixed size; check that each section holds its records
+		auto const count_ = [&] (BakedSectionV2 const& aSection, std::size_t aRecordSize, char const* aWhat) {
+			auto const count = read_record_<BakedCountV2>( aIn, aSection.offset ).count;
+			if( sizeof(BakedCountV2) + std::uint64_t(count)*aRecordSize > aSection.size )
+				throw lut::Error( "load_v2_(): %s: %s section too small for %u records", aInputName, aWhat, count );
+			return count;
+		};
+
+		// Read texture info
+		auto const textureCount = count_( *textures, sizeof(BakedTextureRecordV2), "texture" );
+		aModel.textures.reserve( textureCount );
+		for( std::uint32_t i = 0; i < textureCount; ++i )
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			auto const rec = read_record_<BakedTextureRecordV2>( aIn, textures->offset + sizeof(BakedCountV2) + i*sizeof(BakedTextureRecordV2) );
+
+			if( rec.pathLength >= kMaxString )
+				throw lut::Error( "load_v2_(): %s: unexpectedly long string (%u bytes)", aInputName, rec.pathLength );
+
+			auto const chars = reinterpret_cast<char const*>(checked_range_( aIn, rec.pathOffset, rec.pathLength ));
+
+			BakedTextureInfo info;
+			info.path = aPrefix + std::string( chars, rec.pathLength );
+			info.channels = rec.channels;
 
+			aModel.textures.emplace_back( std::move(info) );
 		}
-		std::memcpy(tanPtr, aModel.meshes[i].tangents.data(), sizeof(glm::vec4) * aModel.meshes[i].tangents.size());
-		vmaUnmapMemory(allocator.allocator, tanStaging.allocation);
 
-		void* indPtr = nullptr;
-		if (auto const res = vmaMapMemory(allocator.allocator, indStaging.allocation, &indPtr); VK_SUCCESS != res)
+		// Read material info
+		auto const materialCount = count_( *materials, sizeof(BakedMaterialRecordV2), "material" );
+		aModel.materials.reserve( materialCount );
+		for( std::uint32_t i = 0; i < materialCount; ++i )
 		{
-			throw lut::Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", lut::to_string(res).c_str());
-		}
-		std::memcpy(indPtr, aModel.meshes[i].indices.data(), sizeof(std::uint32_t) * aModel.meshes[i].indices.size());
-		vmaUnmapMemory(allocator.allocator, indStaging.allocation);
+			auto const rec = read_record_<BakedMaterialRecordV2>( aIn, materials->offset + sizeof(BakedCountV2) + i*sizeof(BakedMaterialRecordV2) );
 
+			BakedMaterialInfo info;
+			info.baseColorTextureId = rec.baseColorTextureId;
+			info.roughnessTextureId = rec.roughnessTextureId;
+			info.metalnessTextureId = rec.metalnessTextureId;
+			info.alphaMaskTextureId = rec.alphaMaskTextureId;
+			info.normalMapTextureId = rec.normalMapTextureId;
+			info.packedRma = 0 != (rec.flags & kBakedMaterialPackedRma);
 
-		// We need to ensure that the Vulkan resources are alive until all the 
-		// transfers have completed. For simplicity, we will just wait for the 
-		// operations to complete with a fence.
-		lut::Fence uploadComplete = lut::create_fence(aContext);
+			check_material_( info, aModel.textures.size(), i, aInputName );
 
-		// Queue data uploads from staging buffers to the final buffers 
-		// This uses a separate command pool for simplicity. 
-		lut::CommandPool uploadPool = create_command_pool(aContext);
-		VkCommandBuffer uploadCmd = alloc_command_buffer(aContext, uploadPool.handle);
+			if( info.packedRma && info.roughnessTextureId != info.metalnessTextureId )
+				throw lut::Error( "load_v2_(): %s: material %u: packed roughness and metalness must share a texture", aInputName, i );
 
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+			aModel.materials.emplace_back( std::move(info) );
+		}
 
-		if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo); VK_SUCCESS != res)
+		// Read mesh data
+		auto const meshCount = count_( *meshes, sizeof(BakedMeshRecordV2), "mesh" );
+		aModel.meshes.reserve( meshCount );
+		for( std::uint32_t i = 0; i < meshCount; ++i )
 		{
-			throw lut::Error("Beginning command buffer recording\n"
-				"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
+			auto const rec = read_record_<BakedMeshRecordV2>( aIn, meshes->offset + sizeof(BakedCountV2) + i*sizeof(BakedMeshRecordV2) );
+
+			BakedMeshData data;
+			data.materialId = rec.materialId;
+			if( data.materialId >= aModel.materials.size() )
+				throw lut::Error( "load_v2_(): %s: mesh %u: invalid material id %u", aInputName, i, data.materialId );
+
+			if( packedVertexSize )
+			{
+				data.packedVertices = view_array_<std::byte>( aIn, *geometry, rec.positionsOffset, std::uint64_t(rec.vertexCount)*packedVertexSize, aInputName );
+			}
+			else
+			{
+				data.positions = view_array_<glm::vec3>( aIn, *geometry, rec.positionsOffset, rec.vertexCount, aInputName );
+				data.normals = view_array_<glm::vec3>( aIn, *geometry, rec.normalsOffset, rec.vertexCount, aInputName );
+				data.texcoords = view_array_<glm::vec2>( aIn, *geometry, rec.texcoordsOffset, rec.vertexCount, aInputName );
+				data.tangents = view_array_<glm::vec4>( aIn, *geometry, rec.tangentsOffset, rec.vertexCount, aInputName );
+			}
+
+			data.indices = view_array_<std::uint32_t>( aIn, *geometry, rec.indicesOffset, rec.indexCount, aInputName );
+
+			check_indices_( data.indices, rec.vertexCount, i, aInputName );
+
+			aModel.meshes.emplace_back( std::move(data) );
 		}
 
-		VkBufferCopy pcopy{};
-		pcopy.size = sizeof(glm::vec3) * aModel.meshes[i].positions.size();
-
-		vkCmdCopyBuffer(uploadCmd, posStaging.buffer, vertexPosGPU.buffer, 1, &pcopy);
-
-		lut::buffer_barrier(uploadCmd,
-			vertexPosGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-		);
-
-		VkBufferCopy ncopy{};
-		ncopy.size = sizeof(glm::vec3) * aModel.meshes[i].normals.size();
-
-		vkCmdCopyBuffer(uploadCmd, normStaging.buffer, vertexNormGPU.buffer, 1, &ncopy);
-
-		lut::buffer_barrier(uploadCmd,
-			vertexNormGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-		);
-		
-		VkBufferCopy tcopy{};
-		tcopy.size = sizeof(glm::vec2) * aModel.meshes[i].texcoords.size();
-		
-		vkCmdCopyBuffer(uploadCmd, uvStaging.buffer, vertexUvGPU.buffer, 1, &tcopy);
-		
-		lut::buffer_barrier(uploadCmd,
-			vertexUvGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-		);
-
-		VkBufferCopy gcopy{};
-		gcopy.size = sizeof(glm::vec4) * aModel.meshes[i].tangents.size();
-
-		vkCmdCopyBuffer(uploadCmd, tanStaging.buffer, vertexTanGPU.buffer, 1, &gcopy);
-
-		lut::buffer_barrier(uploadCmd,
-			vertexTanGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-		);
-		
-		VkBufferCopy icopy{};
-		icopy.size = sizeof(std::uint32_t) * aModel.meshes[i].indices.size();
-
-		vkCmdCopyBuffer(uploadCmd, indStaging.buffer, vertexIndGPU.buffer, 1, &icopy);
-
-		lut::buffer_barrier(uploadCmd,
-			vertexIndGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-		);
-		
-		if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
+		// Read quantization parameters
+		if( kBakedVertexPackedQ16 == aModel.vertexFormat )
 		{
-			throw lut::Error("Ending command buffer recording\n"
-				"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+			auto const quantCount = count_( *quantization, sizeof(BakedQuantizationRecordV2), "quantization" );
+			if( quantCount != meshCount )
+				throw lut::Error( "load_v2_(): %s: %u quantization records for %u meshes", aInputName, quantCount, meshCount );
+
+			for( std::uint32_t i = 0; i < quantCount; ++i )
+			{
+				auto const rec = read_record_<BakedQuantizationRecordV2>( aIn, quantization->offset + sizeof(BakedCountV2) + i*sizeof(BakedQuantizationRecordV2) );
+
+				auto& mesh = aModel.meshes[i];
+				mesh.positionOffset = glm::vec3( rec.offset[0], rec.offset[1], rec.offset[2] );
+				mesh.positionScale = glm::vec3( rec.scale[0], rec.scale[1], rec.scale[2] );
+			}
 		}
-		
-		// Submit transfer commands 
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &uploadCmd;
-
-		if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
+
+		// Read bounds
+		if( bounds )
 		{
-			throw lut::Error("Submitting commands\n"
-				"vkQueueSubmit() returned %s", lut::to_string(res).c_str());
+			auto const boundsCount = count_( *bounds, sizeof(BakedBoundsRecordV2), "bounds" );
+			if( boundsCount != meshCount )
+				throw lut::Error( "load_v2_(): %s: %u bounds records for %u meshes", aInputName, boundsCount, meshCount );
+
+			for( std::uint32_t i = 0; i < boundsCount; ++i )
+			{
+				auto const rec = read_record_<BakedBoundsRecordV2>( aIn, bounds->offset + sizeof(BakedCountV2) + i*sizeof(BakedBoundsRecordV2) );
+
+				auto& mesh = aModel.meshes[i];
+				mesh.hasBounds = true;
+				mesh.aabbMin = glm::vec3( rec.min[0], rec.min[1], rec.min[2] );
+				mesh.aabbMax = glm::vec3( rec.max[0], rec.max[1], rec.max[2] );
+			}
 		}
 
-		if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle,
-			VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		// Read clusters. These are sorted by mesh, and each mesh's clusters
+		// partition its index buffer in order. Meshes without clusters are
+		// drawn as a whole.
+		if( clusters )
 		{
-			throw lut::Error("Waiting for upload to complete\n"
-				"vkWaitForFences() returned %s", lut::to_string(res).c_str());
+			auto const clusterCount = count_( *clusters, sizeof(BakedClusterRecordV2), "cluster" );
+			auto const first = clusters->offset + sizeof(BakedCountV2);
+
+			std::uint32_t i = 0;
+			while( i < clusterCount )
+			{
+				auto const meshId = read_record_<BakedClusterRecordV2>( aIn, first + i*sizeof(BakedClusterRecordV2) ).meshId;
+				if( meshId >= meshCount || !aModel.meshes[meshId].clusters.empty() )
+					throw lut::Error( "load_v2_(): %s: cluster %u: invalid or unsorted mesh id %u", aInputName, i, meshId );
+
+				auto& mesh = aModel.meshes[meshId];
+
+				std::uint32_t j = i;
+				std::uint64_t nextIndex = 0;
+				for( ; j < clusterCount; ++j )
+				{
+					auto const rec = read_record_<BakedClusterRecordV2>( aIn, first + j*sizeof(BakedClusterRecordV2) );
+					if( rec.meshId != meshId )
+						break;
+
+					if( rec.firstIndex != nextIndex || rec.indexCount % 3 )
+						throw lut::Error( "load_v2_(): %s: cluster %u: invalid index range", aInputName, j );
+
+					nextIndex += rec.indexCount;
+				}
+
+				if( nextIndex != mesh.indices.size() )
+					throw lut::Error( "load_v2_(): %s: clusters of mesh %u cover %llu of %zu indices", aInputName, meshId, (unsigned long long)nextIndex, mesh.indices.size() );
+
+				// Records are read with memcpy(), so no alignment is required
+				mesh.clusters.count = j-i;
+				mesh.clusters.bytes = checked_range_( aIn, first + i*sizeof(BakedClusterRecordV2), mesh.clusters.size_bytes() );
+				i = j;
+			}
 		}
 
-		sceneMeshes[i].positions = std::move(vertexPosGPU);
-		sceneMeshes[i].normals = std::move(vertexNormGPU);
-		sceneMeshes[i].texcoords = std::move(vertexUvGPU);
-		sceneMeshes[i].tangents = std::move(vertexTanGPU);
-		sceneMeshes[i].indices = std::move(vertexIndGPU);
-		sceneMeshes[i].indexCount = unsigned int(aModel.meshes[i].indices.size());
-			// IndexCount
-			
+		// Check
+		if( end != std::uint64_t(aIn.end - aIn.beg) )
+			std::fprintf( stderr, "Note: '%s' contains trailing bytes\n", aInputName );
 	}
-	
-}
\ No newline at end of file
+}
+
@@ -4,7 +4,9 @@
 #include <string>
 #include <vector>
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 
 #include <glm/vec2.hpp>
 #include <glm/vec3.hpp>
@@ -14,9 +16,11 @@
 //#include <half.hpp>
 //using half_float::half;
 
-#include "../labutils/vkbuffer.hpp"
+#include "../labutils/mapped_file.hpp"
 namespace lut = labutils;
-/* Baked file format:
+
+#include "baked_format.hpp"
+/* Baked file format (variant "sc22ap-tan", version 1):
  *
  *  1. Header:
  *    - 16*char: file magic = "\0\0COMP5822Mmesh"
@@ -55,6 +59,16 @@ namespace lut = labutils;
  * See cw2-bake/main.cpp (specifically write_model_data_()) for additional
  * information.
  *
+ * Version 2 (variant "sc22ap-tan-v2") stores the same information, but with a
+ * fixed-size header, a table of contents and fixed-size records, with all
+ * geometry arrays aligned to 64 bytes. See baked_format.hpp for its layout.
+ * load_baked_model() accepts both variants.
+ *
+ * Version 2 files may alternatively store a single interleaved, compressed
+ * vertex stream per mesh (BakedModel::vertexFormat != kBakedVertexSeparate).
+ * In that case, BakedMeshData::packedVertices holds the stream and the four
+ * separate attribute arrays are empty.
+ *
  *
  * My suggestion for loading the data into Vulkan is as follows:
  *
@@ -72,8 +86,42 @@ namespace lut = labutils;
  *
  * - Upload mesh data. In my reference solution, I created separate VkBuffers
  *   for each mesh (one for each attribute and one for the indices).
+ *
+ *
+ * The loader memory-maps the file. Attribute and index arrays are not copied
+ * out of the file; BakedMeshData only holds BakedArray<> views that point
+ * into the mapping owned by BakedModel. The data is copied exactly once, when
+ * it is written into a staging buffer. The views are therefore only valid for
+ * as long as the BakedModel they came from.
  */
 
+// View of tCount elements of type tType stored in a mapped baked file. The
+// data in the file is not necessarily aligned for tType, so the elements are
+// exposed as raw bytes (for bulk copies) or read via std::memcpy().
+template< typename tType >
+struct BakedArray
+{
+	std::byte const* bytes = nullptr;
+	std::size_t count = 0;
+
+	std::size_t size() const noexcept { return count; }
+	std::size_t size_bytes() const noexcept { return count * sizeof(tType); }
+	bool empty() const noexcept { return 0 == count; }
+
+	tType operator[] ( std::size_t aIndex ) const noexcept
+	{
+		tType ret;
+		std::memcpy( &ret, bytes + aIndex*sizeof(tType), sizeof(tType) );
+		return ret;
+	}
+
+	void copy_to( void* aDest ) const noexcept
+	{
+		if( count )
+			std::memcpy( aDest, bytes, size_bytes() );
+	}
+};
+
 struct BakedTextureInfo
 {
 	std::string path;
@@ -87,20 +135,39 @@ struct BakedMaterialInfo
 	std::uint32_t metalnessTextureId;
 	std::uint32_t alphaMaskTextureId; // May be set to 0xffffffff if no alpha mask
 	std::uint32_t normalMapTextureId; // May be set to 0xffffffff if no normal map
+
+	// Roughness (R), metalness (G) and alpha mask (B) share one texture, see
+	// kBakedMaterialPackedRma in baked_format.hpp (v2 only)
+	bool packedRma = false;
 };
 
 struct BakedMeshData
 {
 	std::uint32_t materialId;
 
-	std::vector<glm::vec3> positions;
-	std::vector<glm::vec2> texcoords;
-	std::vector<glm::vec3> normals;
-	std::vector<glm::vec4> tangents;
+	BakedArray<glm::vec3> positions;
+	BakedArray<glm::vec2> texcoords;
+	BakedArray<glm::vec3> normals;
+	BakedArray<glm::vec4> tangents;
 
 	//std::vector<half[3]> tbnQuaternion; // For task 1.5
 
-	std::vector<std::uint32_t> indices;
+	// Interleaved vertices (packed formats only); see baked_format.hpp
+	BakedArray<std::byte> packedVertices;
+	glm::vec3 positionOffset{ 0.f };
+	glm::vec3 positionScale{ 1.f };
+
+	BakedArray<std::uint32_t> indices;
+
+	// Clusters partitioning indices (v2 only; empty if not present). See
+	// BakedClusterRecordV2 in baked_format.hpp and culling.hpp.
+	BakedArray<baked::BakedClusterRecordV2> clusters;
+
+	// Object space bounding box (v2 only). Meshes without bounds can not be
+	// culled.
+	bool hasBounds = false;
+	glm::vec3 aabbMin{ 0.f };
+	glm::vec3 aabbMax{ 0.f };
 };
 
 struct BakedModel
@@ -108,23 +175,14 @@ struct BakedModel
 	std::vector<BakedTextureInfo> textures;
 	std::vector<BakedMaterialInfo> materials;
 	std::vector<BakedMeshData> meshes;
-};
-
-
-struct SceneMesh
-{
-	labutils::Buffer positions;
-	labutils::Buffer normals;
-	labutils::Buffer texcoords;
-	labutils::Buffer tangents;
-	labutils::Buffer indices;
 
-	std::uint32_t indexCount;
+	baked::BakedVertexFormatV2 vertexFormat = baked::kBakedVertexSeparate;
 
+	// Backing storage for the BakedArray<> views in meshes
+	lut::MappedFile file;
 };
 
 BakedModel load_baked_model( char const* aModelPath );
-void create_mesh(BakedModel aModel, lut::Allocator const& allocator, labutils::VulkanContext const& aContext, std::vector<SceneMesh>& sceneMeshes);
 
 #endif // BAKED_MODEL_HPP_7D7BFF3A_1743_43DF_8D4F_D67D80FD8282
 
@@ -0,0 +1,159 @@
+#include "baked_texture.hpp"
+
+#include <cstring>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+
+bool is_baked_texture( std::string const& aPath )
+{
+	constexpr std::size_t extLength = sizeof(baked::kBakedTextureExtension) - 1;
+
+	return aPath.size() >= extLength
+		&& 0 == aPath.compare( aPath.size() - extLength, extLength, baked::kBakedTextureExtension )
+	;
+}
+
+VkFormat baked_texture_format( baked::BakedTextureFormat aFormat )
+{
+	switch( aFormat )
+	{
+		case baked::kBakedTextureR8Unorm: return VK_FORMAT_R8_UNORM;
+		case baked::kBakedTextureRgba8Unorm: return VK_FORMAT_R8G8B8A8_UNORM;
+		case baked::kBakedTextureRgba8Srgb: return VK_FORMAT_R8G8B8A8_SRGB;
+		case baked::kBakedTextureBc1Srgb: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+		case baked::kBakedTextureBc4Unorm: return VK_FORMAT_BC4_UNORM_BLOCK;
+		case baked::kBakedTextureBc5Unorm: return VK_FORMAT_BC5_UNORM_BLOCK;
+		case baked::kBakedTextureBc7Srgb: return VK_FORMAT_BC7_SRGB_BLOCK;
+		case baked::kBakedTextureBc7Unorm: return VK_FORMAT_BC7_UNORM_BLOCK;
+	}
+
+	throw lut::Error( "baked_texture_format(): unknown format %u", unsigned(aFormat) );
+}
+
+BakedTexture load_baked_texture( char const* aPath )
+{
+	BakedTexture ret;
+	ret.file = lut::map_file( aPath );
+
+	auto const fileSize = std::uint64_t(ret.file.size);
+
+	baked::BakedTextureHeader header;
+	if( fileSize < sizeof(header) )
+		throw lut::Error( "load_baked_texture(): %s: file too small", aPath );
+
+	std::memcpy( &header, ret.file.data, sizeof(header) );
+	if( 0 != std::memcmp( header.magic, baked::kTextureMagic, sizeof(header.magic) ) )
+		throw lut::Error( "load_baked_texture(): %s: invalid file signature!", aPath );
+
+	switch( header.format )
+	{
+		case baked::kBakedTextureR8Unorm:
+		case baked::kBakedTextureRgba8Unorm:
+		case baked::kBakedTextureRgba8Srgb:
+		case baked::kBakedTextureBc1Srgb:
+		case baked::kBakedTextureBc4Unorm:
+		case baked::kBakedTextureBc5Unorm:
+		case baked::kBakedTextureBc7Srgb:
+		case baked::kBakedTextureBc7Unorm:
+			break;
+		default:
+			throw lut::Error( "load_baked_texture(): %s: unknown format %u", aPath, header.format );
+	}
+
+	if( 0 == header.width || 0 == header.height || header.levelCount != lut::compute_mip_level_count( header.width, header.height ) )
+		throw lut::Error( "load_baked_texture(): %s: %ux%u texture with %u levels is not a full mip chain", aPath, header.width, header.height, header.levelCount );
+
+	auto const tableBytes = std::uint64_t(header.levelCount) * sizeof(baked::BakedTextureLevel);
+	if( fileSize < sizeof(header) + tableBytes )
+		throw lut::Error( "load_baked_texture(): %s: truncated level table", aPath );
+
+	ret.format = baked::BakedTextureFormat(header.format);
+	ret.width = header.width;
+	ret.height = header.height;
+
+	ret.levels.resize( header.levelCount );
+	std::memcpy( ret.levels.data(), ret.file.data + sizeof(header), tableBytes );
+
+	// Levels must be in order, so that they can be staged as one range
+	std::uint64_t end = sizeof(header) + tableBytes;
+	std::uint32_t width = header.width, height = header.height;
+	for( auto const& level : ret.levels )
+	{
+		if( level.width != width || level.height != height || level.size != baked::texture_level_size( ret.format, width, height ) )
+			throw lut::Error( "load_baked_texture(): %s: level has unexpected size", aPath );
+		if( level.offset < end || 0 != level.offset % baked::kBakedTextureAlign || level.size > fileSize - level.offset )
+			throw lut::Error( "load_baked_texture(): %s: level at %llu is misplaced", aPath, (unsigned long long)level.offset );
+
+		end = level.offset + level.size;
+		width = width > 1 ? width >> 1 : 1;
+		height = height > 1 ? height >> 1 : 1;
+	}
+
+	return ret;
+}
+
+lut::Image upload_baked_texture( BakedTexture const& aTexture, lut::UploadBatcher& aUploader, lut::Allocator const& aAllocator )
+{
+	// Stage all levels at once. The level offsets in the file are aligned to
+	// kBakedTextureAlign, so they stay aligned relative to the staged range
+	// (copies of compressed data must start at a multiple of the block size).
+	auto const first = aTexture.levels.front().offset;
+	auto const bytes = aTexture.levels.back().offset + aTexture.levels.back().size - first;
+
+	auto const staging = aUploader.stage( bytes, baked::kBakedTextureAlign );
+	std::memcpy( staging.data, aTexture.file.data + first, bytes );
+
+	lut::Image ret = lut::create_image_texture2d( aAllocator, aTexture.width, aTexture.height, baked_texture_format( aTexture.format ) );
+
+	auto const levelCount = std::uint32_t(aTexture.levels.size());
+	VkImageSubresourceRange const range{
+		VK_IMAGE_ASPECT_COLOR_BIT,
+		0, levelCount,
+		0, 1
+	};
+
+	VkCommandBuffer cbuff = aUploader.command_buffer();
+
+	lut::image_barrier( cbuff, ret.image,
+		0,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_IMAGE_LAYOUT_UNDEFINED,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		range
+	);
+
+	std::vector<VkBufferImageCopy> copies( levelCount );
+	for( std::uint32_t i = 0; i < levelCount; ++i )
+	{
+		auto const& level = aTexture.levels[i];
+
+		auto& copy = copies[i];
+		copy.bufferOffset = staging.offset + (level.offset - first);
+		copy.bufferRowLength = 0;
+		copy.bufferImageHeight = 0;
+		copy.imageSubresource = VkImageSubresourceLayers{
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			i,
+			0, 1
+		};
+		copy.imageOffset = VkOffset3D{ 0, 0, 0 };
+		copy.imageExtent = VkExtent3D{ level.width, level.height, 1 }; // may end mid-block at the edge
+	}
+
+	vkCmdCopyBufferToImage( cbuff, staging.buffer, ret.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, copies.data() );
+
+	lut::image_barrier( cbuff, ret.image,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_ACCESS_SHADER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		range
+	);
+
+	return ret;
+}
@@ -0,0 +1,50 @@
+#ifndef BAKED_TEXTURE_HPP_9A47C2E5_1B3D_4F86_A0E9_52D7C8B1F364
+#define BAKED_TEXTURE_HPP_9A47C2E5_1B3D_4F86_A0E9_52D7C8B1F364
+
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "../labutils/upload.hpp"
+#include "../labutils/vkimage.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/mapped_file.hpp"
+namespace lut = labutils;
+
+#include "baked_format.hpp"
+
+// A baked texture container (see baked_format.hpp), mapped into memory. The
+// level table has been validated: the levels form the full mip chain of the
+// texture, and each lies within the file.
+struct BakedTexture
+{
+	lut::MappedFile file;
+
+	baked::BakedTextureFormat format;
+	std::uint32_t width, height;
+
+	std::vector<baked::BakedTextureLevel> levels;
+};
+
+// True if aPath refers to a baked texture container, i.e., ends with
+// baked::kBakedTextureExtension.
+bool is_baked_texture( std::string const& aPath );
+
+// Vulkan format of the images created for a container
+VkFormat baked_texture_format( baked::BakedTextureFormat );
+
+// Maps and validates the container at aPath. Throws lut::Error on failure.
+BakedTexture load_baked_texture( char const* aPath );
+
+// Records the upload of all levels into aUploader's current batch: the data
+// is staged with a single memcpy() and copied with a single
+// vkCmdCopyBufferToImage(). No mipmaps are generated at runtime. The image
+// has the format baked_texture_format(aTexture.format); block compressed
+// formats require the textureCompressionBC device feature. The image may
+// only be used once the batch has been submitted.
+lut::Image upload_baked_texture( BakedTexture const& aTexture, lut::UploadBatcher&, lut::Allocator const& );
+
+#endif // BAKED_TEXTURE_HPP_9A47C2E5_1B3D_4F86_A0E9_52D7C8B1F364
@@ -0,0 +1,291 @@
+#include "benchmark.hpp"
+
+#include <memory>
+#include <algorithm>
+
+#include <cmath>
+#include <cctype>
+#include <cstdio>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../labutils/error.hpp"
+namespace lut = labutils;
+
+namespace
+{
+	using FilePtr_ = std::unique_ptr<FILE, int (*)(FILE*)>;
+
+	// p50, p95 and p99 of one measurement
+	struct Percentiles_
+	{
+		double p[3];
+	};
+
+	constexpr double kPercentiles_[3] = { 50.0, 95.0, 99.0 };
+
+	template< typename tGetter >
+	Percentiles_ percentiles_( std::vector<FrameSample> const&, tGetter&& );
+
+	// Empty for negative values (unknown)
+	void write_ms_( FILE*, double );
+}
+
+CameraPath parse_camera_path( char const* aText, char const* aSourceName )
+{
+	assert( aText );
+
+	CameraPath ret;
+
+	std::size_t lineNumber = 0;
+	for( char const* line = aText; *line; )
+	{
+		++lineNumber;
+
+		char const* lineEnd = std::strchr( line, '\n' );
+		if( !lineEnd )
+			lineEnd = line + std::strlen( line );
+
+		// Up to the comment, if any
+		std::string content( line, lineEnd );
+		if( auto const comment = content.find( '#' ); std::string::npos != comment )
+			content.resize( comment );
+
+		line = *lineEnd ? lineEnd + 1 : lineEnd;
+
+		float values[8];
+		std::size_t count = 0;
+
+		char const* cur = content.c_str();
+		for( ;; )
+		{
+			char* end = nullptr;
+			float const value = std::strtof( cur, &end );
+			if( end == cur )
+				break;
+
+			if( count == 8 )
+				throw lut::Error( "%s:%zu: too many values (expected 6 or 8)", aSourceName, lineNumber );
+
+			values[count++] = value;
+			cur = end;
+		}
+
+		// Anything left must be whitespace
+		for( ; *cur; ++cur )
+		{
+			if( !std::isspace( static_cast<unsigned char>(*cur) ) )
+				throw lut::Error( "%s:%zu: unexpected '%s'", aSourceName, lineNumber, cur );
+		}
+
+		if( 0 == count )
+			continue; // empty or comment
+
+		CameraKeyframe keyframe;
+		keyframe.time = values[0];
+		keyframe.position = glm::vec3( values[1], values[2], values[3] );
+
+		if( 6 == count )
+		{
+			auto const yaw = glm::radians( values[4] );
+			auto const pitch = glm::radians( values[5] );
+			keyframe.orientation = glm::angleAxis( yaw, glm::vec3( 0.f, 1.f, 0.f ) )
+				* glm::angleAxis( pitch, glm::vec3( 1.f, 0.f, 0.f ) );
+		}
+		else if( 8 == count )
+		{
+			glm::quat const q( values[4], values[5], values[6], values[7] );
+			if( glm::length( q ) < 1e-6f )
+				throw lut::Error( "%s:%zu: zero quaternion", aSourceName, lineNumber );
+
+			keyframe.orientation = glm::normalize( q );
+		}
+		else
+		{
+			throw lut::Error( "%s:%zu: expected 6 or 8 values, got %zu", aSourceName, lineNumber, count );
+		}
+
+		if( !ret.keyframes.empty() && keyframe.time <= ret.keyframes.back().time )
+			throw lut::Error( "%s:%zu: keyframe times must increase", aSourceName, lineNumber );
+
+		ret.keyframes.emplace_back( keyframe );
+	}
+
+	if( ret.keyframes.empty() )
+		throw lut::Error( "%s: no keyframes", aSourceName );
+
+	return ret;
+}
+
+CameraPath load_camera_path( char const* aPath )
+{
+	FilePtr_ file( std::fopen( aPath, "rb" ), &std::fclose );
+	if( !file )
+		throw lut::Error( "%s: unable to open camera path", aPath );
+
+	std::string text;
+
+	char buffer[4096];
+	while( auto const bytes = std::fread( buffer, 1, sizeof(buffer), file.get() ) )
+		text.append( buffer, bytes );
+
+	if( std::ferror( file.get() ) )
+		throw lut::Error( "%s: unable to read camera path", aPath );
+
+	return parse_camera_path( text.c_str(), aPath );
+}
+
+glm::mat4 sample_camera_path( CameraPath const& aPath, float aTime )
+{
+	auto const& keys = aPath.keyframes;
+	assert( !keys.empty() );
+
+	// First keyframe after aTime
+	auto const next = std::upper_bound( keys.begin(), keys.end(), aTime, [] (float aX, CameraKeyframe const& aKey) {
+		return aX < aKey.time;
+	} );
+
+	glm::vec3 position;
+	glm::quat orientation;
+
+	if( keys.begin() == next )
+	{
+		position = keys.front().position;
+		orientation = keys.front().orientation;
+	}
+	else if( keys.end() == next )
+	{
+		position = keys.back().position;
+		orientation = keys.back().orientation;
+	}
+	else
+	{
+		auto const& k0 = *(next-1);
+		auto const& k1 = *next;
+
+		float const a = (aTime - k0.time) / (k1.time - k0.time);
+		position = glm::mix( k0.position, k1.position, a );
+		orientation = glm::slerp( k0.orientation, k1.orientation, a ); // shortest arc
+	}
+
+	return glm::translate( glm::mat4( 1.f ), position ) * glm::mat4_cast( orientation );
+}
+
+float camera_path_time( CameraPath const& aPath, std::uint32_t aFrame, std::uint32_t aFrameCount )
+{
+	auto const& keys = aPath.keyframes;
+	assert( !keys.empty() );
+
+	if( aFrameCount <= 1 )
+		return keys.front().time;
+
+	float const a = float(aFrame) / float(aFrameCount - 1);
+	return keys.front().time + a * (keys.back().time - keys.front().time);
+}
+
+std::string format_camera_keyframe( float aTime, glm::mat4 const& aCamera2World )
+{
+	glm::quat const q = glm::normalize( glm::quat_cast( glm::mat3( aCamera2World ) ) );
+	glm::vec3 const p = aCamera2World[3];
+
+	char line[256];
+	std::snprintf( line, sizeof(line), "%g  %.9g %.9g %.9g  %.9g %.9g %.9g %.9g",
+		aTime, p.x, p.y, p.z, q.w, q.x, q.y, q.z
+	);
+
+	return line;
+}
+
+
+double percentile( std::vector<double> aValues, double aPercent )
+{
+	aValues.erase( std::remove_if( aValues.begin(), aValues.end(), [] (double aX) { return aX < 0.0; } ), aValues.end() );
+	if( aValues.empty() )
+		return -1.0;
+
+	std::sort( aValues.begin(), aValues.end() );
+
+	// Nearest rank: the smallest value that at least aPercent of the values
+	// are less than or equal to
+	auto const n = aValues.size();
+	auto rank = std::size_t(std::ceil( aPercent / 100.0 * double(n) ));
+	rank = std::clamp<std::size_t>( rank, 1, n );
+
+	return aValues[rank-1];
+}
+
+void write_benchmark_csv( char const* aPath, std::vector<FrameSample> const& aSamples )
+{
+	FilePtr_ file( std::fopen( aPath, "w" ), &std::fclose );
+	if( !file )
+		throw lut::Error( "%s: unable to open for writing", aPath );
+
+	auto* const out = file.get();
+
+	std::fprintf( out, "frame,frame_ms,cpu_ms,gpu_ms,draws,triangles\n" );
+	for( std::size_t i = 0; i < aSamples.size(); ++i )
+	{
+		auto const& sample = aSamples[i];
+
+		std::fprintf( out, "%zu,", i );
+		write_ms_( out, sample.frameMs );
+		write_ms_( out, sample.cpuMs );
+		write_ms_( out, sample.gpuMs );
+		std::fprintf( out, "%llu,%llu\n", (unsigned long long)sample.draws, (unsigned long long)sample.triangles );
+	}
+
+	if( std::ferror( out ) )
+		throw lut::Error( "%s: unable to write benchmark results", aPath );
+}
+
+void print_benchmark_summary( std::vector<FrameSample> const& aSamples )
+{
+	// Times in ms, with three decimals; counts without
+	auto const print_ = [&] (char const* aName, Percentiles_ const& aP, bool aTime) {
+		if( aP.p[0] < 0.0 )
+		{
+			std::printf( "  %-9s unavailable\n", aName );
+			return;
+		}
+
+		int const decimals = aTime ? 3 : 0;
+		std::printf( "  %-9s p50 %10.*f  p95 %10.*f  p99 %10.*f%s\n", aName,
+			decimals, aP.p[0], decimals, aP.p[1], decimals, aP.p[2], aTime ? " ms" : "" );
+	};
+
+	std::printf( "Benchmark: %zu frames\n", aSamples.size() );
+	print_( "frame", percentiles_( aSamples, [] (FrameSample const& aX) { return aX.frameMs; } ), true );
+	print_( "CPU", percentiles_( aSamples, [] (FrameSample const& aX) { return aX.cpuMs; } ), true );
+	print_( "GPU", percentiles_( aSamples, [] (FrameSample const& aX) { return aX.gpuMs; } ), true );
+	print_( "draws", percentiles_( aSamples, [] (FrameSample const& aX) { return double(aX.draws); } ), false );
+	print_( "triangles", percentiles_( aSamples, [] (FrameSample const& aX) { return double(aX.triangles); } ), false );
+}
+
+namespace
+{
+	template< typename tGetter >
+	Percentiles_ percentiles_( std::vector<FrameSample> const& aSamples, tGetter&& aGetter )
+	{
+		std::vector<double> values;
+		values.reserve( aSamples.size() );
+		for( auto const& sample : aSamples )
+			values.emplace_back( aGetter( sample ) );
+
+		Percentiles_ ret;
+		for( std::size_t i = 0; i < 3; ++i )
+			ret.p[i] = percentile( values, kPercentiles_[i] );
+
+		return ret;
+	}
+
+	void write_ms_( FILE* aOut, double aMs )
+	{
+		if( aMs >= 0.0 )
+			std::fprintf( aOut, "%.4f,", aMs );
+		else
+			std::fprintf( aOut, "," );
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef BENCHMARK_HPP_71778EEC_57CF_4ADD_8024_F208A79ED8DC
+#define BENCHMARK_HPP_71778EEC_57CF_4ADD_8024_F208A79ED8DC
+
+#include <string>
+#include <vector>
+
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Frame benchmarks. Instead of following user input, the camera plays a
+// recorded path over a fixed number of frames, so that runs are repeatable
+// and their frame times can be compared (e.g., across commits). Nothing in
+// here touches Vulkan.
+//
+// Camera path files are text, one keyframe per line; '#' starts a comment:
+//
+//   time  x y z  yaw pitch       (degrees)
+//   time  x y z  qw qx qy qz     (camera-to-world rotation)
+//
+// Times increase from line to line, in arbitrary units: the path is
+// stretched over the benchmark's frames. Positions are interpolated linearly
+// and orientations spherically. The camera looks along -z; yaw rotates about
+// the world's y axis, then pitch about the camera's x axis. Press K in the
+// interactive viewer to print the current camera as a keyframe.
+
+struct CameraKeyframe
+{
+	float time;
+	glm::vec3 position;
+	glm::quat orientation;
+};
+
+struct CameraPath
+{
+	std::vector<CameraKeyframe> keyframes; // at least one, by time
+};
+
+// aSourceName is used in error messages
+CameraPath parse_camera_path( char const* aText, char const* aSourceName );
+CameraPath load_camera_path( char const* aPath );
+
+// Camera-to-world matrix at aTime; clamped to the path's first and last
+// keyframes
+glm::mat4 sample_camera_path( CameraPath const&, float aTime );
+
+// Path time of frame aFrame of aFrameCount, spreading the frames evenly from
+// the first to the last keyframe
+float camera_path_time( CameraPath const&, std::uint32_t aFrame, std::uint32_t aFrameCount );
+
+// Keyframe line (quaternion form) of the camera aCamera2World
+std::string format_camera_keyframe( float aTime, glm::mat4 const& aCamera2World );
+
+
+// Measurements of one frame. Draws and triangles are those recorded on the
+// CPU (see CullStats).
+struct FrameSample
+{
+	double frameMs = 0.0; // whole frame on the CPU, including waits
+	double cpuMs = 0.0;   // CPU work: update, culling, recording, submission
+	double gpuMs = -1.0;  // command buffer on the GPU; negative if unknown
+
+	std::uint64_t draws = 0;
+	std::uint64_t triangles = 0;
+};
+
+// Nearest-rank percentile (aPercent in [0, 100]) of the non-negative values;
+// negative if there are none
+double percentile( std::vector<double> aValues, double aPercent );
+
+// One row per frame; unknown times are left empty. The percentiles are
+// only printed, by print_benchmark_summary().
+void write_benchmark_csv( char const* aPath, std::vector<FrameSample> const& );
+
+// p50, p95 and p99 of each measurement, to stdout
+void print_benchmark_summary( std::vector<FrameSample> const& );
+
+#endif // BENCHMARK_HPP_71778EEC_57CF_4ADD_8024_F208A79ED8DC
@@ -0,0 +1,246 @@
+#include "bindless.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "../labutils/error.hpp"
+#include "../labutils/to_string.hpp"
+
+namespace
+{
+	template< typename tRecord >
+	lut::Buffer create_record_buffer_( lut::Allocator const& aAllocator, lut::UploadBatcher& aUploader, std::vector<tRecord> const& aRecords )
+	{
+		auto const bytes = aRecords.size() * sizeof(tRecord);
+
+		// Zero-sized buffers are not allowed
+		auto ret = lut::create_buffer(
+			aAllocator,
+			std::max<VkDeviceSize>( bytes, sizeof(tRecord) ),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_ONLY
+		);
+
+		if( !aRecords.empty() )
+			aUploader.upload_buffer( ret.buffer, 0, aRecords.data(), bytes );
+
+		return ret;
+	}
+}
+
+bool bindless_supported( VkPhysicalDevice aPhysicalDev, std::uint32_t aTextureCount )
+{
+	VkPhysicalDeviceVulkan12Features features12{};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &features12;
+	vkGetPhysicalDeviceFeatures2( aPhysicalDev, &features );
+
+	if( !features.features.shaderSampledImageArrayDynamicIndexing || !features12.runtimeDescriptorArray || !features12.descriptorBindingPartiallyBound )
+		return false;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties( aPhysicalDev, &props );
+
+	return aTextureCount <= props.limits.maxPerStageDescriptorSampledImages
+		&& aTextureCount <= props.limits.maxDescriptorSetSampledImages
+	;
+}
+
+std::vector<BindlessMaterial> make_bindless_materials( BakedModel const& aModel, std::uint32_t aFlatNormalMapId )
+{
+	std::vector<BindlessMaterial> ret;
+	ret.reserve( aModel.materials.size() );
+
+	for( auto const& mat : aModel.materials )
+	{
+		BindlessMaterial bm{};
+		bm.baseColor = mat.baseColorTextureId;
+		bm.roughness = mat.roughnessTextureId;
+		bm.metalness = mat.metalnessTextureId;
+		bm.alphaMask = mat.alphaMaskTextureId;
+		bm.normalMap = 0xffffffff != mat.normalMapTextureId ? mat.normalMapTextureId : aFlatNormalMapId;
+		bm.flags = mat.packedRma ? kBindlessMaterialPackedRma : 0;
+
+		ret.emplace_back( bm );
+	}
+
+	return ret;
+}
+
+std::vector<BindlessMesh> make_bindless_meshes( BakedModel const& aModel, std::vector<SceneMesh> const& aMeshes )
+{
+	assert( aModel.meshes.size() == aMeshes.size() );
+
+	std::vector<BindlessMesh> ret;
+	ret.reserve( aMeshes.size() );
+
+	for( std::size_t i = 0; i < aMeshes.size(); ++i )
+	{
+		BindlessMesh bm{};
+		for( int j = 0; j < 3; ++j )
+		{
+			bm.positionOffset[j] = aMeshes[i].positionOffset[j];
+			bm.positionScale[j] = aMeshes[i].positionScale[j];
+		}
+		bm.positionScale[3] = 1.f;
+		bm.materialId = aModel.meshes[i].materialId;
+		bm.firstIndex = aMeshes[i].firstIndex;
+		bm.vertexOffset = aMeshes[i].vertexOffset;
+
+		ret.emplace_back( bm );
+	}
+
+	return ret;
+}
+
+lut::DescriptorSetLayout create_bindless_layout( lut::VulkanContext const& aContext, std::uint32_t aTextureCount )
+{
+	assert( aTextureCount > 0 );
+
+	VkDescriptorSetLayoutBinding bindings[3]{};
+	bindings[0].binding = 0; // this must match the shaders
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	bindings[0].descriptorCount = aTextureCount;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[1].binding = 1;
+	bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[1].descriptorCount = 1;
+	bindings[1].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	bindings[2].binding = 2;
+	bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	bindings[2].descriptorCount = 1;
+	bindings[2].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	// Not every slot needs a texture (e.g., the flat normal map is only
+	// created on demand)
+	VkDescriptorBindingFlags const bindingFlags[3] = { VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT, 0, 0 };
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+	flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	flagsInfo.bindingCount = sizeof(bindingFlags) / sizeof(bindingFlags[0]);
+	flagsInfo.pBindingFlags = bindingFlags;
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &flagsInfo;
+	layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+	layoutInfo.pBindings = bindings;
+
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorSetLayout( aContext.device, &layoutInfo, nullptr, &layout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create bindless descriptor set layout\n"
+			"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	return lut::DescriptorSetLayout( aContext.device, layout );
+}
+
+lut::Buffer create_material_buffer( lut::Allocator const& aAllocator, lut::UploadBatcher& aUploader, std::vector<BindlessMaterial> const& aMaterials )
+{
+	return create_record_buffer_( aAllocator, aUploader, aMaterials );
+}
+
+lut::Buffer create_mesh_buffer( lut::Allocator const& aAllocator, lut::UploadBatcher& aUploader, std::vector<BindlessMesh> const& aMeshes )
+{
+	return create_record_buffer_( aAllocator, aUploader, aMeshes );
+}
+
+BindlessSet create_bindless_set( lut::VulkanContext const& aContext, VkDescriptorSetLayout aLayout, std::vector<VkImageView> const& aTextureViews, VkSampler aSampler, VkBuffer aMaterials, VkBuffer aMeshes )
+{
+	assert( !aTextureViews.empty() );
+
+	BindlessSet ret;
+
+	VkDescriptorPoolSize const pools[] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, std::uint32_t(aTextureViews.size()) },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = sizeof(pools) / sizeof(pools[0]);
+	poolInfo.pPoolSizes = pools;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorPool( aContext.device, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create bindless descriptor pool\n"
+			"vkCreateDescriptorPool() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.pool = lut::DescriptorPool( aContext.device, pool );
+
+	VkDescriptorSetAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocInfo.descriptorPool = ret.pool.handle;
+	allocInfo.descriptorSetCount = 1;
+	allocInfo.pSetLayouts = &aLayout;
+
+	if( auto const res = vkAllocateDescriptorSets( aContext.device, &allocInfo, &ret.set ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to allocate bindless descriptor set\n"
+			"vkAllocateDescriptorSets() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	// One write per contiguous run of views, skipping missing ones
+	std::vector<VkDescriptorImageInfo> imageInfos( aTextureViews.size() );
+	std::vector<VkWriteDescriptorSet> writes;
+
+	for( std::size_t i = 0; i < aTextureViews.size(); ++i )
+	{
+		if( VK_NULL_HANDLE == aTextureViews[i] )
+			continue;
+
+		imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfos[i].imageView = aTextureViews[i];
+		imageInfos[i].sampler = aSampler;
+
+		if( !writes.empty() && writes.back().dstArrayElement + writes.back().descriptorCount == i )
+		{
+			++writes.back().descriptorCount;
+			continue;
+		}
+
+		auto& write = writes.emplace_back();
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = ret.set;
+		write.dstBinding = 0;
+		write.dstArrayElement = std::uint32_t(i);
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.descriptorCount = 1;
+		write.pImageInfo = &imageInfos[i];
+	}
+
+	// Material records (binding 1) and mesh records (binding 2)
+	VkDescriptorBufferInfo bufferInfos[2]{};
+	bufferInfos[0].buffer = aMaterials;
+	bufferInfos[0].range = VK_WHOLE_SIZE;
+	bufferInfos[1].buffer = aMeshes;
+	bufferInfos[1].range = VK_WHOLE_SIZE;
+
+	for( std::uint32_t i = 0; i < 2; ++i )
+	{
+		auto& write = writes.emplace_back();
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = ret.set;
+		write.dstBinding = 1 + i;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets( aContext.device, std::uint32_t(writes.size()), writes.data(), 0, nullptr );
+
+	return ret;
+}
@@ -0,0 +1,114 @@
+#ifndef BINDLESS_HPP_9C4E27A1_3B6D_4F82_A0E5_D81F63B29C47
+#define BINDLESS_HPP_9C4E27A1_3B6D_4F82_A0E5_D81F63B29C47
+
+#include <vector>
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "../labutils/upload.hpp"
+#include "../labutils/vkobject.hpp"
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/vulkan_context.hpp"
+namespace lut = labutils;
+
+#include "baked_model.hpp"
+#include "geometry_arena.hpp"
+
+// Bindless materials: a single descriptor set holds all texture views in
+// one array (binding 0), the material records in a storage buffer (binding
+// 1) and per-mesh records in another one (binding 2). Each draw passes its
+// mesh ID as firstInstance; the vertex shader looks up the mesh record with
+// gl_InstanceIndex and forwards the mesh's material index to the fragment
+// shader. Thus, switching meshes or materials neither rebinds descriptors
+// nor pushes constants, all material pipelines share one pipeline layout,
+// and draws can be issued indirectly (see indirect.hpp).
+//
+// Requires descriptor indexing (runtimeDescriptorArray and
+// descriptorBindingPartiallyBound), which make_vulkan_window() enables when
+// available. Texture indices are dynamically uniform (one material per
+// draw) unless noted otherwise in a shader.
+
+// Set index of the bindless set; set 0 holds the scene uniforms
+constexpr std::uint32_t kBindlessSet = 1;
+
+enum BindlessMaterialFlags : std::uint32_t
+{
+	// roughness == metalness (== alphaMask) refers to one texture holding
+	// roughness (R), metalness (G) and alpha mask (B)
+	kBindlessMaterialPackedRma = 1
+};
+
+// One material record in the storage buffer (std430). Texture fields index
+// the texture array; alphaMask is 0xffffffff without an alpha mask.
+struct BindlessMaterial
+{
+	std::uint32_t baseColor;
+	std::uint32_t roughness;
+	std::uint32_t metalness;
+	std::uint32_t alphaMask;
+	std::uint32_t normalMap;
+	std::uint32_t flags; // BindlessMaterialFlags
+	std::uint32_t reserved[2];
+};
+
+static_assert( sizeof(BindlessMaterial) == 32 );
+
+// One mesh record in the storage buffer (std430). positionOffset and
+// positionScale dequantize packed positions (see SceneMesh); w is unused.
+// firstIndex and vertexOffset locate the mesh in the geometry arena, for
+// shaders that fetch vertices themselves (see visibility.hpp).
+struct BindlessMesh
+{
+	float positionOffset[4];
+	float positionScale[4];
+	std::uint32_t materialId;
+	std::uint32_t firstIndex;
+	std::int32_t vertexOffset;
+	std::uint32_t reserved[1];
+};
+
+static_assert( sizeof(BindlessMesh) == 48 );
+
+// Whether the device supports the features above, and enough sampled images
+// per stage for aTextureCount textures.
+bool bindless_supported( VkPhysicalDevice, std::uint32_t aTextureCount );
+
+// Material records of aModel. Materials without a normal map use the
+// texture at aFlatNormalMapId.
+std::vector<BindlessMaterial> make_bindless_materials( BakedModel const&, std::uint32_t aFlatNormalMapId );
+
+// Mesh records of aModel, whose meshes are at aMeshes in the geometry arena
+std::vector<BindlessMesh> make_bindless_meshes( BakedModel const&, std::vector<SceneMesh> const& aMeshes );
+
+// Layout of the bindless set, for up to aTextureCount textures
+lut::DescriptorSetLayout create_bindless_layout( lut::VulkanContext const&, std::uint32_t aTextureCount );
+
+// Creates the material buffer and records its upload into aUploader. The
+// buffer may only be used once the upload has been submitted.
+lut::Buffer create_material_buffer( lut::Allocator const&, lut::UploadBatcher&, std::vector<BindlessMaterial> const& );
+
+// Same, for the mesh records
+lut::Buffer create_mesh_buffer( lut::Allocator const&, lut::UploadBatcher&, std::vector<BindlessMesh> const& );
+
+struct BindlessSet
+{
+	lut::DescriptorPool pool;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+};
+
+// Allocates and fills the bindless set. Views that are VK_NULL_HANDLE are
+// left unwritten (the binding is partially bound); the materials must not
+// reference them.
+BindlessSet create_bindless_set(
+	lut::VulkanContext const&,
+	VkDescriptorSetLayout,
+	std::vector<VkImageView> const& aTextureViews,
+	VkSampler,
+	VkBuffer aMaterials,
+	VkBuffer aMeshes
+);
+
+#endif // BINDLESS_HPP_9C4E27A1_3B6D_4F82_A0E5_D81F63B29C47
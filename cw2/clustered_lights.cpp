@@ -0,0 +1,393 @@
+#include "clustered_lights.hpp"
+
+#include <limits>
+#include <random>
+#include <algorithm>
+#include <initializer_list>
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+#include "../labutils/to_string.hpp"
+
+namespace
+{
+	// Must match local_size_x in clusters.comp
+	constexpr std::uint32_t kAssignGroupSize = 64;
+
+	constexpr std::uint32_t kClusterBindingCount = 4;
+
+	glm::vec3 view_ray_( LightClusterUniform const& aUniform, float aNdcX, float aNdcY )
+	{
+		auto const p = aUniform.inverseProjection * glm::vec4( aNdcX, aNdcY, 1.f, 1.f );
+		auto const v = glm::vec3( p ) / p.w;
+		return v / -v.z;
+	}
+
+	glm::vec3 hue_( float aHue )
+	{
+		// Fully saturated color with the given hue in [0, 1)
+		auto const h = aHue * 6.f;
+		return glm::clamp( glm::vec3(
+			std::abs( h - 3.f ) - 1.f,
+			2.f - std::abs( h - 2.f ),
+			2.f - std::abs( h - 4.f )
+		), 0.f, 1.f );
+	}
+}
+
+std::vector<PointLight> make_random_lights( std::uint32_t aCount, glm::vec3 const& aMin, glm::vec3 const& aMax, float aCoverage, std::uint32_t aSeed )
+{
+	std::vector<PointLight> ret;
+	if( 0 == aCount )
+		return ret;
+
+	ret.reserve( aCount );
+
+	// The distributions of <random> differ between standard libraries; the
+	// engines do not
+	std::minstd_rand rng( aSeed );
+	auto const uniform_ = [&] {
+		return float(rng() - std::minstd_rand::min()) / float(std::minstd_rand::max() - std::minstd_rand::min());
+	};
+
+	// aCount * 4/3 pi r^3 = aCoverage * volume
+	auto const extent = glm::max( aMax - aMin, glm::vec3( 1e-3f ) );
+	auto const volume = extent.x * extent.y * extent.z;
+	auto const radius = std::cbrt( 3.f * aCoverage * volume / (4.f * 3.14159265f * aCount) );
+
+	// Intensity such that the light is roughly 1 at a quarter of its radius
+	auto const intensity = radius * radius / 16.f + 1.f;
+
+	for( std::uint32_t i = 0; i < aCount; ++i )
+	{
+		PointLight light{};
+
+		auto const x = uniform_(), y = uniform_(), z = uniform_();
+		light.positionRadius = glm::vec4( aMin + extent * glm::vec3( x, y, z ), radius );
+		light.color = glm::vec4( hue_( uniform_() ) * intensity, 0.f );
+
+		ret.emplace_back( light );
+	}
+
+	return ret;
+}
+
+void model_bounds( BakedModel const& aModel, glm::vec3& aMin, glm::vec3& aMax )
+{
+	aMin = glm::vec3( std::numeric_limits<float>::max() );
+	aMax = glm::vec3( -std::numeric_limits<float>::max() );
+
+	bool any = false;
+	for( auto const& mesh : aModel.meshes )
+	{
+		if( !mesh.hasBounds )
+			continue;
+
+		aMin = glm::min( aMin, mesh.aabbMin );
+		aMax = glm::max( aMax, mesh.aabbMax );
+		any = true;
+	}
+
+	if( !any )
+	{
+		aMin = glm::vec3( -1.f );
+		aMax = glm::vec3( 1.f );
+	}
+}
+
+LightClusterUniform make_light_cluster_uniform( glm::mat4 const& aCamera, glm::mat4 const& aProjection, float aNear, float aFar, std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aLightCount )
+{
+	assert( aNear > 0.f && aFar > aNear );
+
+	LightClusterUniform ret{};
+	ret.camera = aCamera;
+	ret.inverseProjection = glm::inverse( aProjection );
+	ret.screen = glm::vec4( float(aWidth), float(aHeight), aNear, aFar );
+
+	// slice = Z * log(depth/near) / log(far/near)
+	auto const logRatio = std::log( aFar / aNear );
+	ret.slices.x = float(kLightClustersZ) / logRatio;
+	ret.slices.y = -float(kLightClustersZ) * std::log( aNear ) / logRatio;
+
+	ret.lightCount = aLightCount;
+	return ret;
+}
+
+void light_cluster_bounds( LightClusterUniform const& aUniform, std::uint32_t aX, std::uint32_t aY, std::uint32_t aZ, glm::vec3& aMin, glm::vec3& aMax )
+{
+	assert( aX < kLightClustersX && aY < kLightClustersY && aZ < kLightClustersZ );
+
+	auto const x0 = float(aX) / kLightClustersX * 2.f - 1.f, x1 = float(aX+1) / kLightClustersX * 2.f - 1.f;
+	auto const y0 = float(aY) / kLightClustersY * 2.f - 1.f, y1 = float(aY+1) / kLightClustersY * 2.f - 1.f;
+
+	auto const zNear = aUniform.screen.z, zFar = aUniform.screen.w;
+	auto const depth0 = zNear * std::pow( zFar / zNear, float(aZ) / kLightClustersZ );
+	auto const depth1 = zNear * std::pow( zFar / zNear, float(aZ+1) / kLightClustersZ );
+
+	glm::vec3 const rays[4] = {
+		view_ray_( aUniform, x0, y0 ),
+		view_ray_( aUniform, x1, y0 ),
+		view_ray_( aUniform, x0, y1 ),
+		view_ray_( aUniform, x1, y1 )
+	};
+
+	aMin = glm::vec3( std::numeric_limits<float>::max() );
+	aMax = glm::vec3( -std::numeric_limits<float>::max() );
+	for( auto const& ray : rays )
+	{
+		aMin = glm::min( aMin, glm::min( ray * depth0, ray * depth1 ) );
+		aMax = glm::max( aMax, glm::max( ray * depth0, ray * depth1 ) );
+	}
+}
+
+std::uint32_t light_cluster_index( LightClusterUniform const& aUniform, glm::vec2 const& aFragCoord, glm::vec3 const& aWorldPos )
+{
+	auto const x = std::min( std::uint32_t(aFragCoord.x * kLightClustersX / aUniform.screen.x), kLightClustersX-1 );
+	auto const y = std::min( std::uint32_t(aFragCoord.y * kLightClustersY / aUniform.screen.y), kLightClustersY-1 );
+
+	auto const depth = -(aUniform.camera * glm::vec4( aWorldPos, 1.f )).z;
+	auto const slice = std::floor( std::log( std::max( depth, 1e-6f ) ) * aUniform.slices.x + aUniform.slices.y );
+	auto const z = std::uint32_t(std::clamp( slice, 0.f, float(kLightClustersZ-1) ));
+
+	return (z * kLightClustersY + y) * kLightClustersX + x;
+}
+
+LightClusterLists assign_lights( LightClusterUniform const& aUniform, std::vector<PointLight> const& aLights )
+{
+	assert( aUniform.lightCount <= aLights.size() );
+
+	// View space spheres
+	std::vector<glm::vec4> spheres;
+	spheres.reserve( aUniform.lightCount );
+
+	for( std::uint32_t i = 0; i < aUniform.lightCount; ++i )
+	{
+		auto const& pr = aLights[i].positionRadius;
+		spheres.emplace_back( glm::vec3( aUniform.camera * glm::vec4( glm::vec3( pr ), 1.f ) ), pr.w );
+	}
+
+	LightClusterLists ret;
+	ret.counts.assign( kLightClusterCount, 0 );
+	ret.indices.assign( std::size_t(kLightClusterCount) * kMaxLightsPerCluster, 0 );
+
+	for( std::uint32_t cluster = 0; cluster < kLightClusterCount; ++cluster )
+	{
+		glm::vec3 bmin, bmax;
+		light_cluster_bounds( aUniform,
+			cluster % kLightClustersX,
+			(cluster / kLightClustersX) % kLightClustersY,
+			cluster / (kLightClustersX * kLightClustersY),
+			bmin, bmax
+		);
+
+		auto& count = ret.counts[cluster];
+		for( std::uint32_t i = 0; i < spheres.size() && count < kMaxLightsPerCluster; ++i )
+		{
+			auto const center = glm::vec3( spheres[i] );
+			auto const d = center - glm::clamp( center, bmin, bmax );
+			if( glm::dot( d, d ) > spheres[i].w * spheres[i].w )
+				continue;
+
+			ret.indices[std::size_t(cluster) * kMaxLightsPerCluster + count++] = i;
+		}
+	}
+
+	return ret;
+}
+
+lut::DescriptorSetLayout create_light_cluster_layout( lut::VulkanContext const& aContext )
+{
+	// parameters, lights, counts, indices
+	VkDescriptorSetLayoutBinding bindings[kClusterBindingCount]{};
+	for( std::uint32_t i = 0; i < kClusterBindingCount; ++i )
+	{
+		bindings[i].binding = i; // this must match the shaders
+		bindings[i].descriptorType = 0 == i ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.bindingCount = kClusterBindingCount;
+	layoutInfo.pBindings = bindings;
+
+	VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorSetLayout( aContext.device, &layoutInfo, nullptr, &layout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create light cluster descriptor set layout\n"
+			"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	return lut::DescriptorSetLayout( aContext.device, layout );
+}
+
+ClusteredLights create_clustered_lights( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, lut::UploadBatcher& aUploader, VkDescriptorSetLayout aClusterLayout, std::vector<PointLight> const& aLights, char const* aAssignShaderPath )
+{
+	ClusteredLights ret;
+	ret.lightCount = std::uint32_t(aLights.size());
+
+	// Pipeline
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &aClusterLayout;
+
+	VkPipelineLayout pipeLayout = VK_NULL_HANDLE;
+	if( auto const res = vkCreatePipelineLayout( aContext.device, &layoutInfo, nullptr, &pipeLayout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create light assignment pipeline layout\n"
+			"vkCreatePipelineLayout() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.assignPipeLayout = lut::PipelineLayout( aContext.device, pipeLayout );
+
+	lut::ShaderModule shader = lut::load_shader_module( aContext, aAssignShaderPath );
+
+	VkComputePipelineCreateInfo pipeInfo{};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeInfo.stage.module = shader.handle;
+	pipeInfo.stage.pName = "main";
+	pipeInfo.layout = ret.assignPipeLayout.handle;
+
+	VkPipeline pipe = VK_NULL_HANDLE;
+	if( auto const res = vkCreateComputePipelines( aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create compute pipeline '%s'\n"
+			"vkCreateComputePipelines() returned %s", aAssignShaderPath, lut::to_string(res).c_str()
+		);
+	}
+
+	ret.assignPipe = lut::Pipeline( aContext.device, pipe );
+
+	// Buffers. Zero-sized buffers are not allowed.
+	auto const lightBytes = aLights.size() * sizeof(PointLight);
+	ret.lights = lut::create_buffer(
+		aAllocator,
+		std::max<VkDeviceSize>( lightBytes, sizeof(PointLight) ),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	if( !aLights.empty() )
+		aUploader.upload_buffer( ret.lights.buffer, 0, aLights.data(), lightBytes );
+
+	ret.uniforms = lut::create_buffer(
+		aAllocator,
+		sizeof(LightClusterUniform),
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	ret.counts = lut::create_buffer(
+		aAllocator,
+		kLightClusterCount * sizeof(std::uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	ret.indices = lut::create_buffer(
+		aAllocator,
+		VkDeviceSize(kLightClusterCount) * kMaxLightsPerCluster * sizeof(std::uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	// Descriptors
+	VkDescriptorPoolSize const pools[] = {
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, kClusterBindingCount - 1 }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = sizeof(pools) / sizeof(pools[0]);
+	poolInfo.pPoolSizes = pools;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorPool( aContext.device, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create light cluster descriptor pool\n"
+			"vkCreateDescriptorPool() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.pool = lut::DescriptorPool( aContext.device, pool );
+	ret.set = lut::alloc_desc_set( aContext, ret.pool.handle, aClusterLayout );
+
+	VkBuffer const buffers[kClusterBindingCount] = {
+		ret.uniforms.buffer,
+		ret.lights.buffer,
+		ret.counts.buffer,
+		ret.indices.buffer
+	};
+
+	VkDescriptorBufferInfo bufferInfos[kClusterBindingCount]{};
+	VkWriteDescriptorSet writes[kClusterBindingCount]{};
+	for( std::uint32_t i = 0; i < kClusterBindingCount; ++i )
+	{
+		bufferInfos[i].buffer = buffers[i];
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = ret.set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorType = 0 == i ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].descriptorCount = 1;
+		writes[i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets( aContext.device, kClusterBindingCount, writes, 0, nullptr );
+
+	return ret;
+}
+
+void record_light_assignment( VkCommandBuffer aCmdBuff, ClusteredLights const& aLights, LightClusterUniform const& aUniform )
+{
+	assert( aUniform.lightCount == aLights.lightCount );
+
+	// The previous frame's assignment and fragment shaders read the
+	// parameters and lists
+	lut::buffer_barrier( aCmdBuff, aLights.uniforms.buffer,
+		VK_ACCESS_UNIFORM_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT
+	);
+
+	vkCmdUpdateBuffer( aCmdBuff, aLights.uniforms.buffer, 0, sizeof(LightClusterUniform), &aUniform );
+
+	lut::buffer_barrier( aCmdBuff, aLights.uniforms.buffer,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+	);
+
+	for( auto const buffer : { aLights.counts.buffer, aLights.indices.buffer } )
+	{
+		lut::buffer_barrier( aCmdBuff, buffer,
+			VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+		);
+	}
+
+	vkCmdBindPipeline( aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aLights.assignPipe.handle );
+	vkCmdBindDescriptorSets( aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aLights.assignPipeLayout.handle, 0, 1, &aLights.set, 0, nullptr );
+
+	vkCmdDispatch( aCmdBuff, (kLightClusterCount + kAssignGroupSize - 1) / kAssignGroupSize, 1, 1 );
+
+	for( auto const buffer : { aLights.counts.buffer, aLights.indices.buffer } )
+	{
+		lut::buffer_barrier( aCmdBuff, buffer,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+		);
+	}
+}
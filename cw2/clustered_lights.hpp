@@ -0,0 +1,153 @@
+#ifndef CLUSTERED_LIGHTS_HPP_E3574421_E80D_4296_8A17_66B273B2073F
+#define CLUSTERED_LIGHTS_HPP_E3574421_E80D_4296_8A17_66B273B2073F
+
+#include <vector>
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "../labutils/upload.hpp"
+#include "../labutils/vkobject.hpp"
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/vulkan_context.hpp"
+namespace lut = labutils;
+
+#include "baked_model.hpp"
+
+// Clustered forward lighting. The view frustum is divided into a grid of
+// clusters (froxels): kLightClustersX by kLightClustersY tiles in screen
+// space, and kLightClustersZ slices in view space depth. The slices are
+// spaced exponentially between the near and far planes, so that clusters
+// are roughly cubical.
+//
+// Each frame, before the render pass, clusters.comp assigns the point lights
+// to the clusters that their spheres of influence overlap, and writes one
+// list of light indices per cluster. The lighting shaders find the cluster
+// of each fragment (see clustered_lights.glsl) and only loop over its list.
+//
+// assign_lights() is the CPU reference of clusters.comp, and
+// light_cluster_index() that of the lookup in the shaders. They produce the
+// same lists, up to floating point differences.
+
+constexpr std::uint32_t kLightClustersX = 16;
+constexpr std::uint32_t kLightClustersY = 9;
+constexpr std::uint32_t kLightClustersZ = 24;
+constexpr std::uint32_t kLightClusterCount = kLightClustersX * kLightClustersY * kLightClustersZ;
+
+// Lights beyond this many in a cluster are dropped, in index order. Must
+// match clusters.comp.
+constexpr std::uint32_t kMaxLightsPerCluster = 128;
+
+// Point light in the lights storage buffer (std430). The light falls off
+// smoothly to zero at its radius.
+struct PointLight
+{
+	glm::vec4 positionRadius; // xyz: world space position, w: radius
+	glm::vec4 color;          // rgb: intensity, w: unused
+};
+
+static_assert( sizeof(PointLight) == 32 );
+
+// Benchmark scene: aCount lights at random positions in the given box, with
+// random hues. The radius is chosen such that the lights' spheres together
+// cover the box about aCoverage times. Deterministic for a given aSeed.
+std::vector<PointLight> make_random_lights(
+	std::uint32_t aCount,
+	glm::vec3 const& aMin,
+	glm::vec3 const& aMax,
+	float aCoverage = 4.f,
+	std::uint32_t aSeed = 1
+);
+
+// Bounding box of all meshes with bounds; a unit box if there are none
+void model_bounds( BakedModel const&, glm::vec3& aMin, glm::vec3& aMax );
+
+// Per-frame parameters of clusters.comp and the lighting shaders (std140)
+struct LightClusterUniform
+{
+	glm::mat4 camera;            // world to view
+	glm::mat4 inverseProjection; // clip to view
+
+	glm::vec4 screen; // xy: framebuffer size in pixels, zw: near, far
+	glm::vec4 slices; // x: scale, y: bias; slice = log(depth) * x + y
+
+	std::uint32_t lightCount;
+	std::uint32_t pad[3];
+};
+
+static_assert( sizeof(LightClusterUniform) == 176 );
+
+// aProjection must map view space depth [aNear, aFar] to [0, 1] (e.g.,
+// glm::perspectiveRH_ZO(), optionally with a mirrored Y axis)
+LightClusterUniform make_light_cluster_uniform(
+	glm::mat4 const& aCamera,
+	glm::mat4 const& aProjection,
+	float aNear, float aFar,
+	std::uint32_t aWidth, std::uint32_t aHeight,
+	std::uint32_t aLightCount
+);
+
+// View space bounding box of one cluster
+void light_cluster_bounds( LightClusterUniform const&, std::uint32_t aX, std::uint32_t aY, std::uint32_t aZ, glm::vec3& aMin, glm::vec3& aMax );
+
+// Cluster of a fragment at aFragCoord (in pixels, as gl_FragCoord.xy) and
+// aWorldPos. Fragments outside of the slices are clamped to the first or
+// last slice.
+std::uint32_t light_cluster_index( LightClusterUniform const&, glm::vec2 const& aFragCoord, glm::vec3 const& aWorldPos );
+
+// Per-cluster light lists, as in the storage buffers: counts[c] lights for
+// cluster c, at indices[c * kMaxLightsPerCluster ...], in ascending order
+struct LightClusterLists
+{
+	std::vector<std::uint32_t> counts;
+	std::vector<std::uint32_t> indices;
+};
+
+// CPU reference of clusters.comp
+LightClusterLists assign_lights( LightClusterUniform const&, std::vector<PointLight> const& );
+
+struct ClusteredLights
+{
+	lut::PipelineLayout assignPipeLayout;
+	lut::Pipeline assignPipe;
+
+	lut::Buffer lights;
+	lut::Buffer uniforms;
+	lut::Buffer counts;
+	lut::Buffer indices;
+
+	std::uint32_t lightCount = 0;
+
+	// Shared by clusters.comp and the lighting shaders
+	lut::DescriptorPool pool;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+};
+
+// Layout of the set of clusters.comp and the lighting shaders: parameters,
+// lights, counts, indices. The graphics pipeline layouts need it before the
+// lights exist.
+lut::DescriptorSetLayout create_light_cluster_layout( lut::VulkanContext const& );
+
+// Creates the buffers and set for aLights and records the upload of the
+// lights into aUploader
+ClusteredLights create_clustered_lights(
+	lut::VulkanContext const&,
+	lut::Allocator const&,
+	lut::UploadBatcher& aUploader,
+	VkDescriptorSetLayout aClusterLayout,
+	std::vector<PointLight> const& aLights,
+	char const* aAssignShaderPath
+);
+
+// Records the light assignment; call before the render pass. The lists are
+// then visible to fragment shaders.
+void record_light_assignment( VkCommandBuffer, ClusteredLights const&, LightClusterUniform const& );
+
+#endif // CLUSTERED_LIGHTS_HPP_E3574421_E80D_4296_8A17_66B273B2073F
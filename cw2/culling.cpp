@@ -0,0 +1,304 @@
+#include "culling.hpp"
+
+#include <algorithm>
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/glm.hpp>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#	include <emmintrin.h>
+#	define CULLING_SSE_ 1
+#endif
+
+Frustum make_frustum( glm::mat4 const& aProjCam )
+{
+	// GLM matrices are column major; aProjCam[c][r]
+	auto const row_ = [&] (int aRow) {
+		return glm::vec4( aProjCam[0][aRow], aProjCam[1][aRow], aProjCam[2][aRow], aProjCam[3][aRow] );
+	};
+
+	auto const r0 = row_( 0 ), r1 = row_( 1 ), r2 = row_( 2 ), r3 = row_( 3 );
+
+	Frustum ret;
+	ret.planes[Frustum::kLeft] = r3 + r0;
+	ret.planes[Frustum::kRight] = r3 - r0;
+	ret.planes[Frustum::kBottom] = r3 + r1;
+	ret.planes[Frustum::kTop] = r3 - r1;
+	ret.planes[Frustum::kNear] = r2;
+	ret.planes[Frustum::kFar] = r3 - r2;
+
+	for( auto& plane : ret.planes )
+		plane /= glm::length( glm::vec3(plane) );
+
+	return ret;
+}
+
+bool sphere_visible( Frustum const& aFrustum, glm::vec3 const& aCenter, float aRadius ) noexcept
+{
+	for( auto const& plane : aFrustum.planes )
+	{
+		if( glm::dot( glm::vec3(plane), aCenter ) + plane.w < -aRadius )
+			return false;
+	}
+
+	return true;
+}
+
+bool aabb_visible( Frustum const& aFrustum, glm::vec3 const& aMin, glm::vec3 const& aMax ) noexcept
+{
+	auto const center = 0.5f * (aMax + aMin);
+	auto const extent = 0.5f * (aMax - aMin);
+
+	for( auto const& plane : aFrustum.planes )
+	{
+		// Distance of the box corner furthest along the plane's normal
+		glm::vec3 const n( plane );
+		if( glm::dot( n, center ) + glm::dot( glm::abs( n ), extent ) + plane.w < 0.f )
+			return false;
+	}
+
+	return true;
+}
+
+void add_aabb( AabbList& aBoxes, glm::vec3 const& aMin, glm::vec3 const& aMax )
+{
+	if( 0 == aBoxes.count % kAabbBatchSize )
+	{
+		auto const padded = aBoxes.count + kAabbBatchSize;
+		for( auto* arr : { &aBoxes.centerX, &aBoxes.centerY, &aBoxes.centerZ, &aBoxes.extentX, &aBoxes.extentY, &aBoxes.extentZ } )
+			arr->resize( padded, 0.f );
+	}
+
+	auto const center = 0.5f * (aMax + aMin);
+	auto const extent = 0.5f * (aMax - aMin);
+
+	auto const i = aBoxes.count++;
+	aBoxes.centerX[i] = center.x;
+	aBoxes.centerY[i] = center.y;
+	aBoxes.centerZ[i] = center.z;
+	aBoxes.extentX[i] = extent.x;
+	aBoxes.extentY[i] = extent.y;
+	aBoxes.extentZ[i] = extent.z;
+}
+
+std::size_t cull_aabbs( Frustum const& aFrustum, AabbList const& aBoxes, std::uint8_t* aVisible ) noexcept
+{
+	assert( aBoxes.centerX.size() % kAabbBatchSize == 0 );
+	assert( aBoxes.centerX.size() >= aBoxes.count );
+
+	std::size_t visible = 0;
+	for( std::size_t i = 0; i < aBoxes.count; i += kAabbBatchSize )
+	{
+#		if defined(CULLING_SSE_)
+		static_assert( 4 == kAabbBatchSize );
+
+		auto const cx = _mm_loadu_ps( aBoxes.centerX.data() + i );
+		auto const cy = _mm_loadu_ps( aBoxes.centerY.data() + i );
+		auto const cz = _mm_loadu_ps( aBoxes.centerZ.data() + i );
+		auto const ex = _mm_loadu_ps( aBoxes.extentX.data() + i );
+		auto const ey = _mm_loadu_ps( aBoxes.extentY.data() + i );
+		auto const ez = _mm_loadu_ps( aBoxes.extentZ.data() + i );
+
+		auto inside = _mm_castsi128_ps( _mm_set1_epi32( -1 ) );
+		for( auto const& plane : aFrustum.planes )
+		{
+			auto const d = _mm_add_ps(
+				_mm_add_ps(
+					_mm_add_ps( _mm_mul_ps( cx, _mm_set1_ps( plane.x ) ), _mm_mul_ps( cy, _mm_set1_ps( plane.y ) ) ),
+					_mm_add_ps( _mm_mul_ps( cz, _mm_set1_ps( plane.z ) ), _mm_mul_ps( ex, _mm_set1_ps( std::abs( plane.x ) ) ) )
+				),
+				_mm_add_ps(
+					_mm_add_ps( _mm_mul_ps( ey, _mm_set1_ps( std::abs( plane.y ) ) ), _mm_mul_ps( ez, _mm_set1_ps( std::abs( plane.z ) ) ) ),
+					_mm_set1_ps( plane.w )
+				)
+			);
+
+			inside = _mm_and_ps( inside, _mm_cmpge_ps( d, _mm_setzero_ps() ) );
+		}
+
+		auto const mask = unsigned(_mm_movemask_ps( inside ));
+#		else // !CULLING_SSE_
+		unsigned mask = 0;
+		for( std::size_t k = 0; k < kAabbBatchSize; ++k )
+		{
+			glm::vec3 const center( aBoxes.centerX[i+k], aBoxes.centerY[i+k], aBoxes.centerZ[i+k] );
+			glm::vec3 const extent( aBoxes.extentX[i+k], aBoxes.extentY[i+k], aBoxes.extentZ[i+k] );
+			if( aabb_visible( aFrustum, center - extent, center + extent ) )
+				mask |= 1u << k;
+		}
+#		endif // ~ CULLING_SSE_
+
+		auto const n = std::min( kAabbBatchSize, aBoxes.count - i );
+		for( std::size_t k = 0; k < n; ++k )
+		{
+			aVisible[i+k] = std::uint8_t((mask >> k) & 1u);
+			visible += aVisible[i+k];
+		}
+	}
+
+	return visible;
+}
+
+bool cluster_visible( baked::BakedClusterRecordV2 const& aCluster, Frustum const& aFrustum, glm::vec3 const& aCameraPos ) noexcept
+{
+	glm::vec3 const center( aCluster.center[0], aCluster.center[1], aCluster.center[2] );
+	if( !sphere_visible( aFrustum, center, aCluster.radius ) )
+		return false;
+
+	// Every triangle faces away from any viewpoint inside the cone opposite
+	// to the normal cone, widened by the bounding sphere. Degenerate cones
+	// (axis = 0, cutoff = 1) never pass this.
+	glm::vec3 const axis( aCluster.coneAxis[0], aCluster.coneAxis[1], aCluster.coneAxis[2] );
+	auto const view = center - aCameraPos;
+	if( glm::dot( view, axis ) >= aCluster.coneCutoff * glm::length( view ) + aCluster.radius )
+		return false;
+
+	return true;
+}
+
+std::size_t cull_clusters( BakedArray<baked::BakedClusterRecordV2> const& aClusters, Frustum const& aFrustum, glm::vec3 const& aCameraPos, std::vector<IndexRange>& aRanges )
+{
+	auto const firstRange = aRanges.size();
+
+	std::size_t visible = 0;
+	for( std::size_t i = 0; i < aClusters.size(); ++i )
+	{
+		auto const cluster = aClusters[i];
+		if( !cluster_visible( cluster, aFrustum, aCameraPos ) )
+			continue;
+
+		++visible;
+
+		if( aRanges.size() > firstRange )
+		{
+			auto& last = aRanges.back();
+			if( last.firstIndex + last.indexCount == cluster.firstIndex )
+			{
+				last.indexCount += cluster.indexCount;
+				continue;
+			}
+		}
+
+		aRanges.emplace_back( IndexRange{ cluster.firstIndex, cluster.indexCount } );
+	}
+
+	return visible;
+}
+
+void depth_pyramid_footprint( std::uint32_t aTarget, std::uint32_t aSourceSize, std::uint32_t aTargetSize, std::uint32_t& aBegin, std::uint32_t& aEnd ) noexcept
+{
+	assert( aTargetSize > 0 && aTarget < aTargetSize );
+
+	// Rounded outwards, so that the footprint covers [aTarget, aTarget+1)
+	// scaled to the source level
+	aBegin = aTarget * aSourceSize / aTargetSize;
+	aEnd = ((aTarget + 1) * aSourceSize + aTargetSize - 1) / aTargetSize;
+}
+
+DepthPyramid build_depth_pyramid( float const* aDepth, std::uint32_t aWidth, std::uint32_t aHeight )
+{
+	assert( aDepth && aWidth > 0 && aHeight > 0 );
+
+	DepthPyramid ret;
+
+	auto& base = ret.levels.emplace_back();
+	base.width = aWidth;
+	base.height = aHeight;
+	base.depth.assign( aDepth, aDepth + std::size_t(aWidth) * aHeight );
+
+	while( ret.levels.back().width > 1 || ret.levels.back().height > 1 )
+	{
+		auto const& src = ret.levels.back();
+
+		DepthPyramid::Level dst;
+		dst.width = std::max( 1u, src.width / 2 );
+		dst.height = std::max( 1u, src.height / 2 );
+		dst.depth.resize( std::size_t(dst.width) * dst.height );
+
+		for( std::uint32_t y = 0; y < dst.height; ++y )
+		{
+			std::uint32_t y0, y1;
+			depth_pyramid_footprint( y, src.height, dst.height, y0, y1 );
+
+			for( std::uint32_t x = 0; x < dst.width; ++x )
+			{
+				std::uint32_t x0, x1;
+				depth_pyramid_footprint( x, src.width, dst.width, x0, x1 );
+
+				float depth = 0.f;
+				for( auto sy = y0; sy < y1; ++sy )
+				{
+					for( auto sx = x0; sx < x1; ++sx )
+						depth = std::max( depth, src.depth[std::size_t(sy) * src.width + sx] );
+				}
+
+				dst.depth[std::size_t(y) * dst.width + x] = depth;
+			}
+		}
+
+		ret.levels.emplace_back( std::move(dst) );
+	}
+
+	return ret;
+}
+
+bool aabb_unoccluded( DepthPyramid const& aPyramid, glm::mat4 const& aProjCam, glm::vec3 const& aMin, glm::vec3 const& aMax ) noexcept
+{
+	assert( !aPyramid.levels.empty() );
+
+	// Screen rectangle ([0,1] texture coordinates) and nearest depth
+	glm::vec2 rectMin( 1.f ), rectMax( 0.f );
+	float nearest = 1.f;
+
+	for( int i = 0; i < 8; ++i )
+	{
+		glm::vec4 const corner(
+			(i & 1) ? aMax.x : aMin.x,
+			(i & 2) ? aMax.y : aMin.y,
+			(i & 4) ? aMax.z : aMin.z,
+			1.f
+		);
+
+		auto const clip = aProjCam * corner;
+		if( clip.w <= 0.f )
+			return true;
+
+		glm::vec3 const ndc = glm::vec3(clip) / clip.w;
+		if( ndc.z <= 0.f )
+			return true;
+
+		auto const uv = glm::vec2(ndc) * 0.5f + 0.5f;
+		rectMin = glm::min( rectMin, uv );
+		rectMax = glm::max( rectMax, uv );
+		nearest = std::min( nearest, ndc.z );
+	}
+
+	rectMin = glm::clamp( rectMin, 0.f, 1.f );
+	rectMax = glm::clamp( rectMax, 0.f, 1.f );
+
+	// Finest level where the rectangle covers at most 2x2 texels. The
+	// coarsest level has a single texel, so this always terminates.
+	for( auto const& level : aPyramid.levels )
+	{
+		auto const texel_ = [] (float aCoord, std::uint32_t aSize) {
+			return std::min( std::uint32_t(aCoord * float(aSize)), aSize - 1 );
+		};
+
+		auto const x0 = texel_( rectMin.x, level.width ), x1 = texel_( rectMax.x, level.width );
+		auto const y0 = texel_( rectMin.y, level.height ), y1 = texel_( rectMax.y, level.height );
+
+		if( x1 - x0 > 1 || y1 - y0 > 1 )
+			continue;
+
+		auto const at_ = [&] (std::uint32_t aX, std::uint32_t aY) {
+			return level.depth[std::size_t(aY) * level.width + aX];
+		};
+
+		auto const farthest = std::max( std::max( at_( x0, y0 ), at_( x1, y0 ) ), std::max( at_( x0, y1 ), at_( x1, y1 ) ) );
+		return nearest <= farthest;
+	}
+
+	return true;
+}
@@ -0,0 +1,126 @@
+#ifndef CULLING_HPP_3F8B1D27_96C4_4E0A_B5D2_71A4E6C08F95
+#define CULLING_HPP_3F8B1D27_96C4_4E0A_B5D2_71A4E6C08F95
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "baked_model.hpp"
+
+// CPU-side visibility tests. Nothing in here touches Vulkan, so the functions
+// can be exercised without a GPU.
+
+// Frustum planes (xyz = normal, w = distance); a point p is on the inner side
+// of a plane if dot(plane.xyz, p) + plane.w >= 0. Normals are unit length.
+struct Frustum
+{
+	enum { kLeft, kRight, kBottom, kTop, kNear, kFar, kPlaneCount };
+
+	glm::vec4 planes[kPlaneCount];
+};
+
+// Extracts the frustum from a projection*view matrix (Gribb and Hartmann).
+// Assumes the Vulkan clip space convention, 0 <= z <= w (e.g.,
+// glm::perspectiveRH_ZO()). The planes are in world space.
+Frustum make_frustum( glm::mat4 const& aProjCam );
+
+bool sphere_visible( Frustum const&, glm::vec3 const& aCenter, float aRadius ) noexcept;
+
+// Conservative box test: false only if the box is entirely outside of one of
+// the planes. Scalar reference for cull_aabbs().
+bool aabb_visible( Frustum const&, glm::vec3 const& aMin, glm::vec3 const& aMax ) noexcept;
+
+// Axis aligned boxes in SoA form, as centers and half extents. The arrays
+// are padded to a multiple of kAabbBatchSize, so that cull_aabbs() can
+// process full batches.
+constexpr std::size_t kAabbBatchSize = 4;
+
+struct AabbList
+{
+	std::size_t count = 0;
+
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+};
+
+void add_aabb( AabbList&, glm::vec3 const& aMin, glm::vec3 const& aMax );
+
+// Tests all boxes in aBoxes against the frustum, kAabbBatchSize at a time
+// (using SSE2 where available). Writes 1 (visible) or 0 (culled) to
+// aVisible[i] for each box; aVisible must hold aBoxes.count entries. Returns
+// the number of visible boxes.
+std::size_t cull_aabbs( Frustum const&, AabbList const& aBoxes, std::uint8_t* aVisible ) noexcept;
+
+// A cluster is visible if its bounding sphere intersects the frustum and it is
+// not entirely back-facing as seen from aCameraPos (normal cone test).
+bool cluster_visible( baked::BakedClusterRecordV2 const&, Frustum const&, glm::vec3 const& aCameraPos ) noexcept;
+
+// Range of indices to draw with vkCmdDrawIndexed()
+struct IndexRange
+{
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+};
+
+// Appends the index ranges of the visible clusters in aClusters to aRanges.
+// Consecutive visible clusters are merged into a single range. Returns the
+// number of visible clusters.
+std::size_t cull_clusters(
+	BakedArray<baked::BakedClusterRecordV2> const& aClusters,
+	Frustum const&,
+	glm::vec3 const& aCameraPos,
+	std::vector<IndexRange>& aRanges
+);
+
+// Hierarchical depth buffer (Hi-Z) for occlusion culling. Level 0 holds the
+// depth buffer as is (rows top to bottom, as in the framebuffer); each
+// further level has half the size of the previous one (rounded down, at
+// least 1) and stores the maximum, i.e., farthest, depth of the texels that
+// it covers. For odd sizes, the last texel of a row or column covers three
+// texels, so that the maximum stays conservative. Mirrors hiz.comp.
+struct DepthPyramid
+{
+	struct Level
+	{
+		std::uint32_t width, height;
+		std::vector<float> depth;
+	};
+
+	std::vector<Level> levels;
+};
+
+DepthPyramid build_depth_pyramid( float const* aDepth, std::uint32_t aWidth, std::uint32_t aHeight );
+
+// Source texels [aBegin, aEnd) that texel aTarget of a level with aTargetSize
+// texels covers in a level with aSourceSize texels (one axis).
+void depth_pyramid_footprint( std::uint32_t aTarget, std::uint32_t aSourceSize, std::uint32_t aTargetSize, std::uint32_t& aBegin, std::uint32_t& aEnd ) noexcept;
+
+// Occlusion test against a depth pyramid that was rendered with aProjCam
+// (depth 0 near, 1 far). The box's screen rectangle is looked up in the
+// finest level where it covers at most 2x2 texels. False only if the box's
+// nearest depth lies behind all of these texels. Boxes that cross the near
+// plane are never occluded. Mirrors cull.comp.
+bool aabb_unoccluded( DepthPyramid const&, glm::mat4 const& aProjCam, glm::vec3 const& aMin, glm::vec3 const& aMax ) noexcept;
+
+// Per-frame culling counters
+struct CullStats
+{
+	std::size_t meshesDrawn = 0;
+	std::size_t meshesCulled = 0;
+
+	std::size_t clustersDrawn = 0;
+	std::size_t clustersCulled = 0;
+
+	// Draws and their triangles, as recorded on the CPU: every pass counts
+	// (e.g., the depth pre-pass draws the meshes again), and draws culled on
+	// the GPU are not known
+	std::size_t draws = 0;
+	std::size_t triangles = 0;
+};
+
+#endif // CULLING_HPP_3F8B1D27_96C4_4E0A_B5D2_71A4E6C08F95
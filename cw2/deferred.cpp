@@ -0,0 +1,432 @@
+#include "deferred.hpp"
+
+#include <cassert>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+#include "../labutils/to_string.hpp"
+
+namespace
+{
+	// Input attachments of the lighting subpass, in binding order (must
+	// match deferred.frag)
+	constexpr DeferredAttachment kLightingInputs[] = {
+		kDeferredDepth,
+		kDeferredAlbedo,
+		kDeferredNormal,
+		kDeferredMaterial
+	};
+
+	constexpr std::uint32_t kLightingInputCount = sizeof(kLightingInputs) / sizeof(kLightingInputs[0]);
+
+	// Push constants of deferred.frag
+	struct LightingPush
+	{
+		glm::mat4 inverseProjCam;
+	};
+}
+
+void create_gbuffer_target( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, VkExtent2D const& aExtent, VkFormat aFormat, lut::Image& aImage, lut::ImageView& aView )
+{
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = aFormat;
+	imageInfo.extent = VkExtent3D{ aExtent.width, aExtent.height, 1 };
+	imageInfo.mipLevels = 1;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	VkImage image = VK_NULL_HANDLE;
+	VmaAllocation allocation = VK_NULL_HANDLE;
+	if( auto const res = vmaCreateImage( aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to allocate G-buffer image\n"
+			"vmaCreateImage() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	aImage = lut::Image( aAllocator.allocator, image, allocation );
+	aView = lut::create_image_view_texture2d( aContext, image, aFormat );
+}
+
+GBuffer create_gbuffer( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, VkExtent2D const& aExtent )
+{
+	GBuffer ret;
+	create_gbuffer_target( aContext, aAllocator, aExtent, kGBufferAlbedoFormat, ret.albedo, ret.albedoView );
+	create_gbuffer_target( aContext, aAllocator, aExtent, kGBufferNormalFormat, ret.normal, ret.normalView );
+	create_gbuffer_target( aContext, aAllocator, aExtent, kGBufferMaterialFormat, ret.material, ret.materialView );
+	return ret;
+}
+
+lut::RenderPass create_gbuffer_render_pass( lut::VulkanContext const& aContext, VkFormat aColorFormat, VkFormat aDepthFormat, std::uint32_t aTargetCount, VkFormat const* aTargetFormats, bool aDepthInput, bool aClearTargets, bool aKeepDepth, VkImageLayout aColorFinalLayout )
+{
+	assert( aTargetCount >= 1 && aTargetCount <= kMaxGBufferTargets );
+
+	std::uint32_t const attachmentCount = kDeferredFirstTarget + aTargetCount;
+
+	// The G-buffer is not stored. Unless aClearTargets, it is not loaded
+	// either: every pixel that the lighting subpass reads was written by the
+	// G-buffer subpass, and the others are skipped (by depth). Cleared
+	// targets take their clear values after those of the swapchain image and
+	// depth.
+	VkAttachmentDescription attachments[kDeferredFirstTarget + kMaxGBufferTargets]{};
+	attachments[kDeferredColor].format = aColorFormat;
+	attachments[kDeferredColor].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[kDeferredColor].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[kDeferredColor].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+	attachments[kDeferredColor].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[kDeferredColor].finalLayout = aColorFinalLayout;
+
+	attachments[kDeferredDepth].format = aDepthFormat;
+	attachments[kDeferredDepth].samples = VK_SAMPLE_COUNT_1_BIT;
+	attachments[kDeferredDepth].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+	attachments[kDeferredDepth].storeOp = aKeepDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	attachments[kDeferredDepth].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	attachments[kDeferredDepth].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+
+	for( std::uint32_t i = 0; i < aTargetCount; ++i )
+	{
+		auto& attachment = attachments[kDeferredFirstTarget + i];
+		attachment.format = aTargetFormats[i];
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = aClearTargets ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	// Subpass 0: G-buffer
+	VkAttachmentReference targetAttachments[kMaxGBufferTargets]{};
+	for( std::uint32_t i = 0; i < aTargetCount; ++i )
+	{
+		targetAttachments[i].attachment = kDeferredFirstTarget + i;
+		targetAttachments[i].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+	}
+
+	VkAttachmentReference depthAttachment{};
+	depthAttachment.attachment = kDeferredDepth;
+	depthAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+	// Subpass 1: lighting. Inputs are the depth buffer (optionally), then
+	// the G-buffer targets.
+	VkAttachmentReference inputAttachments[1 + kMaxGBufferTargets]{};
+	std::uint32_t inputCount = 0;
+
+	if( aDepthInput )
+	{
+		inputAttachments[inputCount].attachment = kDeferredDepth;
+		inputAttachments[inputCount].layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		++inputCount;
+	}
+
+	for( std::uint32_t i = 0; i < aTargetCount; ++i, ++inputCount )
+	{
+		inputAttachments[inputCount].attachment = kDeferredFirstTarget + i;
+		inputAttachments[inputCount].layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	}
+
+	VkAttachmentReference colorAttachment{};
+	colorAttachment.attachment = kDeferredColor;
+	colorAttachment.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+	VkSubpassDescription subpasses[2]{};
+	subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[0].colorAttachmentCount = aTargetCount;
+	subpasses[0].pColorAttachments = targetAttachments;
+	subpasses[0].pDepthStencilAttachment = &depthAttachment;
+
+	subpasses[1].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+	subpasses[1].inputAttachmentCount = inputCount;
+	subpasses[1].pInputAttachments = inputAttachments;
+	subpasses[1].colorAttachmentCount = 1;
+	subpasses[1].pColorAttachments = &colorAttachment;
+
+	VkSubpassDependency deps[4]{};
+
+	// The previous frame's lighting subpass reads the G-buffer, and its
+	// pyramid build (with aKeepDepth) the depth buffer, before this frame
+	// overwrites them
+	deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+	deps[0].dstSubpass = 0;
+	deps[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	deps[0].srcAccessMask = 0;
+	deps[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	deps[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	// The swapchain image is first used by the lighting subpass; its layout
+	// transition must wait for the acquire semaphore (which waits at the
+	// color attachment output stage)
+	deps[1].srcSubpass = VK_SUBPASS_EXTERNAL;
+	deps[1].dstSubpass = 1;
+	deps[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	deps[1].srcAccessMask = 0;
+	deps[1].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+	deps[1].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+	// G-buffer writes to lighting reads, per pixel
+	deps[2].srcSubpass = 0;
+	deps[2].dstSubpass = 1;
+	deps[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	deps[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	deps[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+	deps[2].dstAccessMask = VK_ACCESS_INPUT_ATTACHMENT_READ_BIT;
+	deps[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+
+	// Kept depth is read by compute shaders after the pass. With
+	// aDepthInput, the lighting subpass is its last user, and the writes of
+	// the G-buffer subpass are chained through the dependency above.
+	deps[3].srcSubpass = aDepthInput ? 1 : 0;
+	deps[3].dstSubpass = VK_SUBPASS_EXTERNAL;
+	deps[3].srcStageMask = aDepthInput ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+	deps[3].srcAccessMask = aDepthInput ? 0 : VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+	deps[3].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	deps[3].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	VkRenderPassCreateInfo passInfo{};
+	passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+	passInfo.attachmentCount = attachmentCount;
+	passInfo.pAttachments = attachments;
+	passInfo.subpassCount = 2;
+	passInfo.pSubpasses = subpasses;
+	passInfo.dependencyCount = aKeepDepth ? 4 : 3;
+	passInfo.pDependencies = deps;
+
+	VkRenderPass rpass = VK_NULL_HANDLE;
+	if( auto const res = vkCreateRenderPass( aContext.device, &passInfo, nullptr, &rpass ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create deferred render pass\n"
+			"vkCreateRenderPass() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	return lut::RenderPass( aContext.device, rpass );
+}
+
+lut::RenderPass create_deferred_render_pass( lut::VulkanContext const& aContext, VkFormat aColorFormat, VkFormat aDepthFormat, bool aKeepDepth, VkImageLayout aColorFinalLayout )
+{
+	VkFormat const targetFormats[kGBufferColorCount] = { kGBufferAlbedoFormat, kGBufferNormalFormat, kGBufferMaterialFormat };
+	return create_gbuffer_render_pass( aContext, aColorFormat, aDepthFormat, kGBufferColorCount, targetFormats, true, false, aKeepDepth, aColorFinalLayout );
+}
+
+DeferredLighting create_deferred_lighting( lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aLightClusterLayout )
+{
+	DeferredLighting ret;
+
+	// Input set
+	VkDescriptorSetLayoutBinding bindings[kLightingInputCount]{};
+	for( std::uint32_t i = 0; i < kLightingInputCount; ++i )
+	{
+		bindings[i].binding = i; // this must match the shaders
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = kLightingInputCount;
+	setLayoutInfo.pBindings = bindings;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorSetLayout( aContext.device, &setLayoutInfo, nullptr, &setLayout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create G-buffer descriptor set layout\n"
+			"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.inputLayout = lut::DescriptorSetLayout( aContext.device, setLayout );
+
+	// Pipeline layout
+	VkDescriptorSetLayout const setLayouts[] = { aSceneLayout, ret.inputLayout.handle, aLightClusterLayout };
+
+	VkPushConstantRange pushRange{};
+	pushRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(LightingPush);
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = sizeof(setLayouts) / sizeof(setLayouts[0]);
+	layoutInfo.pSetLayouts = setLayouts;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+
+	VkPipelineLayout pipeLayout = VK_NULL_HANDLE;
+	if( auto const res = vkCreatePipelineLayout( aContext.device, &layoutInfo, nullptr, &pipeLayout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create deferred lighting pipeline layout\n"
+			"vkCreatePipelineLayout() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.pipeLayout = lut::PipelineLayout( aContext.device, pipeLayout );
+
+	// Descriptors
+	VkDescriptorPoolSize const pools[] = {
+		{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, kLightingInputCount }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = sizeof(pools) / sizeof(pools[0]);
+	poolInfo.pPoolSizes = pools;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorPool( aContext.device, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create G-buffer descriptor pool\n"
+			"vkCreateDescriptorPool() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.pool = lut::DescriptorPool( aContext.device, pool );
+	ret.inputSet = lut::alloc_desc_set( aContext, ret.pool.handle, ret.inputLayout.handle );
+
+	return ret;
+}
+
+lut::Pipeline create_fullscreen_pipeline( lut::VulkanContext const& aContext, VkRenderPass aPass, VkPipelineLayout aLayout, VkExtent2D const& aExtent, char const* aVertShaderPath, char const* aFragShaderPath )
+{
+	lut::ShaderModule vert = lut::load_shader_module( aContext, aVertShaderPath );
+	lut::ShaderModule frag = lut::load_shader_module( aContext, aFragShaderPath );
+
+	VkPipelineShaderStageCreateInfo stages[2]{};
+	stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+	stages[0].module = vert.handle;
+	stages[0].pName = "main";
+
+	stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+	stages[1].module = frag.handle;
+	stages[1].pName = "main";
+
+	// The fullscreen triangle is generated from gl_VertexIndex
+	VkPipelineVertexInputStateCreateInfo inputInfo{};
+	inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+	VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
+	assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+	assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+	assemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+	VkViewport viewport{};
+	viewport.width = float(aExtent.width);
+	viewport.height = float(aExtent.height);
+	viewport.minDepth = 0.f;
+	viewport.maxDepth = 1.f;
+
+	VkRect2D scissor{};
+	scissor.extent = aExtent;
+
+	VkPipelineViewportStateCreateInfo viewportInfo{};
+	viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+	viewportInfo.viewportCount = 1;
+	viewportInfo.pViewports = &viewport;
+	viewportInfo.scissorCount = 1;
+	viewportInfo.pScissors = &scissor;
+
+	VkPipelineRasterizationStateCreateInfo rasterInfo{};
+	rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+	rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
+	rasterInfo.cullMode = VK_CULL_MODE_NONE;
+	rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+	rasterInfo.lineWidth = 1.f;
+
+	VkPipelineMultisampleStateCreateInfo samplingInfo{};
+	samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+	samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+	VkPipelineColorBlendAttachmentState blendStates[1]{};
+	blendStates[0].blendEnable = VK_FALSE;
+	blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+	VkPipelineColorBlendStateCreateInfo blendInfo{};
+	blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+	blendInfo.logicOpEnable = VK_FALSE;
+	blendInfo.attachmentCount = 1;
+	blendInfo.pAttachments = blendStates;
+
+	// The second subpass has no depth attachment; depth is (at most) an input
+	VkGraphicsPipelineCreateInfo pipeInfo{};
+	pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+	pipeInfo.stageCount = 2;
+	pipeInfo.pStages = stages;
+	pipeInfo.pVertexInputState = &inputInfo;
+	pipeInfo.pInputAssemblyState = &assemblyInfo;
+	pipeInfo.pViewportState = &viewportInfo;
+	pipeInfo.pRasterizationState = &rasterInfo;
+	pipeInfo.pMultisampleState = &samplingInfo;
+	pipeInfo.pDepthStencilState = nullptr;
+	pipeInfo.pColorBlendState = &blendInfo;
+	pipeInfo.layout = aLayout;
+	pipeInfo.renderPass = aPass;
+	pipeInfo.subpass = 1;
+
+	VkPipeline pipe = VK_NULL_HANDLE;
+	if( auto const res = vkCreateGraphicsPipelines( aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create fullscreen pipeline\n"
+			"vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	return lut::Pipeline( aContext.device, pipe );
+}
+
+void update_deferred_inputs( lut::VulkanContext const& aContext, DeferredLighting const& aLighting, GBuffer const& aGBuffer, VkImageView aDepthView )
+{
+	assert( VK_NULL_HANDLE != aLighting.inputSet );
+
+	VkImageView const views[kLightingInputCount] = {
+		aDepthView,
+		aGBuffer.albedoView.handle,
+		aGBuffer.normalView.handle,
+		aGBuffer.materialView.handle
+	};
+
+	VkDescriptorImageInfo imageInfos[kLightingInputCount]{};
+	VkWriteDescriptorSet writes[kLightingInputCount]{};
+	for( std::uint32_t i = 0; i < kLightingInputCount; ++i )
+	{
+		imageInfos[i].imageView = views[i];
+		imageInfos[i].imageLayout = kDeferredDepth == kLightingInputs[i]
+			? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL
+			: VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = aLighting.inputSet;
+		writes[i].dstBinding = i;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+		writes[i].descriptorCount = 1;
+		writes[i].pImageInfo = &imageInfos[i];
+	}
+
+	vkUpdateDescriptorSets( aContext.device, kLightingInputCount, writes, 0, nullptr );
+}
+
+void record_deferred_lighting( VkCommandBuffer aCmdBuff, DeferredLighting const& aLighting, VkDescriptorSet aSceneSet, VkDescriptorSet aLightClusterSet, glm::mat4 const& aInverseProjCam )
+{
+	vkCmdNextSubpass( aCmdBuff, VK_SUBPASS_CONTENTS_INLINE );
+
+	vkCmdBindPipeline( aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLighting.pipe.handle );
+
+	VkDescriptorSet const sets[] = { aSceneSet, aLighting.inputSet, aLightClusterSet };
+	vkCmdBindDescriptorSets( aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLighting.pipeLayout.handle, 0, sizeof(sets) / sizeof(sets[0]), sets, 0, nullptr );
+
+	LightingPush push{};
+	push.inverseProjCam = aInverseProjCam;
+	vkCmdPushConstants( aCmdBuff, aLighting.pipeLayout.handle, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push );
+
+	vkCmdDraw( aCmdBuff, 3, 1, 0, 0 );
+}
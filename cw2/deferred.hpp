@@ -0,0 +1,146 @@
+#ifndef DEFERRED_HPP_5B0E8C27_91D4_4F6A_B3E2_7A6C1D48F095
+#define DEFERRED_HPP_5B0E8C27_91D4_4F6A_B3E2_7A6C1D48F095
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include <glm/mat4x4.hpp>
+
+#include "../labutils/vkimage.hpp"
+#include "../labutils/vkobject.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/vulkan_context.hpp"
+namespace lut = labutils;
+
+// Deferred shading. The deferred render pass replaces the forward one of
+// main.cpp: its first subpass draws the meshes with the G-buffer fragment
+// shaders, which write the surface attributes instead of shading. The
+// second subpass then shades every covered pixel exactly once, with a
+// fullscreen triangle that reads the G-buffer as input attachments. Shading
+// cost is therefore independent of overdraw; the lighting itself (BRDF and
+// clustered point lights) is shared with the forward shaders, see
+// brdf.glsl and clustered_lights.glsl.
+//
+// G-buffer (10 bytes per pixel, plus depth):
+//  - albedo: base color (rgb)
+//  - normal: world space normal, octahedrally encoded (see gbuffer.glsl)
+//  - material: roughness (r), metalness (g)
+// The world space position is reconstructed from depth.
+//
+// The G-buffer images are transient: they only live within the render pass,
+// and tilers may keep them on chip.
+
+// Attachments of the deferred render pass, in framebuffer order. The first
+// two match the forward render pass.
+enum DeferredAttachment : std::uint32_t
+{
+	kDeferredColor = 0, // swapchain image
+	kDeferredDepth,
+	kDeferredAlbedo,
+	kDeferredNormal,
+	kDeferredMaterial,
+
+	kDeferredAttachmentCount,
+
+	// G-buffer targets start here in any render pass created with
+	// create_gbuffer_render_pass()
+	kDeferredFirstTarget = kDeferredAlbedo
+};
+
+// Most color attachments that create_gbuffer_render_pass() supports
+constexpr std::uint32_t kMaxGBufferTargets = 4;
+
+// Color attachments of the G-buffer subpass
+constexpr std::uint32_t kGBufferColorCount = 3;
+
+constexpr VkFormat kGBufferAlbedoFormat = VK_FORMAT_R8G8B8A8_UNORM;
+constexpr VkFormat kGBufferNormalFormat = VK_FORMAT_R16G16_SFLOAT;
+constexpr VkFormat kGBufferMaterialFormat = VK_FORMAT_R8G8_UNORM;
+
+struct GBuffer
+{
+	lut::Image albedo, normal, material;
+	lut::ImageView albedoView, normalView, materialView;
+};
+
+GBuffer create_gbuffer( lut::VulkanContext const&, lut::Allocator const&, VkExtent2D const& );
+
+// One transient G-buffer target (color and input attachment)
+void create_gbuffer_target( lut::VulkanContext const&, lut::Allocator const&, VkExtent2D const&, VkFormat, lut::Image& aImage, lut::ImageView& aView );
+
+// Two-subpass render pass: the first subpass writes aTargetCount color
+// targets and depth, the second reads them as input attachments and writes
+// the swapchain image. With aDepthInput, depth is input attachment 0 and the
+// targets follow; otherwise the targets start at 0. With aClearTargets, the
+// targets are cleared (e.g., to mark uncovered pixels), otherwise their
+// contents are undefined where nothing was drawn. Framebuffers are the
+// swapchain image, depth, and then the targets. The swapchain image ends in
+// aColorFinalLayout (offscreen images of headless windows are not presented;
+// see lut::make_vulkan_window_headless()).
+lut::RenderPass create_gbuffer_render_pass(
+	lut::VulkanContext const&,
+	VkFormat aColorFormat,
+	VkFormat aDepthFormat,
+	std::uint32_t aTargetCount,
+	VkFormat const* aTargetFormats,
+	bool aDepthInput,
+	bool aClearTargets,
+	bool aKeepDepth,
+	VkImageLayout aColorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR
+);
+
+// Like the forward render pass, aKeepDepth stores the depth buffer for
+// compute shaders after the pass (see gpu_culling.hpp). The depth buffer is
+// also read as an input attachment, and must have been created with
+// VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT.
+lut::RenderPass create_deferred_render_pass( lut::VulkanContext const&, VkFormat aColorFormat, VkFormat aDepthFormat, bool aKeepDepth, VkImageLayout aColorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR );
+
+struct DeferredLighting
+{
+	// Set 1 of the lighting pipeline: depth, albedo, normal, material. Set 0
+	// holds the scene uniforms, set 2 the clustered lights.
+	lut::DescriptorSetLayout inputLayout;
+	lut::PipelineLayout pipeLayout;
+
+	// Depends on the framebuffer size (viewport); see
+	// create_fullscreen_pipeline()
+	lut::Pipeline pipe;
+
+	// Depends on the G-buffer; see update_deferred_inputs()
+	lut::DescriptorPool pool;
+	VkDescriptorSet inputSet = VK_NULL_HANDLE;
+};
+
+DeferredLighting create_deferred_lighting(
+	lut::VulkanContext const&,
+	VkDescriptorSetLayout aSceneLayout,
+	VkDescriptorSetLayout aLightClusterLayout
+);
+
+// Pipeline of a fullscreen triangle (see fullscreen.vert) in the second
+// subpass of a render pass from create_gbuffer_render_pass()
+lut::Pipeline create_fullscreen_pipeline(
+	lut::VulkanContext const&,
+	VkRenderPass,
+	VkPipelineLayout,
+	VkExtent2D const&,
+	char const* aVertShaderPath,
+	char const* aFragShaderPath
+);
+
+// Points the input set at a (new) G-buffer and depth buffer. The set must
+// not be in use.
+void update_deferred_inputs( lut::VulkanContext const&, DeferredLighting const&, GBuffer const&, VkImageView aDepthView );
+
+// Records the lighting subpass; call after drawing the meshes in the
+// G-buffer subpass. aInverseProjCam maps clip space to world space.
+void record_deferred_lighting(
+	VkCommandBuffer,
+	DeferredLighting const&,
+	VkDescriptorSet aSceneSet,
+	VkDescriptorSet aLightClusterSet,
+	glm::mat4 const& aInverseProjCam
+);
+
+#endif // DEFERRED_HPP_5B0E8C27_91D4_4F6A_B3E2_7A6C1D48F095
@@ -0,0 +1,157 @@
+#include "geometry_arena.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include "../labutils/error.hpp"
+#include "../labutils/trace.hpp"
+
+namespace
+{
+	VkDeviceSize align_up_( VkDeviceSize aValue, VkDeviceSize aAlign )
+	{
+		return (aValue + aAlign - 1) / aAlign * aAlign;
+	}
+}
+
+GeometryArenaLayout plan_geometry_arena( BakedModel const& aModel )
+{
+	GeometryArenaLayout ret;
+
+	switch( aModel.vertexFormat )
+	{
+		case baked::kBakedVertexSeparate:
+			ret.streamCount = 4;
+			ret.streamStrides[0] = sizeof(glm::vec3); // position
+			ret.streamStrides[1] = sizeof(glm::vec3); // normal
+			ret.streamStrides[2] = sizeof(glm::vec2); // texcoord
+			ret.streamStrides[3] = sizeof(glm::vec4); // tangent
+			break;
+		case baked::kBakedVertexPackedF32:
+			ret.streamCount = 1;
+			ret.streamStrides[0] = sizeof(baked::BakedPackedVertexF32);
+			break;
+		case baked::kBakedVertexPackedQ16:
+			ret.streamCount = 1;
+			ret.streamStrides[0] = sizeof(baked::BakedPackedVertexQ16);
+			break;
+	}
+
+	bool const packed = baked::kBakedVertexSeparate != aModel.vertexFormat;
+
+	std::uint64_t vertexCount = 0, indexCount = 0;
+
+	ret.meshes.reserve( aModel.meshes.size() );
+	for( auto const& mesh : aModel.meshes )
+	{
+		SceneMesh sm{};
+		sm.firstIndex = std::uint32_t(indexCount);
+		sm.indexCount = std::uint32_t(mesh.indices.size());
+		sm.vertexOffset = std::int32_t(vertexCount);
+		sm.vertexCount = std::uint32_t(packed
+			? mesh.packedVertices.size() / ret.streamStrides[0]
+			: mesh.positions.size()
+		);
+
+		if( packed )
+		{
+			sm.positionOffset = mesh.positionOffset;
+			sm.positionScale = mesh.positionScale;
+
+			// The quantized positions are fetched as UNORM16, i.e., the
+			// shader sees q/65535 rather than q.
+			if( baked::kBakedVertexPackedQ16 == aModel.vertexFormat )
+				sm.positionScale *= 65535.f;
+		}
+
+		vertexCount += sm.vertexCount;
+		indexCount += sm.indexCount;
+
+		if( vertexCount > std::uint64_t(std::numeric_limits<std::int32_t>::max()) )
+			throw lut::Error( "plan_geometry_arena(): too many vertices (%llu)", (unsigned long long)vertexCount );
+		if( indexCount > std::uint64_t(std::numeric_limits<std::uint32_t>::max()) )
+			throw lut::Error( "plan_geometry_arena(): too many indices (%llu)", (unsigned long long)indexCount );
+
+		ret.meshes.emplace_back( sm );
+	}
+
+	VkDeviceSize offset = 0;
+	for( std::uint32_t i = 0; i < ret.streamCount; ++i )
+	{
+		ret.streamOffsets[i] = align_up_( offset, kVertexStreamAlign );
+		offset = ret.streamOffsets[i] + vertexCount * ret.streamStrides[i];
+	}
+
+	ret.vertexBytes = offset;
+	ret.indexBytes = indexCount * sizeof(std::uint32_t);
+
+	return ret;
+}
+
+GeometryArena create_geometry_arena( BakedModel const& aModel, lut::Allocator const& aAllocator, lut::UploadBatcher& aUploader, std::vector<SceneMesh>& aMeshes )
+{
+	LUT_TRACE_SCOPE( __func__ );
+
+	auto layout = plan_geometry_arena( aModel );
+
+	GeometryArena ret;
+	ret.streamCount = layout.streamCount;
+	std::copy( std::begin(layout.streamOffsets), std::end(layout.streamOffsets), ret.streamOffsets );
+
+	// Zero-sized buffers are not allowed. Both buffers are also readable as
+	// storage buffers, by shaders that fetch vertices themselves.
+	ret.vertices = lut::create_buffer(
+		aAllocator,
+		std::max<VkDeviceSize>( layout.vertexBytes, 1 ),
+		VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+	ret.indices = lut::create_buffer(
+		aAllocator,
+		std::max<VkDeviceSize>( layout.indexBytes, 1 ),
+		VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	// Copy straight from the mapped model file into staging memory
+	auto const upload_ = [&] (VkBuffer aDst, VkDeviceSize aOffset, auto const& aArray) {
+		if( !aArray.empty() )
+			aUploader.upload_buffer( aDst, aOffset, aArray.bytes, aArray.size_bytes() );
+	};
+
+	for( std::size_t i = 0; i < aModel.meshes.size(); ++i )
+	{
+		auto const& mesh = aModel.meshes[i];
+		auto const& sm = layout.meshes[i];
+
+		auto const stream_ = [&] (std::uint32_t aStream) {
+			return layout.streamOffsets[aStream] + VkDeviceSize(sm.vertexOffset) * layout.streamStrides[aStream];
+		};
+
+		if( baked::kBakedVertexSeparate == aModel.vertexFormat )
+		{
+			upload_( ret.vertices.buffer, stream_( 0 ), mesh.positions );
+			upload_( ret.vertices.buffer, stream_( 1 ), mesh.normals );
+			upload_( ret.vertices.buffer, stream_( 2 ), mesh.texcoords );
+			upload_( ret.vertices.buffer, stream_( 3 ), mesh.tangents );
+		}
+		else
+		{
+			upload_( ret.vertices.buffer, stream_( 0 ), mesh.packedVertices );
+		}
+
+		upload_( ret.indices.buffer, VkDeviceSize(sm.firstIndex) * sizeof(std::uint32_t), mesh.indices );
+	}
+
+	aMeshes = std::move(layout.meshes);
+	return ret;
+}
+
+void bind_geometry_arena( VkCommandBuffer aCmd, GeometryArena const& aArena )
+{
+	VkBuffer buffers[kMaxVertexStreams];
+	std::fill( std::begin(buffers), std::end(buffers), aArena.vertices.buffer );
+
+	vkCmdBindVertexBuffers( aCmd, 0, aArena.streamCount, buffers, aArena.streamOffsets );
+	vkCmdBindIndexBuffer( aCmd, aArena.indices.buffer, 0, VK_INDEX_TYPE_UINT32 );
+}
@@ -0,0 +1,84 @@
+#ifndef GEOMETRY_ARENA_HPP_6B2E94D1_58A7_4C3F_9D10_E4F7A2C86B35
+#define GEOMETRY_ARENA_HPP_6B2E94D1_58A7_4C3F_9D10_E4F7A2C86B35
+
+#include <vector>
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include <glm/vec3.hpp>
+
+#include "../labutils/upload.hpp"
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/allocator.hpp"
+namespace lut = labutils;
+
+#include "baked_model.hpp"
+
+// All meshes of a model share one vertex buffer and one index buffer. The
+// vertex buffer holds one region per vertex stream (four for
+// kBakedVertexSeparate, one for the packed formats); within each stream the
+// meshes' vertices are stored back to back. The index buffer holds the
+// meshes' (unmodified) indices back to back. A mesh is drawn with its
+// firstIndex and vertexOffset, so the buffers are bound only once.
+
+constexpr std::uint32_t kMaxVertexStreams = 4;
+
+// Alignment of the vertex streams within the vertex buffer
+constexpr VkDeviceSize kVertexStreamAlign = 16;
+
+// Location of a mesh in the arena
+struct SceneMesh
+{
+	std::uint32_t firstIndex;
+	std::uint32_t indexCount;
+	std::int32_t vertexOffset;
+	std::uint32_t vertexCount;
+
+	// Packed formats: positions in the shader are positionOffset + attribute
+	// * positionScale.
+	glm::vec3 positionOffset{ 0.f };
+	glm::vec3 positionScale{ 1.f };
+};
+
+// CPU-side layout of the arena. Computed separately from the upload so that
+// it can be inspected without a Vulkan device.
+struct GeometryArenaLayout
+{
+	std::vector<SceneMesh> meshes;
+
+	std::uint32_t streamCount = 0;
+	VkDeviceSize streamOffsets[kMaxVertexStreams]{};
+	VkDeviceSize streamStrides[kMaxVertexStreams]{};
+
+	VkDeviceSize vertexBytes = 0;
+	VkDeviceSize indexBytes = 0;
+};
+
+GeometryArenaLayout plan_geometry_arena( BakedModel const& );
+
+struct GeometryArena
+{
+	lut::Buffer vertices;
+	lut::Buffer indices;
+
+	std::uint32_t streamCount = 0;
+	VkDeviceSize streamOffsets[kMaxVertexStreams]{};
+};
+
+// Creates the arena and records the upload of all mesh data into
+// aUploader. The arena may only be used once the uploads have been
+// submitted (e.g., after aUploader.finish()). Returns the meshes' locations
+// in aMeshes.
+GeometryArena create_geometry_arena(
+	BakedModel const&,
+	lut::Allocator const&,
+	lut::UploadBatcher& aUploader,
+	std::vector<SceneMesh>& aMeshes
+);
+
+// Binds the arena's vertex streams and index buffer
+void bind_geometry_arena( VkCommandBuffer, GeometryArena const& );
+
+#endif // GEOMETRY_ARENA_HPP_6B2E94D1_58A7_4C3F_9D10_E4F7A2C86B35
@@ -0,0 +1,553 @@
+#include "gpu_culling.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+#include "../labutils/to_string.hpp"
+
+namespace
+{
+	// Must match local_size_* in the shaders
+	constexpr std::uint32_t kHiZGroupSize = 8;
+	constexpr std::uint32_t kCullGroupSize = 64;
+
+	// Push constants of hiz.comp
+	struct HiZPush
+	{
+		std::int32_t sourceSize[2];
+		std::int32_t targetSize[2];
+	};
+
+	lut::DescriptorSetLayout create_set_layout_( lut::VulkanContext const& aContext, std::vector<VkDescriptorType> const& aTypes )
+	{
+		std::vector<VkDescriptorSetLayoutBinding> bindings( aTypes.size() );
+		for( std::size_t i = 0; i < aTypes.size(); ++i )
+		{
+			bindings[i].binding = std::uint32_t(i); // this must match the shaders
+			bindings[i].descriptorType = aTypes[i];
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = std::uint32_t(bindings.size());
+		layoutInfo.pBindings = bindings.data();
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if( auto const res = vkCreateDescriptorSetLayout( aContext.device, &layoutInfo, nullptr, &layout ); VK_SUCCESS != res )
+		{
+			throw lut::Error( "Unable to create culling descriptor set layout\n"
+				"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str()
+			);
+		}
+
+		return lut::DescriptorSetLayout( aContext.device, layout );
+	}
+
+	lut::PipelineLayout create_pipeline_layout_( lut::VulkanContext const& aContext, VkDescriptorSetLayout aLayout, std::uint32_t aPushConstantSize )
+	{
+		VkPushConstantRange pushConstants{};
+		pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstants.offset = 0;
+		pushConstants.size = aPushConstantSize;
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &aLayout;
+		layoutInfo.pushConstantRangeCount = aPushConstantSize ? 1 : 0;
+		layoutInfo.pPushConstantRanges = aPushConstantSize ? &pushConstants : nullptr;
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		if( auto const res = vkCreatePipelineLayout( aContext.device, &layoutInfo, nullptr, &layout ); VK_SUCCESS != res )
+		{
+			throw lut::Error( "Unable to create culling pipeline layout\n"
+				"vkCreatePipelineLayout() returned %s", lut::to_string(res).c_str()
+			);
+		}
+
+		return lut::PipelineLayout( aContext.device, layout );
+	}
+
+	lut::Pipeline create_compute_pipeline_( lut::VulkanContext const& aContext, VkPipelineLayout aLayout, char const* aShaderPath )
+	{
+		lut::ShaderModule shader = lut::load_shader_module( aContext, aShaderPath );
+
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeInfo.stage.module = shader.handle;
+		pipeInfo.stage.pName = "main";
+		pipeInfo.layout = aLayout;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if( auto const res = vkCreateComputePipelines( aContext.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe ); VK_SUCCESS != res )
+		{
+			throw lut::Error( "Unable to create compute pipeline '%s'\n"
+				"vkCreateComputePipelines() returned %s", aShaderPath, lut::to_string(res).c_str()
+			);
+		}
+
+		return lut::Pipeline( aContext.device, pipe );
+	}
+
+	lut::ImageView create_hiz_view_( lut::VulkanContext const& aContext, VkImage aImage, std::uint32_t aBaseLevel, std::uint32_t aLevelCount )
+	{
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = aImage;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_SFLOAT;
+		viewInfo.subresourceRange = VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, aBaseLevel, aLevelCount, 0, 1 };
+
+		VkImageView view = VK_NULL_HANDLE;
+		if( auto const res = vkCreateImageView( aContext.device, &viewInfo, nullptr, &view ); VK_SUCCESS != res )
+		{
+			throw lut::Error( "Unable to create depth pyramid view\n"
+				"vkCreateImageView() returned %s", lut::to_string(res).c_str()
+			);
+		}
+
+		return lut::ImageView( aContext.device, view );
+	}
+}
+
+bool gpu_culling_supported( VkPhysicalDevice aPhysicalDev, EIndirectSupport aIndirect )
+{
+	if( EIndirectSupport::multi != aIndirect )
+		return false;
+
+	VkPhysicalDeviceVulkan12Features features12{};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &features12;
+	vkGetPhysicalDeviceFeatures2( aPhysicalDev, &features );
+
+	return features12.drawIndirectCount;
+}
+
+std::vector<CullBounds> make_cull_bounds( BakedModel const& aModel )
+{
+	std::vector<CullBounds> ret;
+	ret.reserve( aModel.meshes.size() );
+
+	for( auto const& mesh : aModel.meshes )
+	{
+		CullBounds cb{};
+		cb.aabbMin = glm::vec4( mesh.aabbMin, mesh.hasBounds ? 1.f : 0.f );
+		cb.aabbMax = glm::vec4( mesh.aabbMax, 0.f );
+
+		ret.emplace_back( cb );
+	}
+
+	return ret;
+}
+
+IndirectDrawPlan cull_indirect_draws( IndirectDrawPlan const& aPlan, std::vector<CullBounds> const& aBounds, Frustum const& aFrustum, glm::mat4 const& aPreviousProjCam, DepthPyramid const* aPyramid )
+{
+	IndirectDrawPlan ret;
+
+	for( std::uint32_t p = 0; p < kDrawPipelineCount; ++p )
+	{
+		ret.first[p] = aPlan.first[p];
+
+		for( std::uint32_t i = aPlan.first[p]; i < aPlan.first[p] + aPlan.count[p]; ++i )
+		{
+			auto const& cmd = aPlan.commands[i];
+
+			assert( cmd.firstInstance < aBounds.size() );
+			auto const& bounds = aBounds[cmd.firstInstance];
+
+			if( 0.f != bounds.aabbMin.w )
+			{
+				glm::vec3 const bmin( bounds.aabbMin ), bmax( bounds.aabbMax );
+
+				if( !aabb_visible( aFrustum, bmin, bmax ) )
+					continue;
+
+				if( aPyramid && !aabb_unoccluded( *aPyramid, aPreviousProjCam, bmin, bmax ) )
+					continue;
+			}
+
+			ret.commands.emplace_back( cmd );
+			++ret.count[p];
+		}
+
+		// Keep the input's layout: the GPU writes the survivors to the start
+		// of each pipeline's range.
+		ret.commands.resize( ret.first[p] + aPlan.count[p] );
+	}
+
+	return ret;
+}
+
+GpuCuller create_gpu_culler( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, lut::UploadBatcher& aUploader, BakedModel const& aModel, IndirectDraws const& aDraws, VkImageView aDepthView, VkExtent2D const& aDepthExtent, char const* aHiZShaderPath, char const* aCullShaderPath )
+{
+	GpuCuller ret;
+
+	// Only texelFetch() is used; the sampler is required by the descriptors
+	VkSamplerCreateInfo samplerInfo{};
+	samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+	samplerInfo.magFilter = VK_FILTER_NEAREST;
+	samplerInfo.minFilter = VK_FILTER_NEAREST;
+	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+	samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+	VkSampler sampler = VK_NULL_HANDLE;
+	if( auto const res = vkCreateSampler( aContext.device, &samplerInfo, nullptr, &sampler ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create culling sampler\n"
+			"vkCreateSampler() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.sampler = lut::Sampler( aContext.device, sampler );
+
+	// hiz.comp: source level (or depth buffer), target level
+	ret.hizLayout = create_set_layout_( aContext, {
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+		VK_DESCRIPTOR_TYPE_STORAGE_IMAGE
+	} );
+
+	// cull.comp: parameters, input commands, bounds, output commands,
+	// counts, pyramid
+	ret.cullLayout = create_set_layout_( aContext, {
+		VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER
+	} );
+
+	ret.hizPipeLayout = create_pipeline_layout_( aContext, ret.hizLayout.handle, sizeof(HiZPush) );
+	ret.cullPipeLayout = create_pipeline_layout_( aContext, ret.cullLayout.handle, 0 );
+
+	ret.hizPipe = create_compute_pipeline_( aContext, ret.hizPipeLayout.handle, aHiZShaderPath );
+	ret.cullPipe = create_compute_pipeline_( aContext, ret.cullPipeLayout.handle, aCullShaderPath );
+
+	// Buffers
+	auto const bounds = make_cull_bounds( aModel );
+	ret.bounds = lut::create_buffer(
+		aAllocator,
+		std::max<VkDeviceSize>( bounds.size() * sizeof(CullBounds), sizeof(CullBounds) ),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	if( !bounds.empty() )
+		aUploader.upload_buffer( ret.bounds.buffer, 0, bounds.data(), bounds.size() * sizeof(CullBounds) );
+
+	ret.uniforms = lut::create_buffer(
+		aAllocator,
+		sizeof(CullUniform),
+		VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	std::uint32_t commandCount = 0;
+	for( std::uint32_t i = 0; i < kDrawPipelineCount; ++i )
+	{
+		ret.first[i] = aDraws.first[i];
+		ret.count[i] = aDraws.count[i];
+		commandCount += aDraws.count[i];
+	}
+
+	ret.commands = lut::create_buffer(
+		aAllocator,
+		std::max( commandCount, 1u ) * sizeof(VkDrawIndexedIndirectCommand),
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	ret.counts = lut::create_buffer(
+		aAllocator,
+		kDrawPipelineCount * sizeof(std::uint32_t),
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	ret.inputCommands = aDraws.commands.buffer;
+
+	resize_gpu_culler( ret, aContext, aAllocator, aDepthView, aDepthExtent );
+
+	return ret;
+}
+
+void resize_gpu_culler( GpuCuller& aCuller, lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, VkImageView aDepthView, VkExtent2D const& aDepthExtent )
+{
+	// Release the old sets and views before the image
+	aCuller.pool = lut::DescriptorPool();
+	aCuller.hizSets.clear();
+	aCuller.hizLevelViews.clear();
+	aCuller.hizView = lut::ImageView();
+
+	aCuller.hizWidth = aDepthExtent.width;
+	aCuller.hizHeight = aDepthExtent.height;
+	aCuller.hizLevels = lut::compute_mip_level_count( aDepthExtent.width, aDepthExtent.height );
+	aCuller.hizValid = false;
+
+	// Pyramid
+	VkImageCreateInfo imageInfo{};
+	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	imageInfo.imageType = VK_IMAGE_TYPE_2D;
+	imageInfo.format = VK_FORMAT_R32_SFLOAT;
+	imageInfo.extent = VkExtent3D{ aDepthExtent.width, aDepthExtent.height, 1 };
+	imageInfo.mipLevels = aCuller.hizLevels;
+	imageInfo.arrayLayers = 1;
+	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+	VmaAllocationCreateInfo allocInfo{};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	VkImage image = VK_NULL_HANDLE;
+	VmaAllocation allocation = VK_NULL_HANDLE;
+	if( auto const res = vmaCreateImage( aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to allocate depth pyramid\n"
+			"vmaCreateImage() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	aCuller.hiz = lut::Image( aAllocator.allocator, image, allocation );
+
+	aCuller.hizView = create_hiz_view_( aContext, image, 0, aCuller.hizLevels );
+	for( std::uint32_t i = 0; i < aCuller.hizLevels; ++i )
+		aCuller.hizLevelViews.emplace_back( create_hiz_view_( aContext, image, i, 1 ) );
+
+	// Descriptors
+	auto const levels = aCuller.hizLevels;
+	VkDescriptorPoolSize const pools[] = {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, levels + 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, levels },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = levels + 1;
+	poolInfo.poolSizeCount = sizeof(pools) / sizeof(pools[0]);
+	poolInfo.pPoolSizes = pools;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorPool( aContext.device, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create culling descriptor pool\n"
+			"vkCreateDescriptorPool() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	aCuller.pool = lut::DescriptorPool( aContext.device, pool );
+
+	// Level 0 reads the depth buffer, all others the previous level
+	std::vector<VkDescriptorImageInfo> imageInfos( 2 * levels + 1 );
+	std::vector<VkWriteDescriptorSet> writes;
+
+	for( std::uint32_t i = 0; i < levels; ++i )
+	{
+		auto const set = lut::alloc_desc_set( aContext, aCuller.pool.handle, aCuller.hizLayout.handle );
+		aCuller.hizSets.emplace_back( set );
+
+		auto& source = imageInfos[2*i+0];
+		source.sampler = aCuller.sampler.handle;
+		source.imageView = 0 == i ? aDepthView : aCuller.hizLevelViews[i-1].handle;
+		source.imageLayout = 0 == i ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL;
+
+		auto& target = imageInfos[2*i+1];
+		target.imageView = aCuller.hizLevelViews[i].handle;
+		target.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		for( std::uint32_t j = 0; j < 2; ++j )
+		{
+			auto& write = writes.emplace_back();
+			write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			write.dstSet = set;
+			write.dstBinding = j;
+			write.descriptorType = 0 == j ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER : VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			write.descriptorCount = 1;
+			write.pImageInfo = &imageInfos[2*i+j];
+		}
+	}
+
+	aCuller.cullSet = lut::alloc_desc_set( aContext, aCuller.pool.handle, aCuller.cullLayout.handle );
+
+	VkDescriptorBufferInfo bufferInfos[5]{};
+	VkBuffer const buffers[5] = {
+		aCuller.uniforms.buffer,
+		aCuller.inputCommands,
+		aCuller.bounds.buffer,
+		aCuller.commands.buffer,
+		aCuller.counts.buffer
+	};
+
+	for( std::uint32_t i = 0; i < 5; ++i )
+	{
+		bufferInfos[i].buffer = buffers[i];
+		bufferInfos[i].range = VK_WHOLE_SIZE;
+
+		auto& write = writes.emplace_back();
+		write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		write.dstSet = aCuller.cullSet;
+		write.dstBinding = i;
+		write.descriptorType = 0 == i ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER : VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		write.descriptorCount = 1;
+		write.pBufferInfo = &bufferInfos[i];
+	}
+
+	auto& pyramid = imageInfos[2 * levels];
+	pyramid.sampler = aCuller.sampler.handle;
+	pyramid.imageView = aCuller.hizView.handle;
+	pyramid.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+	auto& write = writes.emplace_back();
+	write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	write.dstSet = aCuller.cullSet;
+	write.dstBinding = 5;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	write.descriptorCount = 1;
+	write.pImageInfo = &pyramid;
+
+	vkUpdateDescriptorSets( aContext.device, std::uint32_t(writes.size()), writes.data(), 0, nullptr );
+}
+
+void record_gpu_culling( VkCommandBuffer aCmdBuff, GpuCuller const& aCuller, Frustum const& aFrustum, glm::mat4 const& aPreviousProjCam )
+{
+	CullUniform uniforms{};
+	for( int i = 0; i < Frustum::kPlaneCount; ++i )
+		uniforms.planes[i] = aFrustum.planes[i];
+
+	uniforms.previousProjCam = aPreviousProjCam;
+	uniforms.hizLevels = aCuller.hizLevels;
+	uniforms.occlusion = aCuller.hizValid ? 1 : 0;
+	uniforms.commandCount = aCuller.count[kDrawPipelineOpaque] + aCuller.count[kDrawPipelineAlphaMasked];
+	uniforms.alphaMaskedFirst = aCuller.first[kDrawPipelineAlphaMasked];
+
+	// The previous frame's draws read the outputs; its culling pass the
+	// parameters
+	lut::buffer_barrier( aCmdBuff, aCuller.uniforms.buffer,
+		VK_ACCESS_UNIFORM_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT
+	);
+	lut::buffer_barrier( aCmdBuff, aCuller.counts.buffer,
+		VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT
+	);
+
+	vkCmdUpdateBuffer( aCmdBuff, aCuller.uniforms.buffer, 0, sizeof(CullUniform), &uniforms );
+	vkCmdFillBuffer( aCmdBuff, aCuller.counts.buffer, 0, VK_WHOLE_SIZE, 0 );
+
+	lut::buffer_barrier( aCmdBuff, aCuller.uniforms.buffer,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+	lut::buffer_barrier( aCmdBuff, aCuller.counts.buffer,
+		VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+	lut::buffer_barrier( aCmdBuff, aCuller.commands.buffer,
+		VK_ACCESS_INDIRECT_COMMAND_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
+
+	// Written by the previous frame's record_depth_pyramid()
+	if( aCuller.hizValid )
+	{
+		lut::image_barrier( aCmdBuff, aCuller.hiz.image,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, aCuller.hizLevels, 0, 1 }
+		);
+	}
+
+	vkCmdBindPipeline( aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aCuller.cullPipe.handle );
+	vkCmdBindDescriptorSets( aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aCuller.cullPipeLayout.handle, 0, 1, &aCuller.cullSet, 0, nullptr );
+
+	if( uniforms.commandCount )
+		vkCmdDispatch( aCmdBuff, (uniforms.commandCount + kCullGroupSize - 1) / kCullGroupSize, 1, 1 );
+
+	lut::buffer_barrier( aCmdBuff, aCuller.commands.buffer,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+	);
+	lut::buffer_barrier( aCmdBuff, aCuller.counts.buffer,
+		VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT
+	);
+}
+
+void draw_gpu_culled( VkCommandBuffer aCmdBuff, GpuCuller const& aCuller, EDrawPipeline aPipeline )
+{
+	assert( aPipeline < kDrawPipelineCount );
+
+	auto constexpr stride = std::uint32_t(sizeof(VkDrawIndexedIndirectCommand));
+
+	if( 0 == aCuller.count[aPipeline] )
+		return;
+
+	vkCmdDrawIndexedIndirectCount( aCmdBuff,
+		aCuller.commands.buffer, VkDeviceSize(aCuller.first[aPipeline]) * stride,
+		aCuller.counts.buffer, VkDeviceSize(aPipeline) * sizeof(std::uint32_t),
+		aCuller.count[aPipeline], stride
+	);
+}
+
+void record_depth_pyramid( VkCommandBuffer aCmdBuff, GpuCuller& aCuller )
+{
+	VkImageSubresourceRange const allLevels{ VK_IMAGE_ASPECT_COLOR_BIT, 0, aCuller.hizLevels, 0, 1 };
+
+	// Overwrites the whole pyramid. This frame's culling pass has read it.
+	lut::image_barrier( aCmdBuff, aCuller.hiz.image,
+		VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+		aCuller.hizValid ? VK_IMAGE_LAYOUT_GENERAL : VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+		allLevels
+	);
+
+	vkCmdBindPipeline( aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aCuller.hizPipe.handle );
+
+	std::uint32_t sourceWidth = aCuller.hizWidth, sourceHeight = aCuller.hizHeight;
+	for( std::uint32_t i = 0; i < aCuller.hizLevels; ++i )
+	{
+		auto const width = 0 == i ? sourceWidth : std::max( 1u, sourceWidth / 2 );
+		auto const height = 0 == i ? sourceHeight : std::max( 1u, sourceHeight / 2 );
+
+		HiZPush push{};
+		push.sourceSize[0] = std::int32_t(sourceWidth);
+		push.sourceSize[1] = std::int32_t(sourceHeight);
+		push.targetSize[0] = std::int32_t(width);
+		push.targetSize[1] = std::int32_t(height);
+
+		vkCmdBindDescriptorSets( aCmdBuff, VK_PIPELINE_BIND_POINT_COMPUTE, aCuller.hizPipeLayout.handle, 0, 1, &aCuller.hizSets[i], 0, nullptr );
+		vkCmdPushConstants( aCmdBuff, aCuller.hizPipeLayout.handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(push), &push );
+		vkCmdDispatch( aCmdBuff, (width + kHiZGroupSize - 1) / kHiZGroupSize, (height + kHiZGroupSize - 1) / kHiZGroupSize, 1 );
+
+		// The next level reads this one
+		lut::image_barrier( aCmdBuff, aCuller.hiz.image,
+			VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, i, 1, 0, 1 }
+		);
+
+		sourceWidth = width;
+		sourceHeight = height;
+	}
+
+	aCuller.hizValid = true;
+}
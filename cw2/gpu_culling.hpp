@@ -0,0 +1,150 @@
+#ifndef GPU_CULLING_HPP_7D3F0B86_C25E_4A19_9E47_18B6F2A0D5C3
+#define GPU_CULLING_HPP_7D3F0B86_C25E_4A19_9E47_18B6F2A0D5C3
+
+#include <vector>
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+#include "../labutils/upload.hpp"
+#include "../labutils/vkimage.hpp"
+#include "../labutils/vkobject.hpp"
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/vulkan_context.hpp"
+namespace lut = labutils;
+
+#include "culling.hpp"
+#include "indirect.hpp"
+#include "baked_model.hpp"
+
+// GPU culling of indirect draws (see indirect.hpp). Each frame, before the
+// render pass, cull.comp tests every mesh's bounding box against the view
+// frustum and against a depth pyramid (see DepthPyramid in culling.hpp) of
+// the previous frame's depth buffer. Surviving commands are compacted into a
+// second command buffer, with one draw count per pipeline, and drawn with
+// vkCmdDrawIndexedIndirectCount(). After the render pass, hiz.comp builds the
+// pyramid for the next frame from the depth buffer.
+//
+// The occlusion test projects the boxes with the previous frame's matrix,
+// i.e., the one that the pyramid was rendered with. Geometry that becomes
+// disoccluded by camera motion therefore appears one frame late. Without a
+// valid pyramid (first frame, after a resize, or after frames drawn
+// otherwise) only the frustum test is applied.
+//
+// cull_indirect_draws() is the CPU reference of cull.comp, and
+// build_depth_pyramid() that of hiz.comp. Up to floating point differences
+// they select the same commands; the GPU's order within a pipeline is
+// arbitrary.
+
+// Requires indirect draws with EIndirectSupport::multi and drawIndirectCount
+bool gpu_culling_supported( VkPhysicalDevice, EIndirectSupport );
+
+// Bounds of one mesh in the storage buffer (std430), indexed by mesh ID. w
+// of aabbMin is 1 if the mesh has bounds; meshes without are never culled.
+struct CullBounds
+{
+	glm::vec4 aabbMin;
+	glm::vec4 aabbMax;
+};
+
+static_assert( sizeof(CullBounds) == 32 );
+
+std::vector<CullBounds> make_cull_bounds( BakedModel const& );
+
+// Per-frame parameters of cull.comp (std140)
+struct CullUniform
+{
+	glm::vec4 planes[Frustum::kPlaneCount];
+	glm::mat4 previousProjCam;
+
+	std::uint32_t hizLevels;
+	std::uint32_t occlusion; // 0: frustum test only
+	std::uint32_t commandCount;
+	std::uint32_t alphaMaskedFirst; // first command of kDrawPipelineAlphaMasked
+};
+
+static_assert( sizeof(CullUniform) == 176 );
+
+// CPU reference of cull.comp: the commands of aPlan whose meshes pass the
+// frustum test and, with a pyramid, the occlusion test. Each pipeline keeps
+// its range of aPlan; the count surviving commands come first (in input
+// order), the rest of the range is zeroed.
+IndirectDrawPlan cull_indirect_draws(
+	IndirectDrawPlan const&,
+	std::vector<CullBounds> const&,
+	Frustum const&,
+	glm::mat4 const& aPreviousProjCam,
+	DepthPyramid const* aPyramid
+);
+
+struct GpuCuller
+{
+	lut::Sampler sampler;
+
+	lut::DescriptorSetLayout hizLayout, cullLayout;
+	lut::PipelineLayout hizPipeLayout, cullPipeLayout;
+	lut::Pipeline hizPipe, cullPipe;
+
+	lut::Buffer bounds;
+	lut::Buffer uniforms;
+	lut::Buffer commands; // compacted; same layout as the input
+	lut::Buffer counts;   // one draw count per pipeline
+
+	VkBuffer inputCommands = VK_NULL_HANDLE;
+	std::uint32_t first[kDrawPipelineCount]{};
+	std::uint32_t count[kDrawPipelineCount]{};
+
+	// Depth pyramid, in VK_IMAGE_LAYOUT_GENERAL once built
+	lut::Image hiz;
+	lut::ImageView hizView; // all levels
+	std::vector<lut::ImageView> hizLevelViews;
+	std::uint32_t hizWidth = 0, hizHeight = 0, hizLevels = 0;
+
+	// Descriptors depend on the pyramid; one set per pyramid level, plus
+	// the set of cull.comp
+	lut::DescriptorPool pool;
+	std::vector<VkDescriptorSet> hizSets;
+	VkDescriptorSet cullSet = VK_NULL_HANDLE;
+
+	// Whether the pyramid holds the previous frame's depth. Reset this when a
+	// frame is drawn without the culler.
+	bool hizValid = false;
+};
+
+// Creates the culler for aDraws and records the upload of the mesh bounds
+// into aUploader. The depth buffer must have been created with
+// VK_IMAGE_USAGE_SAMPLED_BIT; the render pass must leave it in
+// VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, with its writes visible
+// to compute shaders.
+GpuCuller create_gpu_culler(
+	lut::VulkanContext const&,
+	lut::Allocator const&,
+	lut::UploadBatcher& aUploader,
+	BakedModel const&,
+	IndirectDraws const&,
+	VkImageView aDepthView,
+	VkExtent2D const& aDepthExtent,
+	char const* aHiZShaderPath,
+	char const* aCullShaderPath
+);
+
+// Recreates the pyramid for a new depth buffer (e.g., after a resize)
+void resize_gpu_culler( GpuCuller&, lut::VulkanContext const&, lut::Allocator const&, VkImageView aDepthView, VkExtent2D const& aDepthExtent );
+
+// Records the culling pass; call before the render pass
+void record_gpu_culling( VkCommandBuffer, GpuCuller const&, Frustum const&, glm::mat4 const& aPreviousProjCam );
+
+// Draws the surviving commands of one pipeline. The pipeline, its descriptor
+// sets and the geometry arena must be bound.
+void draw_gpu_culled( VkCommandBuffer, GpuCuller const&, EDrawPipeline );
+
+// Records the pyramid build from the depth buffer; call after the render
+// pass. Sets hizValid.
+void record_depth_pyramid( VkCommandBuffer, GpuCuller& );
+
+#endif // GPU_CULLING_HPP_7D3F0B86_C25E_4A19_9E47_18B6F2A0D5C3
@@ -0,0 +1,128 @@
+#include "indirect.hpp"
+
+#include <algorithm>
+
+#include <cassert>
+
+EIndirectSupport indirect_draw_support( VkPhysicalDevice aPhysicalDev, std::uint32_t aMaxDrawCount )
+{
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures( aPhysicalDev, &features );
+
+	if( !features.drawIndirectFirstInstance )
+		return EIndirectSupport::none;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties( aPhysicalDev, &props );
+
+	if( features.multiDrawIndirect && aMaxDrawCount <= props.limits.maxDrawIndirectCount )
+		return EIndirectSupport::multi;
+
+	return EIndirectSupport::single;
+}
+
+IndirectDrawPlan plan_indirect_draws( BakedModel const& aModel, std::vector<SceneMesh> const& aMeshes )
+{
+	assert( aModel.meshes.size() == aMeshes.size() );
+
+	// Sort mesh IDs by pipeline, then by material; ties keep the mesh order
+	std::vector<std::uint32_t> order;
+	order.reserve( aMeshes.size() );
+
+	for( std::uint32_t i = 0; i < aMeshes.size(); ++i )
+	{
+		if( 0 != aMeshes[i].indexCount )
+			order.emplace_back( i );
+	}
+
+	auto const pipeline_ = [&] (std::uint32_t aMeshId) {
+		auto const& material = aModel.materials[aModel.meshes[aMeshId].materialId];
+		return 0xffffffff != material.alphaMaskTextureId ? kDrawPipelineAlphaMasked : kDrawPipelineOpaque;
+	};
+
+	std::stable_sort( order.begin(), order.end(), [&] (std::uint32_t aX, std::uint32_t aY) {
+		auto const px = pipeline_( aX ), py = pipeline_( aY );
+		if( px != py )
+			return px < py;
+
+		return aModel.meshes[aX].materialId < aModel.meshes[aY].materialId;
+	} );
+
+	IndirectDrawPlan ret;
+	ret.commands.reserve( order.size() );
+
+	for( auto const meshId : order )
+	{
+		auto const& mesh = aMeshes[meshId];
+
+		VkDrawIndexedIndirectCommand cmd{};
+		cmd.indexCount = mesh.indexCount;
+		cmd.instanceCount = 1;
+		cmd.firstIndex = mesh.firstIndex;
+		cmd.vertexOffset = mesh.vertexOffset;
+		cmd.firstInstance = meshId;
+
+		++ret.count[pipeline_( meshId )];
+		ret.commands.emplace_back( cmd );
+	}
+
+	for( std::uint32_t i = 1; i < kDrawPipelineCount; ++i )
+		ret.first[i] = ret.first[i-1] + ret.count[i-1];
+
+	return ret;
+}
+
+IndirectDraws create_indirect_draws( lut::Allocator const& aAllocator, lut::UploadBatcher& aUploader, IndirectDrawPlan const& aPlan, EIndirectSupport aSupport )
+{
+	assert( EIndirectSupport::none != aSupport );
+
+	auto const bytes = aPlan.commands.size() * sizeof(VkDrawIndexedIndirectCommand);
+
+	IndirectDraws ret;
+
+	// Zero-sized buffers are not allowed
+	ret.commands = lut::create_buffer(
+		aAllocator,
+		std::max<VkDeviceSize>( bytes, sizeof(VkDrawIndexedIndirectCommand) ),
+		VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY
+	);
+
+	if( !aPlan.commands.empty() )
+		aUploader.upload_buffer( ret.commands.buffer, 0, aPlan.commands.data(), bytes );
+
+	for( std::uint32_t i = 0; i < kDrawPipelineCount; ++i )
+	{
+		ret.first[i] = aPlan.first[i];
+		ret.count[i] = aPlan.count[i];
+
+		for( std::uint32_t j = 0; j < aPlan.count[i]; ++j )
+			ret.triangles[i] += aPlan.commands[aPlan.first[i] + j].indexCount / 3;
+	}
+
+	ret.multiDraw = EIndirectSupport::multi == aSupport;
+
+	return ret;
+}
+
+void draw_indirect( VkCommandBuffer aCmdBuff, IndirectDraws const& aDraws, EDrawPipeline aPipeline )
+{
+	assert( aPipeline < kDrawPipelineCount );
+
+	auto const first = aDraws.first[aPipeline];
+	auto const count = aDraws.count[aPipeline];
+	auto constexpr stride = std::uint32_t(sizeof(VkDrawIndexedIndirectCommand));
+
+	if( 0 == count )
+		return;
+
+	if( aDraws.multiDraw )
+	{
+		vkCmdDrawIndexedIndirect( aCmdBuff, aDraws.commands.buffer, VkDeviceSize(first) * stride, count, stride );
+		return;
+	}
+
+	// Without multiDrawIndirect, drawCount must be 0 or 1
+	for( std::uint32_t i = 0; i < count; ++i )
+		vkCmdDrawIndexedIndirect( aCmdBuff, aDraws.commands.buffer, VkDeviceSize(first + i) * stride, 1, stride );
+}
@@ -0,0 +1,92 @@
+#ifndef INDIRECT_HPP_E1A7C5F3_2D84_4B96_8F0E_5C39B7D16A24
+#define INDIRECT_HPP_E1A7C5F3_2D84_4B96_8F0E_5C39B7D16A24
+
+#include <vector>
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include "../labutils/upload.hpp"
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/allocator.hpp"
+namespace lut = labutils;
+
+#include "baked_model.hpp"
+#include "geometry_arena.hpp"
+
+// Indirect draws: the draw commands of all meshes are built once, at load
+// time, and stored in a single buffer. Each frame then issues one
+// vkCmdDrawIndexedIndirect() per pipeline, so the CPU cost of recording does
+// not depend on the number of meshes.
+//
+// Every command draws one whole mesh from the geometry arena, with
+// firstInstance set to the mesh ID. This requires the bindless path (see
+// bindless.hpp), where the shaders find the mesh's data and material through
+// gl_InstanceIndex.
+
+// Pipelines that the commands are grouped by
+enum EDrawPipeline : std::uint32_t
+{
+	kDrawPipelineOpaque,
+	kDrawPipelineAlphaMasked,
+
+	kDrawPipelineCount
+};
+
+// How a device can issue the commands
+enum class EIndirectSupport
+{
+	none,   // no drawIndirectFirstInstance
+	single, // one vkCmdDrawIndexedIndirect() per command
+	multi   // one vkCmdDrawIndexedIndirect() per pipeline
+};
+
+// aMaxDrawCount is the largest number of commands in one call.
+EIndirectSupport indirect_draw_support( VkPhysicalDevice, std::uint32_t aMaxDrawCount );
+
+// CPU-side list of draw commands. Computed separately from the upload so that
+// it can be inspected without a Vulkan device.
+struct IndirectDrawPlan
+{
+	// Grouped by pipeline; within a pipeline, sorted by material and then by
+	// mesh ID
+	std::vector<VkDrawIndexedIndirectCommand> commands;
+
+	// Range of each pipeline's commands
+	std::uint32_t first[kDrawPipelineCount]{};
+	std::uint32_t count[kDrawPipelineCount]{};
+};
+
+// Meshes without indices get no command. aMeshes are the meshes' locations in
+// the geometry arena.
+IndirectDrawPlan plan_indirect_draws( BakedModel const&, std::vector<SceneMesh> const& aMeshes );
+
+struct IndirectDraws
+{
+	lut::Buffer commands;
+
+	std::uint32_t first[kDrawPipelineCount]{};
+	std::uint32_t count[kDrawPipelineCount]{};
+
+	// Triangles drawn by each pipeline's commands
+	std::uint64_t triangles[kDrawPipelineCount]{};
+
+	bool multiDraw = false;
+};
+
+// Creates the command buffer and records its upload into aUploader. The
+// commands may only be used once the upload has been submitted. aSupport must
+// not be EIndirectSupport::none.
+IndirectDraws create_indirect_draws(
+	lut::Allocator const&,
+	lut::UploadBatcher& aUploader,
+	IndirectDrawPlan const&,
+	EIndirectSupport aSupport
+);
+
+// Issues the commands of one pipeline. The pipeline, its descriptor sets and
+// the geometry arena must be bound.
+void draw_indirect( VkCommandBuffer, IndirectDraws const&, EDrawPipeline );
+
+#endif // INDIRECT_HPP_E1A7C5F3_2D84_4B96_8F0E_5C39B7D16A24
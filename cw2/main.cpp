@@ -4,8 +4,10 @@
 #include <vector>
 #include <stdexcept>
 #include <unordered_map>
+#include <algorithm>
 #include <iostream>
 #include <cstdio>
+#include <cstdlib>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
@@ -32,12 +34,26 @@ using namespace labutils::literals;
 #include "../labutils/error.hpp"
 #include "../labutils/vkutil.hpp"
 #include "../labutils/vkimage.hpp"
+#include "../labutils/image_decoder.hpp"
 #include "../labutils/vkobject.hpp"
 #include "../labutils/vkbuffer.hpp"
 #include "../labutils/allocator.hpp" 
+#include "../labutils/gpu_profiler.hpp"
+#include "../labutils/trace.hpp"
 namespace lut = labutils;
 
 #include "baked_model.hpp"
+#include "culling.hpp"
+#include "geometry_arena.hpp"
+#include "baked_texture.hpp"
+#include "bindless.hpp"
+#include "indirect.hpp"
+#include "gpu_culling.hpp"
+#include "clustered_lights.hpp"
+#include "deferred.hpp"
+#include "visibility.hpp"
+#include "screenshot.hpp"
+#include "benchmark.hpp"
 
 
 namespace
@@ -56,6 +72,63 @@ namespace
 		ShaderPath lightingShaderPath{ SHADERDIR_ "lighting.vert.spv", SHADERDIR_ "lighting.frag.spv" };
 		ShaderPath alphamaskShaderPath{ SHADERDIR_ "lighting.vert.spv", SHADERDIR_ "alphamasking.frag.spv" };
 
+		// Same, for models baked with an interleaved (packed) vertex format
+		ShaderPath lightingPackedShaderPath{ SHADERDIR_ "lighting_packed.vert.spv", SHADERDIR_ "lighting.frag.spv" };
+		ShaderPath alphamaskPackedShaderPath{ SHADERDIR_ "lighting_packed.vert.spv", SHADERDIR_ "alphamasking.frag.spv" };
+
+		// Fragment shaders for materials with packed roughness, metalness and
+		// alpha mask textures (see kBakedMaterialPackedRma)
+		char const* lightingRmaFragShaderPath = SHADERDIR_ "lighting_rma.frag.spv";
+		char const* alphamaskRmaFragShaderPath = SHADERDIR_ "alphamasking_rma.frag.spv";
+
+		// Fragment shaders for bindless materials (see bindless.hpp); these
+		// handle both packed and separate material textures
+		char const* lightingBindlessFragShaderPath = SHADERDIR_ "lighting_bindless.frag.spv";
+		char const* alphamaskBindlessFragShaderPath = SHADERDIR_ "alphamasking_bindless.frag.spv";
+
+		// Vertex shaders for bindless materials, which read the per-mesh data
+		// from the bindless set instead of push constants
+		char const* lightingBindlessVertShaderPath = SHADERDIR_ "lighting_bindless.vert.spv";
+		char const* lightingPackedBindlessVertShaderPath = SHADERDIR_ "lighting_packed_bindless.vert.spv";
+
+		// Depth pre-pass (see EPipelineDepth): vertex shaders that output the
+		// position only, for opaque geometry, and fragment shaders that only
+		// alpha test, for alpha-masked geometry (with the lighting vertex
+		// shaders)
+		char const* depthVertShaderPath = SHADERDIR_ "depth.vert.spv";
+		char const* depthPackedVertShaderPath = SHADERDIR_ "depth_packed.vert.spv";
+		char const* depthPackedBindlessVertShaderPath = SHADERDIR_ "depth_packed_bindless.vert.spv";
+		char const* depthAlphamaskFragShaderPath = SHADERDIR_ "depth_alphamask.frag.spv";
+		char const* depthAlphamaskRmaFragShaderPath = SHADERDIR_ "depth_alphamask_rma.frag.spv";
+		char const* depthAlphamaskBindlessFragShaderPath = SHADERDIR_ "depth_alphamask_bindless.frag.spv";
+
+		// Compute shaders for GPU culling (see gpu_culling.hpp)
+		char const* hizShaderPath = SHADERDIR_ "hiz.comp.spv";
+		char const* cullShaderPath = SHADERDIR_ "cull.comp.spv";
+
+		// Compute shader for clustered lighting (see clustered_lights.hpp)
+		char const* clustersShaderPath = SHADERDIR_ "clusters.comp.spv";
+
+		// Deferred shading (see deferred.hpp): fragment shaders that write
+		// the G-buffer instead of shading, with the lighting vertex shaders,
+		// and the fullscreen lighting pass
+		char const* gbufferFragShaderPath = SHADERDIR_ "gbuffer.frag.spv";
+		char const* gbufferAlphamaskFragShaderPath = SHADERDIR_ "gbuffer_alphamask.frag.spv";
+		char const* gbufferRmaFragShaderPath = SHADERDIR_ "gbuffer_rma.frag.spv";
+		char const* gbufferAlphamaskRmaFragShaderPath = SHADERDIR_ "gbuffer_alphamask_rma.frag.spv";
+		char const* gbufferBindlessFragShaderPath = SHADERDIR_ "gbuffer_bindless.frag.spv";
+		char const* gbufferAlphamaskBindlessFragShaderPath = SHADERDIR_ "gbuffer_alphamask_bindless.frag.spv";
+		char const* fullscreenVertShaderPath = SHADERDIR_ "fullscreen.vert.spv";
+		char const* deferredFragShaderPath = SHADERDIR_ "deferred.frag.spv";
+
+		// Visibility buffer (see visibility.hpp): shaders that write the mesh
+		// and triangle IDs only, and the fullscreen resolve
+		char const* visibilityVertShaderPath = SHADERDIR_ "visibility.vert.spv";
+		char const* visibilityPackedVertShaderPath = SHADERDIR_ "visibility_packed.vert.spv";
+		char const* visibilityFragShaderPath = SHADERDIR_ "visibility.frag.spv";
+		char const* visibilityAlphamaskFragShaderPath = SHADERDIR_ "visibility_alphamask.frag.spv";
+		char const* visibilityResolveFragShaderPath = SHADERDIR_ "visibility_resolve.frag.spv";
+
 #		undef SHADERDIR_
 
 		// General rule: with a standard 24 bit or 32 bit float depth buffer,
@@ -77,6 +150,21 @@ namespace
 		constexpr float kCameraSlowMult = 0.05f; // speed multiplier 
 
 		constexpr float kCameraMouseSensitivity = 0.01f; // radians per pixel
+
+		// Number of random point lights, unless given with --lights
+		constexpr std::uint32_t kDefaultLightCount = 256;
+
+		// Headless runs (--headless): size of the offscreen images (that of
+		// the window), and frames rendered unless given with --frames
+		constexpr VkExtent2D kHeadlessExtent{ 1280, 720 };
+		constexpr std::uint32_t kDefaultHeadlessFrames = 100;
+
+		// Benchmarks (--benchmark): frames over which the camera path is
+		// played, unless given with --frames, and frames rendered at the
+		// path's start beforehand, which are not measured (pipeline and
+		// cache warm-up)
+		constexpr std::uint32_t kDefaultBenchmarkFrames = 600;
+		constexpr std::uint32_t kBenchmarkWarmupFrames = 16;
 	}
 	using Clock_ = std::chrono::steady_clock;
 	using Secondsf_ = std::chrono::duration<float, std::ratio<1>>;
@@ -96,6 +184,13 @@ namespace
 			alignas(16) glm::vec3 lightColor{ 1.0f, 1.0f, 1.0f};
 			alignas(16) glm::vec3 ambientColor { 0.02f, 0.02f, 0.02f };
 		};
+
+		// Per-mesh position dequantization (lighting_packed.vert)
+		struct MeshPushConstants
+		{
+			glm::vec4 positionOffset;
+			glm::vec4 positionScale;
+		};
 	}
 	enum class EInputState {
 		forward,
@@ -122,14 +217,150 @@ namespace
 		glm::mat4 camera2world = glm::identity<glm::mat4>();
 
 		glm::vec3 lightPos{ 0.0f, 2.0f, 0.0f };
+
+		// Draw with indirect commands (see indirect.hpp), if supported.
+		// Toggled with I.
+		bool indirectDraws = true;
+
+		// Lay down depth in a pre-pass before shading (see EPipelineDepth).
+		// Toggled with P.
+		bool depthPrepass = false;
+
+		// Camera keyframes printed with K (see benchmark.hpp)
+		std::uint32_t keyframesPrinted = 0;
+	};
+
+	// Depth state of a pipeline. With the depth pre-pass, all geometry is
+	// first drawn by prepass pipelines, which only write depth. The shading
+	// pipelines then test for equal depth without writing it, so that each
+	// pixel is shaded once. Both must compute bit-identical positions; the
+	// vertex shaders declare gl_Position invariant.
+	enum class EPipelineDepth
+	{
+		shaded,      // depth test and write, as without the pre-pass
+		prepass,     // depth only, no color writes
+		shadedEqual  // shading after the pre-pass
 	};
+
+	// Alternatives to the forward render pass
+	enum class EShading
+	{
+		forward,
+		deferred,   // G-buffer and lighting subpass, see deferred.hpp
+		visibility  // visibility buffer and resolve subpass, see visibility.hpp
+	};
+
+	// GPU profiler regions of a frame (see record_commands()); the names
+	// label the summary and the CSV columns
+	enum EGpuRegion : std::uint32_t
+	{
+		kGpuRegionUpload,      // scene uniforms
+		kGpuRegionCompute,     // GPU culling and light assignment
+		kGpuRegionPrepass,     // depth pre-pass, both pipelines
+		kGpuRegionOpaque,
+		kGpuRegionAlphaMask,
+		kGpuRegionFullscreen,  // deferred lighting or visibility resolve
+		kGpuRegionPyramid,     // depth pyramid for GPU culling
+		kGpuRegionCount
+	};
+
+	constexpr char const* kGpuRegionNames[kGpuRegionCount] = {
+		"upload", "compute", "prepass", "opaque", "alphamask", "fullscreen", "pyramid"
+	};
+
+	// Command line options
+	struct Options {
+		std::uint32_t lightCount = cfg::kDefaultLightCount;
+
+		EShading shading = EShading::forward;
+
+		// Render offscreen, without a window (see
+		// lut::make_vulkan_window_headless())
+		bool headless = false;
+
+		// Stop after this many frames; 0 = until the window is closed
+		std::uint32_t frameCount = 0;
+
+		// Headless only: write the last frame to this PNG file
+		char const* pngPath = nullptr;
+
+		// Benchmark: play this camera path (see benchmark.hpp) over
+		// frameCount frames, and optionally write the measurements as CSV
+		char const* cameraPath = nullptr;
+		char const* csvPath = nullptr;
+
+		// Write the GPU profile of each frame as CSV (see lut::GpuProfiler)
+		char const* gpuCsvPath = nullptr;
+
+		// Record CPU trace events, and write them as Chrome trace JSON (see
+		// labutils/trace.hpp)
+		char const* tracePath = nullptr;
+	};
+
+	// Meshes by pipeline (0: opaque, 1: alpha masked), then by material
+	using MaterialMeshes = std::unordered_map<unsigned int, std::unordered_map<unsigned int, std::vector<unsigned int>>>;
+
+	// Inputs of record_commands(), gathered each frame. Objects are not
+	// owned; optional modes are null when not in use.
+	struct FrameCommands {
+		VkRenderPass renderPass = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+		VkExtent2D extent{};
+
+		// Shading pipelines; with the depth pre-pass, also the pre-pass
+		// pipelines (otherwise null), which use the same layouts
+		VkPipelineLayout defaultLayout = VK_NULL_HANDLE;
+		VkPipeline defaultPipe = VK_NULL_HANDLE;
+		VkPipelineLayout alphamaskLayout = VK_NULL_HANDLE;
+		VkPipeline alphamaskPipe = VK_NULL_HANDLE;
+		VkPipeline depthPipe = VK_NULL_HANDLE;
+		VkPipeline depthAlphamaskPipe = VK_NULL_HANDLE;
+
+		// Scene
+		BakedModel const* model = nullptr;
+		GeometryArena const* geometry = nullptr;
+		std::vector<SceneMesh> const* meshes = nullptr;
+
+		VkBuffer sceneUBO = VK_NULL_HANDLE;
+		glsl::SceneUniform sceneUniform{};
+		VkDescriptorSet sceneSet = VK_NULL_HANDLE;
+
+		// Materials: one set per material, or the bindless set (see
+		// bindless.hpp) if not null
+		std::vector<VkDescriptorSet> const* materialSets = nullptr;
+		VkDescriptorSet bindlessSet = VK_NULL_HANDLE;
+		MaterialMeshes const* materialMeshes = nullptr;
+
+		// Indirect draws (see indirect.hpp), optionally culled on the GPU
+		// with the previous frame's depth (see gpu_culling.hpp)
+		IndirectDraws const* indirectDraws = nullptr;
+		GpuCuller* culler = nullptr;
+		glm::mat4 previousProjCam{ 1.f };
+
+		// CPU culling: the view frustum, for clusters, and the meshes that
+		// passed cull_aabbs() (when not drawing indirectly)
+		Frustum frustum{};
+		std::vector<std::uint8_t> const* meshVisible = nullptr;
+
+		ClusteredLights const* lights = nullptr;
+		LightClusterUniform lightUniform{};
+
+		// Alternatives to forward shading, see EShading
+		DeferredLighting const* deferred = nullptr;
+		VisibilityResolve const* visibility = nullptr;
+
+		lut::GpuProfiler* profiler = nullptr;
+		std::uint32_t profilerSlot = 0;
+	};
+
 	// Local functions:
-	lut::RenderPass create_render_pass(lut::VulkanWindow const&);
+	Options parse_options(int aArgc, char* aArgv[]);
+	lut::RenderPass create_render_pass(lut::VulkanWindow const&, bool aKeepDepth = false, VkImageLayout aColorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 	lut::DescriptorSetLayout create_scene_descriptor_layout(lut::VulkanWindow const&);
 	lut::DescriptorSetLayout create_object_descriptor_layout(lut::VulkanWindow const&, VkDescriptorType, unsigned int);
 	lut::PipelineLayout create_pipeline_layout(lut::VulkanContext const&, std::vector<VkDescriptorSetLayout>, unsigned int pushConstantSize = 0);
-	lut::Pipeline create_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, ShaderPath);
-	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator);
+	lut::Pipeline create_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, ShaderPath, baked::BakedVertexFormatV2 = baked::kBakedVertexSeparate, EPipelineDepth = EPipelineDepth::shaded, std::uint32_t aColorAttachmentCount = 1);
+	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator, VkImageUsageFlags aExtraUsage = 0);
 
 	void glfw_callback_key_press(GLFWwindow*, int, int, int, int);
 	void glfw_callback_button(GLFWwindow*, int, int, int);
@@ -137,7 +368,7 @@ namespace
 
 	void update_user_state(UserState&, float aElapsedTime);
 
-	void create_swapchain_framebuffers(lut::VulkanWindow const&, VkRenderPass, std::vector<lut::Framebuffer>&, VkImageView aDepthView);
+	void create_swapchain_framebuffers(lut::VulkanWindow const&, VkRenderPass, std::vector<lut::Framebuffer>&, std::vector<VkImageView> const& aSharedViews);
 
 	void update_scene_uniforms(
 		glsl::SceneUniform&,
@@ -146,12 +377,7 @@ namespace
 		UserState const& aState
 	);
 
-	void record_commands(VkCommandBuffer aCmdBuff, VkRenderPass aRenderPass, VkFramebuffer aFramebuffer,
-		VkPipelineLayout aDefaultPipeLayout, VkPipeline aDefaultPipe, VkPipelineLayout aAlphamaskPipeLayout, 
-		VkPipeline aAlphamaskPipe, VkExtent2D const& aImageExtent, std::vector<SceneMesh> const&,
-		VkBuffer aSceneUBO, glsl::SceneUniform const& aSceneUniform,
-		VkDescriptorSet aSceneDescriptors, std::vector <VkDescriptorSet> aTexDescriptors, BakedModel* aModel, 
-		std::unordered_map <unsigned int, std::unordered_map <unsigned int, std::vector<unsigned int>>> MaterialMeshesMap);
+	void record_commands(VkCommandBuffer, FrameCommands const&, CullStats&);
 
 
 	void submit_commands(
@@ -163,43 +389,274 @@ namespace
 	);
 }
 
-int main() try
+int main(int aArgc, char* aArgv[]) try
 {
+	Options const options = parse_options(aArgc, aArgv);
+
+	if (options.tracePath)
+	{
+		lut::set_trace_thread_name("main");
+		lut::enable_trace(true);
+	}
+
+	// Benchmarks ignore input and follow the camera path
+	bool const benchmark = nullptr != options.cameraPath;
+
+	CameraPath cameraPath;
+	if (benchmark)
+		cameraPath = load_camera_path(options.cameraPath);
+
 	//TODO-implement me.
 	// Create our Vulkan Window
-	lut::VulkanWindow window = lut::make_vulkan_window();
+	bool const headless = options.headless;
+	lut::VulkanWindow window = headless
+		? lut::make_vulkan_window_headless(cfg::kHeadlessExtent)
+		: lut::make_vulkan_window();
 
 	// Configure the GLFW window
 	UserState state{};
-	glfwSetWindowUserPointer(window.window, &state);
-	glfwSetKeyCallback(window.window, &glfw_callback_key_press);
-	glfwSetMouseButtonCallback(window.window, &glfw_callback_button);
-	glfwSetCursorPosCallback(window.window, &glfw_callback_motion);
+	if (!headless && !benchmark)
+	{
+		glfwSetWindowUserPointer(window.window, &state);
+		glfwSetKeyCallback(window.window, &glfw_callback_key_press);
+		glfwSetMouseButtonCallback(window.window, &glfw_callback_button);
+		glfwSetCursorPosCallback(window.window, &glfw_callback_motion);
+	}
 
 	
 	// Create VMA allocator
 	lut::Allocator allocator = lut::create_allocator(window);
 
-	//Creaing resourses for rendering
-	lut::RenderPass renderPass = create_render_pass(window);
-
 	//create scene descriptor set layout
 	lut::DescriptorSetLayout sceneLayout = create_scene_descriptor_layout(window);
 
+	// The model's vertex format determines the vertex input state (and vertex
+	// shader) of the pipelines, so load it first.
+	BakedModel bakedModel = load_baked_model("assets\\cw2\\sponza-pbr.comp5822mesh");
+
+	auto const vertexFormat = bakedModel.vertexFormat;
+	bool const packedVertices = baked::kBakedVertexSeparate != vertexFormat;
+	ShaderPath lightingShaderPath = packedVertices ? cfg::lightingPackedShaderPath : cfg::lightingShaderPath;
+	ShaderPath alphamaskShaderPath = packedVertices ? cfg::alphamaskPackedShaderPath : cfg::alphamaskShaderPath;
+
+	// Likewise, materials with packed textures need fewer bindings. The baker
+	// packs either all materials or none.
+	bool const packedMaterials = !bakedModel.materials.empty() && bakedModel.materials[0].packedRma;
+	for (auto const& material : bakedModel.materials)
+	{
+		if (material.packedRma != packedMaterials)
+			throw lut::Error("Model mixes materials with and without packed textures");
+	}
+
+	// Bindless materials if the device supports them (see bindless.hpp):
+	// one set with all textures, and a material index per draw. Otherwise,
+	// each material gets its own descriptor set. The texture slot after the
+	// model's textures holds the flat normal map.
+	auto const textureSlots = std::uint32_t(bakedModel.textures.size() + 1);
+	bool const bindless = bindless_supported(window.physicalDevice, textureSlots);
+
+	if (bindless)
+	{
+		auto const vertShaderPath = packedVertices ? cfg::lightingPackedBindlessVertShaderPath : cfg::lightingBindlessVertShaderPath;
+		lightingShaderPath = { vertShaderPath, cfg::lightingBindlessFragShaderPath };
+		alphamaskShaderPath = { vertShaderPath, cfg::alphamaskBindlessFragShaderPath };
+	}
+	else if (packedMaterials)
+	{
+		lightingShaderPath.kFragShaderPath = cfg::lightingRmaFragShaderPath;
+		alphamaskShaderPath.kFragShaderPath = cfg::alphamaskRmaFragShaderPath;
+	}
+
+	// The visibility buffer needs the bindless mesh records, and falls back
+	// to forward shading without them
+	EShading shading = options.shading;
+	if (EShading::visibility == shading && !(bindless && visibility_supported(window.physicalDevice) && visibility_fits(window.physicalDevice, bakedModel)))
+	{
+		std::printf("Visibility buffer unsupported by the device or model; using forward shading\n");
+		shading = EShading::forward;
+	}
+
+	bool const deferred = EShading::deferred == shading;
+	bool const visibility = EShading::visibility == shading;
+
+	// Deferred shading draws the meshes into the G-buffer, with the same
+	// vertex shaders and material variants
+	if (deferred)
+	{
+		lightingShaderPath.kFragShaderPath = bindless ? cfg::gbufferBindlessFragShaderPath
+			: packedMaterials ? cfg::gbufferRmaFragShaderPath : cfg::gbufferFragShaderPath;
+		alphamaskShaderPath.kFragShaderPath = bindless ? cfg::gbufferAlphamaskBindlessFragShaderPath
+			: packedMaterials ? cfg::gbufferAlphamaskRmaFragShaderPath : cfg::gbufferAlphamaskFragShaderPath;
+	}
+
+	// The visibility buffer only needs positions, and texture coordinates
+	// for alpha masking
+	if (visibility)
+	{
+		auto const vertShaderPath = packedVertices ? cfg::visibilityPackedVertShaderPath : cfg::visibilityVertShaderPath;
+		lightingShaderPath = { vertShaderPath, cfg::visibilityFragShaderPath };
+		alphamaskShaderPath = { vertShaderPath, cfg::visibilityAlphamaskFragShaderPath };
+	}
+
+	std::printf("Materials: %s\n", bindless ? "bindless" : "one descriptor set each");
+
+	// Indirect draws need the mesh records of the bindless set. At most one
+	// command per mesh is issued at once.
+	auto const indirectSupport = bindless
+		? indirect_draw_support(window.physicalDevice, std::uint32_t(bakedModel.meshes.size()))
+		: EIndirectSupport::none;
+
+	std::printf("Indirect draws: %s\n", EIndirectSupport::multi == indirectSupport
+		? "one per pipeline" : EIndirectSupport::single == indirectSupport ? "one per mesh" : "unsupported");
+
+	// GPU culling of the indirect draws reads the previous frame's depth
+	// buffer, which the render pass must then keep
+	bool const gpuCulling = gpu_culling_supported(window.physicalDevice, indirectSupport);
+	std::printf("GPU culling: %s\n", gpuCulling ? "frustum and occlusion" : "unsupported");
+
+	std::printf("Shading: %s\n", deferred ? "deferred" : visibility ? "visibility buffer" : "forward");
+
+	//Creaing resourses for rendering
+	// Offscreen images are not presented, but may be copied to a PNG
+	VkImageLayout const colorFinalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	auto const create_render_pass_ = [&]() {
+		if (visibility)
+			return create_visibility_render_pass(window, window.swapchainFormat, cfg::kDepthFormat, gpuCulling, colorFinalLayout);
+
+		return deferred
+			? create_deferred_render_pass(window, window.swapchainFormat, cfg::kDepthFormat, gpuCulling, colorFinalLayout)
+			: create_render_pass(window, gpuCulling, colorFinalLayout);
+	};
+
+	lut::RenderPass renderPass = create_render_pass_();
+
 	//create object descriptor set layout
-	lut::DescriptorSetLayout texturedobjectLayout = create_object_descriptor_layout(window, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4);
-	lut::DescriptorSetLayout alphamaskedobjectLayout = create_object_descriptor_layout(window, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 5);
-	
+	// separate: base color, roughness, metalness, (alpha mask,) normal map
+	// packed: base color, roughness/metalness/alpha mask, normal map
+	lut::DescriptorSetLayout texturedobjectLayout, alphamaskedobjectLayout, bindlessLayout;
+	if (bindless)
+	{
+		bindlessLayout = create_bindless_layout(window, textureSlots);
+	}
+	else
+	{
+		texturedobjectLayout = create_object_descriptor_layout(window, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, packedMaterials ? 3 : 4);
+		alphamaskedobjectLayout = create_object_descriptor_layout(window, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, packedMaterials ? 3 : 5);
+	}
+
+	// Point lights of clustered lighting, in set 2 of all pipelines
+	lut::DescriptorSetLayout lightClusterLayout = create_light_cluster_layout(window);
+
+	// With bindless materials, both pipelines share a single layout without
+	// push constants; the per-mesh data is in the bindless set
+	lut::PipelineLayout defaultPipeLayout = bindless
+		? create_pipeline_layout(window, std::vector< VkDescriptorSetLayout> {sceneLayout.handle, bindlessLayout.handle, lightClusterLayout.handle})
+		: create_pipeline_layout(window, std::vector< VkDescriptorSetLayout> {sceneLayout.handle, texturedobjectLayout.handle, lightClusterLayout.handle}, sizeof(glsl::MeshPushConstants));
+
+	lut::PipelineLayout alphamaskPipeLayout;
+	if (!bindless)
+		alphamaskPipeLayout = create_pipeline_layout(window, std::vector< VkDescriptorSetLayout> {sceneLayout.handle, alphamaskedobjectLayout.handle, lightClusterLayout.handle}, sizeof(glsl::MeshPushConstants));
+
+	VkPipelineLayout const alphamaskLayout = bindless ? defaultPipeLayout.handle : alphamaskPipeLayout.handle;
+
+	// Lighting subpass of deferred shading
+	DeferredLighting deferredLighting;
+	if (deferred)
+		deferredLighting = create_deferred_lighting(window, sceneLayout.handle, lightClusterLayout.handle);
+
+	// Resolve subpass of the visibility buffer
+	VisibilityResolve visibilityResolve;
+	if (visibility)
+		visibilityResolve = create_visibility_resolve(window, sceneLayout.handle, bindlessLayout.handle, lightClusterLayout.handle);
+
+	// The mesh pipelines write the G-buffer's color attachments with deferred
+	// shading, and a single one otherwise (the swapchain image, or the
+	// visibility buffer)
+	std::uint32_t const colorAttachmentCount = deferred ? kGBufferColorCount : 1;
+
+	// Depth pre-pass shaders. Opaque geometry needs no fragment shader; with
+	// separate vertex streams, its pipeline reads the position stream only.
+	ShaderPath const depthShaderPath{
+		!packedVertices ? cfg::depthVertShaderPath : bindless ? cfg::depthPackedBindlessVertShaderPath : cfg::depthPackedVertShaderPath,
+		nullptr
+	};
+	ShaderPath const depthAlphamaskShaderPath{
+		alphamaskShaderPath.kVertShaderPath,
+		bindless ? cfg::depthAlphamaskBindlessFragShaderPath : packedMaterials ? cfg::depthAlphamaskRmaFragShaderPath : cfg::depthAlphamaskFragShaderPath
+	};
+
+	// The pipelines depend on the swapchain size (viewport) and are
+	// recreated along with it
+	lut::Pipeline defaultPipe, alphamaskPipe;
+	lut::Pipeline defaultEqualPipe, alphamaskEqualPipe;
+	lut::Pipeline depthPipe, depthAlphamaskPipe;
+
+	auto const create_prepass_pipelines_ = [&]() {
+		defaultEqualPipe = create_pipeline(window, renderPass.handle, defaultPipeLayout.handle, lightingShaderPath, vertexFormat, EPipelineDepth::shadedEqual, colorAttachmentCount);
+		alphamaskEqualPipe = create_pipeline(window, renderPass.handle, alphamaskLayout, alphamaskShaderPath, vertexFormat, EPipelineDepth::shadedEqual, colorAttachmentCount);
+
+		depthPipe = create_pipeline(window, renderPass.handle, defaultPipeLayout.handle, depthShaderPath, vertexFormat, EPipelineDepth::prepass, colorAttachmentCount);
+		depthAlphamaskPipe = create_pipeline(window, renderPass.handle, alphamaskLayout, depthAlphamaskShaderPath, vertexFormat, EPipelineDepth::prepass, colorAttachmentCount);
+	};
+
+	auto const create_pipelines_ = [&]() {
+		defaultPipe = create_pipeline(window, renderPass.handle, defaultPipeLayout.handle, lightingShaderPath, vertexFormat, EPipelineDepth::shaded, colorAttachmentCount);
+		alphamaskPipe = create_pipeline(window, renderPass.handle, alphamaskLayout, alphamaskShaderPath, vertexFormat, EPipelineDepth::shaded, colorAttachmentCount);
+
+		// The pre-pass pipelines are created when the pre-pass is first
+		// enabled (with P), and from then on recreated with the others
+		if (state.depthPrepass || VK_NULL_HANDLE != depthPipe.handle)
+			create_prepass_pipelines_();
+
+		if (deferred)
+		{
+			deferredLighting.pipe = create_fullscreen_pipeline(window, renderPass.handle, deferredLighting.pipeLayout.handle,
+				window.swapchainExtent, cfg::fullscreenVertShaderPath, cfg::deferredFragShaderPath);
+		}
+
+		if (visibility)
+		{
+			visibilityResolve.pipe = create_fullscreen_pipeline(window, renderPass.handle, visibilityResolve.pipeLayout.handle,
+				window.swapchainExtent, cfg::fullscreenVertShaderPath, cfg::visibilityResolveFragShaderPath);
+		}
+	};
 
-	lut::PipelineLayout defaultPipeLayout = create_pipeline_layout(window, std::vector< VkDescriptorSetLayout> {sceneLayout.handle, texturedobjectLayout.handle});
-	lut::Pipeline defaultPipe = create_pipeline(window, renderPass.handle, defaultPipeLayout.handle, cfg::lightingShaderPath);
+	create_pipelines_();
 
-	lut::PipelineLayout alphamaskPipeLayout = create_pipeline_layout(window, std::vector< VkDescriptorSetLayout> {sceneLayout.handle, alphamaskedobjectLayout.handle});
-	lut::Pipeline alphamaskPipe = create_pipeline(window, renderPass.handle, alphamaskPipeLayout.handle, cfg::alphamaskShaderPath);
+	// GPU culling samples the depth buffer; the deferred lighting subpass
+	// reads it as an input attachment
+	VkImageUsageFlags const depthUsage = (gpuCulling ? VK_IMAGE_USAGE_SAMPLED_BIT : 0)
+		| (deferred ? VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT : 0);
+
+	auto [depthBuffer, depthBufferView] = create_depth_buffer(window, allocator, depthUsage);
+
+	// The G-buffer and the visibility buffer depend on the swapchain size,
+	// like the depth buffer. The resolve's inputs also include the geometry
+	// arena, and are written once that exists.
+	GBuffer gbuffer;
+	VisibilityBuffer visibilityBuffer;
+	auto const framebuffer_views_ = [&]() {
+		if (visibility)
+			return std::vector<VkImageView>{ depthBufferView.handle, visibilityBuffer.view.handle };
+
+		if (!deferred)
+			return std::vector<VkImageView>{ depthBufferView.handle };
+
+		return std::vector<VkImageView>{ depthBufferView.handle, gbuffer.albedoView.handle, gbuffer.normalView.handle, gbuffer.materialView.handle };
+	};
+
+	if (deferred)
+	{
+		gbuffer = create_gbuffer(window, allocator, window.swapchainExtent);
+		update_deferred_inputs(window, deferredLighting, gbuffer, depthBufferView.handle);
+	}
+
+	if (visibility)
+		visibilityBuffer = create_visibility_buffer(window, allocator, window.swapchainExtent);
 
-	auto [depthBuffer, depthBufferView] = create_depth_buffer(window, allocator);
 	std::vector<lut::Framebuffer> framebuffers;
-	create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
+	create_swapchain_framebuffers(window, renderPass.handle, framebuffers, framebuffer_views_());
 
 	lut::CommandPool cpool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
@@ -215,20 +672,33 @@ int main() try
 	lut::Semaphore imageAvailable = lut::create_semaphore(window);
 	lut::Semaphore renderFinished = lut::create_semaphore(window);
 
+	// GPU timing and shader invocation counts of the frame's regions, one
+	// profiler slot per command buffer. A slot is read back once its fence
+	// has signalled, i.e., when the command buffer is reused.
+	lut::GpuProfiler gpuProfiler = lut::create_gpu_profiler(window,
+		std::vector<char const*>(std::begin(kGpuRegionNames), std::end(kGpuRegionNames)), std::uint32_t(cbuffers.size()), true);
+
+	if (options.gpuCsvPath)
+		gpuProfiler.open_csv(options.gpuCsvPath);
+
 	//////////////////////////////////////////////////////////////////////////////////
 
-	BakedModel bakedModel = load_baked_model("assets\\cw2\\sponza-pbr.comp5822mesh");
-	
-	//Create a buffer for each mesh
+	// Geometry and textures are uploaded in a few large batches; see
+	// finish() below.
+	lut::UploadBatcher uploader = lut::create_upload_batcher(window, allocator);
+
+	// Upload all meshes into a shared vertex and index buffer
 	std::vector<SceneMesh> sceneMeshes;
-	sceneMeshes.resize(bakedModel.meshes.size());
-	create_mesh(bakedModel, allocator, window, sceneMeshes);
+	GeometryArena geometry = create_geometry_arena(bakedModel, allocator, uploader, sceneMeshes);
+
+	if (visibility)
+		update_visibility_inputs(window, visibilityResolve, visibilityBuffer, geometry);
 	
 	
 	// Create a Pipeline ->( Material->Meshes) Map so that all meshes with same material can be drawn consequently
 	// thus redusing the number of descriptor binding
 	// Materials of default pipeline are stored in Pipeline 0 and alphamask materials are stored in Pipeline 1
-	std::unordered_map<unsigned int , std::unordered_map <unsigned int, std::vector<unsigned int>>> MaterialMeshesMap;
+	MaterialMeshes MaterialMeshesMap;
 
 	for (unsigned int i = 0; i < bakedModel.meshes.size(); i++)
 	{
@@ -237,6 +707,13 @@ int main() try
 		else
 			MaterialMeshesMap[0][bakedModel.meshes[i].materialId].emplace_back(i);
 	}
+
+	// Mesh bounds for frustum culling. Meshes without bounds are always drawn.
+	AabbList meshBounds;
+	for (auto const& mesh : bakedModel.meshes)
+		add_aabb(meshBounds, mesh.aabbMin, mesh.aabbMax);
+
+	std::vector<std::uint8_t> meshVisible(bakedModel.meshes.size());
 	
 	//create scene uniform buffer with lut::create_buffer()
 	lut::Buffer sceneUBO = lut::create_buffer(
@@ -276,7 +753,8 @@ int main() try
 		Roughness = 1,
 		Metalness = 2,
 		AlphaMask = 3,
-		NormalMap = 4
+		NormalMap = 4,
+		PackedRma = 5
 	};
 	// load textures into imag
 
@@ -289,30 +767,63 @@ int main() try
 	// For each texture in model, create image 
 	std::vector <lut::Image> texImages;
 	texImages.resize(bakedModel.textures.size()+1); //+1 for dummy normalmap
+
+	// Textures are decoded on worker threads (below); collect the requests
+	// first. Baked textures (see baked_texture.hpp) need no decoding.
+	std::vector<unsigned int> texRequestIds;
+	std::vector<lut::ImageRequest> texRequests;
+
+	std::vector<unsigned int> bakedTexIds;
+	std::vector<lut::ImageRequest> bakedTexRequests;
+
+	// Format of each image (and its view). Baked textures may be stored in a
+	// different (e.g., block compressed) format, see below.
+	std::vector<VkFormat> texFormats(texImages.size(), VK_FORMAT_UNDEFINED);
+	bool needFlatNormalMap = false;
+
+	auto const request_texture_ = [&](unsigned int aTexId, std::string const& aPath, VkFormat aFormat) {
+		texFormats[aTexId] = aFormat;
+		if (is_baked_texture(aPath))
+		{
+			bakedTexIds.emplace_back(aTexId);
+			bakedTexRequests.emplace_back(lut::ImageRequest{ "assets/cw2/" + aPath, aFormat });
+		}
+		else
+		{
+			texRequestIds.emplace_back(aTexId);
+			texRequests.emplace_back(lut::ImageRequest{ "assets/cw2/" + aPath, aFormat });
+		}
+	};
+
 	for (unsigned int i = 0; i < bakedModel.materials.size(); i++)
 	{	
 		{
 			// Basecolor Texture
 			if (TexIDTextypeMap.find(bakedModel.materials[i].baseColorTextureId) == TexIDTextypeMap.end())
 			{
-				lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-				texImages[bakedModel.materials[i].baseColorTextureId] = (lut::load_image_texture2d(bakedModel.textures[bakedModel.materials[i].baseColorTextureId].path.c_str(), window, loadCmdPool.handle, allocator, VK_FORMAT_R8G8B8A8_SRGB));
+				request_texture_(bakedModel.materials[i].baseColorTextureId, bakedModel.textures[bakedModel.materials[i].baseColorTextureId].path, VK_FORMAT_R8G8B8A8_SRGB);
 				
 				TexIDTextypeMap[bakedModel.materials[i].baseColorTextureId] =  BaseColor;
 			}
+			// Packed roughness, metalness and alpha mask; all three IDs refer
+			// to the same texture, so it is requested only once
+			if (bakedModel.materials[i].packedRma && TexIDTextypeMap.find(bakedModel.materials[i].roughnessTextureId) == TexIDTextypeMap.end())
+			{
+				request_texture_(bakedModel.materials[i].roughnessTextureId, bakedModel.textures[bakedModel.materials[i].roughnessTextureId].path, VK_FORMAT_R8G8B8A8_UNORM);
+
+				TexIDTextypeMap[bakedModel.materials[i].roughnessTextureId] = PackedRma;
+			}
 			// Roughness
 			if (TexIDTextypeMap.find(bakedModel.materials[i].roughnessTextureId) == TexIDTextypeMap.end())
 			{
-				lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-				texImages[bakedModel.materials[i].roughnessTextureId] = (lut::load_image_texture2d(bakedModel.textures[bakedModel.materials[i].roughnessTextureId].path.c_str(), window, loadCmdPool.handle, allocator, VK_FORMAT_R8_UNORM));
+				request_texture_(bakedModel.materials[i].roughnessTextureId, bakedModel.textures[bakedModel.materials[i].roughnessTextureId].path, VK_FORMAT_R8_UNORM);
 				
 				TexIDTextypeMap[bakedModel.materials[i].roughnessTextureId] = Roughness;
 			}
 			// Metalness
 			if (TexIDTextypeMap.find(bakedModel.materials[i].metalnessTextureId) == TexIDTextypeMap.end())
 			{
-				lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-				texImages[bakedModel.materials[i].metalnessTextureId] = (lut::load_image_texture2d(bakedModel.textures[bakedModel.materials[i].metalnessTextureId].path.c_str(), window, loadCmdPool.handle, allocator, VK_FORMAT_R8_UNORM));
+				request_texture_(bakedModel.materials[i].metalnessTextureId, bakedModel.textures[bakedModel.materials[i].metalnessTextureId].path, VK_FORMAT_R8_UNORM);
 				
 				TexIDTextypeMap[bakedModel.materials[i].metalnessTextureId] = Metalness;
 			}
@@ -321,8 +832,7 @@ int main() try
 			{
 				if (TexIDTextypeMap.find(bakedModel.materials[i].alphaMaskTextureId) == TexIDTextypeMap.end())
 				{
-					lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-					texImages[bakedModel.materials[i].alphaMaskTextureId] = (lut::load_image_texture2d(bakedModel.textures[bakedModel.materials[i].alphaMaskTextureId].path.c_str(), window, loadCmdPool.handle, allocator, VK_FORMAT_R8_UNORM));
+					request_texture_(bakedModel.materials[i].alphaMaskTextureId, bakedModel.textures[bakedModel.materials[i].alphaMaskTextureId].path, VK_FORMAT_R8_UNORM);
 						
 					TexIDTextypeMap[bakedModel.materials[i].alphaMaskTextureId] = AlphaMask;
 				}
@@ -332,8 +842,7 @@ int main() try
 			{
 				if (TexIDTextypeMap.find(bakedModel.materials[i].normalMapTextureId) == TexIDTextypeMap.end())
 				{
-					lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-					texImages[bakedModel.materials[i].normalMapTextureId] = (lut::load_image_texture2d(bakedModel.textures[bakedModel.materials[i].normalMapTextureId].path.c_str(), window, loadCmdPool.handle, allocator, VK_FORMAT_R8G8B8A8_UNORM));
+					request_texture_(bakedModel.materials[i].normalMapTextureId, bakedModel.textures[bakedModel.materials[i].normalMapTextureId].path, VK_FORMAT_R8G8B8A8_UNORM);
 
 					TexIDTextypeMap[bakedModel.materials[i].normalMapTextureId] = NormalMap;
 					
@@ -343,9 +852,9 @@ int main() try
 			{
 				if (TexIDTextypeMap.find(bakedModel.textures.size()) == TexIDTextypeMap.end())
 				{
-					lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 					//Save it at the end of array
-					texImages[bakedModel.textures.size()] = (lut::load_image_texture2d(bakedModel.textures[bakedModel.materials[0].baseColorTextureId].path.c_str(), window, loadCmdPool.handle, allocator, VK_FORMAT_R8G8B8A8_UNORM));
+					texFormats[bakedModel.textures.size()] = VK_FORMAT_R8G8B8A8_UNORM;
+					needFlatNormalMap = true;
 
 					TexIDTextypeMap[bakedModel.textures.size()] = NormalMap;
 				}
@@ -354,19 +863,102 @@ int main() try
 		}	
 	}
 
+	// Decode in parallel, and upload each texture as soon as it is ready
+	auto const decodeStart = Clock_::now();
+	{
+		LUT_TRACE_SCOPE("textures");
+
+		lut::ImageDecoder decoder = lut::decode_images(std::move(texRequests));
+
+		VkPhysicalDeviceFeatures features{};
+		vkGetPhysicalDeviceFeatures(window.physicalDevice, &features);
+
+		// Baked textures already contain their mips; upload them while the
+		// others are being decoded
+		for (std::size_t i = 0; i < bakedTexIds.size(); ++i)
+		{
+			LUT_TRACE_SCOPE("baked_texture");
+
+			auto const& request = bakedTexRequests[i];
+			auto const texture = load_baked_texture(request.path.c_str());
+			if (baked::texture_is_compressed(texture.format) && !features.textureCompressionBC)
+				throw lut::Error("%s: block compressed textures are not supported by this device (bake with --texture-compression none)", request.path.c_str());
+
+			texImages[bakedTexIds[i]] = upload_baked_texture(texture, uploader, allocator);
+			texFormats[bakedTexIds[i]] = baked_texture_format(texture.format);
+		}
+
+		for (std::size_t i = 0; i < texRequestIds.size(); ++i)
+		{
+			LUT_TRACE_SCOPE("decoded_texture"); // including the wait
+			texImages[texRequestIds[i]] = lut::upload_image_texture2d(decoder.wait(i), uploader, allocator, texFormats[texRequestIds[i]]);
+		}
+
+		// Flat normal map (0, 0, 1) for materials without one
+		if (needFlatNormalMap)
+		{
+			std::uint8_t const flatNormal[4] = { 128, 128, 255, 255 };
+			auto const image = lut::copy_image_data(1, 1, 4, flatNormal);
+
+			texImages[bakedModel.textures.size()] = lut::upload_image_texture2d(image, uploader, allocator, VK_FORMAT_R8G8B8A8_UNORM);
+		}
+	}
+
+	// Material and mesh records for the bindless path
+	lut::Buffer materialBuffer, meshBuffer;
+	if (bindless)
+	{
+		materialBuffer = create_material_buffer(allocator, uploader, make_bindless_materials(bakedModel, textureSlots - 1));
+		meshBuffer = create_mesh_buffer(allocator, uploader, make_bindless_meshes(bakedModel, sceneMeshes));
+	}
+
+	// Draw commands for all meshes, built once
+	IndirectDraws indirectDraws;
+	if (EIndirectSupport::none != indirectSupport)
+		indirectDraws = create_indirect_draws(allocator, uploader, plan_indirect_draws(bakedModel, sceneMeshes), indirectSupport);
+
+	GpuCuller culler;
+	if (gpuCulling)
+	{
+		culler = create_gpu_culler(window, allocator, uploader, bakedModel, indirectDraws, depthBufferView.handle, window.swapchainExtent,
+			cfg::hizShaderPath, cfg::cullShaderPath);
+	}
+
+	// Benchmark lighting: random point lights throughout the model
+	glm::vec3 sceneMin, sceneMax;
+	model_bounds(bakedModel, sceneMin, sceneMax);
+
+	auto const pointLights = make_random_lights(options.lightCount, sceneMin, sceneMax);
+	ClusteredLights clusteredLights = create_clustered_lights(window, allocator, uploader, lightClusterLayout.handle,
+		pointLights, cfg::clustersShaderPath);
+
+	std::printf("Point lights: %u, radius %.2f\n", clusteredLights.lightCount,
+		pointLights.empty() ? 0.0 : double(pointLights[0].positionRadius.w));
+
+	// Submit the remaining uploads and wait for all of them
+	uploader.finish();
+
+	auto const& uploadStats = uploader.stats();
+	std::printf("Loaded %zu textures (%zu baked) in %.3f s\n", texRequestIds.size() + bakedTexIds.size(), bakedTexIds.size(),
+		std::chrono::duration_cast<Secondsf_>(Clock_::now() - decodeStart).count());
+	std::printf("Uploaded %.1f MB in %u submits, %.3f s (%.1f MB/s)\n",
+		double(uploadStats.bytes) / (1024.0 * 1024.0), uploadStats.submits, uploadStats.seconds, uploadStats.megabytes_per_second());
+
 	
 	std::vector <lut::ImageView> texImageViews;
 	texImageViews.reserve(texImages.size());
 
 	for (unsigned int i = 0; i < texImages.size(); i++)
 	{
+		// The flat normal map only exists if a material needs it
+		if (VK_NULL_HANDLE == texImages[i].image)
+		{
+			texImageViews.emplace_back();
+			continue;
+		}
+
 		// Create view for the texture
-		if(TexIDTextypeMap[i] == BaseColor)
-			texImageViews.emplace_back(lut::create_image_view_texture2d(window, texImages[i].image, VK_FORMAT_R8G8B8A8_SRGB));
-		else if (TexIDTextypeMap[i] == NormalMap)
-			texImageViews.emplace_back(lut::create_image_view_texture2d(window, texImages[i].image, VK_FORMAT_R8G8B8A8_UNORM));
-		else
-			texImageViews.emplace_back(lut::create_image_view_texture2d(window, texImages[i].image, VK_FORMAT_R8_UNORM));
+		texImageViews.emplace_back(lut::create_image_view_texture2d(window, texImages[i].image, texFormats[i]));
 	}
 
 
@@ -375,144 +967,210 @@ int main() try
 	
 	// allocate and initialize descriptor sets for texture
 	std::vector <VkDescriptorSet> materialDescriptors;
-	for (unsigned int i = 0; i < bakedModel.materials.size(); i++)
+	BindlessSet bindlessSet;
+	if (bindless)
 	{
-		if(bakedModel.materials[i].alphaMaskTextureId != 0xffffffff)
-		{ 
-			VkDescriptorSet oDescriptors = lut::alloc_desc_set(window, dpool.handle, alphamaskedobjectLayout.handle);
+		std::vector<VkImageView> views;
+		views.reserve(texImageViews.size());
+		for (auto const& view : texImageViews)
+			views.emplace_back(view.handle);
+
+		bindlessSet = create_bindless_set(window, bindlessLayout.handle, views, defaultSampler.handle, materialBuffer.buffer, meshBuffer.buffer);
+	}
+	else
+	{
+		for (unsigned int i = 0; i < bakedModel.materials.size(); i++)
+		{
+			if (bakedModel.materials[i].packedRma)
 			{
-				VkWriteDescriptorSet desc[5]{};
-
-				VkDescriptorImageInfo basetextureInfo{};
-				basetextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				basetextureInfo.imageView = texImageViews[bakedModel.materials[i].baseColorTextureId].handle;
-				basetextureInfo.sampler = defaultSampler.handle;
-
-				desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[0].dstSet = oDescriptors;
-				desc[0].dstBinding = 0;
-				desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[0].descriptorCount = 1;
-				desc[0].pImageInfo = &basetextureInfo;
-
-				VkDescriptorImageInfo roughtextureInfo{};
-				roughtextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				roughtextureInfo.imageView = texImageViews[bakedModel.materials[i].roughnessTextureId].handle;
-				roughtextureInfo.sampler = defaultSampler.handle;
-
-				desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[1].dstSet = oDescriptors;
-				desc[1].dstBinding = 1;
-				desc[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[1].descriptorCount = 1;
-				desc[1].pImageInfo = &roughtextureInfo;
-
-				VkDescriptorImageInfo metaltextureInfo{};
-				metaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				metaltextureInfo.imageView = texImageViews[bakedModel.materials[i].metalnessTextureId].handle;
-				metaltextureInfo.sampler = defaultSampler.handle;
-
-				desc[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[2].dstSet = oDescriptors;
-				desc[2].dstBinding = 2;
-				desc[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[2].descriptorCount = 1;
-				desc[2].pImageInfo = &metaltextureInfo;
-
-				VkDescriptorImageInfo alphatextureInfo{};
-				alphatextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				alphatextureInfo.imageView = texImageViews[bakedModel.materials[i].alphaMaskTextureId].handle;
-				alphatextureInfo.sampler = defaultSampler.handle;
-
-				desc[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[3].dstSet = oDescriptors;
-				desc[3].dstBinding = 3;
-				desc[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[3].descriptorCount = 1;
-				desc[3].pImageInfo = &alphatextureInfo;
-
-				VkDescriptorImageInfo normaltextureInfo{};
-				normaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				if (bakedModel.materials[i].normalMapTextureId != 0xffffffff)
-					normaltextureInfo.imageView = texImageViews[bakedModel.materials[i].normalMapTextureId].handle;
-				else
-					normaltextureInfo.imageView = texImageViews[bakedModel.textures.size()].handle;
-				normaltextureInfo.sampler = defaultSampler.handle;
-
-				desc[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[4].dstSet = oDescriptors;
-				desc[4].dstBinding = 4;
-				desc[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[4].descriptorCount = 1;
-				desc[4].pImageInfo = &normaltextureInfo;
-
-				constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
-				vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
-
-				materialDescriptors.push_back(oDescriptors);
+				// Same bindings for both pipelines; only the shaders differ
+				bool const alphaMasked = bakedModel.materials[i].alphaMaskTextureId != 0xffffffff;
+				VkDescriptorSet oDescriptors = lut::alloc_desc_set(window, dpool.handle, alphaMasked ? alphamaskedobjectLayout.handle : texturedobjectLayout.handle);
+				{
+					VkWriteDescriptorSet desc[3]{};
+
+					VkDescriptorImageInfo basetextureInfo{};
+					basetextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					basetextureInfo.imageView = texImageViews[bakedModel.materials[i].baseColorTextureId].handle;
+					basetextureInfo.sampler = defaultSampler.handle;
+
+					desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[0].dstSet = oDescriptors;
+					desc[0].dstBinding = 0;
+					desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[0].descriptorCount = 1;
+					desc[0].pImageInfo = &basetextureInfo;
+
+					VkDescriptorImageInfo rmatextureInfo{};
+					rmatextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					rmatextureInfo.imageView = texImageViews[bakedModel.materials[i].roughnessTextureId].handle;
+					rmatextureInfo.sampler = defaultSampler.handle;
+
+					desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[1].dstSet = oDescriptors;
+					desc[1].dstBinding = 1;
+					desc[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[1].descriptorCount = 1;
+					desc[1].pImageInfo = &rmatextureInfo;
+
+					VkDescriptorImageInfo normaltextureInfo{};
+					normaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					if (bakedModel.materials[i].normalMapTextureId != 0xffffffff)
+						normaltextureInfo.imageView = texImageViews[bakedModel.materials[i].normalMapTextureId].handle;
+					else
+						normaltextureInfo.imageView = texImageViews[bakedModel.textures.size()].handle;
+					normaltextureInfo.sampler = defaultSampler.handle;
+
+					desc[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[2].dstSet = oDescriptors;
+					desc[2].dstBinding = 2;
+					desc[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[2].descriptorCount = 1;
+					desc[2].pImageInfo = &normaltextureInfo;
+
+					constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+					vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
+
+					materialDescriptors.push_back(oDescriptors);
+				}
 			}
-		}
-		else
-		{
-			VkDescriptorSet oDescriptors = lut::alloc_desc_set(window, dpool.handle, texturedobjectLayout.handle);
+			else if(bakedModel.materials[i].alphaMaskTextureId != 0xffffffff)
+			{ 
+				VkDescriptorSet oDescriptors = lut::alloc_desc_set(window, dpool.handle, alphamaskedobjectLayout.handle);
+				{
+					VkWriteDescriptorSet desc[5]{};
+
+					VkDescriptorImageInfo basetextureInfo{};
+					basetextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					basetextureInfo.imageView = texImageViews[bakedModel.materials[i].baseColorTextureId].handle;
+					basetextureInfo.sampler = defaultSampler.handle;
+
+					desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[0].dstSet = oDescriptors;
+					desc[0].dstBinding = 0;
+					desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[0].descriptorCount = 1;
+					desc[0].pImageInfo = &basetextureInfo;
+
+					VkDescriptorImageInfo roughtextureInfo{};
+					roughtextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					roughtextureInfo.imageView = texImageViews[bakedModel.materials[i].roughnessTextureId].handle;
+					roughtextureInfo.sampler = defaultSampler.handle;
+
+					desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[1].dstSet = oDescriptors;
+					desc[1].dstBinding = 1;
+					desc[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[1].descriptorCount = 1;
+					desc[1].pImageInfo = &roughtextureInfo;
+
+					VkDescriptorImageInfo metaltextureInfo{};
+					metaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					metaltextureInfo.imageView = texImageViews[bakedModel.materials[i].metalnessTextureId].handle;
+					metaltextureInfo.sampler = defaultSampler.handle;
+
+					desc[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[2].dstSet = oDescriptors;
+					desc[2].dstBinding = 2;
+					desc[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[2].descriptorCount = 1;
+					desc[2].pImageInfo = &metaltextureInfo;
+
+					VkDescriptorImageInfo alphatextureInfo{};
+					alphatextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					alphatextureInfo.imageView = texImageViews[bakedModel.materials[i].alphaMaskTextureId].handle;
+					alphatextureInfo.sampler = defaultSampler.handle;
+
+					desc[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[3].dstSet = oDescriptors;
+					desc[3].dstBinding = 3;
+					desc[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[3].descriptorCount = 1;
+					desc[3].pImageInfo = &alphatextureInfo;
+
+					VkDescriptorImageInfo normaltextureInfo{};
+					normaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					if (bakedModel.materials[i].normalMapTextureId != 0xffffffff)
+						normaltextureInfo.imageView = texImageViews[bakedModel.materials[i].normalMapTextureId].handle;
+					else
+						normaltextureInfo.imageView = texImageViews[bakedModel.textures.size()].handle;
+					normaltextureInfo.sampler = defaultSampler.handle;
+
+					desc[4].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[4].dstSet = oDescriptors;
+					desc[4].dstBinding = 4;
+					desc[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[4].descriptorCount = 1;
+					desc[4].pImageInfo = &normaltextureInfo;
+
+					constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+					vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
+
+					materialDescriptors.push_back(oDescriptors);
+				}
+			}
+			else
 			{
-				VkWriteDescriptorSet desc[4]{};
-
-				VkDescriptorImageInfo basetextureInfo{};
-				basetextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				basetextureInfo.imageView = texImageViews[bakedModel.materials[i].baseColorTextureId].handle;
-				basetextureInfo.sampler = defaultSampler.handle;
-
-				desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[0].dstSet = oDescriptors;
-				desc[0].dstBinding = 0;
-				desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[0].descriptorCount = 1;
-				desc[0].pImageInfo = &basetextureInfo;
-
-				VkDescriptorImageInfo roughtextureInfo{};
-				roughtextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				roughtextureInfo.imageView = texImageViews[bakedModel.materials[i].roughnessTextureId].handle;
-				roughtextureInfo.sampler = defaultSampler.handle;
-
-				desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[1].dstSet = oDescriptors;
-				desc[1].dstBinding = 1;
-				desc[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[1].descriptorCount = 1;
-				desc[1].pImageInfo = &roughtextureInfo;
-
-				VkDescriptorImageInfo metaltextureInfo{};
-				metaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				metaltextureInfo.imageView = texImageViews[bakedModel.materials[i].metalnessTextureId].handle;
-				metaltextureInfo.sampler = defaultSampler.handle;
-
-				desc[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[2].dstSet = oDescriptors;
-				desc[2].dstBinding = 2;
-				desc[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[2].descriptorCount = 1;
-				desc[2].pImageInfo = &metaltextureInfo;
-
-				VkDescriptorImageInfo normaltextureInfo{};
-				normaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-				if (bakedModel.materials[i].normalMapTextureId != 0xffffffff)
-					normaltextureInfo.imageView = texImageViews[bakedModel.materials[i].normalMapTextureId].handle;
-				else
-					normaltextureInfo.imageView = texImageViews[bakedModel.textures.size()].handle;
-				normaltextureInfo.sampler = defaultSampler.handle;
-
-				desc[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-				desc[3].dstSet = oDescriptors;
-				desc[3].dstBinding = 3;
-				desc[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-				desc[3].descriptorCount = 1;
-				desc[3].pImageInfo = &normaltextureInfo;
-
-				constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
-				vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
-
-				materialDescriptors.push_back(oDescriptors);
+				VkDescriptorSet oDescriptors = lut::alloc_desc_set(window, dpool.handle, texturedobjectLayout.handle);
+				{
+					VkWriteDescriptorSet desc[4]{};
+
+					VkDescriptorImageInfo basetextureInfo{};
+					basetextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					basetextureInfo.imageView = texImageViews[bakedModel.materials[i].baseColorTextureId].handle;
+					basetextureInfo.sampler = defaultSampler.handle;
+
+					desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[0].dstSet = oDescriptors;
+					desc[0].dstBinding = 0;
+					desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[0].descriptorCount = 1;
+					desc[0].pImageInfo = &basetextureInfo;
+
+					VkDescriptorImageInfo roughtextureInfo{};
+					roughtextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					roughtextureInfo.imageView = texImageViews[bakedModel.materials[i].roughnessTextureId].handle;
+					roughtextureInfo.sampler = defaultSampler.handle;
+
+					desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[1].dstSet = oDescriptors;
+					desc[1].dstBinding = 1;
+					desc[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[1].descriptorCount = 1;
+					desc[1].pImageInfo = &roughtextureInfo;
+
+					VkDescriptorImageInfo metaltextureInfo{};
+					metaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					metaltextureInfo.imageView = texImageViews[bakedModel.materials[i].metalnessTextureId].handle;
+					metaltextureInfo.sampler = defaultSampler.handle;
+
+					desc[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[2].dstSet = oDescriptors;
+					desc[2].dstBinding = 2;
+					desc[2].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[2].descriptorCount = 1;
+					desc[2].pImageInfo = &metaltextureInfo;
+
+					VkDescriptorImageInfo normaltextureInfo{};
+					normaltextureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+					if (bakedModel.materials[i].normalMapTextureId != 0xffffffff)
+						normaltextureInfo.imageView = texImageViews[bakedModel.materials[i].normalMapTextureId].handle;
+					else
+						normaltextureInfo.imageView = texImageViews[bakedModel.textures.size()].handle;
+					normaltextureInfo.sampler = defaultSampler.handle;
+
+					desc[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+					desc[3].dstSet = oDescriptors;
+					desc[3].dstBinding = 3;
+					desc[3].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+					desc[3].descriptorCount = 1;
+					desc[3].pImageInfo = &normaltextureInfo;
+
+					constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+					vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
+
+					materialDescriptors.push_back(oDescriptors);
+				}
 			}
 		}
 	}
@@ -522,9 +1180,51 @@ int main() try
 	bool recreateSwapchain = false;
 	auto previousClock = Clock_::now();
 
-	while (!glfwWindowShouldClose(window.window))
+	// Culling counters, summed over frames and printed about once per second
+	CullStats cullStats{};
+	std::size_t statsFrames = 0;
+	auto statsClock = previousClock;
+
+	// The depth pyramid for GPU culling is rendered with the previous
+	// frame's camera
+	glm::mat4 previousProjCam = glm::identity<glm::mat4>();
+
+	// Headless runs render into the offscreen images in turn, without
+	// acquiring or presenting them
+	std::uint32_t framesRendered = 0;
+	std::uint32_t lastImageIndex = 0;
+
+	// Benchmarks measure the frames after the warm-up
+	std::uint32_t const warmupFrames = benchmark ? cfg::kBenchmarkWarmupFrames : 0;
+	std::uint32_t const frameLimit = 0 != options.frameCount ? warmupFrames + options.frameCount : 0;
+
+	std::vector<FrameSample> frameSamples;
+	frameSamples.reserve(options.frameCount);
+
+	// Reads back a command buffer's GPU profile. The profiler numbers frames
+	// like framesRendered, as each recorded frame is submitted.
+	lut::GpuProfileFrame gpuFrame;
+
+	auto const collect_gpu_profile_ = [&](std::uint32_t aIndex) {
+		if (!gpuProfiler.collect(aIndex, gpuFrame))
+			return;
+
+		auto const frame = gpuFrame.frame;
+		if (benchmark && frame >= warmupFrames && frame - warmupFrames < frameSamples.size())
+			frameSamples[frame - warmupFrames].gpuMs = gpuFrame.totalMs;
+	};
+
+	while (headless || !glfwWindowShouldClose(window.window))
 	{
-		glfwPollEvents(); // or: glfwWaitEvents()
+		if (0 != frameLimit && framesRendered == frameLimit)
+			break;
+
+		LUT_TRACE_SCOPE("frame");
+
+		auto const frameStart = Clock_::now();
+
+		if (!headless)
+			glfwPollEvents(); // or: glfwWaitEvents()
 
 		// Recreate swap chain?
 		if (recreateSwapchain)
@@ -538,19 +1238,33 @@ int main() try
 			auto const changes = recreate_swapchain(window);
 
 			if (changes.changedFormat)
-				renderPass = create_render_pass(window);
+				renderPass = create_render_pass_();
 
 			if (changes.changedSize)
-				std::tie(depthBuffer, depthBufferView) = create_depth_buffer(window, allocator);
+			{
+				std::tie(depthBuffer, depthBufferView) = create_depth_buffer(window, allocator, depthUsage);
+
+				if (gpuCulling)
+					resize_gpu_culler(culler, window, allocator, depthBufferView.handle, window.swapchainExtent);
+
+				if (deferred)
+				{
+					gbuffer = create_gbuffer(window, allocator, window.swapchainExtent);
+					update_deferred_inputs(window, deferredLighting, gbuffer, depthBufferView.handle);
+				}
+
+				if (visibility)
+				{
+					visibilityBuffer = create_visibility_buffer(window, allocator, window.swapchainExtent);
+					update_visibility_inputs(window, visibilityResolve, visibilityBuffer, geometry);
+				}
+			}
 
 			framebuffers.clear();
-			create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
+			create_swapchain_framebuffers(window, renderPass.handle, framebuffers, framebuffer_views_());
 
 			if (changes.changedSize)
-			{
-				defaultPipe = create_pipeline(window, renderPass.handle, defaultPipeLayout.handle, cfg::lightingShaderPath);
-				alphamaskPipe = create_pipeline(window, renderPass.handle, alphamaskPipeLayout.handle, cfg::alphamaskShaderPath);
-			}
+				create_pipelines_();
 				
 
 			recreateSwapchain = false;
@@ -559,35 +1273,48 @@ int main() try
 
 		// Acquire next swap chain image 
 		std::uint32_t imageIndex = 0;
-		auto const acquireRes = vkAcquireNextImageKHR(
-			window.device,
-			window.swapchain,
-			std::numeric_limits<std::uint64_t>::max(),
-			imageAvailable.handle,
-			VK_NULL_HANDLE,
-			&imageIndex
-		);
-
-		if (VK_SUBOPTIMAL_KHR == acquireRes || VK_ERROR_OUT_OF_DATE_KHR == acquireRes)
+		if (headless)
 		{
-			recreateSwapchain = true;
-			continue;
+			imageIndex = framesRendered % std::uint32_t(window.swapImages.size());
 		}
-
-		if (VK_SUCCESS != acquireRes)
+		else
 		{
-			throw lut::Error("Unable to acquire enxt swapchain image\n"
-				"vkAcquireNextImageKHR() returned %s", lut::to_string(acquireRes).c_str());
+			LUT_TRACE_SCOPE("acquire");
+
+			auto const acquireRes = vkAcquireNextImageKHR(
+				window.device,
+				window.swapchain,
+				std::numeric_limits<std::uint64_t>::max(),
+				imageAvailable.handle,
+				VK_NULL_HANDLE,
+				&imageIndex
+			);
+
+			if (VK_SUBOPTIMAL_KHR == acquireRes || VK_ERROR_OUT_OF_DATE_KHR == acquireRes)
+			{
+				recreateSwapchain = true;
+				continue;
+			}
+
+			if (VK_SUCCESS != acquireRes)
+			{
+				throw lut::Error("Unable to acquire enxt swapchain image\n"
+					"vkAcquireNextImageKHR() returned %s", lut::to_string(acquireRes).c_str());
+			}
 		}
 
 
 		//wait for command buffer to be available
 		assert(std::size_t(imageIndex) < cbfences.size());
-		if (auto const res = vkWaitForFences(window.device, 1, &cbfences[imageIndex].handle,
-			VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to wait for command buffer fence %u\n"
-				"vkWaitForFences() returned %s", imageIndex, lut::to_string(res).c_str());
+			LUT_TRACE_SCOPE("wait_for_fence");
+
+			if (auto const res = vkWaitForFences(window.device, 1, &cbfences[imageIndex].handle,
+				VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+			{
+				throw lut::Error("Unable to wait for command buffer fence %u\n"
+					"vkWaitForFences() returned %s", imageIndex, lut::to_string(res).c_str());
+			}
 		}
 
 		if (auto const res = vkResetFences(window.device, 1, &cbfences[imageIndex].handle); VK_SUCCESS != res)
@@ -596,69 +1323,181 @@ int main() try
 				"vkResetFences() returned %s", imageIndex, lut::to_string(res).c_str());
 		}
 
+		// The command buffer has completed, so its queries are available
+		collect_gpu_profile_(imageIndex);
+
 		// Update state 
 		auto const now = Clock_::now();
 		auto const dt = std::chrono::duration_cast<Secondsf_>(now - previousClock).count();
 		previousClock = now;
 
-		update_user_state(state, dt);
+		if (benchmark)
+		{
+			auto const frame = framesRendered < warmupFrames ? 0 : framesRendered - warmupFrames;
+			state.camera2world = sample_camera_path(cameraPath, camera_path_time(cameraPath, frame, options.frameCount));
+		}
+		else
+		{
+			update_user_state(state, dt);
+		}
 
 		//Update uniforms
 		glsl::SceneUniform sceneUniforms{};
 		update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height, state);
 
+		// Frustum culling. Indirect draws are built once, so there is no
+		// per-mesh work on the CPU; they are either culled on the GPU or
+		// draw all meshes. (GPU culling results stay on the GPU and are not
+		// counted.)
+		Frustum const frustum = make_frustum(sceneUniforms.projCam);
+
+		bool const drawIndirect = state.indirectDraws && EIndirectSupport::none != indirectSupport;
+		GpuCuller* const frameCuller = drawIndirect && gpuCulling ? &culler : nullptr;
+
+		// A pyramid from before the last frame would be stale
+		if (!frameCuller)
+			culler.hizValid = false;
+
+		char const* cullMode = "";
+		if (frameCuller)
+		{
+			cullMode = " (culled on the GPU)";
+		}
+		else if (drawIndirect)
+		{
+			cullMode = " (indirect)";
+			cullStats.meshesDrawn += indirectDraws.count[kDrawPipelineOpaque] + indirectDraws.count[kDrawPipelineAlphaMasked];
+		}
+		else
+		{
+			auto const visibleMeshes = cull_aabbs(frustum, meshBounds, meshVisible.data());
+			cullStats.meshesDrawn += visibleMeshes;
+			cullStats.meshesCulled += meshVisible.size() - visibleMeshes;
+
+			for (std::size_t i = 0; i < meshVisible.size(); ++i)
+			{
+				if (!bakedModel.meshes[i].hasBounds && !meshVisible[i])
+				{
+					meshVisible[i] = 1;
+					++cullStats.meshesDrawn;
+					--cullStats.meshesCulled;
+				}
+			}
+		}
+
 		//Record and submit commands
 		assert(std::size_t(imageIndex) < cbuffers.size());
 		assert(std::size_t(imageIndex) < framebuffers.size());
 
-		record_commands(
-			cbuffers[imageIndex],
-			renderPass.handle,
-			framebuffers[imageIndex].handle,
-			defaultPipeLayout.handle,
-			defaultPipe.handle,
-			alphamaskPipeLayout.handle,
-			alphamaskPipe.handle,
-			window.swapchainExtent,
-			sceneMeshes,
-			sceneUBO.buffer,
-			sceneUniforms,
-			sceneDescriptors,
-			materialDescriptors,
-			&bakedModel,
-			MaterialMeshesMap
-		);
+		// With the pre-pass, shading tests for equal depth
+		bool const prepass = state.depthPrepass;
+		if (prepass && VK_NULL_HANDLE == depthPipe.handle)
+			create_prepass_pipelines_();
+
+		auto const lightUniform = make_light_cluster_uniform(sceneUniforms.camera, sceneUniforms.projection,
+			cfg::kCameraNear, cfg::kCameraFar, window.swapchainExtent.width, window.swapchainExtent.height, clusteredLights.lightCount);
+
+		auto const drawsBefore = cullStats.draws, trianglesBefore = cullStats.triangles;
+
+		FrameCommands frameCommands;
+		frameCommands.renderPass = renderPass.handle;
+		frameCommands.framebuffer = framebuffers[imageIndex].handle;
+		frameCommands.extent = window.swapchainExtent;
+		frameCommands.defaultLayout = defaultPipeLayout.handle;
+		frameCommands.defaultPipe = prepass ? defaultEqualPipe.handle : defaultPipe.handle;
+		frameCommands.alphamaskLayout = alphamaskLayout;
+		frameCommands.alphamaskPipe = prepass ? alphamaskEqualPipe.handle : alphamaskPipe.handle;
+		frameCommands.depthPipe = prepass ? depthPipe.handle : VK_NULL_HANDLE;
+		frameCommands.depthAlphamaskPipe = prepass ? depthAlphamaskPipe.handle : VK_NULL_HANDLE;
+		frameCommands.model = &bakedModel;
+		frameCommands.geometry = &geometry;
+		frameCommands.meshes = &sceneMeshes;
+		frameCommands.sceneUBO = sceneUBO.buffer;
+		frameCommands.sceneUniform = sceneUniforms;
+		frameCommands.sceneSet = sceneDescriptors;
+		frameCommands.materialSets = &materialDescriptors;
+		frameCommands.bindlessSet = bindlessSet.set;
+		frameCommands.materialMeshes = &MaterialMeshesMap;
+		frameCommands.indirectDraws = drawIndirect ? &indirectDraws : nullptr;
+		frameCommands.culler = frameCuller;
+		frameCommands.previousProjCam = previousProjCam;
+		frameCommands.frustum = frustum;
+		frameCommands.meshVisible = &meshVisible;
+		frameCommands.lights = &clusteredLights;
+		frameCommands.lightUniform = lightUniform;
+		frameCommands.deferred = deferred ? &deferredLighting : nullptr;
+		frameCommands.visibility = visibility ? &visibilityResolve : nullptr;
+		frameCommands.profiler = &gpuProfiler;
+		frameCommands.profilerSlot = imageIndex;
+
+		record_commands(cbuffers[imageIndex], frameCommands, cullStats);
+
+		previousProjCam = sceneUniforms.projCam;
+
+		FrameSample sample{};
+		sample.draws = cullStats.draws - drawsBefore;
+		sample.triangles = cullStats.triangles - trianglesBefore;
 
 		submit_commands(
 			window,
 			cbuffers[imageIndex],
 			cbfences[imageIndex].handle,
-			imageAvailable.handle,
-			renderFinished.handle
+			headless ? VK_NULL_HANDLE : imageAvailable.handle,
+			headless ? VK_NULL_HANDLE : renderFinished.handle
 		);
 
-		// Present the results 
-		VkPresentInfoKHR presentInfo{};
-		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		presentInfo.waitSemaphoreCount = 1;
-		presentInfo.pWaitSemaphores = &renderFinished.handle;
-		presentInfo.swapchainCount = 1;
-		presentInfo.pSwapchains = &window.swapchain;
-		presentInfo.pImageIndices = &imageIndex;
-		presentInfo.pResults = nullptr;
-
-		auto const presentRes = vkQueuePresentKHR(window.presentQueue, &presentInfo);
-
-		if (VK_SUBOPTIMAL_KHR == presentRes || VK_ERROR_OUT_OF_DATE_KHR == presentRes)
+		sample.cpuMs = std::chrono::duration<double, std::milli>(Clock_::now() - now).count();
+
+		// Periodic statistics. Not during benchmarks, where the printing
+		// would end up in the frame times; they print a summary at the end.
+		++statsFrames;
+		if (!benchmark && now - statsClock >= std::chrono::seconds(1))
 		{
-			recreateSwapchain = true;
+			std::printf("Per frame%s: %.0f meshes drawn, %.0f culled; %.0f clusters drawn, %.0f culled\n",
+				cullMode, double(cullStats.meshesDrawn) / statsFrames, double(cullStats.meshesCulled) / statsFrames,
+				double(cullStats.clustersDrawn) / statsFrames, double(cullStats.clustersCulled) / statsFrames);
+
+			gpuProfiler.print_summary();
+
+			cullStats = CullStats{};
+			statsFrames = 0;
+			statsClock = now;
 		}
-		else if (VK_SUCCESS != presentRes)
+
+		// Present the results 
+		if (!headless)
 		{
-			throw lut::Error("Unable present swapchain image %u\n"
-				"vkQueuePresentKHR() returned %s", imageIndex, lut::to_string(presentRes).c_str());
+			LUT_TRACE_SCOPE("present");
+
+			VkPresentInfoKHR presentInfo{};
+			presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+			presentInfo.waitSemaphoreCount = 1;
+			presentInfo.pWaitSemaphores = &renderFinished.handle;
+			presentInfo.swapchainCount = 1;
+			presentInfo.pSwapchains = &window.swapchain;
+			presentInfo.pImageIndices = &imageIndex;
+			presentInfo.pResults = nullptr;
+
+			auto const presentRes = vkQueuePresentKHR(window.presentQueue, &presentInfo);
+
+			if (VK_SUBOPTIMAL_KHR == presentRes || VK_ERROR_OUT_OF_DATE_KHR == presentRes)
+			{
+				recreateSwapchain = true;
+			}
+			else if (VK_SUCCESS != presentRes)
+			{
+				throw lut::Error("Unable present swapchain image %u\n"
+					"vkQueuePresentKHR() returned %s", imageIndex, lut::to_string(presentRes).c_str());
+			}
 		}
 
+		sample.frameMs = std::chrono::duration<double, std::milli>(Clock_::now() - frameStart).count();
+
+		if (benchmark && framesRendered >= warmupFrames)
+			frameSamples.emplace_back(sample);
+
+		++framesRendered;
+		lastImageIndex = imageIndex;
 	}
 
 	// Cleanup takes place automatically in the destructors, but we sill need
@@ -666,6 +1505,37 @@ int main() try
 	vkDeviceWaitIdle(window.device);
 	///
 
+	// Profiles of the last frames
+	for (std::uint32_t i = 0; i < std::uint32_t(cbuffers.size()); ++i)
+		collect_gpu_profile_(i);
+
+	if (options.gpuCsvPath)
+		std::printf("Wrote GPU profile to %s\n", options.gpuCsvPath);
+
+	if (options.tracePath)
+	{
+		lut::enable_trace(false);
+		lut::write_chrome_trace(options.tracePath);
+		std::printf("Wrote CPU trace to %s\n", options.tracePath);
+	}
+
+	if (benchmark)
+	{
+		print_benchmark_summary(frameSamples);
+
+		if (options.csvPath)
+		{
+			write_benchmark_csv(options.csvPath, frameSamples);
+			std::printf("Wrote %zu frames to %s\n", frameSamples.size(), options.csvPath);
+		}
+	}
+
+	if (options.pngPath && framesRendered)
+	{
+		write_screenshot_png(window, allocator, window.swapImages[lastImageIndex], window.swapchainFormat, window.swapchainExtent, options.pngPath);
+		std::printf("Wrote frame %u to %s\n", framesRendered, options.pngPath);
+	}
+
 	return 0;
 }
 catch( std::exception const& eErr )
@@ -677,7 +1547,7 @@ catch( std::exception const& eErr )
 
 namespace
 {
-	lut::RenderPass create_render_pass(lut::VulkanWindow const& aWindow)
+	lut::RenderPass create_render_pass(lut::VulkanWindow const& aWindow, bool aKeepDepth, VkImageLayout aColorFinalLayout)
 	{
 		// Note: the stencilLoadOp & stencilStoreOp members are left initialized 
 		// to 0 (=DONT CARE). The image format (R8G8B8A8 SRGB) of the color 
@@ -692,14 +1562,14 @@ namespace
 		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments[0].finalLayout = aColorFinalLayout;
 		//depthbuffer
 		attachments[1].format = cfg::kDepthFormat;
 		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
 		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].storeOp = aKeepDepth ? VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
 		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments[1].finalLayout = aKeepDepth ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		//SUBPASS
 		VkAttachmentReference subpassAttachments[1]{};
@@ -716,7 +1586,23 @@ namespace
 		subpasses[0].pColorAttachments = subpassAttachments;
 		subpasses[0].pDepthStencilAttachment = &depthAttachment;
 
-		//no explicit subpass dependencies 
+		// Kept depth is read by compute shaders (the depth pyramid, see
+		// gpu_culling.hpp) after the pass, and before the next frame's pass
+		// overwrites it
+		VkSubpassDependency deps[2]{};
+		deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		deps[0].dstSubpass = 0;
+		deps[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		deps[0].srcAccessMask = 0;
+		deps[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		deps[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+		deps[1].srcSubpass = 0;
+		deps[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		deps[1].srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		deps[1].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
 		VkRenderPassCreateInfo passInfo{};
 		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
@@ -724,8 +1610,8 @@ namespace
 		passInfo.pAttachments = attachments;
 		passInfo.subpassCount = 1;
 		passInfo.pSubpasses = subpasses;
-		passInfo.dependencyCount = 0; //changed!
-		passInfo.pDependencies = nullptr; //changed! 
+		passInfo.dependencyCount = aKeepDepth ? 2 : 0; //changed!
+		passInfo.pDependencies = aKeepDepth ? deps : nullptr; //changed! 
 
 		VkRenderPass rpass = VK_NULL_HANDLE;
 		if (auto const res = vkCreateRenderPass(aWindow.device, &passInfo, nullptr, &rpass); VK_SUCCESS != res)
@@ -793,34 +1679,28 @@ namespace
 	lut::PipelineLayout create_pipeline_layout(lut::VulkanContext const& aContext,
 		std::vector<VkDescriptorSetLayout> aLayout, unsigned int apushConstantSize)
 	{
-		//VkPushConstantRange colorPushConstant;
-		//if (apushConstantSize != 0)
-		//{
-
-		//	//this push constant range starts at the beginning
-		//	colorPushConstant.offset = 0;
-		//	//this push constant range takes up the size of a MeshPushConstants struct
-		//	colorPushConstant.size = apushConstantSize;
-		//	//this push constant range is accessible only in the vertex shader
-		//	//colorPushConstant.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
-		//	colorPushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-
-		//}
+		VkPushConstantRange meshPushConstant{};
+		//this push constant range starts at the beginning
+		meshPushConstant.offset = 0;
+		//this push constant range takes up the size of a MeshPushConstants struct
+		meshPushConstant.size = apushConstantSize;
+		//this push constant range is accessible only in the vertex shader
+		meshPushConstant.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 
 		VkPipelineLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 		layoutInfo.setLayoutCount = aLayout.size();
 		layoutInfo.pSetLayouts = aLayout.data();
-		/*if (apushConstantSize != 0)
+		if (apushConstantSize != 0)
 		{
 			layoutInfo.pushConstantRangeCount = 1;
-			layoutInfo.pPushConstantRanges = &colorPushConstant;
+			layoutInfo.pPushConstantRanges = &meshPushConstant;
 		}
 		else
-		{*/
+		{
 			layoutInfo.pushConstantRangeCount = 0;
 			layoutInfo.pPushConstantRanges = nullptr;
-		//}
+		}
 
 
 		VkPipelineLayout layout = VK_NULL_HANDLE;
@@ -834,11 +1714,18 @@ namespace
 	}
 
 
-	lut::Pipeline create_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, ShaderPath aShaderPath)
+	lut::Pipeline create_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, ShaderPath aShaderPath, baked::BakedVertexFormatV2 aVertexFormat, EPipelineDepth aDepth, std::uint32_t aColorAttachmentCount)
 	{
 		//throw lut::Error("Not yet implemented"); //TODO: implement me!
+		// Depth-only pipelines may omit the fragment shader; they then read
+		// the vertex positions only
+		bool const positionOnly = nullptr == aShaderPath.kFragShaderPath;
+		assert(!positionOnly || EPipelineDepth::prepass == aDepth);
+
 		lut::ShaderModule vert = lut::load_shader_module(aWindow, aShaderPath.kVertShaderPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, aShaderPath.kFragShaderPath);
+		lut::ShaderModule frag;
+		if (!positionOnly)
+			frag = lut::load_shader_module(aWindow, aShaderPath.kFragShaderPath);
 
 		// Define shader stages in the pipeline 
 		VkPipelineShaderStageCreateInfo stages[2]{};
@@ -894,12 +1781,47 @@ namespace
 		vertexAttributes[3].format = VK_FORMAT_R32G32B32A32_SFLOAT;
 		vertexAttributes[3].offset = 0;
 
+		// Packed formats: a single interleaved buffer, see baked_format.hpp
+		bool const quantized = baked::kBakedVertexPackedQ16 == aVertexFormat;
+
+		VkVertexInputBindingDescription packedInputs[1]{};
+		packedInputs[0].binding = 0;
+		packedInputs[0].stride = quantized ? sizeof(baked::BakedPackedVertexQ16) : sizeof(baked::BakedPackedVertexF32);
+		packedInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		VkVertexInputAttributeDescription packedAttributes[3]{};
+		// position + tangent sign
+		packedAttributes[0].binding = 0;
+		packedAttributes[0].location = 0;
+		packedAttributes[0].format = quantized ? VK_FORMAT_R16G16B16A16_UNORM : VK_FORMAT_R32G32B32A32_SFLOAT;
+		packedAttributes[0].offset = 0;
+		// octahedral normal + tangent
+		packedAttributes[1].binding = 0;
+		packedAttributes[1].location = 1;
+		packedAttributes[1].format = VK_FORMAT_R16G16B16A16_SNORM;
+		packedAttributes[1].offset = quantized ? offsetof(baked::BakedPackedVertexQ16, frame) : offsetof(baked::BakedPackedVertexF32, frame);
+		// texture coordinate
+		packedAttributes[2].binding = 0;
+		packedAttributes[2].location = 2;
+		packedAttributes[2].format = VK_FORMAT_R16G16_SFLOAT;
+		packedAttributes[2].offset = quantized ? offsetof(baked::BakedPackedVertexQ16, texcoord) : offsetof(baked::BakedPackedVertexF32, texcoord);
+
 		VkPipelineVertexInputStateCreateInfo inputInfo{};
 		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-		inputInfo.vertexBindingDescriptionCount = 4; // number of vertexInputs above 
-		inputInfo.pVertexBindingDescriptions = vertexInputs;
-		inputInfo.vertexAttributeDescriptionCount = 4; // number of vertexAttributes above 
-		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
+		if (baked::kBakedVertexSeparate == aVertexFormat)
+		{
+			inputInfo.vertexBindingDescriptionCount = positionOnly ? 1 : 4; // number of vertexInputs above 
+			inputInfo.pVertexBindingDescriptions = vertexInputs;
+			inputInfo.vertexAttributeDescriptionCount = positionOnly ? 1 : 4; // number of vertexAttributes above 
+			inputInfo.pVertexAttributeDescriptions = vertexAttributes;
+		}
+		else
+		{
+			inputInfo.vertexBindingDescriptionCount = 1;
+			inputInfo.pVertexBindingDescriptions = packedInputs;
+			inputInfo.vertexAttributeDescriptionCount = positionOnly ? 1 : 3;
+			inputInfo.pVertexAttributeDescriptions = packedAttributes;
+		}
 
 
 		// Define which primitive (point, line, triangle, ...) the input is 
@@ -949,14 +1871,22 @@ namespace
 		// We define one blend state per color attachment - this example uses a 
 		// single color attachment, so we only need one. Right now, we dont do any
 		// blending, so we can ignore most of the members. 
-		VkPipelineColorBlendAttachmentState blendStates[1]{};
-		blendStates[0].blendEnable = VK_FALSE;
-		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		// (The G-buffer subpass of deferred shading has several.)
+		assert(aColorAttachmentCount >= 1 && aColorAttachmentCount <= kGBufferColorCount);
+
+		VkPipelineColorBlendAttachmentState blendStates[kGBufferColorCount]{};
+		for (std::uint32_t i = 0; i < aColorAttachmentCount; ++i)
+		{
+			blendStates[i].blendEnable = VK_FALSE;
+			blendStates[i].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+			if (EPipelineDepth::prepass == aDepth)
+				blendStates[i].colorWriteMask = 0;
+		}
 
 		VkPipelineColorBlendStateCreateInfo blendInfo{};
 		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
 		blendInfo.logicOpEnable = VK_FALSE;
-		blendInfo.attachmentCount = 1;
+		blendInfo.attachmentCount = aColorAttachmentCount;
 		blendInfo.pAttachments = blendStates;
 
 		VkPipelineDepthStencilStateCreateInfo depthInfo{};
@@ -964,6 +1894,11 @@ namespace
 		depthInfo.depthTestEnable = VK_TRUE;
 		depthInfo.depthWriteEnable = VK_TRUE;
 		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		if (EPipelineDepth::shadedEqual == aDepth)
+		{
+			depthInfo.depthWriteEnable = VK_FALSE;
+			depthInfo.depthCompareOp = VK_COMPARE_OP_EQUAL;
+		}
 		depthInfo.minDepthBounds = 0.f;
 		depthInfo.maxDepthBounds = 1.f;
 
@@ -971,7 +1906,7 @@ namespace
 		VkGraphicsPipelineCreateInfo pipeInfo{};
 		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
 
-		pipeInfo.stageCount = 2; // vertex + fragment stages 
+		pipeInfo.stageCount = positionOnly ? 1 : 2; // vertex (+ fragment) stages 
 		pipeInfo.pStages = stages;
 
 		pipeInfo.pVertexInputState = &inputInfo;
@@ -1000,23 +1935,26 @@ namespace
 	}
 
 	void create_swapchain_framebuffers(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass,
-		std::vector<lut::Framebuffer>& aFramebuffers, VkImageView aDepthView)
+		std::vector<lut::Framebuffer>& aFramebuffers, std::vector<VkImageView> const& aSharedViews)
 	{
 		assert(aFramebuffers.empty());
 
 		//throw lut::Error("Not yet implemented"); //TODO: implement me!
+		// Attachment 0 is the swapchain image; the others (depth, G-buffer)
+		// are shared by all framebuffers
+		std::vector<VkImageView> attachments(1 + aSharedViews.size());
+		std::copy(aSharedViews.begin(), aSharedViews.end(), attachments.begin() + 1);
+
 		for (std::size_t i = 0; i < aWindow.swapViews.size(); ++i)
 		{
-			VkImageView attachments[2] = {
-				aWindow.swapViews[i],
-				aDepthView };
+			attachments[0] = aWindow.swapViews[i];
 
 			VkFramebufferCreateInfo fbInfo{};
 			fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
 			fbInfo.flags = 0; // normal framebuffer 
 			fbInfo.renderPass = aRenderPass;
-			fbInfo.attachmentCount = 2;
-			fbInfo.pAttachments = attachments;
+			fbInfo.attachmentCount = std::uint32_t(attachments.size());
+			fbInfo.pAttachments = attachments.data();
 			fbInfo.width = aWindow.swapchainExtent.width;
 			fbInfo.height = aWindow.swapchainExtent.height;
 			fbInfo.layers = 1;
@@ -1036,7 +1974,7 @@ namespace
 	}
 
 
-	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator)
+	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator, VkImageUsageFlags aExtraUsage)
 	{
 		//throw lut::Error("Not yet implemented"); //TODO- (Section 6) implement me!
 		VkImageCreateInfo imageInfo{};
@@ -1050,7 +1988,7 @@ namespace
 		imageInfo.arrayLayers = 1;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | aExtraUsage;
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
@@ -1092,12 +2030,18 @@ namespace
 	}
 
 
-	void record_commands(VkCommandBuffer aCmdBuff, VkRenderPass aRenderPass, VkFramebuffer aFramebuffer, VkPipelineLayout aDefaultPipeLayout, 
-		VkPipeline aDefaultPipe, VkPipelineLayout aAlphamaskPipeLayout, VkPipeline aAlphamaskPipe, VkExtent2D const& aImageExtent, 
-		std::vector<SceneMesh> const& sceneMeshes, VkBuffer aSceneUBO,
-		glsl::SceneUniform const& aSceneUniform, VkDescriptorSet aSceneDescriptors,
-		std::vector <VkDescriptorSet> aTexDescriptors, BakedModel* aModel, std::unordered_map <unsigned int, std::unordered_map <unsigned int, std::vector<unsigned int>>> aMaterialMeshesMap)
+	void record_commands(VkCommandBuffer aCmdBuff, FrameCommands const& aFrame, CullStats& aStats)
 	{
+		LUT_TRACE_SCOPE(__func__);
+
+		auto const& model = *aFrame.model;
+		auto const& geometry = *aFrame.geometry;
+		auto const& sceneMeshes = *aFrame.meshes;
+		auto const& materialSets = *aFrame.materialSets;
+		auto const& meshVisible = *aFrame.meshVisible;
+		auto const& lights = *aFrame.lights;
+		auto& profiler = *aFrame.profiler;
+
 		//throw lut::Error("Not yet implemented"); //TODO: implement me!
 		// Begin recording commands 
 		VkCommandBufferBeginInfo begInfo{};
@@ -1111,26 +2055,42 @@ namespace
 				"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
 		}
 
+		profiler.begin_frame(aCmdBuff, aFrame.profilerSlot);
+
 		// Upload scene uniforms 
+		profiler.begin_region(aCmdBuff, kGpuRegionUpload);
 		lut::buffer_barrier(aCmdBuff,
-			aSceneUBO,
+			aFrame.sceneUBO,
 			VK_ACCESS_UNIFORM_READ_BIT,
 			VK_ACCESS_TRANSFER_WRITE_BIT,
 			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT
 		);
 
-		vkCmdUpdateBuffer(aCmdBuff, aSceneUBO, 0, sizeof(glsl::SceneUniform), &aSceneUniform);
+		vkCmdUpdateBuffer(aCmdBuff, aFrame.sceneUBO, 0, sizeof(glsl::SceneUniform), &aFrame.sceneUniform);
 		lut::buffer_barrier(aCmdBuff,
-			aSceneUBO,
+			aFrame.sceneUBO,
 			VK_ACCESS_TRANSFER_WRITE_BIT,
 			VK_ACCESS_UNIFORM_READ_BIT,
 			VK_PIPELINE_STAGE_TRANSFER_BIT,
 			VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
 		);
+		profiler.end_region(aCmdBuff, kGpuRegionUpload);
+
+		profiler.begin_region(aCmdBuff, kGpuRegionCompute);
+
+		// GPU culling writes the draw commands
+		if (aFrame.culler)
+			record_gpu_culling(aCmdBuff, *aFrame.culler, aFrame.frustum, aFrame.previousProjCam);
 
-		// Clear values
-		VkClearValue clearValues[2]{};
+		// Per-cluster light lists for the lighting shaders
+		record_light_assignment(aCmdBuff, lights, aFrame.lightUniform);
+
+		profiler.end_region(aCmdBuff, kGpuRegionCompute);
+
+		// Clear values. The visibility buffer (the first render target after
+		// depth) is cleared to 0; see visibility.hpp.
+		VkClearValue clearValues[kDeferredFirstTarget + kMaxGBufferTargets]{};
 		clearValues[0].color.float32[0] = 0.1f; // Clear to a dark gray background. 
 		clearValues[0].color.float32[1] = 0.1f; // If we were debugging, this would potentially 
 		clearValues[0].color.float32[2] = 0.1f; // help us see whether the render pass took 
@@ -1141,80 +2101,189 @@ namespace
 		// Begin render pass 
 		VkRenderPassBeginInfo passInfo{};
 		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		passInfo.renderPass = aRenderPass;
-		passInfo.framebuffer = aFramebuffer;
+		passInfo.renderPass = aFrame.renderPass;
+		passInfo.framebuffer = aFrame.framebuffer;
 		passInfo.renderArea.offset = VkOffset2D{ 0, 0 };
-		passInfo.renderArea.extent = VkExtent2D{ aImageExtent.width, aImageExtent.height };
-		passInfo.clearValueCount = 2;
+		passInfo.renderArea.extent = VkExtent2D{ aFrame.extent.width, aFrame.extent.height };
+		passInfo.clearValueCount = sizeof(clearValues) / sizeof(clearValues[0]);
 		passInfo.pClearValues = clearValues;
 
 		vkCmdBeginRenderPass(aCmdBuff, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
 
 
-		// Begin drawing with graphics pipeline 
-		// Bind Default pipeline 
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aDefaultPipe);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aDefaultPipeLayout,
-			0, 1, &aSceneDescriptors, 0, nullptr);
+		// Bindless: the material set is bound along with the scene set. Each
+		// draw passes its mesh ID as firstInstance, which selects the mesh's
+		// data and material in the shaders (see bindless.hpp).
+		bool const bindless = VK_NULL_HANDLE != aFrame.bindlessSet;
+		VkDescriptorSet const sharedSets[] = { aFrame.sceneSet, aFrame.bindlessSet };
+		std::uint32_t const sharedSetCount = bindless ? 2 : 1;
 
-		for (auto& mat : aMaterialMeshesMap[0])
-		{	
-			// Bind Material descriptors
-			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aDefaultPipeLayout,
-					1, 1, &aTexDescriptors[mat.first], 0, nullptr);
+		// Packed formats: per-mesh position dequantization
+		bool const packedVertices = baked::kBakedVertexSeparate != model.vertexFormat;
+
+		auto const push_mesh_constants_ = [&](SceneMesh const& aMesh, VkPipelineLayout aLayout) {
+			if (!packedVertices || bindless)
+				return;
+
+			glsl::MeshPushConstants push{};
+			push.positionOffset = glm::vec4(aMesh.positionOffset, 0.f);
+			push.positionScale = glm::vec4(aMesh.positionScale, 1.f);
+			vkCmdPushConstants(aCmdBuff, aLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(push), &push);
+		};
 
-			for (unsigned int i = 0; i < aMaterialMeshesMap[0][mat.first].size(); i++)
+		// Draws the visible clusters of a mesh, or the whole mesh if it has
+		// no clusters. Clusters are contiguous index ranges. The visibility
+		// buffer needs whole meshes, whose triangles gl_PrimitiveID counts.
+		std::vector<IndexRange> ranges;
+
+		auto const draw_mesh_ = [&](unsigned int aMeshId, bool aCount) {
+			auto const& mesh = sceneMeshes[aMeshId];
+
+			std::uint32_t const firstInstance = bindless ? aMeshId : 0;
+
+			auto const& clusters = model.meshes[aMeshId].clusters;
+			if (clusters.empty() || aFrame.visibility)
 			{
-				// Bind vertex input 
-				VkBuffer vBuffers[4] = { sceneMeshes[aMaterialMeshesMap[0][mat.first][i]].positions.buffer,
-										sceneMeshes[aMaterialMeshesMap[0][mat.first][i]].normals.buffer,
-										sceneMeshes[aMaterialMeshesMap[0][mat.first][i]].texcoords.buffer,
-										sceneMeshes[aMaterialMeshesMap[0][mat.first][i]].tangents.buffer };
+				vkCmdDrawIndexed(aCmdBuff, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, firstInstance);
+				++aStats.draws;
+				aStats.triangles += mesh.indexCount / 3;
+				return;
+			}
 
-				VkDeviceSize offsets[4]{};
-				vkCmdBindVertexBuffers(aCmdBuff, 0, 4, vBuffers, offsets);
+			ranges.clear();
+			auto const visible = cull_clusters(clusters, aFrame.frustum, aFrame.sceneUniform.cameraPosition, ranges);
+			if (aCount)
+			{
+				aStats.clustersDrawn += visible;
+				aStats.clustersCulled += clusters.size() - visible;
+			}
 
-				//Bind Index Buffer
-				vkCmdBindIndexBuffer(aCmdBuff, sceneMeshes[aMaterialMeshesMap[0][mat.first][i]].indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			for (auto const& range : ranges)
+			{
+				vkCmdDrawIndexed(aCmdBuff, range.indexCount, 1, mesh.firstIndex + range.firstIndex, mesh.vertexOffset, firstInstance);
+				++aStats.draws;
+				aStats.triangles += range.indexCount / 3;
+			}
+		};
 
-				//Draw
-				vkCmdDrawIndexed(aCmdBuff, sceneMeshes[aMaterialMeshesMap[0][mat.first][i]].indexCount, 1, 0, 0, 0);
-			}		
-		}
-		
-		// Bind Alphamask pipeline 
-		vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aAlphamaskPipe);
-		vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aAlphamaskPipeLayout,
-			0, 1, &aSceneDescriptors, 0, nullptr);
+		auto const bind_material_ = [&](unsigned int aMaterialId, VkPipelineLayout aLayout) {
+			if (bindless)
+				return;
 
-		for (auto& mat : aMaterialMeshesMap[1])
-		{
 			// Bind Material descriptors
-			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aAlphamaskPipeLayout,
-				1, 1, &aTexDescriptors[mat.first], 0, nullptr);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLayout,
+				1, 1, &materialSets[aMaterialId], 0, nullptr);
+		};
 
-			for (unsigned int i = 0; i < aMaterialMeshesMap[1][mat.first].size(); i++)
+		// Draws the meshes of one pipeline. The depth pre-pass draws exactly
+		// the same meshes and clusters as shading, which tests for equal
+		// depth; they are counted once. Opaque geometry in the pre-pass
+		// does not read its material.
+		auto const draw_pipeline_ = [&](EDrawPipeline aPipeline, VkPipeline aPipe, VkPipelineLayout aLayout, bool aPrepass) {
+			vkCmdBindPipeline(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aPipe);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLayout,
+				0, sharedSetCount, sharedSets, 0, nullptr);
+			vkCmdBindDescriptorSets(aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aLayout,
+				2, 1, &lights.set, 0, nullptr);
+
+			if (aFrame.culler)
 			{
-				// Bind vertex input 
-				VkBuffer vBuffers[4] = { sceneMeshes[aMaterialMeshesMap[1][mat.first][i]].positions.buffer,
-										sceneMeshes[aMaterialMeshesMap[1][mat.first][i]].normals.buffer,
-										sceneMeshes[aMaterialMeshesMap[1][mat.first][i]].texcoords.buffer,
-										sceneMeshes[aMaterialMeshesMap[1][mat.first][i]].tangents.buffer };
+				draw_gpu_culled(aCmdBuff, *aFrame.culler, aPipeline);
+				return;
+			}
+
+			if (aFrame.indirectDraws)
+			{
+				draw_indirect(aCmdBuff, *aFrame.indirectDraws, aPipeline);
+				aStats.draws += aFrame.indirectDraws->count[aPipeline];
+				aStats.triangles += aFrame.indirectDraws->triangles[aPipeline];
+				return;
+			}
+
+			bool const materials = !aPrepass || kDrawPipelineOpaque != aPipeline;
 
-				VkDeviceSize offsets[4]{};
-				vkCmdBindVertexBuffers(aCmdBuff, 0, 4, vBuffers, offsets);
+			auto const pipelineMeshes = aFrame.materialMeshes->find(aPipeline);
+			if (aFrame.materialMeshes->end() == pipelineMeshes)
+				return;
 
-				//Bind Index Buffer
-				vkCmdBindIndexBuffer(aCmdBuff, sceneMeshes[aMaterialMeshesMap[1][mat.first][i]].indices.buffer, 0, VK_INDEX_TYPE_UINT32);
+			for (auto const& mat : pipelineMeshes->second)
+			{
+				if (materials)
+					bind_material_(mat.first, aLayout);
 
-				//Draw
-				vkCmdDrawIndexed(aCmdBuff, sceneMeshes[aMaterialMeshesMap[1][mat.first][i]].indexCount, 1, 0, 0, 0);
+				for (auto const meshId : mat.second)
+				{
+					// Skip meshes outside of the view frustum
+					if (!meshVisible[meshId])
+						continue;
+
+					push_mesh_constants_(sceneMeshes[meshId], aLayout);
+
+					//Draw
+					draw_mesh_(meshId, !aPrepass);
+				}
 			}
+		};
+
+		// All meshes share the arena's buffers; bind them once
+		bind_geometry_arena(aCmdBuff, geometry);
+
+		// Depth pre-pass
+		if (VK_NULL_HANDLE != aFrame.depthPipe)
+		{
+			profiler.begin_region(aCmdBuff, kGpuRegionPrepass);
+			draw_pipeline_(kDrawPipelineOpaque, aFrame.depthPipe, aFrame.defaultLayout, true);
+			draw_pipeline_(kDrawPipelineAlphaMasked, aFrame.depthAlphamaskPipe, aFrame.alphamaskLayout, true);
+			profiler.end_region(aCmdBuff, kGpuRegionPrepass);
+		}
+
+		// Begin drawing with graphics pipeline 
+		// Default pipeline, then alphamask pipeline
+		// (With deferred shading, these write the G-buffer; with the
+		// visibility buffer, the mesh and triangle IDs.)
+		profiler.begin_region(aCmdBuff, kGpuRegionOpaque);
+		draw_pipeline_(kDrawPipelineOpaque, aFrame.defaultPipe, aFrame.defaultLayout, false);
+		profiler.end_region(aCmdBuff, kGpuRegionOpaque);
+
+		profiler.begin_region(aCmdBuff, kGpuRegionAlphaMask);
+		draw_pipeline_(kDrawPipelineAlphaMasked, aFrame.alphamaskPipe, aFrame.alphamaskLayout, false);
+		profiler.end_region(aCmdBuff, kGpuRegionAlphaMask);
+
+		// The fullscreen passes move to the next subpass, which statistics
+		// queries cannot span; they are timed only
+		if (aFrame.deferred || aFrame.visibility)
+			profiler.begin_region(aCmdBuff, kGpuRegionFullscreen, false);
+
+		// Deferred shading: one fullscreen pass over the G-buffer
+		if (aFrame.deferred)
+			record_deferred_lighting(aCmdBuff, *aFrame.deferred, aFrame.sceneSet, lights.set, glm::inverse(aFrame.sceneUniform.projCam));
+
+		// Visibility buffer: one fullscreen pass that fetches and shades the
+		// visible triangles
+		if (aFrame.visibility)
+			record_visibility_resolve(aCmdBuff, *aFrame.visibility, geometry, model.vertexFormat, aFrame.sceneSet, aFrame.bindlessSet, lights.set);
+
+		// (Fullscreen passes draw a single triangle)
+		if (aFrame.deferred || aFrame.visibility)
+		{
+			profiler.end_region(aCmdBuff, kGpuRegionFullscreen);
+
+			++aStats.draws;
+			++aStats.triangles;
 		}
-		
+
 		// End the render pass 
 		vkCmdEndRenderPass(aCmdBuff);
 
+		// Depth pyramid for the next frame's culling
+		if (aFrame.culler)
+		{
+			profiler.begin_region(aCmdBuff, kGpuRegionPyramid);
+			record_depth_pyramid(aCmdBuff, *aFrame.culler);
+			profiler.end_region(aCmdBuff, kGpuRegionPyramid);
+		}
+
+		profiler.end_frame(aCmdBuff);
 
 		// End command recording 
 		if (auto const res = vkEndCommandBuffer(aCmdBuff); VK_SUCCESS != res)
@@ -1227,6 +2296,8 @@ namespace
 
 	void submit_commands(lut::VulkanContext const& aContext, VkCommandBuffer aCmdBuff, VkFence aFence, VkSemaphore aWaitSemaphore, VkSemaphore aSignalSemaphore)
 	{
+		LUT_TRACE_SCOPE(__func__);
+
 		//throw lut::Error("Not yet implemented"); //TODO: implement me!
 		VkPipelineStageFlags waitPipelineStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
@@ -1235,12 +2306,20 @@ namespace
 		submitInfo.commandBufferCount = 1;
 		submitInfo.pCommandBuffers = &aCmdBuff;
 
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &aWaitSemaphore;
-		submitInfo.pWaitDstStageMask = &waitPipelineStages;
+		// Either semaphore may be null (headless windows neither acquire nor
+		// present)
+		if (VK_NULL_HANDLE != aWaitSemaphore)
+		{
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &aWaitSemaphore;
+			submitInfo.pWaitDstStageMask = &waitPipelineStages;
+		}
 
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &aSignalSemaphore;
+		if (VK_NULL_HANDLE != aSignalSemaphore)
+		{
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &aSignalSemaphore;
+		}
 
 		if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, aFence); VK_SUCCESS != res)
 		{
@@ -1296,6 +2375,22 @@ namespace
 			state->inputMap[std::size_t(EInputState::moveLight)] = !isReleased;
 			break;
 
+		case GLFW_KEY_I:
+			if (GLFW_PRESS == aAction)
+				state->indirectDraws = !state->indirectDraws;
+			break;
+
+		case GLFW_KEY_P:
+			if (GLFW_PRESS == aAction)
+				state->depthPrepass = !state->depthPrepass;
+			break;
+
+		// Print the camera as a keyframe of a camera path, for --benchmark
+		case GLFW_KEY_K:
+			if (GLFW_PRESS == aAction)
+				std::printf("%s\n", format_camera_keyframe(float(state->keyframesPrinted++), state->camera2world).c_str());
+			break;
+
 		default:
 			;
 		}
@@ -1402,6 +2497,107 @@ namespace
 
 		aSceneUniforms.lightPosition = aState.lightPos;
 	}
+
+	Options parse_options(int aArgc, char* aArgv[])
+	{
+		Options ret;
+
+		for (int i = 1; i < aArgc; ++i)
+		{
+			if (0 == std::strcmp(aArgv[i], "--lights") && i + 1 < aArgc)
+			{
+				char* end = nullptr;
+				auto const count = std::strtoul(aArgv[++i], &end, 10);
+				if (end == aArgv[i] || '\0' != *end)
+					throw lut::Error("--lights: expected a number, got '%s'", aArgv[i]);
+
+				ret.lightCount = std::uint32_t(count);
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--deferred"))
+			{
+				ret.shading = EShading::deferred;
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--visibility"))
+			{
+				ret.shading = EShading::visibility;
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--headless"))
+			{
+				ret.headless = true;
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--frames") && i + 1 < aArgc)
+			{
+				char* end = nullptr;
+				auto const count = std::strtoul(aArgv[++i], &end, 10);
+				if (end == aArgv[i] || '\0' != *end || 0 == count)
+					throw lut::Error("--frames: expected a positive number, got '%s'", aArgv[i]);
+
+				ret.frameCount = std::uint32_t(count);
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--png") && i + 1 < aArgc)
+			{
+				ret.pngPath = aArgv[++i];
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--benchmark") && i + 1 < aArgc)
+			{
+				ret.cameraPath = aArgv[++i];
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--csv") && i + 1 < aArgc)
+			{
+				ret.csvPath = aArgv[++i];
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--gpu-csv") && i + 1 < aArgc)
+			{
+				ret.gpuCsvPath = aArgv[++i];
+				continue;
+			}
+
+			if (0 == std::strcmp(aArgv[i], "--trace") && i + 1 < aArgc)
+			{
+				ret.tracePath = aArgv[++i];
+				continue;
+			}
+
+			throw lut::Error("Unknown command line argument '%s'\n"
+				"Usage: %s [--lights N] [--deferred | --visibility] [--headless [--png FILE]] [--frames N] [--benchmark CAMERA_PATH [--csv FILE]] [--gpu-csv FILE] [--trace FILE]", aArgv[i], aArgv[0]);
+		}
+
+		// Swap chain images cannot be copied from (see screenshot.hpp)
+		if (ret.pngPath && !ret.headless)
+			throw lut::Error("--png requires --headless");
+
+		if (ret.csvPath && !ret.cameraPath)
+			throw lut::Error("--csv requires --benchmark");
+
+		if (ret.tracePath && !lut::kTraceCompiled)
+			throw lut::Error("--trace requires a build with tracing (premake5 --trace)");
+
+		// Benchmarks have a fixed length
+		if (ret.cameraPath && 0 == ret.frameCount)
+			ret.frameCount = cfg::kDefaultBenchmarkFrames;
+
+		// Without a window, nothing else ends the run
+		if (ret.headless && 0 == ret.frameCount)
+			ret.frameCount = cfg::kDefaultHeadlessFrames;
+
+		return ret;
+	}
 }
 
 
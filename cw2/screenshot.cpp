@@ -0,0 +1,140 @@
+#include "screenshot.hpp"
+
+#include <vector>
+#include <limits>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <stb_image_write.h>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+#include "../labutils/vkbuffer.hpp"
+#include "../labutils/to_string.hpp"
+
+namespace
+{
+	// Offsets of red, green and blue within a pixel, or false if aFormat is
+	// not 8-bit RGBA or BGRA
+	bool rgb_offsets_( VkFormat aFormat, std::size_t aOffsets[3] )
+	{
+		switch( aFormat )
+		{
+			case VK_FORMAT_R8G8B8A8_UNORM:
+			case VK_FORMAT_R8G8B8A8_SRGB:
+				aOffsets[0] = 0; aOffsets[1] = 1; aOffsets[2] = 2;
+				return true;
+
+			case VK_FORMAT_B8G8R8A8_UNORM:
+			case VK_FORMAT_B8G8R8A8_SRGB:
+				aOffsets[0] = 2; aOffsets[1] = 1; aOffsets[2] = 0;
+				return true;
+
+			default:
+				return false;
+		}
+	}
+}
+
+void write_screenshot_png( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, VkImage aImage, VkFormat aFormat, VkExtent2D const& aExtent, char const* aPath )
+{
+	std::size_t offsets[3];
+	if( !rgb_offsets_( aFormat, offsets ) )
+		throw lut::Error( "%s: unsupported image format %d", aPath, int(aFormat) );
+
+	std::size_t const pixelCount = std::size_t(aExtent.width) * aExtent.height;
+	lut::Buffer readback = lut::create_buffer( aAllocator, pixelCount * 4, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU );
+
+	// Copy the image into the buffer
+	lut::CommandPool pool = lut::create_command_pool( aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT );
+	VkCommandBuffer cmd = lut::alloc_command_buffer( aContext, pool.handle );
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	if( auto const res = vkBeginCommandBuffer( cmd, &beginInfo ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to begin recording command buffer\n"
+			"vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str() );
+	}
+
+	// The render pass that wrote the image was submitted earlier
+	lut::image_barrier( cmd, aImage,
+		VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		VK_ACCESS_TRANSFER_READ_BIT,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT
+	);
+
+	VkBufferImageCopy copy{};
+	copy.bufferOffset = 0;
+	copy.bufferRowLength = 0; // tightly packed
+	copy.bufferImageHeight = 0;
+	copy.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+	copy.imageOffset = VkOffset3D{ 0, 0, 0 };
+	copy.imageExtent = VkExtent3D{ aExtent.width, aExtent.height, 1 };
+
+	vkCmdCopyImageToBuffer( cmd, aImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback.buffer, 1, &copy );
+
+	lut::buffer_barrier( cmd, readback.buffer,
+		VK_ACCESS_TRANSFER_WRITE_BIT,
+		VK_ACCESS_HOST_READ_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_HOST_BIT
+	);
+
+	if( auto const res = vkEndCommandBuffer( cmd ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to end recording command buffer\n"
+			"vkEndCommandBuffer() returned %s", lut::to_string(res).c_str() );
+	}
+
+	lut::Fence done = lut::create_fence( aContext );
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &cmd;
+
+	if( auto const res = vkQueueSubmit( aContext.graphicsQueue, 1, &submitInfo, done.handle ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to submit screenshot copy\n"
+			"vkQueueSubmit() returned %s", lut::to_string(res).c_str() );
+	}
+
+	if( auto const res = vkWaitForFences( aContext.device, 1, &done.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max() ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to wait for screenshot copy\n"
+			"vkWaitForFences() returned %s", lut::to_string(res).c_str() );
+	}
+
+	// Read back, dropping alpha (the swapchain image's alpha is not
+	// meaningful)
+	void* ptr = nullptr;
+	if( auto const res = vmaMapMemory( aAllocator.allocator, readback.allocation, &ptr ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Mapping screenshot memory\n"
+			"vmaMapMemory() returned %s", lut::to_string(res).c_str() );
+	}
+
+	vmaInvalidateAllocation( aAllocator.allocator, readback.allocation, 0, VK_WHOLE_SIZE );
+
+	auto const* src = static_cast<std::uint8_t const*>(ptr);
+
+	std::vector<std::uint8_t> rgb( pixelCount * 3 );
+	for( std::size_t i = 0; i < pixelCount; ++i )
+	{
+		rgb[i*3+0] = src[i*4+offsets[0]];
+		rgb[i*3+1] = src[i*4+offsets[1]];
+		rgb[i*3+2] = src[i*4+offsets[2]];
+	}
+
+	vmaUnmapMemory( aAllocator.allocator, readback.allocation );
+
+	if( !stbi_write_png( aPath, int(aExtent.width), int(aExtent.height), 3, rgb.data(), int(aExtent.width) * 3 ) )
+		throw lut::Error( "%s: unable to write PNG", aPath );
+}
@@ -0,0 +1,29 @@
+#ifndef SCREENSHOT_HPP_C72FB8C9_CCB8_46F8_8E50_641377E88F0B
+#define SCREENSHOT_HPP_C72FB8C9_CCB8_46F8_8E50_641377E88F0B
+
+#include <volk/volk.h>
+
+#include "../labutils/allocator.hpp"
+#include "../labutils/vulkan_context.hpp"
+namespace lut = labutils;
+
+// Screenshots, e.g., of the last frame of a headless run (see
+// lut::make_vulkan_window_headless()) for regression checks.
+//
+// Swap chain images are not created with TRANSFER_SRC usage, so only the
+// offscreen images of headless windows can be read back.
+
+// Copies aImage to the host and writes it to aPath as an 8-bit RGB PNG.
+// aImage must be an 8-bit RGBA or BGRA color image of aExtent in
+// VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, last written as a color attachment.
+// Waits for the copy to finish.
+void write_screenshot_png(
+	lut::VulkanContext const&,
+	lut::Allocator const&,
+	VkImage aImage,
+	VkFormat aFormat,
+	VkExtent2D const& aExtent,
+	char const* aPath
+);
+
+#endif // SCREENSHOT_HPP_C72FB8C9_CCB8_46F8_8E50_641377E88F0B
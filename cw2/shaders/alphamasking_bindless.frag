@@ -0,0 +1,104 @@
+#version 450 
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+layout (location = 0) in vec3 gPosition; //in world space
+layout (location = 1) in vec3 gNormal;
+layout (location = 2) in vec2 gTexCoord; 
+layout (location = 3) in vec4 gtangent;
+layout (location = 4) flat in uint gMaterialIndex;
+
+layout( set = 0, binding = 0 ) uniform UScene 
+	{ 
+		mat4 camera; 
+		mat4 projection; 
+		mat4 projCam; 
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec3 lightColor;
+		vec3 ambientColor;
+	} uScene; 
+
+
+// Bindless materials (see bindless.hpp): all textures in one array, the
+// material records in a storage buffer, and the material index from the
+// vertex shader's mesh record. The index is the same for the whole draw
+// (each draw of a multi-draw is its own invocation group), so the texture
+// indices are dynamically uniform and need no nonuniformEXT().
+layout( set = 1, binding = 0 ) uniform sampler2D uTextures[];
+
+struct Material
+{
+	uint baseColor;
+	uint roughness;
+	uint metalness;
+	uint alphaMask;
+	uint normalMap;
+	uint flags;
+	uint reserved[2];
+};
+
+const uint kMaterialPackedRma = 1;
+
+layout( std430, set = 1, binding = 1 ) readonly buffer UMaterials
+{
+	Material materials[];
+} uMaterials;
+
+#include "brdf.glsl"
+#include "clustered_lights.glsl"
+
+layout( location = 0 ) out vec4 oColor; 
+
+void main() 
+{ 
+
+	Material material = uMaterials.materials[gMaterialIndex];
+
+	vec4 base = texture( uTextures[material.baseColor], gTexCoord );
+
+	// Packed: roughness, metalness and alpha mask in one fetch
+	vec3 rma;
+	if( 0 != (material.flags & kMaterialPackedRma) )
+		rma = texture( uTextures[material.roughness], gTexCoord ).rgb;
+	else
+	{
+		rma.r = texture( uTextures[material.roughness], gTexCoord ).r;
+		rma.g = texture( uTextures[material.metalness], gTexCoord ).r;
+		rma.b = texture( uTextures[material.alphaMask], gTexCoord ).r;
+	}
+
+	highp float mask = rma.b;
+	if(base.a < mask)
+        discard;
+
+	// reading and converting from [0, 1] to [-1, 1]. Only x and y are
+	// used (BC5 normal maps store nothing else); z is reconstructed.
+	vec2 mapNormalXY = 2 * texture( uTextures[material.normalMap], gTexCoord ).rg - 1.0;
+	vec3 mapNormal = normalize(vec3(mapNormalXY, sqrt(max(0.0, 1.0 - dot(mapNormalXY, mapNormalXY)))));
+	vec3 vNormal = normalize(gNormal);
+	vec4 tangent = normalize(gtangent);
+	vec3 bitangent = normalize(cross(vNormal, tangent.xyz) * tangent.w);
+
+	vec3 normal = normalize( mat3( tangent.xyz, bitangent, vNormal) * mapNormal); 
+	
+	vec3 lightDirection = normalize(uScene.lightPosition - gPosition); 
+	vec3 viewDirection = normalize(uScene.cameraPosition - gPosition);	
+	// normal = normalize(gNormal);
+
+	vec3 basecolor = base.rgb;
+	highp float roughness = rma.r;
+	highp float metalness = rma.g;	
+	
+	// Ambient Light
+	vec3 AmbientLight = uScene.ambientColor * basecolor;
+
+	// Scene light, and the point lights of the fragment's cluster
+	vec3 Lo = brdf_nol( basecolor, roughness, metalness, normal, viewDirection, lightDirection ) * uScene.lightColor;
+	Lo += clustered_lights( gl_FragCoord.xy, gPosition, basecolor, roughness, metalness, normal, viewDirection );
+
+	oColor = vec4(AmbientLight + Lo, 1.0f);
+	
+} 
+
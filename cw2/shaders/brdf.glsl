@@ -0,0 +1,41 @@
+// BRDF of the lighting shaders: Lambertian diffuse, and a microfacet
+// specular term with a Blinn-Phong normal distribution, Schlick's Fresnel
+// approximation and the Cook-Torrance masking term. Returns the BRDF times
+// N.L, i.e., the reflected radiance per unit of radiance arriving from
+// lightDirection. All directions are unit length and point away from the
+// surface.
+
+#ifndef BRDF_GLSL
+#define BRDF_GLSL
+
+vec3 brdf_nol( vec3 basecolor, float roughness, float metalness, vec3 normal, vec3 viewDirection, vec3 lightDirection )
+{
+	vec3 halfVector = normalize(viewDirection + lightDirection);
+	highp float shininess =  max(2/(pow(roughness,4)), 0.0001) - 2;
+
+	// Dot Products
+	float NoH = max(dot(normal, halfVector), 0.0);
+	float NoV = max(dot(normal, viewDirection), 0.0);
+	float NoL = max(dot(normal, lightDirection), 0.0);
+	float VoH = dot(viewDirection, halfVector);
+
+	// Fresnel term - F, evaluate using the Schlick approximation
+	vec3 F0 = (1-metalness) * vec3(0.04f, 0.04f, 0.04f) + metalness * basecolor;
+	vec3 F = F0 + (1 - F0) * pow((1 - VoH), 5);
+
+	// Lambertian Diffuse
+	vec3 LDiffuse = (basecolor/3.14159265) * (vec3(1.0f,1.0f,1.0f) - F ) * (1.0f - metalness);
+
+	// Normal Distribution Function - D
+	float D = ((shininess + 2)/(2.0 * 3.14159265)) * (pow(NoH,shininess));
+
+	// Masking term from the Cook-Torrance model - G
+	float G = min (1, min((2 * NoH * NoV / VoH) , (2 * NoH * NoL / VoH)));
+
+	// microfacet BRDF model
+	vec3 Fr = LDiffuse + (D * F * G )/ max((4 * NoV * NoL), 0.0001); 
+
+	return Fr * NoL;
+}
+
+#endif // BRDF_GLSL
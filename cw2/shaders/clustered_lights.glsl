@@ -0,0 +1,88 @@
+// Clustered point lights (see clustered_lights.hpp), in set 2 of the
+// lighting pipelines. light_cluster_index() mirrors the C++ function of the
+// same name. Requires brdf.glsl.
+
+#ifndef CLUSTERED_LIGHTS_GLSL
+#define CLUSTERED_LIGHTS_GLSL
+
+// Must match clustered_lights.hpp
+const uint kLightClustersX = 16;
+const uint kLightClustersY = 9;
+const uint kLightClustersZ = 24;
+const uint kMaxLightsPerCluster = 128;
+
+struct PointLight
+{
+	vec4 positionRadius; // xyz: world space position, w: radius
+	vec4 color;          // rgb: intensity
+};
+
+layout( std140, set = 2, binding = 0 ) uniform ULightClusters
+{
+	mat4 camera;
+	mat4 inverseProjection;
+
+	vec4 screen; // xy: framebuffer size, zw: near, far
+	vec4 slices; // x: scale, y: bias
+
+	uint lightCount;
+} uLightClusters;
+
+layout( std430, set = 2, binding = 1 ) readonly buffer ULights
+{
+	PointLight lights[];
+} uLights;
+
+layout( std430, set = 2, binding = 2 ) readonly buffer UClusterCounts
+{
+	uint counts[];
+} uClusterCounts;
+
+layout( std430, set = 2, binding = 3 ) readonly buffer UClusterIndices
+{
+	uint indices[];
+} uClusterIndices;
+
+uint light_cluster_index( vec2 fragCoord, vec3 worldPos )
+{
+	uint x = min( uint(fragCoord.x * kLightClustersX / uLightClusters.screen.x), kLightClustersX-1 );
+	uint y = min( uint(fragCoord.y * kLightClustersY / uLightClusters.screen.y), kLightClustersY-1 );
+
+	float depth = -(uLightClusters.camera * vec4( worldPos, 1.0 )).z;
+	float slice = floor( log( max( depth, 1e-6 ) ) * uLightClusters.slices.x + uLightClusters.slices.y );
+	uint z = uint( clamp( slice, 0.0, float(kLightClustersZ-1) ) );
+
+	return (z * kLightClustersY + y) * kLightClustersX + x;
+}
+
+// Sum of the BRDF-weighted radiance of the lights in the fragment's cluster.
+// The lights fall off with the inverse square of the distance (offset by 1
+// to avoid the singularity), windowed to reach zero at their radius.
+vec3 clustered_lights( vec2 fragCoord, vec3 worldPos, vec3 basecolor, float roughness, float metalness, vec3 normal, vec3 viewDirection )
+{
+	uint cluster = light_cluster_index( fragCoord, worldPos );
+	uint count = uClusterCounts.counts[cluster];
+
+	vec3 ret = vec3( 0.0 );
+	for( uint i = 0; i < count; ++i )
+	{
+		PointLight light = uLights.lights[uClusterIndices.indices[cluster * kMaxLightsPerCluster + i]];
+
+		vec3 toLight = light.positionRadius.xyz - worldPos;
+		float dist2 = dot( toLight, toLight );
+		float radius2 = light.positionRadius.w * light.positionRadius.w;
+		if( dist2 >= radius2 )
+			continue;
+
+		float x = dist2 / radius2;
+		float window = (1.0 - x*x) * (1.0 - x*x);
+		float attenuation = window / (dist2 + 1.0);
+
+		vec3 lightDirection = toLight * inversesqrt( max( dist2, 1e-8 ) );
+		ret += brdf_nol( basecolor, roughness, metalness, normal, viewDirection, lightDirection ) * light.color.rgb * attenuation;
+	}
+
+	return ret;
+}
+
+#endif // CLUSTERED_LIGHTS_GLSL
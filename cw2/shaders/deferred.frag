@@ -0,0 +1,62 @@
+#version 450 
+#extension GL_GOOGLE_include_directive : require
+
+layout( set = 0, binding = 0 ) uniform UScene 
+	{ 
+		mat4 camera; 
+		mat4 projection; 
+		mat4 projCam; 
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec3 lightColor;
+		vec3 ambientColor;
+	} uScene; 
+
+// G-buffer (see deferred.hpp), written by the previous subpass
+layout( input_attachment_index = 0, set = 1, binding = 0 ) uniform subpassInput uDepth;
+layout( input_attachment_index = 1, set = 1, binding = 1 ) uniform subpassInput uAlbedo;
+layout( input_attachment_index = 2, set = 1, binding = 2 ) uniform subpassInput uNormal;
+layout( input_attachment_index = 3, set = 1, binding = 3 ) uniform subpassInput uMaterial;
+
+layout( push_constant ) uniform UDeferred
+{
+	mat4 inverseProjCam; // clip to world
+} uDeferred;
+
+#include "brdf.glsl"
+#include "gbuffer.glsl"
+#include "clustered_lights.glsl"
+
+layout( location = 0 ) out vec4 oColor; 
+
+void main() 
+{ 
+	// Nothing was drawn here; keep the clear color
+	float depth = subpassLoad( uDepth ).r;
+	if( depth >= 1.0 )
+		discard;
+
+	// World space position from depth
+	vec2 ndc = gl_FragCoord.xy / uLightClusters.screen.xy * 2.0 - 1.0;
+	vec4 world = uDeferred.inverseProjCam * vec4( ndc, depth, 1.0 );
+	vec3 position = world.xyz / world.w;
+
+	vec3 basecolor = subpassLoad( uAlbedo ).rgb;
+	vec3 normal = gbuffer_decode_normal( subpassLoad( uNormal ).rg );
+	vec2 rm = subpassLoad( uMaterial ).rg;
+	highp float roughness = rm.r;
+	highp float metalness = rm.g;
+
+	vec3 lightDirection = normalize(uScene.lightPosition - position); 
+	vec3 viewDirection = normalize(uScene.cameraPosition - position);	
+
+	// Ambient Light
+	vec3 AmbientLight = uScene.ambientColor * basecolor;
+
+	// Scene light, and the point lights of the fragment's cluster
+	vec3 Lo = brdf_nol( basecolor, roughness, metalness, normal, viewDirection, lightDirection ) * uScene.lightColor;
+	Lo += clustered_lights( gl_FragCoord.xy, position, basecolor, roughness, metalness, normal, viewDirection );
+
+	oColor = vec4(AmbientLight + Lo, 1.0f);
+} 
@@ -0,0 +1,26 @@
+#version 450
+
+// Depth pre-pass for opaque geometry with separate vertex streams: reads the
+// position stream only. gl_Position must match the shading pass exactly,
+// since that tests with VK_COMPARE_OP_EQUAL.
+
+layout (location = 0) in vec3 position;
+
+layout( set = 0, binding = 0 ) uniform UScene
+	{
+		mat4 camera;
+		mat4 projection;
+		mat4 projCam;
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec4 lightColor;
+		vec4 ambientColor;
+	} uScene;
+
+invariant gl_Position;
+
+void main()
+{
+	gl_Position = uScene.projCam * vec4( position, 1.f );
+}
@@ -0,0 +1,15 @@
+#version 450 
+
+// Depth pre-pass for alpha-masked geometry: only the alpha test of
+// alphamasking.frag, no shading. Uses the shading pass's vertex shader.
+
+layout (location = 2) in vec2 gTexCoord; 
+
+layout( set = 1, binding = 0 ) uniform sampler2D BaseColorSampler;
+layout( set = 1, binding = 3 ) uniform sampler2D AlphaMaskSampler; 
+
+void main() 
+{ 
+	if( texture( BaseColorSampler, gTexCoord ).a < texture( AlphaMaskSampler, gTexCoord ).r )
+		discard;
+} 
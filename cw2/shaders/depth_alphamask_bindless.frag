@@ -0,0 +1,43 @@
+#version 450 
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Variant of depth_alphamask.frag for bindless materials (see
+// alphamasking_bindless.frag). With packed textures, the mask is the B
+// channel of the RMA texture in the roughness slot.
+
+layout (location = 2) in vec2 gTexCoord; 
+layout (location = 4) flat in uint gMaterialIndex;
+
+layout( set = 1, binding = 0 ) uniform sampler2D uTextures[];
+
+struct Material
+{
+	uint baseColor;
+	uint roughness;
+	uint metalness;
+	uint alphaMask;
+	uint normalMap;
+	uint flags;
+	uint reserved[2];
+};
+
+const uint kMaterialPackedRma = 1;
+
+layout( std430, set = 1, binding = 1 ) readonly buffer UMaterials
+{
+	Material materials[];
+} uMaterials;
+
+void main() 
+{ 
+	Material material = uMaterials.materials[gMaterialIndex];
+
+	float mask;
+	if( 0 != (material.flags & kMaterialPackedRma) )
+		mask = texture( uTextures[material.roughness], gTexCoord ).b;
+	else
+		mask = texture( uTextures[material.alphaMask], gTexCoord ).r;
+
+	if( texture( uTextures[material.baseColor], gTexCoord ).a < mask )
+		discard;
+} 
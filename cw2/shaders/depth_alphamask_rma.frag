@@ -0,0 +1,15 @@
+#version 450 
+
+// Variant of depth_alphamask.frag for packed material textures; the alpha
+// mask is the B channel of the RMA texture (see alphamasking_rma.frag).
+
+layout (location = 2) in vec2 gTexCoord; 
+
+layout( set = 1, binding = 0 ) uniform sampler2D BaseColorSampler;
+layout( set = 1, binding = 1 ) uniform sampler2D RmaSampler; 
+
+void main() 
+{ 
+	if( texture( BaseColorSampler, gTexCoord ).a < texture( RmaSampler, gTexCoord ).b )
+		discard;
+} 
@@ -0,0 +1,34 @@
+#version 450
+
+// Depth pre-pass for opaque geometry with an interleaved (packed) vertex
+// format: reads the position attribute only. See depth.vert.
+
+layout (location = 0) in vec4 position; // xyz: position
+
+layout( set = 0, binding = 0 ) uniform UScene
+	{
+		mat4 camera;
+		mat4 projection;
+		mat4 projCam;
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec4 lightColor;
+		vec4 ambientColor;
+	} uScene;
+
+// Dequantization of position.xyz; identity for fp32 positions.
+layout( push_constant ) uniform UMesh
+	{
+		vec4 positionOffset;
+		vec4 positionScale;
+	} uMesh;
+
+invariant gl_Position;
+
+void main()
+{
+	vec3 pos = uMesh.positionOffset.xyz + position.xyz * uMesh.positionScale.xyz;
+
+	gl_Position = uScene.projCam * vec4( pos, 1.f );
+}
@@ -0,0 +1,44 @@
+#version 450
+
+// Variant of depth_packed.vert for bindless materials, which takes the
+// dequantization from the mesh record (see lighting_packed_bindless.vert).
+
+layout (location = 0) in vec4 position; // xyz: position
+
+layout( set = 0, binding = 0 ) uniform UScene
+	{
+		mat4 camera;
+		mat4 projection;
+		mat4 projCam;
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec4 lightColor;
+		vec4 ambientColor;
+	} uScene;
+
+struct Mesh
+{
+	vec4 positionOffset;
+	vec4 positionScale;
+	uint materialId;
+	uint firstIndex;
+	int vertexOffset;
+	uint reserved;
+};
+
+layout( std430, set = 1, binding = 2 ) readonly buffer UMeshes
+{
+	Mesh meshes[];
+} uMeshes;
+
+invariant gl_Position;
+
+void main()
+{
+	Mesh mesh = uMeshes.meshes[gl_InstanceIndex];
+
+	vec3 pos = mesh.positionOffset.xyz + position.xyz * mesh.positionScale.xyz;
+
+	gl_Position = uScene.projCam * vec4( pos, 1.f );
+}
@@ -0,0 +1,9 @@
+#version 450
+
+// Fullscreen triangle, without vertex buffers: vertices 0, 1, 2 map to
+// (-1,-1), (3,-1) and (-1,3), which covers the viewport
+void main()
+{
+	vec2 uv = vec2( (gl_VertexIndex << 1) & 2, gl_VertexIndex & 2 );
+	gl_Position = vec4( uv * 2.0 - 1.0, 0.0, 1.0 );
+}
@@ -0,0 +1,34 @@
+// G-buffer of the deferred path (see deferred.hpp). Normals are stored
+// octahedrally encoded: the unit sphere is projected onto the octahedron
+// |x| + |y| + |z| = 1, whose lower half is folded over the upper one, and
+// the result is flattened into the square [-1, 1]^2.
+
+#ifndef GBUFFER_GLSL
+#define GBUFFER_GLSL
+
+vec2 gbuffer_encode_normal( vec3 n )
+{
+	n /= abs( n.x ) + abs( n.y ) + abs( n.z );
+
+	vec2 e = n.xy;
+	if( n.z < 0.0 )
+	{
+		vec2 signs = mix( vec2( -1.0 ), vec2( 1.0 ), greaterThanEqual( e, vec2( 0.0 ) ) );
+		e = (1.0 - abs( e.yx )) * signs;
+	}
+
+	return e;
+}
+
+vec3 gbuffer_decode_normal( vec2 e )
+{
+	vec3 n = vec3( e, 1.0 - abs( e.x ) - abs( e.y ) );
+
+	// Unfold the lower half
+	float t = max( -n.z, 0.0 );
+	n.xy += mix( vec2( t ), vec2( -t ), greaterThanEqual( n.xy, vec2( 0.0 ) ) );
+
+	return normalize( n );
+}
+
+#endif // GBUFFER_GLSL
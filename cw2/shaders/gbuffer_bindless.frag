@@ -0,0 +1,81 @@
+#version 450 
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+// G-buffer pass of the deferred path: the material fetches and normal
+// mapping of lighting_bindless.frag, without shading
+
+layout (location = 0) in vec3 gPosition; //in world space
+layout (location = 1) in vec3 gNormal;
+layout (location = 2) in vec2 gTexCoord; 
+layout (location = 3) in vec4 gtangent;
+layout (location = 4) flat in uint gMaterialIndex;
+
+// Bindless materials (see bindless.hpp): all textures in one array, the
+// material records in a storage buffer, and the material index from the
+// vertex shader's mesh record. The index is the same for the whole draw
+// (each draw of a multi-draw is its own invocation group), so the texture
+// indices are dynamically uniform and need no nonuniformEXT().
+layout( set = 1, binding = 0 ) uniform sampler2D uTextures[];
+
+struct Material
+{
+	uint baseColor;
+	uint roughness;
+	uint metalness;
+	uint alphaMask;
+	uint normalMap;
+	uint flags;
+	uint reserved[2];
+};
+
+const uint kMaterialPackedRma = 1;
+
+layout( std430, set = 1, binding = 1 ) readonly buffer UMaterials
+{
+	Material materials[];
+} uMaterials;
+
+#include "gbuffer.glsl"
+
+// G-buffer (see deferred.hpp)
+layout( location = 0 ) out vec4 oAlbedo;
+layout( location = 1 ) out vec2 oNormal;
+layout( location = 2 ) out vec2 oMaterial;
+
+void main() 
+{ 
+	Material material = uMaterials.materials[gMaterialIndex];
+
+	// reading and converting from [0, 1] to [-1, 1]. Only x and y are
+	// used (BC5 normal maps store nothing else); z is reconstructed.
+	vec2 mapNormalXY = 2 * texture( uTextures[material.normalMap], gTexCoord ).rg - 1.0;
+	vec3 mapNormal = normalize(vec3(mapNormalXY, sqrt(max(0.0, 1.0 - dot(mapNormalXY, mapNormalXY)))));
+	vec3 vNormal = normalize(gNormal);
+	vec4 tangent = normalize(gtangent);
+	vec3 bitangent = normalize(cross(vNormal, tangent.xyz) * tangent.w);
+
+	vec3 normal = normalize( mat3( tangent.xyz, bitangent, vNormal) * mapNormal); 
+
+	vec3 basecolor = texture( uTextures[material.baseColor], gTexCoord ).rgb;
+
+	// Packed: roughness and metalness in one fetch
+	highp float roughness, metalness;
+	if( 0 != (material.flags & kMaterialPackedRma) )
+	{
+		vec2 rm = texture( uTextures[material.roughness], gTexCoord ).rg;
+		roughness = rm.r;
+		metalness = rm.g;
+	}
+	else
+	{
+		roughness = texture( uTextures[material.roughness], gTexCoord ).r;
+		metalness = texture( uTextures[material.metalness], gTexCoord ).r;
+	}
+
+	oAlbedo = vec4( basecolor, 1.0 );
+	oNormal = gbuffer_encode_normal( normal );
+	oMaterial = vec2( roughness, metalness );
+	
+} 
+
@@ -0,0 +1,47 @@
+#version 450 
+#extension GL_GOOGLE_include_directive : require
+
+// G-buffer pass of the deferred path: the material fetches and normal
+// mapping of lighting_rma.frag, without shading
+
+layout (location = 0) in vec3 gPosition; //in world space
+layout (location = 1) in vec3 gNormal;
+layout (location = 2) in vec2 gTexCoord; 
+layout (location = 3) in vec4 gtangent;
+
+layout( set = 1, binding = 0 ) uniform sampler2D BaseColorSampler;
+// Packed material texture: roughness (r), metalness (g); b (alpha mask) is
+// unused here
+layout( set = 1, binding = 1 ) uniform sampler2D RmaSampler; 
+layout( set = 1, binding = 2 ) uniform sampler2D NormalMapSampler;
+
+#include "gbuffer.glsl"
+
+// G-buffer (see deferred.hpp)
+layout( location = 0 ) out vec4 oAlbedo;
+layout( location = 1 ) out vec2 oNormal;
+layout( location = 2 ) out vec2 oMaterial;
+
+void main() 
+{ 
+	// reading and converting from [0, 1] to [-1, 1]. Only x and y are
+	// used (BC5 normal maps store nothing else); z is reconstructed.
+	vec2 mapNormalXY = 2 * texture( NormalMapSampler, gTexCoord ).rg - 1.0;
+	vec3 mapNormal = normalize(vec3(mapNormalXY, sqrt(max(0.0, 1.0 - dot(mapNormalXY, mapNormalXY)))));
+	vec3 vNormal = normalize(gNormal);
+	vec4 tangent = normalize(gtangent);
+	vec3 bitangent = normalize(cross(vNormal, tangent.xyz) * tangent.w);
+
+	vec3 normal = normalize( mat3( tangent.xyz, bitangent, vNormal) * mapNormal); 
+
+	vec3 basecolor = texture( BaseColorSampler, gTexCoord ).rgb;
+	vec2 rm = texture( RmaSampler, gTexCoord ).rg;
+	highp float roughness = rm.r;
+	highp float metalness = rm.g;	
+
+	oAlbedo = vec4( basecolor, 1.0 );
+	oNormal = gbuffer_encode_normal( normal );
+	oMaterial = vec2( roughness, metalness );
+	
+} 
+
@@ -1,4 +1,5 @@
 #version 450 
+#extension GL_GOOGLE_include_directive : require
 
 layout (location = 0) in vec3 gPosition; //in world space
 layout (location = 1) in vec3 gNormal;
@@ -24,12 +25,17 @@ layout( set = 1, binding = 1 ) uniform sampler2D RoughnessSampler;
 layout( set = 1, binding = 2 ) uniform sampler2D MetalnessSampler; 
 layout( set = 1, binding = 3 ) uniform sampler2D NormalMapSampler;
 
+#include "brdf.glsl"
+#include "clustered_lights.glsl"
+
 layout( location = 0 ) out vec4 oColor; 
 
 void main() 
 { 
-	// reading and converting from [0, 1] to [-1, 1]
-	vec3 mapNormal = normalize(2 * texture( NormalMapSampler, gTexCoord ).rgb - 1.0);
+	// reading and converting from [0, 1] to [-1, 1]. Only x and y are
+	// used (BC5 normal maps store nothing else); z is reconstructed.
+	vec2 mapNormalXY = 2 * texture( NormalMapSampler, gTexCoord ).rg - 1.0;
+	vec3 mapNormal = normalize(vec3(mapNormalXY, sqrt(max(0.0, 1.0 - dot(mapNormalXY, mapNormalXY)))));
 	vec3 vNormal = normalize(gNormal);
 	vec4 tangent = normalize(gtangent);
 	vec3 bitangent = normalize(cross(vNormal, tangent.xyz) * tangent.w);
@@ -38,41 +44,20 @@ void main()
 	
 	vec3 lightDirection = normalize(uScene.lightPosition - gPosition); 
 	vec3 viewDirection = normalize(uScene.cameraPosition - gPosition);	
-	vec3 halfVector = normalize(viewDirection + lightDirection);
 	//normal = normalize(gNormal);
 
 	vec3 basecolor = texture( BaseColorSampler, gTexCoord ).rgb;
 	highp float roughness = texture( RoughnessSampler, gTexCoord ).r;
 	highp float metalness = texture( MetalnessSampler, gTexCoord ).r;	
-	highp float shininess =  max(2/(pow(roughness,4)), 0.0001) - 2;
-
-
-	// Dot Products
-	float NoH = max(dot(normal, halfVector), 0.0);
-	float NoV = max(dot(normal, viewDirection), 0.0);
-	float NoL = max(dot(normal, lightDirection), 0.0);
-	float VoH = dot(viewDirection, halfVector);
 
 	// Ambient Light
 	vec3 AmbientLight = uScene.ambientColor * basecolor;
 
-	// Fresnel term - F, evaluate using the Schlick approximation
-	vec3 F0 = (1-metalness) * vec3(0.04f, 0.04f, 0.04f) + metalness * basecolor;
-	vec3 F = F0 + (1 - F0) * pow((1 - VoH), 5);
-
-	// Lambertian Diffuse
-	vec3 LDiffuse = (basecolor/3.14159265) * (vec3(1.0f,1.0f,1.0f) - F ) * (1.0f - metalness);
-
-	// Normal Distribution Function - D
-	float D = ((shininess + 2)/(2.0 * 3.14159265)) * (pow(NoH,shininess));
-
-	// Masking term from the Cook-Torrance model - G
-	float G = min (1, min((2 * NoH * NoV / VoH) , (2 * NoH * NoL / VoH)));
-
-	// microfacet BRDF model
-	vec3 Fr = LDiffuse + (D * F * G )/ max((4 * NoV * NoL), 0.0001); 
+	// Scene light, and the point lights of the fragment's cluster
+	vec3 Lo = brdf_nol( basecolor, roughness, metalness, normal, viewDirection, lightDirection ) * uScene.lightColor;
+	Lo += clustered_lights( gl_FragCoord.xy, gPosition, basecolor, roughness, metalness, normal, viewDirection );
 
-	oColor = vec4(AmbientLight + Fr * uScene.lightColor * NoL , 1.0f);
+	oColor = vec4(AmbientLight + Lo, 1.0f);
 	
 } 
 
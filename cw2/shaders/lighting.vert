@@ -22,6 +22,9 @@ layout (location = 1) out vec3 gNormal;
 layout (location = 2) out vec2 gTexCoord; 
 layout (location = 3) out vec4 gtangent;
 
+// Must match the depth pre-pass (depth*.vert), see create_pipeline()
+invariant gl_Position;
+
 void main() 
 { 
 	gPosition = position;
@@ -0,0 +1,57 @@
+#version 450 
+
+// Variant of lighting.vert for bindless materials (see bindless.hpp). Each
+// draw passes its mesh ID as firstInstance; the mesh record provides the
+// material index for the fragment shader.
+
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec3 normal;
+layout (location = 2) in vec2 texcoord;
+layout (location = 3) in vec4 tangent;
+
+layout( set = 0, binding = 0 ) uniform UScene 
+	{ 
+		mat4 camera; 
+		mat4 projection; 
+		mat4 projCam; 
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec4 lightColor;
+		vec4 ambientColor;
+	} uScene; 
+
+struct Mesh
+{
+	vec4 positionOffset;
+	vec4 positionScale;
+	uint materialId;
+	uint firstIndex;
+	int vertexOffset;
+	uint reserved;
+};
+
+layout( std430, set = 1, binding = 2 ) readonly buffer UMeshes
+{
+	Mesh meshes[];
+} uMeshes;
+
+layout (location = 0) out vec3 gPosition;
+layout (location = 1) out vec3 gNormal; 
+layout (location = 2) out vec2 gTexCoord; 
+layout (location = 3) out vec4 gtangent;
+layout (location = 4) flat out uint gMaterialIndex;
+
+// Must match the depth pre-pass (depth*.vert), see create_pipeline()
+invariant gl_Position;
+
+void main() 
+{ 
+	gPosition = position;
+	gNormal = normalize(normal);
+	gTexCoord = texcoord;
+	gtangent = tangent;
+	gMaterialIndex = uMeshes.meshes[gl_InstanceIndex].materialId;
+
+	gl_Position = uScene.projCam * vec4( position, 1.f ); 
+} 
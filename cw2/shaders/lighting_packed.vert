@@ -0,0 +1,55 @@
+#version 450
+
+// Variant of lighting.vert for the interleaved vertex formats written by
+// cw2-bake --vertex-format packed|packed16. See cw2/baked_format.hpp.
+
+layout (location = 0) in vec4 position; // xyz: position, w: tangent sign (< 0.5 means -1)
+layout (location = 1) in vec4 frame;    // xy: oct. normal, zw: oct. tangent
+layout (location = 2) in vec2 texcoord;
+
+layout( set = 0, binding = 0 ) uniform UScene
+	{
+		mat4 camera;
+		mat4 projection;
+		mat4 projCam;
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec4 lightColor;
+		vec4 ambientColor;
+	} uScene;
+
+// Dequantization of position.xyz; identity for fp32 positions.
+layout( push_constant ) uniform UMesh
+	{
+		vec4 positionOffset;
+		vec4 positionScale;
+	} uMesh;
+
+layout (location = 0) out vec3 gPosition;
+layout (location = 1) out vec3 gNormal;
+layout (location = 2) out vec2 gTexCoord;
+layout (location = 3) out vec4 gtangent;
+
+vec3 oct_decode( vec2 e )
+{
+	vec3 v = vec3( e, 1.0 - abs(e.x) - abs(e.y) );
+	if( v.z < 0.0 )
+		v.xy = (1.0 - abs(v.yx)) * vec2( v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0 );
+	return normalize( v );
+}
+
+// Must match the depth pre-pass (depth*.vert), see create_pipeline()
+invariant gl_Position;
+
+void main()
+{
+	vec3 pos = uMesh.positionOffset.xyz + position.xyz * uMesh.positionScale.xyz;
+
+	gPosition = pos;
+	gNormal = oct_decode( frame.xy );
+	gTexCoord = texcoord;
+	gtangent = vec4( oct_decode( frame.zw ), position.w < 0.5 ? -1.0 : 1.0 );
+
+	gl_Position = uScene.projCam * vec4( pos, 1.f );
+}
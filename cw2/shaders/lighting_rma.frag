@@ -0,0 +1,65 @@
+#version 450 
+#extension GL_GOOGLE_include_directive : require
+
+layout (location = 0) in vec3 gPosition; //in world space
+layout (location = 1) in vec3 gNormal;
+layout (location = 2) in vec2 gTexCoord; 
+layout (location = 3) in vec4 gtangent;
+
+layout( set = 0, binding = 0 ) uniform UScene 
+	{ 
+		mat4 camera; 
+		mat4 projection; 
+		mat4 projCam; 
+
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec3 lightColor;
+		vec3 ambientColor;
+	} uScene; 
+
+
+layout( set = 1, binding = 0 ) uniform sampler2D BaseColorSampler;
+// Packed material texture: roughness (r), metalness (g); b (alpha mask) is
+// unused here
+layout( set = 1, binding = 1 ) uniform sampler2D RmaSampler; 
+layout( set = 1, binding = 2 ) uniform sampler2D NormalMapSampler;
+
+#include "brdf.glsl"
+#include "clustered_lights.glsl"
+
+layout( location = 0 ) out vec4 oColor; 
+
+void main() 
+{ 
+	// reading and converting from [0, 1] to [-1, 1]. Only x and y are
+	// used (BC5 normal maps store nothing else); z is reconstructed.
+	vec2 mapNormalXY = 2 * texture( NormalMapSampler, gTexCoord ).rg - 1.0;
+	vec3 mapNormal = normalize(vec3(mapNormalXY, sqrt(max(0.0, 1.0 - dot(mapNormalXY, mapNormalXY)))));
+	vec3 vNormal = normalize(gNormal);
+	vec4 tangent = normalize(gtangent);
+	vec3 bitangent = normalize(cross(vNormal, tangent.xyz) * tangent.w);
+
+	vec3 normal = normalize( mat3( tangent.xyz, bitangent, vNormal) * mapNormal); 
+	
+	vec3 lightDirection = normalize(uScene.lightPosition - gPosition); 
+	vec3 viewDirection = normalize(uScene.cameraPosition - gPosition);	
+	//normal = normalize(gNormal);
+
+	vec3 basecolor = texture( BaseColorSampler, gTexCoord ).rgb;
+	vec2 rm = texture( RmaSampler, gTexCoord ).rg;
+	highp float roughness = rm.r;
+	highp float metalness = rm.g;	
+
+	// Ambient Light
+	vec3 AmbientLight = uScene.ambientColor * basecolor;
+
+	// Scene light, and the point lights of the fragment's cluster
+	vec3 Lo = brdf_nol( basecolor, roughness, metalness, normal, viewDirection, lightDirection ) * uScene.lightColor;
+	Lo += clustered_lights( gl_FragCoord.xy, gPosition, basecolor, roughness, metalness, normal, viewDirection );
+
+	oColor = vec4(AmbientLight + Lo, 1.0f);
+	
+} 
+
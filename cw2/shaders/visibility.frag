@@ -0,0 +1,17 @@
+#version 450 
+#extension GL_GOOGLE_include_directive : require
+
+// Geometry pass of the visibility buffer (see visibility.hpp): writes the
+// mesh ID and triangle index only. gl_PrimitiveID counts the triangles of
+// the current draw, so each draw must cover a whole mesh.
+
+layout (location = 5) flat in uint gMeshId;
+
+#include "visibility.glsl"
+
+layout( location = 0 ) out uint oVisibility;
+
+void main() 
+{ 
+	oVisibility = visibility_pack( gMeshId, uint(gl_PrimitiveID) );
+} 
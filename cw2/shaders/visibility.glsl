@@ -0,0 +1,60 @@
+// Visibility buffer (see visibility.hpp). Each pixel holds the mesh ID and
+// triangle index of the surface it shows, packed into one uint; 0 marks
+// pixels where nothing was drawn. visibility_pack() and
+// visibility_barycentrics() mirror the C++ functions of the same names.
+
+#ifndef VISIBILITY_GLSL
+#define VISIBILITY_GLSL
+
+// Must match visibility.hpp
+const uint kVisibilityTriangleBits = 20;
+const uint kVisibilityTriangleMask = (1u << kVisibilityTriangleBits) - 1u;
+const uint kVisibilityMaxMeshes = (1u << (32u - kVisibilityTriangleBits)) - 1u;
+
+// 0 (nothing drawn) if meshId or triangle does not fit
+uint visibility_pack( uint meshId, uint triangle )
+{
+	if( meshId >= kVisibilityMaxMeshes || triangle > kVisibilityTriangleMask )
+		return 0u;
+
+	return ((meshId + 1u) << kVisibilityTriangleBits) | triangle;
+}
+
+// Perspective-correct barycentrics of the pixel at ndc (in [-1, 1]^2)
+// within the triangle with clip space vertices c0, c1 and c2, and their
+// change per pixel in x and y (for texture LOD). pixelSize is the size of
+// one pixel in ndc, i.e., 2 / framebuffer size.
+struct Barycentrics
+{
+	vec3 lambda;
+	vec3 ddx;
+	vec3 ddy;
+};
+
+Barycentrics visibility_barycentrics( vec4 c0, vec4 c1, vec4 c2, vec2 ndc, vec2 pixelSize )
+{
+	vec3 invW = 1.0 / vec3( c0.w, c1.w, c2.w );
+
+	vec2 p0 = c0.xy * invW.x;
+	vec2 p1 = c1.xy * invW.y;
+	vec2 p2 = c2.xy * invW.z;
+
+	// Screen space (affine) barycentrics are linear in ndc
+	float invDet = 1.0 / ((p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x));
+	vec3 dbdx = vec3( p1.y - p2.y, p2.y - p0.y, p0.y - p1.y ) * invDet;
+	vec3 dbdy = vec3( p2.x - p1.x, p0.x - p2.x, p1.x - p0.x ) * invDet;
+
+	// Interpolate b/w linearly, and divide by the interpolated 1/w
+	vec2 d = ndc - p0;
+	vec3 f = (vec3( 1.0, 0.0, 0.0 ) + dbdx * d.x + dbdy * d.y) * invW;
+	vec3 fx = f + dbdx * (pixelSize.x * invW);
+	vec3 fy = f + dbdy * (pixelSize.y * invW);
+
+	Barycentrics ret;
+	ret.lambda = f / (f.x + f.y + f.z);
+	ret.ddx = fx / (fx.x + fx.y + fx.z) - ret.lambda;
+	ret.ddy = fy / (fy.x + fy.y + fy.z) - ret.lambda;
+	return ret;
+}
+
+#endif // VISIBILITY_GLSL
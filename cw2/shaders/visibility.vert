@@ -0,0 +1,53 @@
+#version 450 
+
+// Geometry pass of the visibility buffer (see visibility.hpp), for separate
+// vertex streams. Only the position is needed, plus the texture coordinate
+// for alpha masking; the resolve pass fetches the other attributes itself.
+// Output locations match lighting_bindless.vert, so that the depth pre-pass
+// can use depth_alphamask_bindless.frag with this shader.
+
+layout (location = 0) in vec3 position;
+layout (location = 2) in vec2 texcoord;
+
+layout( set = 0, binding = 0 ) uniform UScene 
+	{ 
+		mat4 camera; 
+		mat4 projection; 
+		mat4 projCam; 
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec4 lightColor;
+		vec4 ambientColor;
+	} uScene; 
+
+struct Mesh
+{
+	vec4 positionOffset;
+	vec4 positionScale;
+	uint materialId;
+	uint firstIndex;
+	int vertexOffset;
+	uint reserved;
+};
+
+layout( std430, set = 1, binding = 2 ) readonly buffer UMeshes
+{
+	Mesh meshes[];
+} uMeshes;
+
+layout (location = 2) out vec2 gTexCoord; 
+layout (location = 4) flat out uint gMaterialIndex;
+layout (location = 5) flat out uint gMeshId;
+
+// Must match the depth pre-pass (depth*.vert), see create_pipeline()
+invariant gl_Position;
+
+void main() 
+{ 
+	gTexCoord = texcoord;
+	gMaterialIndex = uMeshes.meshes[gl_InstanceIndex].materialId;
+	gMeshId = gl_InstanceIndex;
+
+	gl_Position = uScene.projCam * vec4( position, 1.f ); 
+} 
@@ -0,0 +1,50 @@
+#version 450 
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Variant of visibility.frag with alpha masking (see
+// depth_alphamask_bindless.frag).
+
+layout (location = 2) in vec2 gTexCoord; 
+layout (location = 4) flat in uint gMaterialIndex;
+layout (location = 5) flat in uint gMeshId;
+
+layout( set = 1, binding = 0 ) uniform sampler2D uTextures[];
+
+struct Material
+{
+	uint baseColor;
+	uint roughness;
+	uint metalness;
+	uint alphaMask;
+	uint normalMap;
+	uint flags;
+	uint reserved[2];
+};
+
+const uint kMaterialPackedRma = 1;
+
+layout( std430, set = 1, binding = 1 ) readonly buffer UMaterials
+{
+	Material materials[];
+} uMaterials;
+
+#include "visibility.glsl"
+
+layout( location = 0 ) out uint oVisibility;
+
+void main() 
+{ 
+	Material material = uMaterials.materials[gMaterialIndex];
+
+	float mask;
+	if( 0 != (material.flags & kMaterialPackedRma) )
+		mask = texture( uTextures[material.roughness], gTexCoord ).b;
+	else
+		mask = texture( uTextures[material.alphaMask], gTexCoord ).r;
+
+	if( texture( uTextures[material.baseColor], gTexCoord ).a < mask )
+		discard;
+
+	oVisibility = visibility_pack( gMeshId, uint(gl_PrimitiveID) );
+} 
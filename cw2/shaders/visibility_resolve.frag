@@ -0,0 +1,231 @@
+#version 450 
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+// Resolve pass of the visibility buffer (see visibility.hpp). For each
+// covered pixel, fetches the three vertices of its triangle from the
+// geometry arena, interpolates their attributes with perspective-correct
+// barycentrics, and shades as lighting_bindless.frag does. Neighbouring
+// pixels may belong to different meshes, so the material's texture indices
+// are not uniform; textures are sampled with explicit gradients, since
+// implicit derivatives are undefined across such pixels.
+
+layout( set = 0, binding = 0 ) uniform UScene 
+	{ 
+		mat4 camera; 
+		mat4 projection; 
+		mat4 projCam; 
+
+		vec3 cameraPosition;
+		vec3 lightPosition;
+		vec3 lightColor;
+		vec3 ambientColor;
+	} uScene; 
+
+layout( set = 1, binding = 0 ) uniform sampler2D uTextures[];
+
+struct Material
+{
+	uint baseColor;
+	uint roughness;
+	uint metalness;
+	uint alphaMask;
+	uint normalMap;
+	uint flags;
+	uint reserved[2];
+};
+
+const uint kMaterialPackedRma = 1;
+
+layout( std430, set = 1, binding = 1 ) readonly buffer UMaterials
+{
+	Material materials[];
+} uMaterials;
+
+struct Mesh
+{
+	vec4 positionOffset;
+	vec4 positionScale;
+	uint materialId;
+	uint firstIndex;
+	int vertexOffset;
+	uint reserved;
+};
+
+layout( std430, set = 1, binding = 2 ) readonly buffer UMeshes
+{
+	Mesh meshes[];
+} uMeshes;
+
+// Visibility buffer, written by the previous subpass, and the geometry
+// arena's buffers. The vertex buffer is read as words, since its layout
+// depends on the model's vertex format.
+layout( input_attachment_index = 0, set = 3, binding = 0 ) uniform usubpassInput uVisibility;
+
+layout( std430, set = 3, binding = 1 ) readonly buffer UIndices
+{
+	uint indices[];
+} uIndices;
+
+layout( std430, set = 3, binding = 2 ) readonly buffer UVertices
+{
+	uint words[];
+} uVertices;
+
+layout( push_constant ) uniform UResolve
+{
+	uint streamOffsets[4]; // in words
+	uint vertexFormat;     // baked::BakedVertexFormatV2
+} uResolve;
+
+// Must match baked_format.hpp
+const uint kVertexSeparate = 0;
+const uint kVertexPackedF32 = 1;
+const uint kVertexPackedQ16 = 2;
+
+#include "brdf.glsl"
+#include "visibility.glsl"
+#include "clustered_lights.glsl"
+
+layout( location = 0 ) out vec4 oColor; 
+
+struct Vertex
+{
+	vec3 position;
+	vec3 normal;
+	vec2 texcoord;
+	vec4 tangent;
+};
+
+vec3 oct_decode( vec2 e )
+{
+	vec3 v = vec3( e, 1.0 - abs(e.x) - abs(e.y) );
+	if( v.z < 0.0 )
+		v.xy = (1.0 - abs(v.yx)) * vec2( v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0 );
+	return normalize( v );
+}
+
+vec3 load_vec3( uint base )
+{
+	return uintBitsToFloat( uvec3( uVertices.words[base], uVertices.words[base+1], uVertices.words[base+2] ) );
+}
+
+// Same conversions as the vertex input state of create_pipeline(); see
+// baked_format.hpp for the packed layouts
+Vertex fetch_vertex( Mesh mesh, uint index )
+{
+	uint v = uint( int(index) + mesh.vertexOffset );
+
+	Vertex ret;
+	if( kVertexSeparate == uResolve.vertexFormat )
+	{
+		ret.position = load_vec3( uResolve.streamOffsets[0] + v * 3 );
+		ret.normal = load_vec3( uResolve.streamOffsets[1] + v * 3 );
+
+		uint t = uResolve.streamOffsets[2] + v * 2;
+		ret.texcoord = uintBitsToFloat( uvec2( uVertices.words[t], uVertices.words[t+1] ) );
+
+		uint g = uResolve.streamOffsets[3] + v * 4;
+		ret.tangent = vec4( load_vec3( g ), uintBitsToFloat( uVertices.words[g+3] ) );
+		return ret;
+	}
+
+	// BakedPackedVertexF32 is 7 words, BakedPackedVertexQ16 5 words
+	vec4 position;
+	uint frame;
+	if( kVertexPackedF32 == uResolve.vertexFormat )
+	{
+		uint base = uResolve.streamOffsets[0] + v * 7;
+		position = vec4( load_vec3( base ), uintBitsToFloat( uVertices.words[base+3] ) );
+		frame = base + 4;
+	}
+	else
+	{
+		uint base = uResolve.streamOffsets[0] + v * 5;
+		position = vec4( unpackUnorm2x16( uVertices.words[base] ), unpackUnorm2x16( uVertices.words[base+1] ) );
+		frame = base + 2;
+	}
+
+	vec2 n = unpackSnorm2x16( uVertices.words[frame] );
+	vec2 t = unpackSnorm2x16( uVertices.words[frame+1] );
+
+	ret.position = mesh.positionOffset.xyz + position.xyz * mesh.positionScale.xyz;
+	ret.normal = oct_decode( n );
+	ret.texcoord = unpackHalf2x16( uVertices.words[frame+2] );
+	ret.tangent = vec4( oct_decode( t ), position.w < 0.5 ? -1.0 : 1.0 );
+	return ret;
+}
+
+void main() 
+{ 
+	// Nothing was drawn here; keep the clear color
+	uint visibility = subpassLoad( uVisibility ).r;
+	if( 0u == visibility )
+		discard;
+
+	uint meshId = (visibility >> kVisibilityTriangleBits) - 1u;
+	uint triangle = visibility & kVisibilityTriangleMask;
+
+	Mesh mesh = uMeshes.meshes[meshId];
+	Material material = uMaterials.materials[mesh.materialId];
+
+	uint first = mesh.firstIndex + triangle * 3u;
+	Vertex v0 = fetch_vertex( mesh, uIndices.indices[first] );
+	Vertex v1 = fetch_vertex( mesh, uIndices.indices[first+1] );
+	Vertex v2 = fetch_vertex( mesh, uIndices.indices[first+2] );
+
+	vec2 pixelSize = 2.0 / uLightClusters.screen.xy;
+	vec2 ndc = gl_FragCoord.xy * pixelSize - 1.0;
+
+	Barycentrics b = visibility_barycentrics(
+		uScene.projCam * vec4( v0.position, 1.0 ),
+		uScene.projCam * vec4( v1.position, 1.0 ),
+		uScene.projCam * vec4( v2.position, 1.0 ),
+		ndc, pixelSize
+	);
+
+	mat3x2 uvs = mat3x2( v0.texcoord, v1.texcoord, v2.texcoord );
+	vec2 texcoord = uvs * b.lambda;
+	vec2 texcoordDx = uvs * b.ddx;
+	vec2 texcoordDy = uvs * b.ddy;
+
+	vec3 position = mat3( v0.position, v1.position, v2.position ) * b.lambda;
+	vec3 vNormal = normalize( mat3( v0.normal, v1.normal, v2.normal ) * b.lambda );
+	vec4 tangent = normalize( mat3x4( v0.tangent, v1.tangent, v2.tangent ) * b.lambda );
+
+	// reading and converting from [0, 1] to [-1, 1]. Only x and y are
+	// used (BC5 normal maps store nothing else); z is reconstructed.
+	vec2 mapNormalXY = 2 * textureGrad( uTextures[nonuniformEXT(material.normalMap)], texcoord, texcoordDx, texcoordDy ).rg - 1.0;
+	vec3 mapNormal = normalize(vec3(mapNormalXY, sqrt(max(0.0, 1.0 - dot(mapNormalXY, mapNormalXY)))));
+	vec3 bitangent = normalize(cross(vNormal, tangent.xyz) * tangent.w);
+
+	vec3 normal = normalize( mat3( tangent.xyz, bitangent, vNormal) * mapNormal); 
+
+	vec3 lightDirection = normalize(uScene.lightPosition - position); 
+	vec3 viewDirection = normalize(uScene.cameraPosition - position);	
+
+	vec3 basecolor = textureGrad( uTextures[nonuniformEXT(material.baseColor)], texcoord, texcoordDx, texcoordDy ).rgb;
+
+	// Packed: roughness and metalness in one fetch
+	highp float roughness, metalness;
+	if( 0 != (material.flags & kMaterialPackedRma) )
+	{
+		vec2 rm = textureGrad( uTextures[nonuniformEXT(material.roughness)], texcoord, texcoordDx, texcoordDy ).rg;
+		roughness = rm.r;
+		metalness = rm.g;
+	}
+	else
+	{
+		roughness = textureGrad( uTextures[nonuniformEXT(material.roughness)], texcoord, texcoordDx, texcoordDy ).r;
+		metalness = textureGrad( uTextures[nonuniformEXT(material.metalness)], texcoord, texcoordDx, texcoordDy ).r;
+	}
+
+	// Ambient Light
+	vec3 AmbientLight = uScene.ambientColor * basecolor;
+
+	// Scene light, and the point lights of the fragment's cluster
+	vec3 Lo = brdf_nol( basecolor, roughness, metalness, normal, viewDirection, lightDirection ) * uScene.lightColor;
+	Lo += clustered_lights( gl_FragCoord.xy, position, basecolor, roughness, metalness, normal, viewDirection );
+
+	oColor = vec4(AmbientLight + Lo, 1.0f);
+} 
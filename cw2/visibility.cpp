@@ -0,0 +1,249 @@
+#include "visibility.hpp"
+
+#include <cassert>
+
+#include "../labutils/error.hpp"
+#include "../labutils/vkutil.hpp"
+#include "../labutils/to_string.hpp"
+
+#include "deferred.hpp"
+
+namespace
+{
+	// Storage buffers read by visibility_resolve.frag: materials and meshes
+	// (bindless set), lights, counts and indices (clustered lights), and the
+	// arena's index and vertex buffers
+	constexpr std::uint32_t kResolveStorageBuffers = 7;
+
+	// Push constants of visibility_resolve.frag
+	struct ResolvePush
+	{
+		std::uint32_t streamOffsets[kMaxVertexStreams];
+		std::uint32_t vertexFormat;
+	};
+
+	// The resolve reads packed vertices as whole words
+	static_assert( sizeof(baked::BakedPackedVertexF32) == 7 * sizeof(std::uint32_t) );
+	static_assert( sizeof(baked::BakedPackedVertexQ16) == 5 * sizeof(std::uint32_t) );
+	static_assert( kVertexStreamAlign % sizeof(std::uint32_t) == 0 );
+}
+
+bool visibility_supported( VkPhysicalDevice aPhysicalDev )
+{
+	VkPhysicalDeviceVulkan12Features features12{};
+	features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &features12;
+	vkGetPhysicalDeviceFeatures2( aPhysicalDev, &features );
+
+	if( !features.features.geometryShader || !features12.shaderSampledImageArrayNonUniformIndexing )
+		return false;
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties( aPhysicalDev, &props );
+
+	return props.limits.maxBoundDescriptorSets >= 4
+		&& props.limits.maxPerStageDescriptorStorageBuffers >= kResolveStorageBuffers
+	;
+}
+
+bool visibility_fits( VkPhysicalDevice aPhysicalDev, BakedModel const& aModel )
+{
+	if( aModel.meshes.size() > kVisibilityMaxMeshes )
+		return false;
+
+	for( auto const& mesh : aModel.meshes )
+	{
+		if( mesh.indices.size() / 3 > kVisibilityMaxTriangles )
+			return false;
+	}
+
+	VkPhysicalDeviceProperties props;
+	vkGetPhysicalDeviceProperties( aPhysicalDev, &props );
+
+	auto const layout = plan_geometry_arena( aModel );
+	return layout.vertexBytes <= props.limits.maxStorageBufferRange
+		&& layout.indexBytes <= props.limits.maxStorageBufferRange
+	;
+}
+
+VisibilityBarycentrics visibility_barycentrics( glm::vec4 const& aC0, glm::vec4 const& aC1, glm::vec4 const& aC2, glm::vec2 const& aNdc, glm::vec2 const& aPixelSize )
+{
+	glm::vec3 const invW = 1.f / glm::vec3( aC0.w, aC1.w, aC2.w );
+
+	glm::vec2 const p0 = glm::vec2( aC0 ) * invW.x;
+	glm::vec2 const p1 = glm::vec2( aC1 ) * invW.y;
+	glm::vec2 const p2 = glm::vec2( aC2 ) * invW.z;
+
+	// Screen space (affine) barycentrics are linear in NDC
+	float const invDet = 1.f / ((p1.x - p0.x) * (p2.y - p0.y) - (p1.y - p0.y) * (p2.x - p0.x));
+	glm::vec3 const dbdx = glm::vec3( p1.y - p2.y, p2.y - p0.y, p0.y - p1.y ) * invDet;
+	glm::vec3 const dbdy = glm::vec3( p2.x - p1.x, p0.x - p2.x, p1.x - p0.x ) * invDet;
+
+	// Interpolate b/w linearly, and divide by the interpolated 1/w
+	glm::vec2 const d = aNdc - p0;
+	glm::vec3 const f = (glm::vec3( 1.f, 0.f, 0.f ) + dbdx * d.x + dbdy * d.y) * invW;
+	glm::vec3 const fx = f + dbdx * (aPixelSize.x * invW);
+	glm::vec3 const fy = f + dbdy * (aPixelSize.y * invW);
+
+	VisibilityBarycentrics ret;
+	ret.lambda = f / (f.x + f.y + f.z);
+	ret.ddx = fx / (fx.x + fx.y + fx.z) - ret.lambda;
+	ret.ddy = fy / (fy.x + fy.y + fy.z) - ret.lambda;
+	return ret;
+}
+
+VisibilityBuffer create_visibility_buffer( lut::VulkanContext const& aContext, lut::Allocator const& aAllocator, VkExtent2D const& aExtent )
+{
+	VisibilityBuffer ret;
+	create_gbuffer_target( aContext, aAllocator, aExtent, kVisibilityFormat, ret.image, ret.view );
+	return ret;
+}
+
+lut::RenderPass create_visibility_render_pass( lut::VulkanContext const& aContext, VkFormat aColorFormat, VkFormat aDepthFormat, bool aKeepDepth, VkImageLayout aColorFinalLayout )
+{
+	// Cleared to 0, which marks uncovered pixels
+	VkFormat const targetFormats[] = { kVisibilityFormat };
+	return create_gbuffer_render_pass( aContext, aColorFormat, aDepthFormat, 1, targetFormats, false, true, aKeepDepth, aColorFinalLayout );
+}
+
+VisibilityResolve create_visibility_resolve( lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aBindlessLayout, VkDescriptorSetLayout aLightClusterLayout )
+{
+	VisibilityResolve ret;
+
+	// Input set
+	VkDescriptorSetLayoutBinding bindings[3]{};
+	bindings[0].binding = 0; // this must match the shaders
+	bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	bindings[0].descriptorCount = 1;
+	bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+	for( std::uint32_t i = 1; i < 3; ++i )
+	{
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+	setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setLayoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+	setLayoutInfo.pBindings = bindings;
+
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorSetLayout( aContext.device, &setLayoutInfo, nullptr, &setLayout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create visibility descriptor set layout\n"
+			"vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.inputLayout = lut::DescriptorSetLayout( aContext.device, setLayout );
+
+	// Pipeline layout
+	VkDescriptorSetLayout const setLayouts[] = { aSceneLayout, aBindlessLayout, aLightClusterLayout, ret.inputLayout.handle };
+
+	VkPushConstantRange pushRange{};
+	pushRange.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	pushRange.offset = 0;
+	pushRange.size = sizeof(ResolvePush);
+
+	VkPipelineLayoutCreateInfo layoutInfo{};
+	layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	layoutInfo.setLayoutCount = sizeof(setLayouts) / sizeof(setLayouts[0]);
+	layoutInfo.pSetLayouts = setLayouts;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushRange;
+
+	VkPipelineLayout pipeLayout = VK_NULL_HANDLE;
+	if( auto const res = vkCreatePipelineLayout( aContext.device, &layoutInfo, nullptr, &pipeLayout ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create visibility resolve pipeline layout\n"
+			"vkCreatePipelineLayout() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.pipeLayout = lut::PipelineLayout( aContext.device, pipeLayout );
+
+	// Descriptors
+	VkDescriptorPoolSize const pools[] = {
+		{ VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2 }
+	};
+
+	VkDescriptorPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	poolInfo.maxSets = 1;
+	poolInfo.poolSizeCount = sizeof(pools) / sizeof(pools[0]);
+	poolInfo.pPoolSizes = pools;
+
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	if( auto const res = vkCreateDescriptorPool( aContext.device, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+	{
+		throw lut::Error( "Unable to create visibility descriptor pool\n"
+			"vkCreateDescriptorPool() returned %s", lut::to_string(res).c_str()
+		);
+	}
+
+	ret.pool = lut::DescriptorPool( aContext.device, pool );
+	ret.inputSet = lut::alloc_desc_set( aContext, ret.pool.handle, ret.inputLayout.handle );
+
+	return ret;
+}
+
+void update_visibility_inputs( lut::VulkanContext const& aContext, VisibilityResolve const& aResolve, VisibilityBuffer const& aBuffer, GeometryArena const& aGeometry )
+{
+	assert( VK_NULL_HANDLE != aResolve.inputSet );
+
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageView = aBuffer.view.handle;
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+
+	VkDescriptorBufferInfo bufferInfos[2]{};
+	bufferInfos[0].buffer = aGeometry.indices.buffer;
+	bufferInfos[0].range = VK_WHOLE_SIZE;
+	bufferInfos[1].buffer = aGeometry.vertices.buffer;
+	bufferInfos[1].range = VK_WHOLE_SIZE;
+
+	VkWriteDescriptorSet writes[3]{};
+	writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writes[0].dstSet = aResolve.inputSet;
+	writes[0].dstBinding = 0;
+	writes[0].descriptorType = VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT;
+	writes[0].descriptorCount = 1;
+	writes[0].pImageInfo = &imageInfo;
+
+	for( std::uint32_t i = 0; i < 2; ++i )
+	{
+		writes[1+i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[1+i].dstSet = aResolve.inputSet;
+		writes[1+i].dstBinding = 1 + i;
+		writes[1+i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[1+i].descriptorCount = 1;
+		writes[1+i].pBufferInfo = &bufferInfos[i];
+	}
+
+	vkUpdateDescriptorSets( aContext.device, 3, writes, 0, nullptr );
+}
+
+void record_visibility_resolve( VkCommandBuffer aCmdBuff, VisibilityResolve const& aResolve, GeometryArena const& aGeometry, baked::BakedVertexFormatV2 aVertexFormat, VkDescriptorSet aSceneSet, VkDescriptorSet aBindlessSet, VkDescriptorSet aLightClusterSet )
+{
+	vkCmdNextSubpass( aCmdBuff, VK_SUBPASS_CONTENTS_INLINE );
+
+	vkCmdBindPipeline( aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aResolve.pipe.handle );
+
+	VkDescriptorSet const sets[] = { aSceneSet, aBindlessSet, aLightClusterSet, aResolve.inputSet };
+	vkCmdBindDescriptorSets( aCmdBuff, VK_PIPELINE_BIND_POINT_GRAPHICS, aResolve.pipeLayout.handle, 0, sizeof(sets) / sizeof(sets[0]), sets, 0, nullptr );
+
+	// Vertex buffer layout, in words
+	ResolvePush push{};
+	for( std::uint32_t i = 0; i < aGeometry.streamCount; ++i )
+		push.streamOffsets[i] = std::uint32_t(aGeometry.streamOffsets[i] / sizeof(std::uint32_t));
+	push.vertexFormat = aVertexFormat;
+	vkCmdPushConstants( aCmdBuff, aResolve.pipeLayout.handle, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(push), &push );
+
+	vkCmdDraw( aCmdBuff, 3, 1, 0, 0 );
+}
@@ -0,0 +1,159 @@
+#ifndef VISIBILITY_HPP_236C137F_6169_48A6_901F_6625E5AD5A37
+#define VISIBILITY_HPP_236C137F_6169_48A6_901F_6625E5AD5A37
+
+#include <cstdint>
+
+#include <volk/volk.h>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+
+#include "../labutils/vkimage.hpp"
+#include "../labutils/vkobject.hpp"
+#include "../labutils/allocator.hpp"
+#include "../labutils/vulkan_context.hpp"
+namespace lut = labutils;
+
+#include "baked_model.hpp"
+#include "geometry_arena.hpp"
+
+// Visibility buffer. Like deferred shading (see deferred.hpp), this replaces
+// the forward render pass with two subpasses. The first draws the meshes,
+// but writes only which triangle of which mesh covers each pixel, packed
+// into a single 32-bit value. The second is a fullscreen resolve: for each
+// covered pixel, it fetches the triangle's three vertices from the geometry
+// arena (read as storage buffers), computes perspective-correct barycentrics
+// analytically, interpolates the vertex attributes and shades the pixel
+// once. Compared to deferred shading, the render target is 4 bytes per
+// pixel regardless of the material model, and materials are only read for
+// visible pixels.
+//
+// Requires the bindless path: the resolve finds each mesh's material and
+// location in the arena through the bindless mesh records. Triangle indices
+// come from gl_PrimitiveID, which restarts with every draw; hence every draw
+// must cover a whole mesh (no cluster culling; see culling.hpp).
+//
+// visibility_barycentrics() is the CPU reference of the function of the same
+// name in visibility.glsl.
+
+// Low bits of a visibility value: triangle index within the mesh. High
+// bits: mesh ID + 1, so that 0 marks pixels where nothing was drawn.
+constexpr std::uint32_t kVisibilityTriangleBits = 20;
+constexpr std::uint32_t kVisibilityMaxTriangles = 1u << kVisibilityTriangleBits;
+constexpr std::uint32_t kVisibilityMaxMeshes = (1u << (32 - kVisibilityTriangleBits)) - 1;
+
+constexpr VkFormat kVisibilityFormat = VK_FORMAT_R32_UINT;
+
+// Returns 0 (nothing drawn) if aMeshId or aTriangle does not fit, rather
+// than a value that refers to another triangle. visibility_fits() checks
+// that this does not happen.
+constexpr std::uint32_t visibility_pack( std::uint32_t aMeshId, std::uint32_t aTriangle ) noexcept
+{
+	if( aMeshId >= kVisibilityMaxMeshes || aTriangle >= kVisibilityMaxTriangles )
+		return 0;
+
+	return ((aMeshId + 1) << kVisibilityTriangleBits) | aTriangle;
+}
+
+// Returns false for pixels where nothing was drawn
+constexpr bool visibility_unpack( std::uint32_t aValue, std::uint32_t& aMeshId, std::uint32_t& aTriangle ) noexcept
+{
+	if( 0 == aValue )
+		return false;
+
+	aMeshId = (aValue >> kVisibilityTriangleBits) - 1;
+	aTriangle = aValue & (kVisibilityMaxTriangles - 1);
+	return true;
+}
+
+// Whether the device can run the resolve: gl_PrimitiveID in fragment shaders
+// (geometryShader), non-uniform texture indexing, and enough storage buffers
+// in the fragment stage
+bool visibility_supported( VkPhysicalDevice );
+
+// Whether aModel's meshes and triangles can be packed into visibility
+// values, and its arena can be read as storage buffers on the device
+bool visibility_fits( VkPhysicalDevice, BakedModel const& );
+
+// Barycentrics of a pixel, and their change per pixel in x and y
+struct VisibilityBarycentrics
+{
+	glm::vec3 lambda;
+	glm::vec3 ddx;
+	glm::vec3 ddy;
+};
+
+// Perspective-correct barycentrics of the pixel at aNdc (in [-1, 1]^2)
+// within the triangle with clip space vertices aC0, aC1 and aC2. aPixelSize
+// is the size of one pixel in NDC, i.e., 2 / framebuffer size. The
+// derivatives are forward differences to the next pixel.
+VisibilityBarycentrics visibility_barycentrics(
+	glm::vec4 const& aC0,
+	glm::vec4 const& aC1,
+	glm::vec4 const& aC2,
+	glm::vec2 const& aNdc,
+	glm::vec2 const& aPixelSize
+);
+
+// Interpolates a vertex attribute with aWeights, i.e., lambda (the value) or
+// ddx/ddy (its change per pixel)
+template< typename tAttribute >
+tAttribute visibility_interpolate( glm::vec3 const& aWeights, tAttribute const& aA0, tAttribute const& aA1, tAttribute const& aA2 )
+{
+	return aA0 * aWeights.x + aA1 * aWeights.y + aA2 * aWeights.z;
+}
+
+// The visibility buffer depends on the framebuffer size
+struct VisibilityBuffer
+{
+	lut::Image image;
+	lut::ImageView view;
+};
+
+VisibilityBuffer create_visibility_buffer( lut::VulkanContext const&, lut::Allocator const&, VkExtent2D const& );
+
+// See create_gbuffer_render_pass(). Attachments: swapchain image, depth,
+// visibility buffer. The depth buffer is not an input of the resolve.
+lut::RenderPass create_visibility_render_pass( lut::VulkanContext const&, VkFormat aColorFormat, VkFormat aDepthFormat, bool aKeepDepth, VkImageLayout aColorFinalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR );
+
+struct VisibilityResolve
+{
+	// Set 3 of the resolve pipeline: visibility buffer, index buffer, vertex
+	// buffer. Sets 0 to 2 are those of the bindless mesh pipelines.
+	lut::DescriptorSetLayout inputLayout;
+	lut::PipelineLayout pipeLayout;
+
+	// Depends on the framebuffer size (viewport); see
+	// create_fullscreen_pipeline()
+	lut::Pipeline pipe;
+
+	// Depends on the visibility buffer; see update_visibility_inputs()
+	lut::DescriptorPool pool;
+	VkDescriptorSet inputSet = VK_NULL_HANDLE;
+};
+
+VisibilityResolve create_visibility_resolve(
+	lut::VulkanContext const&,
+	VkDescriptorSetLayout aSceneLayout,
+	VkDescriptorSetLayout aBindlessLayout,
+	VkDescriptorSetLayout aLightClusterLayout
+);
+
+// Points the input set at a (new) visibility buffer and the arena's buffers.
+// The set must not be in use.
+void update_visibility_inputs( lut::VulkanContext const&, VisibilityResolve const&, VisibilityBuffer const&, GeometryArena const& );
+
+// Records the resolve subpass; call after drawing the meshes in the first
+// subpass. aGeometry and aVertexFormat must match the meshes'.
+void record_visibility_resolve(
+	VkCommandBuffer,
+	VisibilityResolve const&,
+	GeometryArena const& aGeometry,
+	baked::BakedVertexFormatV2 aVertexFormat,
+	VkDescriptorSet aSceneSet,
+	VkDescriptorSet aBindlessSet,
+	VkDescriptorSet aLightClusterSet
+);
+
+#endif // VISIBILITY_HPP_236C137F_6169_48A6_901F_6625E5AD5A37
@@ -0,0 +1,391 @@
+#include "gpu_profiler.hpp"
+
+#include <cassert>
+
+#include "error.hpp"
+#include "vkutil.hpp"
+#include "to_string.hpp"
+
+namespace
+{
+	// Vertex and fragment shader invocations; results are returned in bit
+	// order, i.e., vertices first
+	constexpr VkQueryPipelineStatisticFlags kStatistics_
+		= VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+	;
+
+	// Two 64-bit results of query aQuery; false if not yet available
+	bool get_pair_( VkDevice aDevice, VkQueryPool aPool, std::uint32_t aQuery, std::uint64_t aValues[2] )
+	{
+		auto const res = vkGetQueryPoolResults( aDevice, aPool, aQuery, 1, 2*sizeof(std::uint64_t), aValues, 2*sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT );
+		if( VK_NOT_READY == res )
+			return false;
+
+		if( VK_SUCCESS != res )
+		{
+			throw labutils::Error( "Unable to get query results\n"
+				"vkGetQueryPoolResults() returned %s", labutils::to_string(res).c_str() );
+		}
+
+		return true;
+	}
+
+	// Timestamps of queries aFirst and aFirst+1; false if not yet available
+	bool get_timestamps_( VkDevice aDevice, VkQueryPool aPool, std::uint32_t aFirst, std::uint64_t aTicks[2] )
+	{
+		auto const res = vkGetQueryPoolResults( aDevice, aPool, aFirst, 2, 2*sizeof(std::uint64_t), aTicks, sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT );
+		if( VK_NOT_READY == res )
+			return false;
+
+		if( VK_SUCCESS != res )
+		{
+			throw labutils::Error( "Unable to get timestamps\n"
+				"vkGetQueryPoolResults() returned %s", labutils::to_string(res).c_str() );
+		}
+
+		return true;
+	}
+}
+
+namespace labutils
+{
+	GpuProfiler::GpuProfiler() noexcept = default;
+	GpuProfiler::~GpuProfiler() = default;
+
+	GpuProfiler::GpuProfiler( GpuProfiler&& ) noexcept = default;
+	GpuProfiler& GpuProfiler::operator=( GpuProfiler&& ) noexcept = default;
+
+
+	void GpuProfiler::begin_frame( VkCommandBuffer aCmd, std::uint32_t aSlot )
+	{
+		assert( aSlot < mSlotCount );
+		assert( kNoRegion_ == mActiveRegion );
+
+		auto const regions = region_count();
+
+		mCurrentSlot = aSlot;
+		mSlotFrames[aSlot] = mNextFrame++;
+		mSlotStates[aSlot] = 0;
+		for( std::uint32_t i = 0; i < regions; ++i )
+			mRegionStates[aSlot*regions + i] = 0;
+
+		// Queries must be reset before they are written again. Timestamps are
+		// taken at the bottom of the pipe, i.e., once all previously
+		// submitted work has completed.
+		if( has_timestamps() )
+		{
+			auto const first = aSlot * 2 * (regions+1);
+			vkCmdResetQueryPool( aCmd, mTimestamps.handle, first, 2 * (regions+1) );
+			vkCmdWriteTimestamp( aCmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mTimestamps.handle, first );
+		}
+
+		if( has_statistics() )
+			vkCmdResetQueryPool( aCmd, mStatistics.handle, aSlot * regions, regions );
+	}
+
+	void GpuProfiler::end_frame( VkCommandBuffer aCmd )
+	{
+		assert( kNoRegion_ == mActiveRegion );
+
+		if( has_timestamps() )
+		{
+			auto const first = mCurrentSlot * 2 * (region_count()+1);
+			vkCmdWriteTimestamp( aCmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mTimestamps.handle, first+1 );
+		}
+
+		mSlotStates[mCurrentSlot] = kWritten_;
+	}
+
+	void GpuProfiler::begin_region( VkCommandBuffer aCmd, std::uint32_t aRegion, bool aStatistics )
+	{
+		assert( aRegion < region_count() );
+		assert( kNoRegion_ == mActiveRegion );
+
+		auto& state = mRegionStates[mCurrentSlot*region_count() + aRegion];
+		assert( 0 == state ); // once per frame
+
+		mActiveRegion = aRegion;
+
+		if( has_timestamps() )
+		{
+			auto const first = mCurrentSlot * 2 * (region_count()+1) + 2 + 2*aRegion;
+			vkCmdWriteTimestamp( aCmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mTimestamps.handle, first );
+			state |= kTimed_;
+		}
+
+		if( aStatistics && has_statistics() )
+		{
+			vkCmdBeginQuery( aCmd, mStatistics.handle, mCurrentSlot*region_count() + aRegion, 0 );
+			state |= kCounted_;
+		}
+	}
+
+	void GpuProfiler::end_region( VkCommandBuffer aCmd, std::uint32_t aRegion )
+	{
+		assert( aRegion == mActiveRegion );
+		mActiveRegion = kNoRegion_;
+
+		if( has_timestamps() )
+		{
+			auto const first = mCurrentSlot * 2 * (region_count()+1) + 2 + 2*aRegion;
+			vkCmdWriteTimestamp( aCmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mTimestamps.handle, first+1 );
+		}
+
+		if( kCounted_ & mRegionStates[mCurrentSlot*region_count() + aRegion] )
+			vkCmdEndQuery( aCmd, mStatistics.handle, mCurrentSlot*region_count() + aRegion );
+	}
+
+	bool GpuProfiler::collect( std::uint32_t aSlot, GpuProfileFrame& aFrame )
+	{
+		assert( aSlot < mSlotCount );
+
+		if( !(kWritten_ & mSlotStates[aSlot]) )
+			return false;
+
+		auto const regions = region_count();
+
+		aFrame.frame = mSlotFrames[aSlot];
+		aFrame.totalMs = -1.0;
+		aFrame.regionMs.assign( regions, -1.0 );
+		aFrame.vertexInvocations.assign( regions, -1 );
+		aFrame.fragmentInvocations.assign( regions, -1 );
+
+		// Everything in a command buffer completes together, so the frame's
+		// last timestamp is a good indicator for the rest
+		if( has_timestamps() )
+		{
+			auto const first = aSlot * 2 * (regions+1);
+
+			std::uint64_t ticks[2];
+			if( !get_timestamps_( mDevice, mTimestamps.handle, first, ticks ) )
+				return false;
+
+			// Differences modulo the valid bits, in case of wrap-around
+			aFrame.totalMs = double((ticks[1] - ticks[0]) & mTimestampMask) * mTimestampMs;
+
+			for( std::uint32_t i = 0; i < regions; ++i )
+			{
+				if( !(kTimed_ & mRegionStates[aSlot*regions + i]) )
+					continue;
+
+				if( !get_timestamps_( mDevice, mTimestamps.handle, first + 2 + 2*i, ticks ) )
+					return false;
+
+				aFrame.regionMs[i] = double((ticks[1] - ticks[0]) & mTimestampMask) * mTimestampMs;
+			}
+		}
+
+		if( has_statistics() )
+		{
+			for( std::uint32_t i = 0; i < regions; ++i )
+			{
+				if( !(kCounted_ & mRegionStates[aSlot*regions + i]) )
+					continue;
+
+				std::uint64_t counts[2];
+				if( !get_pair_( mDevice, mStatistics.handle, aSlot*regions + i, counts ) )
+					return false;
+
+				aFrame.vertexInvocations[i] = std::int64_t(counts[0]);
+				aFrame.fragmentInvocations[i] = std::int64_t(counts[1]);
+			}
+		}
+
+		// Without timestamps, mark the recorded regions
+		if( !has_timestamps() )
+		{
+			for( std::uint32_t i = 0; i < regions; ++i )
+			{
+				if( 0 != mRegionStates[aSlot*regions + i] )
+					aFrame.regionMs[i] = 0.0;
+			}
+		}
+
+		mSlotStates[aSlot] = 0;
+
+		accumulate_( aFrame );
+		if( mCsv )
+			write_csv_row_( aFrame );
+
+		return true;
+	}
+
+	void GpuProfiler::print_summary()
+	{
+		if( 0 == mSummedFrames )
+			return;
+
+		if( has_timestamps() )
+			std::printf( "GPU per frame (%u frames): %.3f ms\n", mSummedFrames, mSummedTotalMs / mSummedFrames );
+		else
+			std::printf( "GPU per frame (%u frames):\n", mSummedFrames );
+
+		for( std::uint32_t i = 0; i < region_count(); ++i )
+		{
+			auto const count = mSummedRegionFrames[i];
+			if( 0 == count )
+				continue;
+
+			std::printf( "  %-12s", mRegionNames[i].c_str() );
+			if( has_timestamps() )
+				std::printf( " %8.3f ms", mSummedMs[i] / count );
+			if( auto const counted = mSummedCountedFrames[i]; 0 != counted )
+			{
+				std::printf( "  %12.0f vertices  %12.0f fragments",
+					double(mSummedVertices[i]) / counted,
+					double(mSummedFragments[i]) / counted
+				);
+			}
+			std::printf( "\n" );
+		}
+
+		mSummedFrames = 0;
+		mSummedTotalMs = 0.0;
+		mSummedMs.assign( region_count(), 0.0 );
+		mSummedRegionFrames.assign( region_count(), 0 );
+		mSummedCountedFrames.assign( region_count(), 0 );
+		mSummedVertices.assign( region_count(), 0 );
+		mSummedFragments.assign( region_count(), 0 );
+	}
+
+	void GpuProfiler::open_csv( char const* aPath )
+	{
+		mCsv.reset( std::fopen( aPath, "w" ) );
+		if( !mCsv )
+			throw Error( "%s: unable to open for writing", aPath );
+
+		auto* const out = mCsv.get();
+
+		std::fprintf( out, "frame" );
+		if( has_timestamps() )
+		{
+			std::fprintf( out, ",total_ms" );
+			for( auto const& name : mRegionNames )
+				std::fprintf( out, ",%s_ms", name.c_str() );
+		}
+		if( has_statistics() )
+		{
+			for( auto const& name : mRegionNames )
+				std::fprintf( out, ",%s_vertices,%s_fragments", name.c_str(), name.c_str() );
+		}
+		std::fprintf( out, "\n" );
+
+		if( std::ferror( out ) )
+			throw Error( "%s: unable to write GPU profile", aPath );
+	}
+
+	void GpuProfiler::accumulate_( GpuProfileFrame const& aFrame )
+	{
+		++mSummedFrames;
+		if( aFrame.totalMs > 0.0 )
+			mSummedTotalMs += aFrame.totalMs;
+
+		for( std::uint32_t i = 0; i < region_count(); ++i )
+		{
+			if( aFrame.regionMs[i] < 0.0 )
+				continue;
+
+			++mSummedRegionFrames[i];
+			mSummedMs[i] += aFrame.regionMs[i];
+
+			if( aFrame.vertexInvocations[i] < 0 )
+				continue;
+
+			++mSummedCountedFrames[i];
+			mSummedVertices[i] += std::uint64_t(aFrame.vertexInvocations[i]);
+			mSummedFragments[i] += std::uint64_t(aFrame.fragmentInvocations[i]);
+		}
+	}
+
+	void GpuProfiler::write_csv_row_( GpuProfileFrame const& aFrame )
+	{
+		auto* const out = mCsv.get();
+
+		// Unknown values are left empty
+		std::fprintf( out, "%llu", (unsigned long long)aFrame.frame );
+		if( has_timestamps() )
+		{
+			std::fprintf( out, ",%.4f", aFrame.totalMs );
+			for( auto const ms : aFrame.regionMs )
+			{
+				if( ms >= 0.0 )
+					std::fprintf( out, ",%.4f", ms );
+				else
+					std::fprintf( out, "," );
+			}
+		}
+		if( has_statistics() )
+		{
+			for( std::uint32_t i = 0; i < region_count(); ++i )
+			{
+				if( aFrame.vertexInvocations[i] >= 0 )
+				{
+					std::fprintf( out, ",%lld,%lld",
+						(long long)aFrame.vertexInvocations[i],
+						(long long)aFrame.fragmentInvocations[i]
+					);
+				}
+				else
+				{
+					std::fprintf( out, ",," );
+				}
+			}
+		}
+		std::fprintf( out, "\n" );
+	}
+
+
+	GpuProfiler create_gpu_profiler( VulkanContext const& aContext, std::vector<char const*> const& aRegionNames, std::uint32_t aSlotCount, bool aStatistics )
+	{
+		assert( aSlotCount > 0 );
+
+		GpuProfiler ret;
+		ret.mDevice = aContext.device;
+		ret.mSlotCount = aSlotCount;
+
+		for( auto const* name : aRegionNames )
+			ret.mRegionNames.emplace_back( name );
+
+		auto const regions = ret.region_count();
+
+		ret.mSlotFrames.assign( aSlotCount, 0 );
+		ret.mSlotStates.assign( aSlotCount, 0 );
+		ret.mRegionStates.assign( std::size_t(aSlotCount) * regions, 0 );
+
+		ret.mSummedMs.assign( regions, 0.0 );
+		ret.mSummedRegionFrames.assign( regions, 0 );
+		ret.mSummedCountedFrames.assign( regions, 0 );
+		ret.mSummedVertices.assign( regions, 0 );
+		ret.mSummedFragments.assign( regions, 0 );
+
+		// Timestamps, if the graphics queue supports them
+		std::uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties( aContext.physicalDevice, &familyCount, nullptr );
+
+		std::vector<VkQueueFamilyProperties> families( familyCount );
+		vkGetPhysicalDeviceQueueFamilyProperties( aContext.physicalDevice, &familyCount, families.data() );
+
+		assert( aContext.graphicsFamilyIndex < familyCount );
+		if( auto const validBits = families[aContext.graphicsFamilyIndex].timestampValidBits; 0 != validBits )
+		{
+			VkPhysicalDeviceProperties props;
+			vkGetPhysicalDeviceProperties( aContext.physicalDevice, &props );
+
+			ret.mTimestampMs = double(props.limits.timestampPeriod) * 1e-6;
+			ret.mTimestampMask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+			ret.mTimestamps = create_query_pool( aContext, VK_QUERY_TYPE_TIMESTAMP, aSlotCount * 2 * (regions+1) );
+		}
+
+		// Pipeline statistics
+		VkPhysicalDeviceFeatures features;
+		vkGetPhysicalDeviceFeatures( aContext.physicalDevice, &features );
+
+		if( aStatistics && features.pipelineStatisticsQuery && regions > 0 )
+			ret.mStatistics = create_query_pool( aContext, VK_QUERY_TYPE_PIPELINE_STATISTICS, aSlotCount * regions, kStatistics_ );
+
+		return ret;
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstdio>
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Results of one frame; see GpuProfiler::collect()
+	struct GpuProfileFrame
+	{
+		std::uint64_t frame = 0; // numbered by begin_frame(), from 0
+
+		// Whole command buffer, from begin_frame() to end_frame()
+		double totalMs = -1.0;
+
+		// Per region; negative for regions that the frame did not record,
+		// and invocations also for regions without statistics
+		std::vector<double> regionMs;
+		std::vector<std::int64_t> vertexInvocations;
+		std::vector<std::int64_t> fragmentInvocations;
+	};
+
+	// GPU profiler for named regions of command buffers. Each region is
+	// bracketed by timestamps and, if the device supports pipeline statistics
+	// queries, counts vertex and fragment shader invocations.
+	//
+	// Queries live in slots, one per frame in flight (e.g., one per command
+	// buffer). A slot's results are read back when the slot comes around
+	// again, i.e., a few frames later, once the frame's fence has signalled:
+	// collect() never waits for the GPU.
+	//
+	// Regions must not nest (statistics queries of one type cannot overlap),
+	// and each is recorded at most once per frame; a frame may skip some.
+	// Statistics are only counted in regions that begin and end in the same
+	// subpass, or outside of render passes; others pass aStatistics = false.
+	//
+	// Collected frames are summed for print_summary(), and written to the CSV
+	// file given to open_csv(), if any.
+	//
+	// Like the other wrappers, GpuProfiler is move-only. Without timestamp
+	// support on the queue and without pipeline statistics, all recording
+	// functions do nothing.
+	class GpuProfiler
+	{
+		public:
+			GpuProfiler() noexcept, ~GpuProfiler();
+
+			GpuProfiler( GpuProfiler const& ) = delete;
+			GpuProfiler& operator= (GpuProfiler const&) = delete;
+
+			GpuProfiler( GpuProfiler&& ) noexcept;
+			GpuProfiler& operator = (GpuProfiler&&) noexcept;
+
+		public:
+			bool has_timestamps() const noexcept { return VK_NULL_HANDLE != mTimestamps.handle; }
+			bool has_statistics() const noexcept { return VK_NULL_HANDLE != mStatistics.handle; }
+
+			std::uint32_t region_count() const noexcept { return std::uint32_t(mRegionNames.size()); }
+
+			// Call first, outside of render passes, in a command buffer that
+			// uses slot aSlot. Discards the slot's uncollected results.
+			void begin_frame( VkCommandBuffer, std::uint32_t aSlot );
+
+			// Call last, outside of render passes
+			void end_frame( VkCommandBuffer );
+
+			void begin_region( VkCommandBuffer, std::uint32_t aRegion, bool aStatistics = true );
+			void end_region( VkCommandBuffer, std::uint32_t aRegion );
+
+			// Reads back the results of slot aSlot, without waiting. Returns
+			// false if there are none, or if they are not yet available.
+			bool collect( std::uint32_t aSlot, GpuProfileFrame& );
+
+			// Averages of the frames collected since the last call, to stdout
+			void print_summary();
+
+			// Writes the header now, and one row per collected frame
+			void open_csv( char const* aPath );
+
+		private:
+			friend GpuProfiler create_gpu_profiler( VulkanContext const&, std::vector<char const*> const&, std::uint32_t, bool );
+
+			enum : std::uint8_t { kWritten_ = 1, kTimed_ = 2, kCounted_ = 4 };
+			static constexpr std::uint32_t kNoRegion_ = ~std::uint32_t(0);
+
+			void accumulate_( GpuProfileFrame const& );
+			void write_csv_row_( GpuProfileFrame const& );
+
+			VkDevice mDevice = VK_NULL_HANDLE;
+
+			QueryPool mTimestamps; // per slot: frame, then each region (begin, end)
+			QueryPool mStatistics; // per slot: each region
+			double mTimestampMs = 0.0; // milliseconds per tick
+			std::uint64_t mTimestampMask = 0; // timestampValidBits
+
+			std::vector<std::string> mRegionNames;
+			std::uint32_t mSlotCount = 0;
+
+			// Per slot: frame number and whether it holds results; per slot
+			// and region: kTimed_/kCounted_
+			std::vector<std::uint64_t> mSlotFrames;
+			std::vector<std::uint8_t> mSlotStates;
+			std::vector<std::uint8_t> mRegionStates;
+
+			std::uint64_t mNextFrame = 0;
+			std::uint32_t mCurrentSlot = 0;
+			std::uint32_t mActiveRegion = kNoRegion_;
+
+			// Sums for print_summary()
+			std::uint32_t mSummedFrames = 0;
+			double mSummedTotalMs = 0.0;
+			std::vector<double> mSummedMs;
+			std::vector<std::uint32_t> mSummedRegionFrames, mSummedCountedFrames;
+			std::vector<std::uint64_t> mSummedVertices, mSummedFragments;
+
+			std::unique_ptr<std::FILE, int (*)(std::FILE*)> mCsv{ nullptr, &std::fclose };
+	};
+
+	// Profiler with the given region names (region IDs are their indices)
+	// and aSlotCount slots, for command buffers of the context's graphics
+	// queue. Pipeline statistics are collected if aStatistics is set and the
+	// device supports them; the device must have been created with the
+	// pipelineStatisticsQuery feature in that case, which make_vulkan_window()
+	// enables where available (make_vulkan_context() does not).
+	GpuProfiler create_gpu_profiler(
+		VulkanContext const&,
+		std::vector<char const*> const& aRegionNames,
+		std::uint32_t aSlotCount,
+		bool aStatistics
+	);
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
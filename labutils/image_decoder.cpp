@@ -0,0 +1,176 @@
+#include "image_decoder.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <algorithm>
+#include <exception>
+#include <condition_variable>
+
+#include <cassert>
+
+#include <stb_image.h>
+
+#include "error.hpp"
+#include "trace.hpp"
+
+namespace labutils
+{
+	std::uint32_t image_channels( VkFormat aFormat )
+	{
+		switch( aFormat )
+		{
+			case VK_FORMAT_R8G8B8A8_SRGB:
+			case VK_FORMAT_R8G8B8A8_UNORM:
+				return 4;
+			case VK_FORMAT_R8_UNORM:
+				return 1;
+			default:
+				throw Error( "image_channels(): unsupported format %d", int(aFormat) );
+		}
+	}
+
+	ImageData load_image_data( char const* aPath, std::uint32_t aChannels )
+	{
+		// Flip images vertically. Vulkan expects the first scanline to be the
+		// bottom-most scanline. PNG et al. instead define the first scanline
+		// to be the top-most one. The per-thread setting keeps concurrent
+		// decodes independent.
+		stbi_set_flip_vertically_on_load_thread( 1 );
+
+		int width, height, channels;
+		stbi_uc* data = stbi_load( aPath, &width, &height, &channels, int(aChannels) );
+		if( !data )
+			throw Error( "%s: unable to load image (%s)", aPath, stbi_failure_reason() );
+
+		ImageData ret;
+		ret.width = std::uint32_t(width);
+		ret.height = std::uint32_t(height);
+		ret.channels = aChannels;
+		ret.pixels = decltype(ret.pixels)( data, &stbi_image_free );
+		return ret;
+	}
+
+	ImageData copy_image_data( std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aChannels, std::uint8_t const* aPixels )
+	{
+		ImageData ret;
+		ret.width = aWidth;
+		ret.height = aHeight;
+		ret.channels = aChannels;
+
+		auto const bytes = ret.size_bytes();
+		ret.pixels = decltype(ret.pixels)( new std::uint8_t[bytes], [] (void* aPtr) { delete [] static_cast<std::uint8_t*>(aPtr); } );
+		std::copy_n( aPixels, bytes, ret.pixels.get() );
+		return ret;
+	}
+
+
+	struct ImageDecoder::State_
+	{
+		std::vector<ImageRequest> requests;
+
+		std::vector<ImageData> results;
+		std::vector<std::exception_ptr> errors;
+		std::vector<char> done;
+
+		std::mutex mutex;
+		std::condition_variable cv;
+
+		std::atomic<std::size_t> next{ 0 };
+		std::atomic<bool> cancel{ false };
+
+		std::vector<std::thread> threads;
+
+		void work()
+		{
+			while( !cancel.load( std::memory_order_relaxed ) )
+			{
+				auto const i = next.fetch_add( 1, std::memory_order_relaxed );
+				if( i >= requests.size() )
+					break;
+
+				ImageData image;
+				std::exception_ptr error;
+				try
+				{
+					LUT_TRACE_SCOPE( "decode_image" );
+
+					auto const& req = requests[i];
+					image = load_image_data( req.path.c_str(), image_channels( req.format ) );
+				}
+				catch( ... )
+				{
+					error = std::current_exception();
+				}
+
+				{
+					std::lock_guard<std::mutex> lock( mutex );
+					results[i] = std::move(image);
+					errors[i] = std::move(error);
+					done[i] = 1;
+				}
+				cv.notify_all();
+			}
+		}
+	};
+
+	ImageDecoder::ImageDecoder() noexcept = default;
+
+	ImageDecoder::~ImageDecoder()
+	{
+		if( !mState )
+			return;
+
+		mState->cancel = true;
+		for( auto& thread : mState->threads )
+			thread.join();
+	}
+
+	ImageDecoder::ImageDecoder( ImageDecoder&& ) noexcept = default;
+	ImageDecoder& ImageDecoder::operator=( ImageDecoder&& aOther ) noexcept
+	{
+		std::swap( mState, aOther.mState );
+		return *this;
+	}
+
+	ImageData ImageDecoder::wait( std::size_t aIndex )
+	{
+		assert( mState && aIndex < mState->requests.size() );
+
+		std::unique_lock<std::mutex> lock( mState->mutex );
+		mState->cv.wait( lock, [&] { return 0 != mState->done[aIndex]; } );
+
+		if( auto error = std::exchange( mState->errors[aIndex], nullptr ) )
+			std::rethrow_exception( error );
+
+		return std::move(mState->results[aIndex]);
+	}
+
+	std::size_t ImageDecoder::size() const noexcept
+	{
+		return mState ? mState->requests.size() : 0;
+	}
+
+
+	ImageDecoder decode_images( std::vector<ImageRequest> aRequests, unsigned aThreads )
+	{
+		if( 0 == aThreads )
+			aThreads = std::max( 1u, std::thread::hardware_concurrency() );
+
+		ImageDecoder ret;
+		ret.mState = std::make_unique<ImageDecoder::State_>();
+
+		auto& state = *ret.mState;
+		state.requests = std::move(aRequests);
+		state.results.resize( state.requests.size() );
+		state.errors.resize( state.requests.size() );
+		state.done.resize( state.requests.size(), 0 );
+
+		auto const threadCount = std::min<std::size_t>( aThreads, state.requests.size() );
+		for( std::size_t i = 0; i < threadCount; ++i )
+			state.threads.emplace_back( [&state] { state.work(); } );
+
+		return ret;
+	}
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace labutils
+{
+	// Decoded 8-bit image, with rows stored bottom-up (as Vulkan expects;
+	// see load_image_texture2d()).
+	struct ImageData
+	{
+		std::uint32_t width = 0;
+		std::uint32_t height = 0;
+		std::uint32_t channels = 0;
+
+		std::unique_ptr<std::uint8_t, void (*)(void*)> pixels{ nullptr, [] (void*) {} };
+
+		std::size_t size_bytes() const noexcept
+		{
+			return std::size_t(width) * height * channels;
+		}
+	};
+
+	// Number of 8-bit channels to decode for images uploaded as aFormat.
+	// Throws labutils::Error for unsupported formats.
+	std::uint32_t image_channels( VkFormat aFormat );
+
+	// Decodes the image at aPath into aChannels channels. Thread-safe. Throws
+	// labutils::Error on failure.
+	ImageData load_image_data( char const* aPath, std::uint32_t aChannels );
+
+	// Copies aWidth x aHeight pixels of aChannels channels (rows bottom-up)
+	// into a new ImageData, e.g., for placeholder textures.
+	ImageData copy_image_data( std::uint32_t aWidth, std::uint32_t aHeight, std::uint32_t aChannels, std::uint8_t const* aPixels );
+
+	struct ImageRequest
+	{
+		std::string path;
+		VkFormat format;
+	};
+
+	// Decodes images on a pool of worker threads. Images are started in
+	// request order; wait() returns a result as soon as it is ready, so the
+	// caller can process (e.g., upload) earlier images while later ones are
+	// still being decoded. Like the other wrappers, ImageDecoder is
+	// move-only. Destroying it stops the workers after their current image.
+	class ImageDecoder
+	{
+		public:
+			ImageDecoder() noexcept, ~ImageDecoder();
+
+			ImageDecoder( ImageDecoder const& ) = delete;
+			ImageDecoder& operator= (ImageDecoder const&) = delete;
+
+			ImageDecoder( ImageDecoder&& ) noexcept;
+			ImageDecoder& operator = (ImageDecoder&&) noexcept;
+
+		public:
+			// Blocks until image aIndex has been decoded, and returns it. Each
+			// image can be retrieved once. Rethrows decoding errors.
+			ImageData wait( std::size_t aIndex );
+
+			std::size_t size() const noexcept;
+
+		private:
+			struct State_;
+			std::unique_ptr<State_> mState;
+
+			friend ImageDecoder decode_images( std::vector<ImageRequest>, unsigned );
+	};
+
+	// Starts decoding aRequests with aThreads workers (0 = number of hardware
+	// threads).
+	ImageDecoder decode_images( std::vector<ImageRequest> aRequests, unsigned aThreads = 0 );
+}
@@ -0,0 +1,144 @@
+#include "mapped_file.hpp"
+
+#include <utility>
+
+#include <cassert>
+#include <cstring>
+
+#if defined(_WIN32)
+#	if !defined(WIN32_LEAN_AND_MEAN)
+#		define WIN32_LEAN_AND_MEAN 1
+#	endif
+#	if !defined(NOMINMAX)
+#		define NOMINMAX 1
+#	endif
+#	include <windows.h>
+#else // POSIX
+#	include <cerrno>
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include "error.hpp"
+
+namespace labutils
+{
+	MappedFile::MappedFile() noexcept = default;
+
+	MappedFile::~MappedFile()
+	{
+#		if defined(_WIN32)
+		if( data )
+			UnmapViewOfFile( data );
+		if( mMapping )
+			CloseHandle( mMapping );
+		if( mFile )
+			CloseHandle( mFile );
+#		else // POSIX
+		if( data )
+			munmap( const_cast<std::byte*>(data), size );
+#		endif
+	}
+
+	MappedFile::MappedFile( MappedFile&& aOther ) noexcept
+		: data( std::exchange( aOther.data, nullptr ) )
+		, size( std::exchange( aOther.size, 0 ) )
+#		if defined(_WIN32)
+		, mFile( std::exchange( aOther.mFile, nullptr ) )
+		, mMapping( std::exchange( aOther.mMapping, nullptr ) )
+#		endif
+	{}
+	MappedFile& MappedFile::operator=( MappedFile&& aOther ) noexcept
+	{
+		std::swap( data, aOther.data );
+		std::swap( size, aOther.size );
+#		if defined(_WIN32)
+		std::swap( mFile, aOther.mFile );
+		std::swap( mMapping, aOther.mMapping );
+#		endif
+		return *this;
+	}
+}
+
+namespace labutils
+{
+#	if defined(_WIN32)
+	MappedFile map_file( char const* aPath )
+	{
+		assert( aPath );
+
+		MappedFile ret;
+
+		HANDLE const file = CreateFileA( aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+		if( INVALID_HANDLE_VALUE == file )
+			throw Error( "map_file(): unable to open '%s' for reading (error %lu)", aPath, GetLastError() );
+
+		ret.mFile = file;
+
+		LARGE_INTEGER size{};
+		if( !GetFileSizeEx( file, &size ) )
+			throw Error( "map_file(): unable to query size of '%s' (error %lu)", aPath, GetLastError() );
+
+		if( 0 == size.QuadPart )
+			return ret;
+
+		HANDLE const mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if( !mapping )
+			throw Error( "map_file(): CreateFileMapping() failed for '%s' (error %lu)", aPath, GetLastError() );
+
+		ret.mMapping = mapping;
+
+		void const* view = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+		if( !view )
+			throw Error( "map_file(): MapViewOfFile() failed for '%s' (error %lu)", aPath, GetLastError() );
+
+		ret.data = static_cast<std::byte const*>(view);
+		ret.size = std::size_t(size.QuadPart);
+		return ret;
+	}
+#	else // POSIX
+	MappedFile map_file( char const* aPath )
+	{
+		assert( aPath );
+
+		int const fd = open( aPath, O_RDONLY );
+		if( -1 == fd )
+			throw Error( "map_file(): unable to open '%s' for reading: %s", aPath, std::strerror(errno) );
+
+		struct stat st{};
+		if( 0 != fstat( fd, &st ) )
+		{
+			int const err = errno;
+			close( fd );
+			throw Error( "map_file(): unable to query size of '%s': %s", aPath, std::strerror(err) );
+		}
+
+		MappedFile ret;
+		if( 0 == st.st_size )
+		{
+			close( fd );
+			return ret;
+		}
+
+		void* const ptr = mmap( nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0 );
+		int const err = errno;
+
+		// The mapping keeps its own reference to the file.
+		close( fd );
+
+		if( MAP_FAILED == ptr )
+			throw Error( "map_file(): mmap() failed for '%s': %s", aPath, std::strerror(err) );
+
+		// The loaders walk the file front to back.
+		madvise( ptr, std::size_t(st.st_size), MADV_SEQUENTIAL );
+
+		ret.data = static_cast<std::byte const*>(ptr);
+		ret.size = std::size_t(st.st_size);
+		return ret;
+	}
+#	endif // ~ POSIX
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <utility>
+
+#include <cstddef>
+
+namespace labutils
+{
+	// Read-only memory mapping of a whole file. The mapping stays valid until
+	// the MappedFile object is destroyed; pointers into it must not outlive
+	// the object. Like the other wrappers, MappedFile is move-only.
+	class MappedFile
+	{
+		public:
+			MappedFile() noexcept, ~MappedFile();
+
+			MappedFile( MappedFile const& ) = delete;
+			MappedFile& operator= (MappedFile const&) = delete;
+
+			MappedFile( MappedFile&& ) noexcept;
+			MappedFile& operator = (MappedFile&&) noexcept;
+
+		public:
+			std::byte const* data = nullptr;
+			std::size_t size = 0;
+
+		private:
+			friend MappedFile map_file( char const* );
+
+#			if defined(_WIN32)
+			void* mFile = nullptr;
+			void* mMapping = nullptr;
+#			endif
+	};
+
+	// Map the file at aPath into memory. Throws labutils::Error on failure.
+	// Empty files are permitted and result in data == nullptr and size == 0.
+	MappedFile map_file( char const* aPath );
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
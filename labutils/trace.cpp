@@ -0,0 +1,255 @@
+#include "trace.hpp"
+
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <cstdio>
+#include <cstddef>
+
+#include "error.hpp"
+
+namespace
+{
+	// Fields are atomic so that write_chrome_trace() may read them while the
+	// owning thread records; see read_events_().
+	struct TraceEvent_
+	{
+		std::atomic<char const*> name{ nullptr };
+		std::atomic<std::uint64_t> begin{ 0 }, end{ 0 };
+	};
+
+	struct ThreadTrace_
+	{
+		std::uint32_t id = 0;
+		std::string name; // guarded by TraceRegistry_::mutex
+
+		// Events recorded so far; event i is in slot i % kTraceEventsPerThread
+		std::atomic<std::uint64_t> count{ 0 };
+		std::unique_ptr<TraceEvent_[]> events;
+	};
+
+	struct TraceRegistry_
+	{
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ThreadTrace_>> threads;
+	};
+
+	struct EventCopy_
+	{
+		char const* name;
+		std::uint64_t begin, end;
+	};
+
+	std::atomic<bool> gTraceEnabled_{ false };
+	std::atomic<std::uint64_t> gTraceStart_{ 0 };
+
+	// Never destroyed: threads may still record during static destruction
+	TraceRegistry_& registry_()
+	{
+		static auto* const registry = new TraceRegistry_();
+		return *registry;
+	}
+
+	// Nanoseconds; never 0
+	std::uint64_t now_() noexcept
+	{
+		auto const ns = std::chrono::duration_cast<std::chrono::nanoseconds>( std::chrono::steady_clock::now().time_since_epoch() ).count();
+		return std::uint64_t(ns) | 1;
+	}
+
+	// The calling thread's buffer, registered on first use. Registration
+	// allocates; if it fails, returns nullptr and is retried on the next
+	// call.
+	ThreadTrace_* thread_trace_() noexcept
+	{
+		thread_local ThreadTrace_* trace = nullptr;
+		if( !trace )
+		{
+			try
+			{
+				auto thread = std::make_unique<ThreadTrace_>();
+				thread->events = std::make_unique<TraceEvent_[]>( labutils::kTraceEventsPerThread );
+
+				auto& reg = registry_();
+				std::lock_guard<std::mutex> lock( reg.mutex );
+
+				thread->id = std::uint32_t(reg.threads.size()) + 1;
+				thread->name = "thread " + std::to_string( thread->id );
+
+				auto* const registered = thread.get();
+				reg.threads.emplace_back( std::move(thread) );
+				trace = registered;
+			}
+			catch( ... )
+			{
+				return nullptr;
+			}
+		}
+
+		return trace;
+	}
+
+	// Only the owning thread writes its buffer. The event is published by
+	// the release store of the count. Dropped if the thread's buffer could
+	// not be registered.
+	void record_( char const* aName, std::uint64_t aBegin, std::uint64_t aEnd ) noexcept
+	{
+		auto* const thread = thread_trace_();
+		if( !thread )
+			return;
+
+		auto& trace = *thread;
+
+		auto const index = trace.count.load( std::memory_order_relaxed );
+		auto& event = trace.events[index % labutils::kTraceEventsPerThread];
+
+		event.name.store( aName, std::memory_order_relaxed );
+		event.begin.store( aBegin, std::memory_order_relaxed );
+		event.end.store( aEnd, std::memory_order_relaxed );
+
+		trace.count.store( index + 1, std::memory_order_release );
+	}
+
+	// The retained events of a thread, oldest first. The owning thread may
+	// overwrite slots during the copy; recheck the count afterwards and drop
+	// the events that could have been overwritten (including the one that
+	// may be in progress).
+	std::vector<EventCopy_> read_events_( ThreadTrace_ const& aTrace )
+	{
+		auto const capacity = std::uint64_t(labutils::kTraceEventsPerThread);
+
+		auto const count = aTrace.count.load( std::memory_order_acquire );
+		auto const first = count > capacity ? count - capacity : 0;
+
+		std::vector<EventCopy_> ret;
+		ret.reserve( std::size_t(count - first) );
+
+		for( auto i = first; i < count; ++i )
+		{
+			auto const& event = aTrace.events[i % capacity];
+			ret.emplace_back( EventCopy_{
+				event.name.load( std::memory_order_relaxed ),
+				event.begin.load( std::memory_order_relaxed ),
+				event.end.load( std::memory_order_relaxed )
+			} );
+		}
+
+		std::atomic_thread_fence( std::memory_order_acquire );
+
+		auto const after = aTrace.count.load( std::memory_order_relaxed );
+		auto const valid = after + 1 > capacity ? after + 1 - capacity : 0;
+		if( valid > first )
+			ret.erase( ret.begin(), ret.begin() + std::ptrdiff_t(std::min( valid, count ) - first) );
+
+		return ret;
+	}
+
+	void write_json_string_( std::FILE* aOut, char const* aString )
+	{
+		std::fputc( '"', aOut );
+		for( auto const* ch = aString; *ch; ++ch )
+		{
+			auto const c = static_cast<unsigned char>(*ch);
+			if( '"' == c || '\\' == c )
+				std::fprintf( aOut, "\\%c", c );
+			else if( c < 0x20 )
+				std::fprintf( aOut, "\\u%04x", c );
+			else
+				std::fputc( c, aOut );
+		}
+		std::fputc( '"', aOut );
+	}
+}
+
+namespace labutils
+{
+	void enable_trace( bool aEnable ) noexcept
+	{
+		if( aEnable )
+		{
+			std::uint64_t expected = 0;
+			gTraceStart_.compare_exchange_strong( expected, now_() );
+		}
+
+		gTraceEnabled_.store( aEnable, std::memory_order_relaxed );
+	}
+
+	void set_trace_thread_name( char const* aName )
+	{
+		auto* const trace = thread_trace_();
+		if( !trace )
+			throw Error( "set_trace_thread_name(): unable to register thread '%s'", aName );
+
+		auto& reg = registry_();
+		std::lock_guard<std::mutex> lock( reg.mutex );
+		trace->name = aName;
+	}
+
+	void write_chrome_trace( char const* aPath )
+	{
+		std::unique_ptr<std::FILE, int (*)(std::FILE*)> file( std::fopen( aPath, "w" ), &std::fclose );
+		if( !file )
+			throw Error( "%s: unable to open for writing", aPath );
+
+		auto* const out = file.get();
+		auto const start = gTraceStart_.load( std::memory_order_relaxed );
+
+		auto& reg = registry_();
+		std::lock_guard<std::mutex> lock( reg.mutex );
+
+		// Complete ("X") events, with times in microseconds, and a name per
+		// thread ("M" metadata)
+		std::fprintf( out, "{\"traceEvents\":[\n" );
+
+		bool first = true;
+		auto const separate_ = [&] {
+			if( !first )
+				std::fprintf( out, ",\n" );
+			first = false;
+		};
+
+		for( auto const& thread : reg.threads )
+		{
+			separate_();
+			std::fprintf( out, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", thread->id );
+			write_json_string_( out, thread->name.c_str() );
+			std::fprintf( out, "}}" );
+
+			for( auto const& event : read_events_( *thread ) )
+			{
+				separate_();
+				std::fprintf( out, "{\"name\":" );
+				write_json_string_( out, event.name );
+				std::fprintf( out, ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+					thread->id,
+					double(event.begin - start) * 1e-3,
+					double(event.end - event.begin) * 1e-3
+				);
+			}
+		}
+
+		std::fprintf( out, "\n],\"displayTimeUnit\":\"ms\"}\n" );
+
+		if( std::ferror( out ) )
+			throw Error( "%s: unable to write trace", aPath );
+	}
+
+
+	TraceScope::TraceScope( char const* aName ) noexcept
+		: mName( aName )
+		, mBegin( gTraceEnabled_.load( std::memory_order_relaxed ) ? now_() : 0 )
+	{}
+
+	TraceScope::~TraceScope()
+	{
+		if( 0 != mBegin )
+			record_( mName, mBegin, now_() );
+	}
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
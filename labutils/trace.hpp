@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+
+// CPU trace instrumentation. LUT_TRACE_SCOPE( "name" ) records the time
+// spent in the enclosing scope as an event of the calling thread, once
+// recording has been started with enable_trace(). write_chrome_trace()
+// exports the events as Chrome trace JSON, for chrome://tracing or Perfetto.
+//
+// Each thread records into its own fixed-size ring buffer without locking;
+// only a thread's first event takes a lock, to register its buffer. When a
+// buffer is full, the thread's oldest events are overwritten. Recording
+// never throws: events of a thread whose buffer cannot be allocated are
+// dropped.
+//
+// Instrumentation is compiled in only if LUT_TRACE is nonzero (premake5
+// --trace). Otherwise, LUT_TRACE_SCOPE() expands to nothing, and there is
+// nothing to record or export (kTraceCompiled).
+//
+// Event names are not copied: pass string literals or __func__.
+
+#if !defined(LUT_TRACE)
+#	define LUT_TRACE 0
+#endif
+
+#if LUT_TRACE
+#	define LUT_TRACE_SCOPE( aName ) ::labutils::TraceScope LUT_TRACE_CONCAT_( lutTraceScope_, __LINE__ )( aName )
+#	define LUT_TRACE_CONCAT_( a, b ) LUT_TRACE_CONCAT2_( a, b )
+#	define LUT_TRACE_CONCAT2_( a, b ) a##b
+#else
+#	define LUT_TRACE_SCOPE( aName ) static_cast<void>(0)
+#endif
+
+namespace labutils
+{
+	constexpr bool kTraceCompiled = 0 != LUT_TRACE;
+
+	// At most this many recent events per thread are kept for
+	// write_chrome_trace()
+	constexpr std::uint32_t kTraceEventsPerThread = 1u << 15;
+
+	// Starts or stops recording events; stopped initially. Trace times are
+	// relative to the first start.
+	void enable_trace( bool ) noexcept;
+
+	// Name of the calling thread in exported traces; copied
+	void set_trace_thread_name( char const* aName );
+
+	// Writes the recorded events of all threads, including threads that have
+	// since exited. Best called once the traced work has finished: events
+	// that are overwritten during the export are left out.
+	void write_chrome_trace( char const* aPath );
+
+	// See LUT_TRACE_SCOPE()
+	class TraceScope
+	{
+		public:
+			explicit TraceScope( char const* aName ) noexcept;
+			~TraceScope();
+
+			TraceScope( TraceScope const& ) = delete;
+			TraceScope& operator= (TraceScope const&) = delete;
+
+		private:
+			char const* mName;
+			std::uint64_t mBegin; // 0 if not recording
+	};
+}
+
+//EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab:
@@ -0,0 +1,332 @@
+#include "upload.hpp"
+
+#include <limits>
+#include <utility>
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+#include "error.hpp"
+#include "vkutil.hpp"
+#include "to_string.hpp"
+
+namespace
+{
+	// Like create_buffer(), but takes the raw VmaAllocator
+	labutils::Buffer create_staging_buffer_( VmaAllocator aAllocator, VkDeviceSize aSize )
+	{
+		VkBufferCreateInfo bufferInfo{};
+		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferInfo.size = aSize;
+		bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
+
+		if( auto const res = vmaCreateBuffer( aAllocator, &bufferInfo, &allocInfo, &buffer, &allocation, nullptr ); VK_SUCCESS != res )
+		{
+			throw labutils::Error( "Unable to allocate staging buffer.\n"
+				"vmaCreateBuffer() returned %s", labutils::to_string(res).c_str() );
+		}
+
+		return labutils::Buffer( aAllocator, buffer, allocation );
+	}
+}
+
+namespace labutils
+{
+	UploadBatcher::UploadBatcher() noexcept = default;
+
+	UploadBatcher::~UploadBatcher()
+	{
+		if( VK_NULL_HANDLE == mDevice )
+			return;
+
+		// The destructor must not throw; make sure that nothing is in flight
+		// before the staging memory is released, and ignore errors.
+		if( mRecording )
+		{
+			for( auto& buffer : mSegments[mCurrent].dedicated )
+				vmaUnmapMemory( mAllocator, buffer.allocation );
+		}
+
+		for( auto& segment : mSegments )
+		{
+			if( segment.pending )
+				vkWaitForFences( mDevice, 1, &segment.fence.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max() );
+		}
+
+		if( mMapped )
+			vmaUnmapMemory( mAllocator, mStaging.allocation );
+	}
+
+	UploadBatcher::UploadBatcher( UploadBatcher&& aOther ) noexcept
+		: UploadBatcher()
+	{
+		swap_( aOther );
+	}
+	UploadBatcher& UploadBatcher::operator=( UploadBatcher&& aOther ) noexcept
+	{
+		swap_( aOther );
+		return *this;
+	}
+
+	void UploadBatcher::swap_( UploadBatcher& aOther ) noexcept
+	{
+		std::swap( mDevice, aOther.mDevice );
+		std::swap( mQueue, aOther.mQueue );
+		std::swap( mAllocator, aOther.mAllocator );
+		std::swap( mStaging, aOther.mStaging );
+		std::swap( mMapped, aOther.mMapped );
+		std::swap( mSegmentSize, aOther.mSegmentSize );
+		std::swap( mPool, aOther.mPool );
+		std::swap( mSegments, aOther.mSegments );
+		std::swap( mCurrent, aOther.mCurrent );
+		std::swap( mHead, aOther.mHead );
+		std::swap( mEnd, aOther.mEnd );
+		std::swap( mRecording, aOther.mRecording );
+		std::swap( mStats, aOther.mStats );
+		std::swap( mTiming, aOther.mTiming );
+		std::swap( mStart, aOther.mStart );
+	}
+
+
+	StagingRange UploadBatcher::stage( VkDeviceSize aBytes, VkDeviceSize aAlign )
+	{
+		assert( VK_NULL_HANDLE != mDevice );
+		assert( aAlign > 0 );
+
+		if( !mTiming )
+		{
+			mStart = std::chrono::steady_clock::now();
+			mTiming = true;
+		}
+
+		mStats.bytes += aBytes;
+
+		if( !mRecording )
+			begin_segment_();
+
+		// Too large for the ring: use a dedicated buffer
+		if( aBytes > mSegmentSize )
+		{
+			auto& segment = mSegments[mCurrent];
+
+			Buffer buffer = create_staging_buffer_( mAllocator, aBytes );
+
+			void* ptr = nullptr;
+			if( auto const res = vmaMapMemory( mAllocator, buffer.allocation, &ptr ); VK_SUCCESS != res )
+			{
+				throw Error( "Mapping memory for writing\n"
+					"vmaMapMemory() returned %s", to_string(res).c_str() );
+			}
+
+			auto const handle = buffer.buffer;
+			segment.dedicated.emplace_back( std::move(buffer) );
+
+			return StagingRange{ ptr, handle, 0 };
+		}
+
+		auto offset = (mHead + aAlign - 1) / aAlign * aAlign;
+		if( offset + aBytes > mEnd )
+		{
+			flush();
+			begin_segment_();
+			offset = (mHead + aAlign - 1) / aAlign * aAlign;
+			assert( offset + aBytes <= mEnd );
+		}
+
+		mHead = offset + aBytes;
+		return StagingRange{ mMapped + offset, mStaging.buffer, offset };
+	}
+
+	VkCommandBuffer UploadBatcher::command_buffer()
+	{
+		assert( VK_NULL_HANDLE != mDevice );
+
+		if( !mRecording )
+			begin_segment_();
+
+		return mSegments[mCurrent].cmd;
+	}
+
+	void UploadBatcher::upload_buffer( VkBuffer aDst, VkDeviceSize aDstOffset, void const* aData, VkDeviceSize aBytes )
+	{
+		auto const* src = static_cast<std::byte const*>(aData);
+
+		for( VkDeviceSize done = 0; done < aBytes; )
+		{
+			auto const chunk = std::min( aBytes - done, mSegmentSize );
+			auto const range = stage( chunk, 4 );
+
+			std::memcpy( range.data, src + done, chunk );
+
+			VkBufferCopy copy{};
+			copy.srcOffset = range.offset;
+			copy.dstOffset = aDstOffset + done;
+			copy.size = chunk;
+			vkCmdCopyBuffer( command_buffer(), range.buffer, aDst, 1, &copy );
+
+			done += chunk;
+		}
+	}
+
+	void UploadBatcher::flush()
+	{
+		if( !mRecording )
+			return;
+
+		auto& segment = mSegments[mCurrent];
+
+		// Make the transfers visible to everything that follows on the queue
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+		vkCmdPipelineBarrier( segment.cmd,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr
+		);
+
+		if( auto const res = vkEndCommandBuffer( segment.cmd ); VK_SUCCESS != res )
+		{
+			throw Error( "Ending command buffer recording\n"
+				"vkEndCommandBuffer() returned %s", to_string(res).c_str() );
+		}
+
+		// Host writes must be visible before the submit (no-op for coherent
+		// memory)
+		auto const begin = mCurrent * mSegmentSize;
+		vmaFlushAllocation( mAllocator, mStaging.allocation, begin, mHead - begin );
+
+		for( auto& buffer : segment.dedicated )
+		{
+			vmaFlushAllocation( mAllocator, buffer.allocation, 0, VK_WHOLE_SIZE );
+			vmaUnmapMemory( mAllocator, buffer.allocation );
+		}
+
+		mRecording = false;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &segment.cmd;
+
+		if( auto const res = vkQueueSubmit( mQueue, 1, &submitInfo, segment.fence.handle ); VK_SUCCESS != res )
+		{
+			throw Error( "Submitting commands\n"
+				"vkQueueSubmit() returned %s", to_string(res).c_str() );
+		}
+
+		segment.pending = true;
+		++mStats.submits;
+
+		// The next batch uses the next segment
+		mCurrent = (mCurrent + 1) % mSegments.size();
+	}
+
+	void UploadBatcher::finish()
+	{
+		flush();
+
+		for( auto& segment : mSegments )
+			wait_segment_( segment );
+
+		if( mTiming )
+		{
+			mStats.seconds += std::chrono::duration<double>( std::chrono::steady_clock::now() - mStart ).count();
+			mTiming = false;
+		}
+	}
+
+	void UploadBatcher::wait_segment_( Segment_& aSegment )
+	{
+		if( !aSegment.pending )
+			return;
+
+		if( auto const res = vkWaitForFences( mDevice, 1, &aSegment.fence.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max() ); VK_SUCCESS != res )
+		{
+			throw Error( "Waiting for upload batch\n"
+				"vkWaitForFences() returned %s", to_string(res).c_str() );
+		}
+		if( auto const res = vkResetFences( mDevice, 1, &aSegment.fence.handle ); VK_SUCCESS != res )
+		{
+			throw Error( "Resetting upload fence\n"
+				"vkResetFences() returned %s", to_string(res).c_str() );
+		}
+
+		aSegment.pending = false;
+		aSegment.dedicated.clear();
+	}
+
+	void UploadBatcher::begin_segment_()
+	{
+		assert( !mRecording );
+
+		auto& segment = mSegments[mCurrent];
+
+		// Wait for the batch last submitted from this segment
+		wait_segment_( segment );
+
+		if( auto const res = vkResetCommandBuffer( segment.cmd, 0 ); VK_SUCCESS != res )
+		{
+			throw Error( "Resetting command buffer\n"
+				"vkResetCommandBuffer() returned %s", to_string(res).c_str() );
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if( auto const res = vkBeginCommandBuffer( segment.cmd, &beginInfo ); VK_SUCCESS != res )
+		{
+			throw Error( "Beginning command buffer recording\n"
+				"vkBeginCommandBuffer() returned %s", to_string(res).c_str() );
+		}
+
+		mHead = mCurrent * mSegmentSize;
+		mEnd = mHead + mSegmentSize;
+		mRecording = true;
+	}
+
+
+	UploadBatcher create_upload_batcher( VulkanContext const& aContext, Allocator const& aAllocator, VkDeviceSize aStagingSize, std::uint32_t aSegments )
+	{
+		assert( aSegments > 0 );
+
+		UploadBatcher ret;
+		ret.mDevice = aContext.device;
+		ret.mQueue = aContext.graphicsQueue;
+		ret.mAllocator = aAllocator.allocator;
+
+		// Keep segments aligned, so that aligned offsets within a segment are
+		// aligned in the buffer
+		ret.mSegmentSize = std::max<VkDeviceSize>( aStagingSize / aSegments / 256 * 256, 256 );
+
+		ret.mStaging = create_buffer( aAllocator, ret.mSegmentSize * aSegments, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU );
+
+		void* ptr = nullptr;
+		if( auto const res = vmaMapMemory( aAllocator.allocator, ret.mStaging.allocation, &ptr ); VK_SUCCESS != res )
+		{
+			throw Error( "Mapping staging memory\n"
+				"vmaMapMemory() returned %s", to_string(res).c_str() );
+		}
+		ret.mMapped = static_cast<std::byte*>(ptr);
+
+		ret.mPool = create_command_pool( aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
+
+		ret.mSegments.resize( aSegments );
+		for( auto& segment : ret.mSegments )
+		{
+			segment.cmd = alloc_command_buffer( aContext, ret.mPool.handle );
+			segment.fence = create_fence( aContext );
+		}
+
+		return ret;
+	}
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include <chrono>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "vkbuffer.hpp"
+#include "allocator.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	struct UploadStats
+	{
+		VkDeviceSize bytes = 0;     // bytes staged
+		std::uint32_t submits = 0;  // command buffers submitted
+		double seconds = 0.0;       // from the first staging to finish()
+
+		double megabytes_per_second() const noexcept
+		{
+			return seconds > 0.0 ? double(bytes) / (1024.0*1024.0) / seconds : 0.0;
+		}
+	};
+
+	// Location of staged data. Valid until the batch it belongs to has been
+	// submitted: write to data, then record copies from (buffer, offset).
+	struct StagingRange
+	{
+		void* data;
+		VkBuffer buffer;
+		VkDeviceSize offset;
+	};
+
+	// Batches host-to-device uploads. Data is staged in a persistently mapped
+	// ring buffer that is split into a few segments. Each segment has its own
+	// command buffer and fence; copies are recorded into the current
+	// segment's command buffer, which is submitted (without waiting) when the
+	// segment fills up. Only reusing a segment waits, for the batch that was
+	// last submitted from it. Requests that do not fit into a segment get a
+	// dedicated staging buffer that lives until its batch has completed.
+	//
+	// Each batch ends with a memory barrier that makes the transfer writes
+	// visible to all later commands on the queue. Image layout transitions
+	// remain the caller's responsibility.
+	//
+	// Like the other wrappers, UploadBatcher is move-only.
+	class UploadBatcher
+	{
+		public:
+			UploadBatcher() noexcept, ~UploadBatcher();
+
+			UploadBatcher( UploadBatcher const& ) = delete;
+			UploadBatcher& operator= (UploadBatcher const&) = delete;
+
+			UploadBatcher( UploadBatcher&& ) noexcept;
+			UploadBatcher& operator = (UploadBatcher&&) noexcept;
+
+		public:
+			// Reserves aBytes of staging memory, aligned to aAlign. May
+			// submit the current batch.
+			StagingRange stage( VkDeviceSize aBytes, VkDeviceSize aAlign = 16 );
+
+			// Command buffer of the current batch. It changes when stage()
+			// starts a new batch, so record the commands that use a
+			// StagingRange after staging it.
+			VkCommandBuffer command_buffer();
+
+			// Stages aBytes from aData and records a copy to aDst. Large
+			// uploads are split into segment-sized copies.
+			void upload_buffer( VkBuffer aDst, VkDeviceSize aDstOffset, void const* aData, VkDeviceSize aBytes );
+
+			// Submits the current batch, if any, without waiting.
+			void flush();
+
+			// Submits the current batch and waits for all batches.
+			void finish();
+
+			UploadStats const& stats() const noexcept { return mStats; }
+
+		private:
+			struct Segment_
+			{
+				VkCommandBuffer cmd = VK_NULL_HANDLE;
+				Fence fence;
+				std::vector<Buffer> dedicated;
+				bool pending = false; // submitted, fence not yet waited for
+			};
+
+			friend UploadBatcher create_upload_batcher( VulkanContext const&, Allocator const&, VkDeviceSize, std::uint32_t );
+
+			void begin_segment_();
+			void wait_segment_( Segment_& );
+			void swap_( UploadBatcher& ) noexcept;
+
+			VkDevice mDevice = VK_NULL_HANDLE;
+			VkQueue mQueue = VK_NULL_HANDLE;
+			VmaAllocator mAllocator = VK_NULL_HANDLE;
+
+			Buffer mStaging;
+			std::byte* mMapped = nullptr;
+			VkDeviceSize mSegmentSize = 0;
+
+			CommandPool mPool;
+			std::vector<Segment_> mSegments;
+
+			std::size_t mCurrent = 0;
+			VkDeviceSize mHead = 0, mEnd = 0; // in the current segment
+			bool mRecording = false;
+
+			UploadStats mStats;
+			bool mTiming = false;
+			std::chrono::steady_clock::time_point mStart;
+	};
+
+	// Creates a batcher with aStagingSize bytes of staging memory, split into
+	// aSegments segments. Uses the context's graphics queue.
+	UploadBatcher create_upload_batcher(
+		VulkanContext const&,
+		Allocator const&,
+		VkDeviceSize aStagingSize = 64*1024*1024,
+		std::uint32_t aSegments = 4
+	);
+}
@@ -9,8 +9,6 @@
 #include <cassert>
 #include <cstring> // for std::memcpy()
 
-#include <stb_image.h>
-
 #include "error.hpp"
 #include "vkutil.hpp"
 #include "vkbuffer.hpp"
@@ -82,75 +80,34 @@ namespace labutils
 
 namespace labutils
 {
-	Image load_image_texture2d( char const* aPath, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator , VkFormat aFormat)
+	Image load_image_texture2d( char const* aPath, UploadBatcher& aUploader, Allocator const& aAllocator , VkFormat aFormat)
 	{
-		//throw Error( "Not yet implemented" ); //TODO- (Section 4) implement me!
-		// Flip images vertically by default. 
-		// Vulkan expects the first scanline to be the bottom-most scanline. PNG et 
-		// al. instead define the first scanline to be the top-most one. 
-		stbi_set_flip_vertically_on_load(1);
-		
-		stbi_uc* data;
-		int baseWidthi, baseHeighti, baseChannelsi;
-
 		std::string textureDir = "assets/cw2/" + std::string(aPath);
 
-		if (aFormat == VK_FORMAT_R8G8B8A8_SRGB || aFormat == VK_FORMAT_R8G8B8A8_UNORM) // for base color
-			data = stbi_load(textureDir.c_str(), &baseWidthi, &baseHeighti, &baseChannelsi, 4); // want 4 c h annel s = RGBA 
-		else if (aFormat == VK_FORMAT_R8_UNORM)
-			data = stbi_load(textureDir.c_str(), &baseWidthi, &baseHeighti, &baseChannelsi, 1);
-		
-		
-
-
-		if (!data)
-		{
-			throw Error("%s: unable to load texture base image (%s)", aPath, 0, stbi_failure_reason());
-		}
-		auto const baseWidth = std::uint32_t(baseWidthi);
-		auto const baseHeight = std::uint32_t(baseHeighti);
-
-		// Create staging buffer and copy image data to it 
-		std::size_t sizeInBytes;
-		if (aFormat == VK_FORMAT_R8G8B8A8_SRGB || aFormat == VK_FORMAT_R8G8B8A8_UNORM)
-			sizeInBytes = baseWidth * baseHeight * 4;
-		
-		else if (aFormat == VK_FORMAT_R8_UNORM)
-			sizeInBytes = baseWidth * baseHeight * 1;
-
-		auto staging = create_buffer(aAllocator, sizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+		auto const image = load_image_data(textureDir.c_str(), image_channels(aFormat));
+		return upload_image_texture2d(image, aUploader, aAllocator, aFormat);
+	}
 
-		void* sptr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, staging.allocation, &sptr); VK_SUCCESS != res)
-		{
-			throw Error("Mapping memory for writing\n"
-				"vmaMapMemory() returned %s", to_string(res).c_str());
-		}
+	Image upload_image_texture2d( ImageData const& aImage, UploadBatcher& aUploader, Allocator const& aAllocator, VkFormat aFormat )
+	{
+		assert(aImage.channels == image_channels(aFormat));
 
-		std::memcpy(sptr, data, sizeInBytes);
-		vmaUnmapMemory(aAllocator.allocator, staging.allocation);
+		auto const baseWidth = aImage.width;
+		auto const baseHeight = aImage.height;
 
-		// Free image data 
-		stbi_image_free(data);
+		// Copy image data to staging memory 
+		auto const sizeInBytes = aImage.size_bytes();
+		auto const staging = aUploader.stage(sizeInBytes);
+		std::memcpy(staging.data, aImage.pixels.get(), sizeInBytes);
 
 		// Create image 
 		Image ret = create_image_texture2d(aAllocator, baseWidth, baseHeight,
 			aFormat, VK_IMAGE_USAGE_SAMPLED_BIT |
 			VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
 
-		// Create command buffer for data upload and begin recording
-		VkCommandBuffer cbuff = alloc_command_buffer(aContext, aCmdPool);
-
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
-
-		if (auto const res = vkBeginCommandBuffer(cbuff, &beginInfo); VK_SUCCESS != res)
-		{
-			throw Error("Beginning command buffer recording\n"
-				"vkBeginCommandBuffer() returned %s", to_string(res).c_str());
-		}
+		// Record the upload into the uploader's current batch. This must
+		// happen after staging, which may have started a new batch.
+		VkCommandBuffer cbuff = aUploader.command_buffer();
 
 		// Transition whole image layout 
 		// When copying data to the image, the images layout must be 
@@ -174,7 +131,7 @@ namespace labutils
 
 		// Upload data from staging buffer to image 
 		VkBufferImageCopy copy;
-		copy.bufferOffset = 0;
+		copy.bufferOffset = staging.offset;
 		copy.bufferRowLength = 0;
 		copy.bufferImageHeight = 0;
 		copy.imageSubresource = VkImageSubresourceLayers{
@@ -273,42 +230,8 @@ namespace labutils
 			}
 		);
 
-		// End command recording 
-		if (auto const res = vkEndCommandBuffer(cbuff); VK_SUCCESS != res)
-		{
-			throw Error("Ending command buffer recording\n"
-				"vkEndCommandBuffer() returned %s", to_string(res).c_str());
-		}
-
-		// Submit command buffer and wait for commands to complete 
-		// Commands must have completed before we can destroy the temporary 
-		// resources, such as the staging buffers.
-		Fence uploadComplete = create_fence(aContext);
-
-		VkSubmitInfo submitInfo{};
-
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &cbuff;
-
-		if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
-		{
-			throw Error("Submitting commands\n"
-				"vkQueueSubmit() returned %s", to_string(res).c_str());
-		}
-
-		if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE,
-			std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
-		{
-			throw Error("Waiting for upload to complete\n"
-				"vkWaitForFences() returned %s", to_string(res).c_str());
-		}
-
-		// Return resulting image 
-		// Most temporary resources are destroyed automatically through their 
-		// destructors. However, the command buffer we must free manually. 
-		vkFreeCommandBuffers(aContext.device, aCmdPool, 1, &cbuff);
-
+		// The batch is submitted by the uploader; the staging memory remains
+		// valid until it has completed.
 		return ret;
 	}
 
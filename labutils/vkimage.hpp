@@ -7,6 +7,8 @@
 
 #include <cassert>
 
+#include "upload.hpp"
+#include "image_decoder.hpp"
 #include "allocator.hpp"
 
 namespace labutils
@@ -33,7 +35,14 @@ namespace labutils
 	};
 
 
-	Image load_image_texture2d( char const* aPath, VulkanContext const&, VkCommandPool, Allocator const& , VkFormat);
+	// Loads the image and records its upload (and mipmap generation) into
+	// aUploader's current batch. The image may only be used once the batch
+	// has been submitted, e.g., after aUploader.finish().
+	Image load_image_texture2d( char const* aPath, UploadBatcher& aUploader, Allocator const& , VkFormat);
+
+	// Same, for an already decoded image (see image_decoder.hpp).
+	// aImage.channels must match aFormat.
+	Image upload_image_texture2d( ImageData const& aImage, UploadBatcher& aUploader, Allocator const&, VkFormat );
 
 	Image create_image_texture2d( Allocator const&, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat, VkImageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT );
 
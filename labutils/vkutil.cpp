@@ -133,6 +133,24 @@ namespace labutils
 		return Semaphore(aContext.device, semaphore);
 	}
 
+	QueryPool create_query_pool(VulkanContext const& aContext, VkQueryType aType, std::uint32_t aQueryCount, VkQueryPipelineStatisticFlags aStatistics)
+	{
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = aType;
+		poolInfo.queryCount = aQueryCount;
+		poolInfo.pipelineStatistics = aStatistics;
+
+		VkQueryPool pool = VK_NULL_HANDLE;
+		if (auto const res = vkCreateQueryPool(aContext.device, &poolInfo, nullptr, &pool); VK_SUCCESS != res)
+		{
+			throw Error("Unable to create query pool\n"
+				"vkCreateQueryPool() returned %s", to_string(res).c_str());
+		}
+
+		return QueryPool(aContext.device, pool);
+	}
+
 
 	void buffer_barrier(VkCommandBuffer aCmdBuff, VkBuffer aBuffer, VkAccessFlags aSrcAccessMask,
 		VkAccessFlags aDstAccessMask, VkPipelineStageFlags aSrcStageMask,
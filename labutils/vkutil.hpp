@@ -17,6 +17,9 @@ namespace labutils
 	Fence create_fence(VulkanContext const&, VkFenceCreateFlags = 0);
 	Semaphore create_semaphore(VulkanContext const&);
 
+	// aStatistics for VK_QUERY_TYPE_PIPELINE_STATISTICS pools
+	QueryPool create_query_pool(VulkanContext const&, VkQueryType, std::uint32_t aQueryCount, VkQueryPipelineStatisticFlags aStatistics = 0);
+
 	void buffer_barrier(
 		VkCommandBuffer,
 		VkBuffer,
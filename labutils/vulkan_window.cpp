@@ -20,12 +20,18 @@ namespace lut = labutils;
 
 namespace
 {
+	// Enables the validation layer and debug utils in debug builds, in 
+	// addition to aEnabledExtensions, creates the instance and loads the rest
+	// of the Vulkan API
+	void init_instance( lut::VulkanWindow&, std::vector<char const*> aEnabledExtensions );
+
 	// The device selection process has changed somewhat w.r.t. the one used 
 	// earlier (e.g., with VulkanContext.
 	VkPhysicalDevice select_device( VkInstance, VkSurfaceKHR );
 	float score_device( VkPhysicalDevice, VkSurfaceKHR );
 
 	std::optional<std::uint32_t> find_queue_family( VkPhysicalDevice, VkQueueFlags, VkSurfaceKHR = VK_NULL_HANDLE );
+	std::uint32_t find_memory_type( VkPhysicalDevice, std::uint32_t aMemoryTypeBits, VkMemoryPropertyFlags );
 
 	VkDevice create_device( 
 		VkPhysicalDevice,
@@ -47,6 +53,9 @@ namespace
 
 	void get_swapchain_images( VkDevice, VkSwapchainKHR, std::vector<VkImage>& );
 	void create_swapchain_image_views( VkDevice, VkFormat, std::vector<VkImage> const&, std::vector<VkImageView>& );
+
+	// Offscreen replacement of the swap chain images of headless windows
+	void create_offscreen_images( VkPhysicalDevice, VkDevice, VkFormat, VkExtent2D, std::uint32_t aCount, std::vector<VkImage>&, std::vector<VkDeviceMemory>& );
 }
 
 namespace labutils
@@ -63,6 +72,16 @@ namespace labutils
 		if( VK_NULL_HANDLE != swapchain )
 			vkDestroySwapchainKHR( device, swapchain, nullptr );
 
+		// Offscreen images of headless windows are ours (unlike swap chain 
+		// images)
+		if( VK_NULL_HANDLE == swapchain )
+		{
+			for( auto const image : swapImages )
+				vkDestroyImage( device, image, nullptr );
+			for( auto const memory : offscreenMemory )
+				vkFreeMemory( device, memory, nullptr );
+		}
+
 		// Window and related objects
 		if( VK_NULL_HANDLE != surface )
 			vkDestroySurfaceKHR( instance, surface, nullptr );
@@ -92,6 +111,7 @@ namespace labutils
 		, swapViews( std::move( aOther.swapViews ) )
 		, swapchainFormat( aOther.swapchainFormat )
 		, swapchainExtent( aOther.swapchainExtent )
+		, offscreenMemory( std::move( aOther.offscreenMemory ) )
 	{}
 
 	VulkanWindow& VulkanWindow::operator=( VulkanWindow&& aOther ) noexcept
@@ -106,6 +126,7 @@ namespace labutils
 		std::swap( swapViews, aOther.swapViews );
 		std::swap( swapchainFormat, aOther.swapchainFormat );
 		std::swap( swapchainExtent, aOther.swapchainExtent );
+		std::swap( offscreenMemory, aOther.offscreenMemory );
 		return *this;
 	}
 
@@ -150,13 +171,10 @@ namespace labutils
 			throw lut::Error("GLFW: Vulkan not supported.");
 		}
 
-		// Check for instance layers and extensions
-		auto const supportedLayers = detail::get_instance_layers();
+		// Check for instance extensions
 		auto const supportedExtensions = detail::get_instance_extensions();
 
-		bool enableDebugUtils = false;
-
-		std::vector<char const*> enabledLayers, enabledExensions;
+		std::vector<char const*> enabledExensions;
 
 		//TODO: check that the instance extensions required by GLFW are available,
 		//TODO: and if so, request these to be enabled in the instance creation.
@@ -173,35 +191,8 @@ namespace labutils
 			enabledExensions.emplace_back(requiredExt[i]);
 		}
 
-		// Validation layers support.
-#		if !defined(NDEBUG) // debug builds only
-		if( supportedLayers.count( "VK_LAYER_KHRONOS_validation" ) )
-		{
-			enabledLayers.emplace_back( "VK_LAYER_KHRONOS_validation" );
-		}
-
-		if( supportedExtensions.count( "VK_EXT_debug_utils" ) )
-		{
-			enableDebugUtils = true;
-			enabledExensions.emplace_back( "VK_EXT_debug_utils" );
-		}
-#		endif // ~ debug builds
-
-		for( auto const& layer : enabledLayers )
-			std::fprintf( stderr, "Enabling layer: %s\n", layer );
-
-		for( auto const& extension : enabledExensions )
-			std::fprintf( stderr, "Enabling instance extension: %s\n", extension );
-
 		// Create Vulkan instance
-		ret.instance = detail::create_instance( enabledLayers, enabledExensions, enableDebugUtils );
-
-		// Load rest of the Vulkan API
-		volkLoadInstance( ret.instance );
-
-		// Setup debug messenger
-		if( enableDebugUtils )
-			ret.debugMessenger = detail::create_debug_messenger( ret.instance );
+		init_instance( ret, std::move(enabledExensions) );
 
 		//TODO: create GLFW window
 		// // // Create GLFW Window and the Vulkan surface 
@@ -303,8 +294,67 @@ namespace labutils
 		return ret;
 	}
 
+	// make_vulkan_window_headless()
+	VulkanWindow make_vulkan_window_headless( VkExtent2D aExtent, std::uint32_t aImageCount )
+	{
+		assert( aImageCount > 0 );
+
+		VulkanWindow ret;
+
+		// Initialize Volk
+		if( auto const res = volkInitialize(); VK_SUCCESS != res )
+		{
+			throw lut::Error( "Unable to load Vulkan API\n" 
+				"Volk returned error %s", lut::to_string(res).c_str()
+			);
+		}
+
+		// No surface, hence no window system extensions
+		init_instance( ret, {} );
+
+		// Select appropriate Vulkan device. Without a surface, the device
+		// need not support presentation.
+		ret.physicalDevice = select_device( ret.instance, VK_NULL_HANDLE );
+		if( VK_NULL_HANDLE == ret.physicalDevice )
+			throw lut::Error( "No suitable physical device found!" );
+
+		{
+			VkPhysicalDeviceProperties props;
+			vkGetPhysicalDeviceProperties( ret.physicalDevice, &props );
+			std::fprintf( stderr, "Selected device: %s (%d.%d.%d), headless\n", props.deviceName, VK_API_VERSION_MAJOR(props.apiVersion), VK_API_VERSION_MINOR(props.apiVersion), VK_API_VERSION_PATCH(props.apiVersion) );
+		}
+
+		// Create a logical device with a single GRAPHICS queue, which also
+		// stands in for the present queue. No device extensions are needed.
+		auto const graphics = find_queue_family( ret.physicalDevice, VK_QUEUE_GRAPHICS_BIT );
+		assert( graphics ); // see score_device()
+
+		ret.graphicsFamilyIndex = *graphics;
+		ret.device = create_device( ret.physicalDevice, { *graphics } );
+
+		vkGetDeviceQueue( ret.device, ret.graphicsFamilyIndex, 0, &ret.graphicsQueue );
+		assert( VK_NULL_HANDLE != ret.graphicsQueue );
+
+		ret.presentFamilyIndex = ret.graphicsFamilyIndex;
+		ret.presentQueue = ret.graphicsQueue;
+
+		// Offscreen images in place of the swap chain. R8G8B8A8_SRGB matches
+		// the preferred swap chain format, and every implementation supports
+		// it as a color attachment.
+		ret.swapchainFormat = VK_FORMAT_R8G8B8A8_SRGB;
+		ret.swapchainExtent = aExtent;
+
+		create_offscreen_images( ret.physicalDevice, ret.device, ret.swapchainFormat, ret.swapchainExtent, aImageCount, ret.swapImages, ret.offscreenMemory );
+		create_swapchain_image_views( ret.device, ret.swapchainFormat, ret.swapImages, ret.swapViews );
+
+		// Done
+		return ret;
+	}
+
 	SwapChanges recreate_swapchain( VulkanWindow& aWindow )
 	{
+		assert( VK_NULL_HANDLE != aWindow.swapchain );
+
 		//TODO: implement me!
 		//throw lut::Error( "Not yet implemented!" );
 		// Remember old format & extents 
@@ -604,6 +654,61 @@ namespace
 
 		assert( aViews.size() == aImages.size() );
 	}
+
+	void create_offscreen_images( VkPhysicalDevice aPhysicalDev, VkDevice aDevice, VkFormat aFormat, VkExtent2D aExtent, std::uint32_t aCount, std::vector<VkImage>& aImages, std::vector<VkDeviceMemory>& aMemory )
+	{
+		assert( 0 == aImages.size() && 0 == aMemory.size() );
+
+		for( std::uint32_t i = 0; i < aCount; ++i )
+		{
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = aFormat;
+			imageInfo.extent = VkExtent3D{ aExtent.width, aExtent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			VkImage image = VK_NULL_HANDLE;
+			if( auto const res = vkCreateImage( aDevice, &imageInfo, nullptr, &image ); VK_SUCCESS != res )
+			{
+				throw lut::Error( "Unable to create offscreen image %u\n"
+					"vkCreateImage() returned %s", i, lut::to_string(res).c_str() );
+			}
+
+			// Record the image right away, so that the window destroys it
+			// if anything below fails
+			aImages.emplace_back( image );
+
+			VkMemoryRequirements reqs;
+			vkGetImageMemoryRequirements( aDevice, image, &reqs );
+
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = reqs.size;
+			allocInfo.memoryTypeIndex = find_memory_type( aPhysicalDev, reqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
+
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			if( auto const res = vkAllocateMemory( aDevice, &allocInfo, nullptr, &memory ); VK_SUCCESS != res )
+			{
+				throw lut::Error( "Unable to allocate memory for offscreen image %u\n"
+					"vkAllocateMemory() returned %s", i, lut::to_string(res).c_str() );
+			}
+
+			aMemory.emplace_back( memory );
+
+			if( auto const res = vkBindImageMemory( aDevice, image, memory, 0 ); VK_SUCCESS != res )
+			{
+				throw lut::Error( "Unable to bind memory to offscreen image %u\n"
+					"vkBindImageMemory() returned %s", i, lut::to_string(res).c_str() );
+			}
+		}
+	}
 }
 
 namespace
@@ -645,6 +750,29 @@ namespace
 		return {};
 	}
 
+	// Prefers memory types with all of aProperties, and falls back to any
+	// type allowed by aMemoryTypeBits (e.g., software implementations may
+	// not have DEVICE_LOCAL memory)
+	std::uint32_t find_memory_type( VkPhysicalDevice aPhysicalDev, std::uint32_t aMemoryTypeBits, VkMemoryPropertyFlags aProperties )
+	{
+		VkPhysicalDeviceMemoryProperties props;
+		vkGetPhysicalDeviceMemoryProperties( aPhysicalDev, &props );
+
+		for( std::uint32_t i = 0; i < props.memoryTypeCount; ++i )
+		{
+			if( (aMemoryTypeBits & (1u << i)) && aProperties == (aProperties & props.memoryTypes[i].propertyFlags) )
+				return i;
+		}
+
+		for( std::uint32_t i = 0; i < props.memoryTypeCount; ++i )
+		{
+			if( aMemoryTypeBits & (1u << i) )
+				return i;
+		}
+
+		throw lut::Error( "No memory type among 0x%x", aMemoryTypeBits );
+	}
+
 	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::vector<std::uint32_t> const& aQueues, std::vector<char const*> const& aEnabledExtensions )
 	{
 		if( aQueues.empty() )
@@ -671,9 +799,80 @@ namespace
 			deviceFeatures.samplerAnisotropy = VK_TRUE;
 			std::fprintf(stderr, "Enabling Optional Device Feature: samplerAnisotropy \n");
 		}
+		if (supportedFeatures.textureCompressionBC)
+		{
+			deviceFeatures.textureCompressionBC = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: textureCompressionBC \n");
+		}
+		if (supportedFeatures.shaderSampledImageArrayDynamicIndexing)
+		{
+			deviceFeatures.shaderSampledImageArrayDynamicIndexing = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: shaderSampledImageArrayDynamicIndexing \n");
+		}
+		if (supportedFeatures.multiDrawIndirect)
+		{
+			deviceFeatures.multiDrawIndirect = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: multiDrawIndirect \n");
+		}
+		if (supportedFeatures.drawIndirectFirstInstance)
+		{
+			deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: drawIndirectFirstInstance \n");
+		}
+		// Shader invocation counts (GpuProfiler)
+		if (supportedFeatures.pipelineStatisticsQuery)
+		{
+			deviceFeatures.pipelineStatisticsQuery = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: pipelineStatisticsQuery \n");
+		}
+		// gl_PrimitiveID in fragment shaders (visibility buffer in cw2)
+		if (supportedFeatures.geometryShader)
+		{
+			deviceFeatures.geometryShader = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: geometryShader \n");
+		}
+
+		// Descriptor indexing (core in Vulkan 1.2, which score_device()
+		// requires), for bindless texture arrays
+		VkPhysicalDeviceVulkan12Features supported12{};
+		supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 supported2{};
+		supported2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		supported2.pNext = &supported12;
+		vkGetPhysicalDeviceFeatures2(aPhysicalDev, &supported2);
+
+		VkPhysicalDeviceVulkan12Features features12{};
+		features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+		if (supported12.runtimeDescriptorArray)
+		{
+			features12.runtimeDescriptorArray = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: runtimeDescriptorArray \n");
+		}
+		if (supported12.descriptorBindingPartiallyBound)
+		{
+			features12.descriptorBindingPartiallyBound = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: descriptorBindingPartiallyBound \n");
+		}
+		if (supported12.shaderSampledImageArrayNonUniformIndexing)
+		{
+			features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: shaderSampledImageArrayNonUniformIndexing \n");
+		}
+		if (supported12.drawIndirectCount)
+		{
+			features12.drawIndirectCount = VK_TRUE;
+			std::fprintf(stderr, "Enabling Optional Device Feature: drawIndirectCount \n");
+		}
+
+		VkPhysicalDeviceFeatures2 enabledFeatures{};
+		enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		enabledFeatures.pNext = &features12;
+		enabledFeatures.features = deviceFeatures;
 		
 		VkDeviceCreateInfo deviceInfo{};
 		deviceInfo.sType  = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceInfo.pNext  = &enabledFeatures;
 
 		deviceInfo.queueCreateInfoCount     = std::uint32_t(queueInfos.size());
 		deviceInfo.pQueueCreateInfos        = queueInfos.data();
@@ -681,7 +880,7 @@ namespace
 		deviceInfo.enabledExtensionCount    = std::uint32_t(aEnabledExtensions.size());
 		deviceInfo.ppEnabledExtensionNames  = aEnabledExtensions.data();
 
-		deviceInfo.pEnabledFeatures         = &deviceFeatures;
+		deviceInfo.pEnabledFeatures         = nullptr; // see enabledFeatures
 
 		VkDevice device = VK_NULL_HANDLE;
 		if( auto const res = vkCreateDevice( aPhysicalDev, &deviceInfo, nullptr, &device ); VK_SUCCESS != res )
@@ -697,6 +896,47 @@ namespace
 
 namespace
 {
+	void init_instance( lut::VulkanWindow& aWindow, std::vector<char const*> aEnabledExtensions )
+	{
+		// Check for instance layers and extensions
+		auto const supportedLayers = lut::detail::get_instance_layers();
+		auto const supportedExtensions = lut::detail::get_instance_extensions();
+
+		bool enableDebugUtils = false;
+
+		std::vector<char const*> enabledLayers;
+
+		// Validation layers support.
+#		if !defined(NDEBUG) // debug builds only
+		if( supportedLayers.count( "VK_LAYER_KHRONOS_validation" ) )
+		{
+			enabledLayers.emplace_back( "VK_LAYER_KHRONOS_validation" );
+		}
+
+		if( supportedExtensions.count( "VK_EXT_debug_utils" ) )
+		{
+			enableDebugUtils = true;
+			aEnabledExtensions.emplace_back( "VK_EXT_debug_utils" );
+		}
+#		endif // ~ debug builds
+
+		for( auto const& layer : enabledLayers )
+			std::fprintf( stderr, "Enabling layer: %s\n", layer );
+
+		for( auto const& extension : aEnabledExtensions )
+			std::fprintf( stderr, "Enabling instance extension: %s\n", extension );
+
+		// Create Vulkan instance
+		aWindow.instance = lut::detail::create_instance( enabledLayers, aEnabledExtensions, enableDebugUtils );
+
+		// Load rest of the Vulkan API
+		volkLoadInstance( aWindow.instance );
+
+		// Setup debug messenger
+		if( enableDebugUtils )
+			aWindow.debugMessenger = lut::detail::create_debug_messenger( aWindow.instance );
+	}
+
 	float score_device( VkPhysicalDevice aPhysicalDev, VkSurfaceKHR aSurface )
 	{
 		VkPhysicalDeviceProperties props;
@@ -714,9 +954,11 @@ namespace
 
 		//TODO: additional checks
 		//TODO:  - check that the VK_KHR_swapchain extension is supported
+		// Neither this nor presentation is needed without a surface (headless
+		// windows)
 		auto const exts = lut::detail::get_device_extensions(aPhysicalDev);
 
-		if (!exts.count(VK_KHR_SWAPCHAIN_EXTENSION_NAME))
+		if (VK_NULL_HANDLE != aSurface && !exts.count(VK_KHR_SWAPCHAIN_EXTENSION_NAME))
 		{
 			std::fprintf(stderr, "Info: Discarding device %s: extension %s missing\n",
 				props.deviceName, VK_KHR_SWAPCHAIN_EXTENSION_NAME);
@@ -725,7 +967,7 @@ namespace
 
 		//TODO:  - check that there is a queue family that can present to the
 		//TODO:    given surface
-		if (!find_queue_family(aPhysicalDev, 0, aSurface))
+		if (VK_NULL_HANDLE != aSurface && !find_queue_family(aPhysicalDev, 0, aSurface))
 		{
 			std::fprintf(stderr, "Info: Discarding device %s: cant present to surface\n",
 				props.deviceName);
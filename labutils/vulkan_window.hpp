@@ -39,10 +39,27 @@ namespace labutils
 
 			VkFormat swapchainFormat;
 			VkExtent2D swapchainExtent;
+
+			// Headless windows only (see make_vulkan_window_headless()):
+			// memory of the offscreen images in swapImages, which the window
+			// then owns
+			std::vector<VkDeviceMemory> offscreenMemory;
 	};
 
 	VulkanWindow make_vulkan_window();
 
+	// Headless variant, e.g., for benchmarks on machines without a display.
+	// There is no GLFW window, surface or swap chain (window, surface and
+	// swapchain are null), and VK_KHR_swapchain is not required, so software
+	// implementations such as lavapipe qualify. Instead, swapImages holds
+	// aImageCount offscreen color images of aExtent, which can be rendered to
+	// and copied from (COLOR_ATTACHMENT and TRANSFER_SRC usage). They are
+	// never presented: render passes should leave them in
+	// VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL rather than PRESENT_SRC_KHR, and
+	// frames are submitted without acquiring images. presentQueue is the
+	// graphics queue.
+	VulkanWindow make_vulkan_window_headless( VkExtent2D aExtent, std::uint32_t aImageCount = 2 );
+
 
 	struct SwapChanges
 	{
@@ -50,6 +67,7 @@ namespace labutils
 		bool changedFormat: 1;
 	};
 
+	// Not for headless windows, whose images never change
 	SwapChanges recreate_swapchain( VulkanWindow& );
 }
 
@@ -1,3 +1,9 @@
+-- Options
+newoption {
+	trigger = "trace",
+	description = "Compile in CPU trace instrumentation (see labutils/trace.hpp)"
+}
+
 workspace "COMP5822M-cw2"
 	language "C++"
 	cppdialect "C++17"
@@ -53,6 +59,9 @@ workspace "COMP5822M-cw2"
 		optimize "On"
 		defines { "NDEBUG=1" }
 
+	filter "options:trace"
+		defines { "LUT_TRACE=1" }
+
 	filter "*"
 
 -- Third party dependencies
@@ -116,10 +125,44 @@ project "cw2-bake"
 
 	links "labutils" -- for lut::Error
 	links "x-tgen" -- Task 1.4
+	links "x-stb" -- texture baking
 
 	dependson "x-glm" 
 	dependson "x-rapidobj"
 
+project "cw2-tests"
+	local sources = { 
+		"cw2-tests/**.cpp",
+		"cw2-tests/**.hpp",
+
+		-- CPU-side code under test, and what it depends on
+		"cw2-bake/build_clusters.cpp",
+		"cw2-bake/compress_texture.cpp",
+		"cw2-bake/index_mesh.cpp",
+		"cw2-bake/optimize_mesh.cpp",
+		"cw2/baked_model.cpp",
+		"cw2/benchmark.cpp",
+		"cw2/clustered_lights.cpp",
+		"cw2/culling.cpp",
+		"cw2/deferred.cpp",
+		"cw2/geometry_arena.cpp",
+		"cw2/gpu_culling.cpp",
+		"cw2/indirect.cpp",
+		"cw2/visibility.cpp"
+	}
+
+	kind "ConsoleApp"
+	location "cw2-tests"
+
+	files( sources )
+
+	links "labutils"
+	links "x-volk"
+	links "x-stb"
+	links "x-vma"
+
+	dependson "x-glm" 
+
 project "labutils"
 	local sources = { 
 		"labutils/**.cpp",
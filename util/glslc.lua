@@ -25,6 +25,12 @@ end
 
 local glslc = path.join( shaderc, binname );
 
+-- The SPIR-V is not tracked; it is generated when building cw2-shaders,
+-- which cw2 depends on. Without glslc, neither builds.
+if not os.isfile( glslc ) then
+	print( "Warning: '" .. glslc .. "' not found; cw2-shaders and cw2 will fail to build" );
+end
+
 local glslc_build_command_ = function( kind, ext, opt, opath, ipaths )
 	local istr = "";
 	for _,ipath in ipairs(ipaths) do